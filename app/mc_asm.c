@@ -9,11 +9,13 @@
 #include "mcc/ast.h"
 #include "mcc/ir.h"
 #include "mcc/parser.h"
+#include "mcc/peephole.h"
 #include "mcc/semantic_checks.h"
 #include "mcc/symbol_table.h"
 
 #include "mc_cl_parser.inc"
 #include "mc_get_ast.inc"
+#include "mc_run_passes.inc"
 
 // register datastructures with register_cleanup and they will be deleted on exit
 #include "mc_cleanup.inc"
@@ -88,6 +90,13 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	// ---------------------------------------------------------------------- Remove unreachable functions
+
+	if (!remove_unreachable_functions((&result)->program, command_line->options)) {
+		fprintf(stderr, "Call graph generation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Generate IR
 
 	struct mcc_ir_row *ir = mcc_ir_generate((&result)->program);
@@ -97,15 +106,47 @@ int main(int argc, char *argv[])
 	}
 	register_cleanup(ir);
 
+	// ---------------------------------------------------------------------- Apply or instrument profile
+
+	struct mcc_asm_options asm_options = {.sse2 = command_line->options->sse2,
+	                                      .target = command_line->options->target,
+	                                      .omit_frame_pointer = command_line->options->omit_frame_pointer,
+	                                      .pack_bool_arrays = command_line->options->pack_bool_arrays};
+	bool profiled = apply_profile(ir, command_line->options, &asm_options);
+	register_cleanup(asm_options.profile_header);
+	if (!profiled) {
+		fprintf(stderr, "Profile instrumentation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
+	// ---------------------------------------------------------------------- Optimise IR
+
+	// Vector rows need SSE2 and 4 byte array elements
+	bool vectorize = command_line->options->sse2 && command_line->options->target == MCC_ASM_TARGET_X86;
+	if (command_line->options->vectorize_report && !vectorize)
+		fprintf(stderr, "Loops are only vectorized with -msse2 for the target x86.\n");
+	FILE *report = command_line->options->vectorize_report ? stderr : NULL;
+	if (!run_passes(ir, command_line->options, vectorize, report)) {
+		fprintf(stderr, "IR optimisation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Generate ASM
 
-	struct mcc_asm *code = mcc_asm_generate(ir);
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &asm_options);
 	if (!code) {
 		fprintf(stderr, "Assembly code generation failed. Unknown error.\n");
 		return EXIT_FAILURE;
 	}
 	register_cleanup(code);
 
+	// ---------------------------------------------------------------------- Optimise ASM
+
+	if (!mcc_peephole_run(code)) {
+		fprintf(stderr, "Assembly optimisation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Print ASM
 
 	// Print to file or stdout
@@ -12,6 +12,7 @@
 
 #include "mc_cl_parser.inc"
 #include "mc_get_ast.inc"
+#include "mc_run_passes.inc"
 
 // register datastructures with register_cleanup and they will be deleted on exit
 #include "mc_cleanup.inc"
@@ -87,6 +88,13 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	// ---------------------------------------------------------------------- Remove unreachable functions
+
+	if (!remove_unreachable_functions((&result)->program, command_line->options)) {
+		fprintf(stderr, "Call graph generation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Generate IR
 
 	struct mcc_ir_row *ir = mcc_ir_generate((&result)->program);
@@ -96,6 +104,14 @@ int main(int argc, char *argv[])
 	}
 	register_cleanup(ir);
 
+	// ---------------------------------------------------------------------- Optimise IR
+
+	// The IR is printed for the x86 target without SSE2, which loops are not vectorized for
+	if (!run_passes(ir, command_line->options, false, NULL)) {
+		fprintf(stderr, "IR optimisation failed. Unknown error.\n");
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Print IR
 
 	// Print to file or stdout
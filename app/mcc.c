@@ -11,16 +11,18 @@
 #include "mcc/ast.h"
 #include "mcc/ir.h"
 #include "mcc/parser.h"
+#include "mcc/peephole.h"
 #include "mcc/semantic_checks.h"
 #include "mcc/symbol_table.h"
 
 #include "mc_cl_parser.inc"
 #include "mc_get_ast.inc"
+#include "mc_run_passes.inc"
 
 // register datastructures with register_cleanup and they will be deleted on exit
 #include "mc_cleanup.inc"
 
-bool assemble_and_link(char *binary_filename, bool quiet);
+bool assemble_and_link(char *binary_filename, bool quiet, enum mcc_asm_target target);
 
 int main(int argc, char *argv[])
 {
@@ -102,6 +104,15 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	// ---------------------------------------------------------------------- Remove unreachable functions
+
+	if (!remove_unreachable_functions((&result)->program, command_line->options)) {
+		if (!command_line->options->quiet) {
+			fprintf(stderr, "Call graph generation failed. Unknown error.\n");
+		}
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Generate IR
 
 	struct mcc_ir_row *ir = mcc_ir_generate((&result)->program);
@@ -113,9 +124,35 @@ int main(int argc, char *argv[])
 	}
 	register_cleanup(ir);
 
+	// ---------------------------------------------------------------------- Apply or instrument profile
+
+	struct mcc_asm_options asm_options = {.sse2 = command_line->options->sse2,
+	                                      .target = command_line->options->target,
+	                                      .omit_frame_pointer = command_line->options->omit_frame_pointer,
+	                                      .pack_bool_arrays = command_line->options->pack_bool_arrays};
+	bool profiled = apply_profile(ir, command_line->options, &asm_options);
+	register_cleanup(asm_options.profile_header);
+	if (!profiled) {
+		if (!command_line->options->quiet) {
+			fprintf(stderr, "Profile instrumentation failed. Unknown error.\n");
+		}
+		return EXIT_FAILURE;
+	}
+
+	// ---------------------------------------------------------------------- Optimise IR
+
+	// Vector rows need SSE2 and 4 byte array elements
+	bool vectorize = command_line->options->sse2 && command_line->options->target == MCC_ASM_TARGET_X86;
+	if (!run_passes(ir, command_line->options, vectorize, NULL)) {
+		if (!command_line->options->quiet) {
+			fprintf(stderr, "IR optimisation failed. Unknown error.\n");
+		}
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Generate Assembly
 
-	struct mcc_asm *code = mcc_asm_generate(ir);
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &asm_options);
 	if (!code) {
 		if (!command_line->options->quiet) {
 			fprintf(stderr, "Assembly code generation failed. Unknown error.\n");
@@ -124,6 +161,15 @@ int main(int argc, char *argv[])
 	}
 	register_cleanup(code);
 
+	// ---------------------------------------------------------------------- Optimise Assembly
+
+	if (!mcc_peephole_run(code)) {
+		if (!command_line->options->quiet) {
+			fprintf(stderr, "Assembly optimisation failed. Unknown error.\n");
+		}
+		return EXIT_FAILURE;
+	}
+
 	// ---------------------------------------------------------------------- Save assembly to file
 
 	// Print assembly to file
@@ -141,9 +187,10 @@ int main(int argc, char *argv[])
 
 	bool success = true;
 	if (command_line->options->write_to_file) {
-		success = assemble_and_link(command_line->options->output_file, command_line->options->quiet);
+		success = assemble_and_link(command_line->options->output_file, command_line->options->quiet,
+		                            command_line->options->target);
 	} else {
-		success = assemble_and_link("a.out", command_line->options->quiet);
+		success = assemble_and_link("a.out", command_line->options->quiet, command_line->options->target);
 	}
 	if (!success) {
 		if (!command_line->options->quiet) {
@@ -157,7 +204,7 @@ int main(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
-bool assemble_and_link(char *binary_filename, bool quiet)
+bool assemble_and_link(char *binary_filename, bool quiet, enum mcc_asm_target target)
 {
 	// Create string of command
 	char *cc = NULL;
@@ -169,15 +216,16 @@ bool assemble_and_link(char *binary_filename, bool quiet)
 	} else {
 		cc = env_cc;
 	}
-	int length =
-	    strlen(cc) + strlen(" -m32 -o ") + strlen(binary_filename) + strlen(" a.s ") + strlen(builtins) + 1;
+	char *machine = target == MCC_ASM_TARGET_X86_64 ? "-m64" : "-m32";
+	int length = strlen(cc) + strlen(" ") + strlen(machine) + strlen(" -o ") + strlen(binary_filename) +
+	             strlen(" a.s ") + strlen(builtins) + 1;
 	if (quiet)
 		length += strlen(" &>/dev/null");
 	char callstring[length];
 	if (quiet) {
-		snprintf(callstring, length, "%s -m32 -o %s a.s %s &>/dev/null", cc, binary_filename, builtins);
+		snprintf(callstring, length, "%s %s -o %s a.s %s &>/dev/null", cc, machine, binary_filename, builtins);
 	} else {
-		snprintf(callstring, length, "%s -m32 -o %s a.s %s", cc, binary_filename, builtins);
+		snprintf(callstring, length, "%s %s -o %s a.s %s", cc, machine, binary_filename, builtins);
 	}
 
 	// Call backend compiler
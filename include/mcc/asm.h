@@ -1,7 +1,8 @@
 // Assembly Code generation
 //
 // This module defines the data structures and functions used to generate the assembly code.
-// It is targeting an x86 system and written in AT&T syntax.
+// It is targeting an x86 system and written in AT&T syntax. With the target MCC_ASM_TARGET_X86_64, x86-64 code
+// following the System V calling convention is generated from the same IR instead.
 // Assembly lines are generated "on-the-fly" and automatically appended to the line "current" that is passed in via the
 // mcc_asm_data struct.
 
@@ -11,11 +12,36 @@
 #include "mcc/ir.h"
 #include "mcc/stack_size.h"
 
+enum mcc_asm_target {
+	MCC_ASM_TARGET_X86,
+	MCC_ASM_TARGET_X86_64,
+};
+
+// Options of the code generation
+struct mcc_asm_options {
+	// Compute floats with SSE2 scalar instructions instead of the x87 stack. Always used for MCC_ASM_TARGET_X86_64.
+	bool sse2;
+	enum mcc_asm_target target;
+	// Address the stack frame of functions that call no other function from esp, without setting up ebp
+	bool omit_frame_pointer;
+	// Store the elements of bool arrays in one bit each instead of one byte
+	bool pack_bool_arrays;
+	// Number of counters of the COUNT rows and the description of them the program writes its profile with (see
+	// profile.h). No profile data is emitted if there are no counters.
+	unsigned num_profile_counters;
+	char *profile_header;
+};
+
 // Used for the generation process
 struct mcc_asm_data {
 	bool has_failed;
+	struct mcc_asm_options options;
 	struct mcc_asm_data_section *data_section;
 	struct mcc_asm_line *current;
+	// Reference array whose base address is kept in ecx until the row pinned_until (end of a loop) is generated.
+	// NULL if no base address is kept.
+	char *pinned_array;
+	struct mcc_ir_row *pinned_until;
 };
 
 //---------------------------------------------------------------------------------------- Data structure: ASM
@@ -36,6 +62,8 @@ struct mcc_asm_data_section {
 enum mcc_asm_declaration_type {
 	MCC_ASM_DECLARATION_TYPE_STRING,
 	MCC_ASM_DECLARATION_TYPE_FLOAT,
+	// Zeroed 64 bit counters
+	MCC_ASM_DECLARATION_TYPE_COUNTERS,
 };
 
 struct mcc_asm_declaration {
@@ -44,24 +72,32 @@ struct mcc_asm_declaration {
 	union {
 		double float_value;
 		char *string_value;
+		unsigned num_counters;
 	};
+	// Visible to the other object files, like the runtime in mc_builtins.c
+	bool is_global;
 	struct mcc_asm_declaration *next;
 };
 
 struct mcc_asm_function {
 	char *label;
 	struct mcc_asm_line *head;
+	// Visible to the other object files. On x86, functions that take their arguments in registers are not, since C
+	// callers would pass them on the stack.
+	bool is_global;
 	struct mcc_asm_function *next;
 };
 
 enum mcc_asm_opcode {
 	MCC_ASM_MOVL,
 	MCC_ASM_MOVZBL,
+	MCC_ASM_MOVB,
 	MCC_ASM_CMPL,
 	MCC_ASM_PUSHL,
 	MCC_ASM_POPL,
 	MCC_ASM_LEAVE,
 	MCC_ASM_ADDL,
+	MCC_ASM_ADCL,
 	MCC_ASM_SUBL,
 	MCC_ASM_IMULL,
 	MCC_ASM_IDIVL,
@@ -79,10 +115,22 @@ enum mcc_asm_opcode {
 	MCC_ASM_OR,
 	MCC_ASM_RETURN,
 	MCC_ASM_CALLL,
+	MCC_ASM_JMP,
 	MCC_ASM_XORL,
 	MCC_ASM_NEGL,
+	MCC_ASM_NOTL,
+	MCC_ASM_BTL,
+	MCC_ASM_BTSL,
 	MCC_ASM_JE,
 	MCC_ASM_JNE,
+	MCC_ASM_JL,
+	MCC_ASM_JG,
+	MCC_ASM_JLE,
+	MCC_ASM_JGE,
+	MCC_ASM_JA,
+	MCC_ASM_JAE,
+	MCC_ASM_JB,
+	MCC_ASM_JBE,
 	MCC_ASM_LABEL,
 	MCC_ASM_LEAL,
 	MCC_ASM_FLDS,
@@ -95,6 +143,50 @@ enum mcc_asm_opcode {
 	MCC_ASM_FMULP,
 	MCC_ASM_FDIVP,
 	MCC_ASM_FCHS,
+	MCC_ASM_MOVSS,
+	MCC_ASM_ADDSS,
+	MCC_ASM_SUBSS,
+	MCC_ASM_MULSS,
+	MCC_ASM_DIVSS,
+	MCC_ASM_UCOMISS,
+	MCC_ASM_MOVQ,
+	MCC_ASM_MOVSLQ,
+	MCC_ASM_LEAQ,
+	MCC_ASM_PUSHQ,
+	MCC_ASM_POPQ,
+	MCC_ASM_ADDQ,
+	MCC_ASM_SUBQ,
+	MCC_ASM_CALLQ,
+	MCC_ASM_MOVUPS,
+	MCC_ASM_MOVDQU,
+	MCC_ASM_MOVDQA,
+	MCC_ASM_MOVD,
+	MCC_ASM_UNPCKLPS,
+	MCC_ASM_MOVLHPS,
+	MCC_ASM_PUNPCKLDQ,
+	MCC_ASM_PUNPCKLQDQ,
+	MCC_ASM_ADDPS,
+	MCC_ASM_SUBPS,
+	MCC_ASM_MULPS,
+	MCC_ASM_DIVPS,
+	MCC_ASM_PADDD,
+	MCC_ASM_PSUBD,
+	MCC_ASM_PCMPGTD,
+	MCC_ASM_PAND,
+	MCC_ASM_PANDN,
+	MCC_ASM_POR,
+	MCC_ASM_CLTD,
+	MCC_ASM_SHLL,
+	MCC_ASM_SARL,
+	MCC_ASM_SHRL,
+	MCC_ASM_INCL,
+	MCC_ASM_DECL,
+	MCC_ASM_CMOVE,
+	MCC_ASM_CMOVNE,
+	MCC_ASM_CMOVL,
+	MCC_ASM_CMOVG,
+	MCC_ASM_CMOVLE,
+	MCC_ASM_CMOVGE,
 };
 
 struct mcc_asm_line {
@@ -104,7 +196,7 @@ struct mcc_asm_line {
 			struct mcc_asm_operand *first;
 			struct mcc_asm_operand *second;
 		};
-		// MCC_ASM_LABEL
+		// Lines with an opcode for which mcc_asm_opcode_has_label is true
 		unsigned label;
 	};
 	struct mcc_asm_line *next;
@@ -127,6 +219,24 @@ enum mcc_asm_register {
 	MCC_ASM_EBP,
 	MCC_ASM_ST,
 	MCC_ASM_DL,
+	MCC_ASM_XMM0,
+	MCC_ASM_XMM1,
+	MCC_ASM_XMM2,
+	MCC_ASM_XMM3,
+	MCC_ASM_XMM4,
+	MCC_ASM_XMM5,
+	MCC_ASM_XMM6,
+	MCC_ASM_XMM7,
+	MCC_ASM_RAX,
+	MCC_ASM_RBX,
+	MCC_ASM_RCX,
+	MCC_ASM_RDX,
+	MCC_ASM_RSI,
+	MCC_ASM_RDI,
+	MCC_ASM_R8,
+	MCC_ASM_R9,
+	MCC_ASM_RSP,
+	MCC_ASM_RBP,
 };
 
 struct mcc_asm_operand {
@@ -144,7 +254,10 @@ struct mcc_asm_operand {
 			int offset_size;                     // 4
 		};
 	};
+	// Also added to the address of data operands
 	int offset;
+	// Data operands addressed relative to the instruction pointer, e.g. str_0(%rip)
+	bool rip_relative;
 };
 
 //------------------------------------------------------------------------------------ Functions: Create data structures
@@ -167,6 +280,11 @@ struct mcc_asm_declaration *mcc_asm_new_string_declaration(char *identifier,
                                                            struct mcc_asm_declaration *next,
                                                            struct mcc_asm_data *data);
 
+struct mcc_asm_declaration *mcc_asm_new_counters_declaration(char *identifier,
+                                                             unsigned num_counters,
+                                                             struct mcc_asm_declaration *next,
+                                                             struct mcc_asm_data *data);
+
 struct mcc_asm_function *
 mcc_asm_new_function(char *label, struct mcc_asm_line *head, struct mcc_asm_function *next, struct mcc_asm_data *data);
 
@@ -177,6 +295,9 @@ void mcc_asm_new_line(enum mcc_asm_opcode opcode,
 
 void mcc_asm_new_label(enum mcc_asm_opcode opcode, unsigned label, struct mcc_asm_data *data);
 
+// Label lines and conditional jumps have a label instead of operands
+bool mcc_asm_opcode_has_label(enum mcc_asm_opcode opcode);
+
 struct mcc_asm_operand *mcc_asm_new_function_operand(char *function_name, struct mcc_asm_data *data);
 
 struct mcc_asm_operand *mcc_asm_new_literal_operand(int literal, struct mcc_asm_data *data);
@@ -233,5 +354,8 @@ void mcc_asm_generate_data_section(struct mcc_asm_data_section *data_section,
 
 struct mcc_asm *mcc_asm_generate(struct mcc_ir_row *ir);
 
+// Same as mcc_asm_generate, with the given options instead of the defaults
+struct mcc_asm *mcc_asm_generate_with_options(struct mcc_ir_row *ir, const struct mcc_asm_options *options);
+
 #endif // MCC_ASM_H
 
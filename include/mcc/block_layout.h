@@ -0,0 +1,44 @@
+// Basic Block Layout
+//
+// This module reorders the basic blocks of each function, so that the likely successor of a block follows it and is
+// reached by falling through instead of by a jump. Blocks are emitted in the order the IR generator produced them,
+// which places the else branch behind a jump and leaves rarely taken exits between the hot blocks of a loop.
+// How often a block runs is estimated from its loop depth, every level counting MCC_BLOCK_LAYOUT_LOOP_SCALE times as
+// much. A branch that stays in its loop is taken with MCC_BLOCK_LAYOUT_LOOP_PROBABILITY, otherwise a branch to a block
+// that returns is taken less often than the other one. Both branches are equally likely without a hint.
+// Functions annotated with a profile (see profile.h) take the counts of the blocks as frequencies instead, and the
+// branches of a block in proportion to the counts of their targets.
+// Starting with each block in a chain of its own, the edges are visited by decreasing weight, i.e. frequency of the
+// source times probability, and the chain ending at the source is joined with the chain starting at the target. Ties
+// keep the fall-throughs of the generated order. Back edges do not join chains, so loops stay entered at the top. Nor
+// does the jump of a conditional jump unless its condition is a comparison or negation only it uses, other conditions
+// would need a negation that costs more than the jump saved. The chain of the entry block comes first, the others
+// follow in the order of their first block.
+// Jumps to the block placed next are removed. If the target of a conditional jump is placed next, its condition is
+// inverted with mcc_ir_invert_compare and it jumps to the old fall-through instead; blocks whose successor is no
+// longer placed behind them get a jump to it.
+
+#ifndef MCC_BLOCK_LAYOUT_H
+#define MCC_BLOCK_LAYOUT_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+#include "mcc/pass_manager.h"
+
+// Factor by which a block in a loop runs more often than a block in front of it
+#define MCC_BLOCK_LAYOUT_LOOP_SCALE 8.0
+
+// Probability of a conditional branch to stay in its loop
+#define MCC_BLOCK_LAYOUT_LOOP_PROBABILITY 0.9
+
+// Probability of a conditional branch to a block that returns, if the other one does not
+#define MCC_BLOCK_LAYOUT_RETURN_PROBABILITY 0.3
+
+// Reorder the blocks of all functions of the IR. Returns false if memory allocation fails.
+bool mcc_block_layout_run(struct mcc_ir_row *ir);
+
+// Same, taking the CFG analyses from the cache of the pass manager and invalidating them on every change
+bool mcc_block_layout_run_with_manager(struct mcc_pass_manager *manager);
+
+#endif // MCC_BLOCK_LAYOUT_H
@@ -0,0 +1,49 @@
+// Call Graph
+//
+// This module builds the call graph of a checked program from the function calls in the AST. Each function definition
+// is a node, and there is one edge from a function to every function it calls. Calls of functions without a
+// definition in the AST are not part of the graph.
+// Functions that cannot be reached from main are never executed. They are removed from the AST before the IR is
+// generated, so programs that are linked together with large libraries of mC functions only pay for the functions
+// they use.
+// The graph can be printed in the DOT format, unreachable functions are drawn dashed.
+
+#ifndef MCC_CALL_GRAPH_H
+#define MCC_CALL_GRAPH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mcc/ast.h"
+
+//---------------------------------------------------------------------------------------- Data structure
+
+struct mcc_call_graph_function {
+	struct mcc_ast_function_definition *definition;
+	// Indices of the called functions, each only once
+	unsigned *callees;
+	unsigned num_callees;
+	// Whether main calls the function, directly or not. main reaches itself.
+	bool is_reachable;
+};
+
+struct mcc_call_graph {
+	// In the order of the program
+	struct mcc_call_graph_function *functions;
+	unsigned num_functions;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+// Build the call graph of a program that passed the semantic checks. Returns NULL if memory allocation fails.
+struct mcc_call_graph *mcc_call_graph_build(struct mcc_ast_program *program);
+
+void mcc_call_graph_delete(struct mcc_call_graph *graph);
+
+// Remove the function definitions main does not reach. The first node of the program stays the first node. Nothing is
+// removed from programs without main. Returns false if memory allocation fails.
+bool mcc_call_graph_remove_unreachable(struct mcc_ast_program *program);
+
+void mcc_call_graph_print_dot(FILE *out, struct mcc_call_graph *graph);
+
+#endif // MCC_CALL_GRAPH_H
@@ -5,6 +5,7 @@
 // of the graph.
 // In order to make traversing easier, each node also contains a pointer to the next basic block, inferred from the
 // order they appear in the IR. This essentially enables traversing the CFG as if it was a linked list.
+// Blocks are numbered in that order, starting with 0 for the first block of the IR (or function).
 
 #ifndef MCC_CFG_H
 #define MCC_CFG_H
@@ -15,9 +16,12 @@
 
 struct mcc_basic_block {
 	struct mcc_ir_row *leader;
+	// Last IR row that belongs to the basic block
+	struct mcc_ir_row *last;
 	struct mcc_basic_block *child_left;
 	struct mcc_basic_block *child_right;
 	struct mcc_basic_block *next;
+	unsigned id;
 };
 
 //---------------------------------------------------------------------------------------- Functions: CFG
@@ -28,6 +32,10 @@ struct mcc_basic_block *mcc_cfg_generate(struct mcc_ir_row *ir);
 // Restrict the CFG to just one function
 struct mcc_basic_block *mcc_cfg_limit_to_function(char *function_identifier, struct mcc_basic_block *cfg_first);
 
+// Gives the cfg of the function starting at function_label. Unlike mcc_cfg_generate, the IR is left untouched, so it
+// can still be traversed (and modified) as a whole. Delete the result with mcc_cfg_delete_cfg.
+struct mcc_basic_block *mcc_cfg_generate_function(struct mcc_ir_row *function_label);
+
 //---------------------------------------------------------------------------------------- Functions: Set up datastructs
 
 struct mcc_basic_block *mcc_cfg_new_basic_block(struct mcc_ir_row *leader,
@@ -37,5 +45,8 @@ struct mcc_basic_block *mcc_cfg_new_basic_block(struct mcc_ir_row *leader,
 // Delete CFG and contained IR
 void mcc_delete_cfg_and_ir(struct mcc_basic_block *head);
 
+// Delete CFG but keep the IR
+void mcc_cfg_delete_cfg(struct mcc_basic_block *head);
+
 #endif // MCC_CFG_H
 
@@ -0,0 +1,96 @@
+// CFG Analysis
+//
+// This module provides analyses on the CFG of a single function, as needed by the optimisation passes: predecessors,
+// dominators and natural loops.
+// The CFG is obtained with mcc_cfg_generate_function, so the IR stays intact. Any transformation of the IR
+// invalidates the analysis; it then has to be deleted and computed again.
+
+#ifndef MCC_CFG_ANALYSIS_H
+#define MCC_CFG_ANALYSIS_H
+
+#include <stdbool.h>
+
+#include "mcc/cfg.h"
+#include "mcc/ir.h"
+
+//---------------------------------------------------------------------------------------- Data structure
+
+// Natural loop: all blocks that can reach a back edge to the header without passing through the header.
+// Back edges to the same header are merged into one loop.
+struct mcc_cfg_loop {
+	struct mcc_basic_block *header;
+	// Indexed by block id
+	bool *contains;
+	// Outermost loops have depth 1
+	unsigned depth;
+	struct mcc_cfg_loop *parent;
+	struct mcc_cfg_loop *next;
+};
+
+struct mcc_cfg_row_entry {
+	struct mcc_ir_row *row;
+	struct mcc_basic_block *block;
+};
+
+// Rows of a while loop that tests an identifier against a bound before every iteration:
+//     L: t = i < n; jumpfalse t E; ...; jump L; E:
+// The test may also be i <= n. Such a loop is recognised from the rows alone, without the analysis.
+struct mcc_cfg_counted_loop {
+	// Label row L
+	struct mcc_ir_row *header;
+	// i < n or i <= n, followed by its jumpfalse
+	struct mcc_ir_row *test;
+	struct mcc_ir_row *exit_jump;
+	// Last jump back to the header, the exit label follows it
+	struct mcc_ir_row *back_jump;
+	char *counter;
+};
+
+struct mcc_cfg_analysis {
+	struct mcc_ir_row *function_label;
+	struct mcc_basic_block *cfg;
+	unsigned num_blocks;
+	// Indexed by block id
+	struct mcc_basic_block **blocks;
+	unsigned *num_predecessors;
+	struct mcc_basic_block ***predecessors;
+	bool *is_reachable;
+	// Bit set of the dominators of each block
+	unsigned long **dominators;
+	// Innermost loops come first
+	struct mcc_cfg_loop *loops;
+	// All rows of the function sorted by address, for looking up the block of a row
+	unsigned num_rows;
+	struct mcc_cfg_row_entry *rows;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+// Analyse the function starting at function_label. Returns NULL if memory allocation fails.
+struct mcc_cfg_analysis *mcc_cfg_analyse_function(struct mcc_ir_row *function_label);
+
+void mcc_cfg_delete_analysis(struct mcc_cfg_analysis *analysis);
+
+bool mcc_cfg_dominates(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *a, struct mcc_basic_block *b);
+
+bool mcc_cfg_loop_contains(struct mcc_cfg_loop *loop, struct mcc_basic_block *block);
+
+// Returns NULL if row does not belong to the analysed function
+struct mcc_basic_block *mcc_cfg_get_block_of_row(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *row);
+
+bool mcc_cfg_loop_contains_row(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop, struct mcc_ir_row *row);
+
+// The loop ends with the last jump back to its header. Returns NULL if the label row is no loop header.
+struct mcc_ir_row *mcc_cfg_find_back_jump(struct mcc_ir_row *header);
+
+// Matches the rows from the label row header on against the shape of a counted loop. Returns false if they do not
+// match.
+bool mcc_cfg_match_counted_loop(struct mcc_ir_row *header, struct mcc_cfg_counted_loop *loop);
+
+// Gives the row after which code can be inserted, so that it is executed once every time the loop is entered.
+// If the header is the target of jumps from outside the loop, a new labeled block is put in front of it and those
+// jumps are redirected. Returns NULL if there is no such place or memory allocation fails.
+// The analysis has to be recomputed afterwards.
+struct mcc_ir_row *mcc_cfg_loop_preheader(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop);
+
+#endif // MCC_CFG_ANALYSIS_H
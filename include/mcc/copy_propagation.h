@@ -0,0 +1,30 @@
+// Copy Propagation
+//
+// This module removes the copies the IR generation leaves behind. Every expression is computed into a row of its own
+// and then copied into its variable, and inlining copies the arguments into the parameters and the result into the
+// variable of the call (see inline.h).
+// A variable that is assigned exactly once, with the value of a row, an int or bool literal or another variable that
+// is assigned exactly once, is replaced by that value wherever it is read, and the copy is deleted. The copy has to
+// dominate all reads, so the variable holds the value at every one of them. Float and string literals are loaded from
+// temporaries; a temporary holding the same literal as one whose assignment dominates it is replaced by that one.
+// Before that, assignments whose value is never read are deleted, like the zero a float variable is initialised with,
+// which leaves many variables with a single assignment. The assignments that take the parameters stay, the code
+// generation stores the arguments with them.
+// Finally, temporaries that hold array elements used as indices are assigned and read within one block. Those whose
+// uses do not overlap share one name, and so one stack slot (see stack_size.h).
+
+#ifndef MCC_COPY_PROPAGATION_H
+#define MCC_COPY_PROPAGATION_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+#include "mcc/pass_manager.h"
+
+// Propagate the copies of all functions of the IR. Returns false if memory allocation fails.
+bool mcc_copy_propagation_run(struct mcc_ir_row *ir);
+
+// Same, taking the CFG analyses from the cache of the pass manager and invalidating them on every change
+bool mcc_copy_propagation_run_with_manager(struct mcc_pass_manager *manager);
+
+#endif // MCC_COPY_PROPAGATION_H
@@ -0,0 +1,25 @@
+// Induction Variable Strength Reduction
+//
+// This module finds the basic induction variables of a loop, i.e. integer variables that are assigned exactly once in
+// the loop by adding or subtracting a literal, like i = i + 1. A multiplication of such a variable with a loop
+// invariant factor, e.g. the index of a[i * 4], is replaced by a new variable that is initialised in front of the loop
+// and increased along with the induction variable.
+// If the induction variable is then only used for the loop exit test, the test is rewritten against the new
+// variable and the old increment is removed. This is only done if initial value, bound and factor are literals, so
+// it can be checked that none of the products overflows.
+
+#ifndef MCC_INDUCTION_H
+#define MCC_INDUCTION_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+#include "mcc/pass_manager.h"
+
+// Strength-reduce induction variables in all loops of the IR. Returns false if memory allocation fails.
+bool mcc_induction_run(struct mcc_ir_row *ir);
+
+// Same, taking the CFG analyses from the cache of the pass manager and invalidating them on every change
+bool mcc_induction_run_with_manager(struct mcc_pass_manager *manager);
+
+#endif // MCC_INDUCTION_H
@@ -0,0 +1,23 @@
+// Function Inlining
+//
+// This module replaces calls of small functions by a copy of the called function's IR. Parameters become variables
+// that are assigned the pushed arguments, array parameters are replaced by the passed array. Variables and labels of
+// the copy are renamed, every return becomes an assignment to a result variable and a jump behind the copy.
+// A function is inlined if its size in IR rows is at most the limit, or at most four times the limit if it is called
+// only once. Functions that can call themselves, directly or indirectly, and main are never inlined.
+// With a profile (see profile.h), calls that never ran are not inlined, and calls that ran at least twice per run of
+// their function may inline functions of up to four times the limit as well.
+
+#ifndef MCC_INLINE_H
+#define MCC_INLINE_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+
+#define MCC_INLINE_DEFAULT_LIMIT 30
+
+// Inline calls in the whole IR. A limit of 0 disables inlining. Returns false if memory allocation fails.
+bool mcc_inline_run(struct mcc_ir_row *ir, unsigned limit);
+
+#endif // MCC_INLINE_H
@@ -4,6 +4,7 @@
 // It is implemented as Three Address Code in the form of triples.
 // The result of an instruction that takes two or less arguments is assigned to one variable (either temporary or a
 // variable from the original code).
+// Elements of bool arrays are only moved by assignments from and to variables, other rows read them from temporaries.
 
 #ifndef MCC_IR_H
 #define MCC_IR_H
@@ -56,6 +57,11 @@ enum mcc_ir_instruction {
 	MCC_IR_INSTR_ARRAY,
 	MCC_IR_INSTR_NEGATIV,
 	MCC_IR_INSTR_NOT,
+	// arg1 if it is smaller (greater) than arg2, else arg2. Only generated for vector rows by the loop vectorizer.
+	MCC_IR_INSTR_MIN,
+	MCC_IR_INSTR_MAX,
+	// Increments the profile counter arg1 (a literal index), inserted by mcc_profile_instrument (see profile.h)
+	MCC_IR_INSTR_COUNT,
 	MCC_IR_INSTR_UNKNOWN
 };
 
@@ -101,6 +107,9 @@ enum mcc_ir_row_types {
 struct mcc_ir_row_type {
 	enum mcc_ir_row_types type;
 	signed array_size; // -1 if no array
+	// Number of consecutive array elements a vector row works on at once, 1 for scalar rows. Array element
+	// operands of a vector row stand for the elements starting at the index, other operands for all lanes.
+	unsigned lanes;
 };
 
 struct mcc_ir_row {
@@ -111,6 +120,9 @@ struct mcc_ir_row {
 	struct mcc_ir_arg *arg1;
 	struct mcc_ir_arg *arg2;
 
+	// How often the block of the row ran according to the profile applied by mcc_profile_annotate, -1 if unknown
+	long long profile_count;
+
 	struct mcc_ir_row *prev_row;
 	struct mcc_ir_row *next_row;
 };
@@ -160,6 +172,67 @@ struct mcc_ir_arg *mcc_ir_generate_expression(struct mcc_ast_expression *express
 
 struct mcc_ir_row *mcc_ir_generate(struct mcc_ast_program *ast);
 
+//---------------------------------------------------------------------------------------- Modify IR
+
+// Helpers for passes that transform the generated IR. Constructors return NULL if memory allocation fails.
+
+struct mcc_ir_row_type *mcc_ir_new_row_type(enum mcc_ir_row_types row_type, signed array_size);
+
+struct mcc_ir_row *mcc_ir_new_row(struct mcc_ir_arg *arg1,
+                                  struct mcc_ir_arg *arg2,
+                                  enum mcc_ir_instruction instr,
+                                  struct mcc_ir_row_type *type);
+
+struct mcc_ir_arg *mcc_ir_new_arg_row(struct mcc_ir_row *row);
+
+struct mcc_ir_arg *mcc_ir_new_arg_label(unsigned label);
+
+struct mcc_ir_arg *mcc_ir_new_arg_int(long lit);
+
+// The identifier is copied
+struct mcc_ir_arg *mcc_ir_new_arg_identifier(char *ident);
+
+// The identifier is copied, index is taken over
+struct mcc_ir_arg *mcc_ir_new_arg_array_element(char *ident, struct mcc_ir_arg *index);
+
+// Deep copy, array elements included
+struct mcc_ir_arg *mcc_ir_copy_arg(struct mcc_ir_arg *arg);
+
+void mcc_ir_insert_row_before(struct mcc_ir_row *position, struct mcc_ir_row *row);
+
+void mcc_ir_insert_row_after(struct mcc_ir_row *position, struct mcc_ir_row *row);
+
+// Unlink row from the IR without deleting it
+void mcc_ir_unlink_row(struct mcc_ir_row *row);
+
+// Whether row is past the rows of a function, which is the case at the end of the IR and at the next function label
+bool mcc_ir_is_function_end(struct mcc_ir_row *row);
+
+// Whether the row is one of the comparisons ==, !=, <, >, <= and >=
+bool mcc_ir_is_compare(struct mcc_ir_row *row);
+
+// The comparison that gives the opposite result, e.g. >= for <
+enum mcc_ir_instruction mcc_ir_invert_compare(enum mcc_ir_instruction instr);
+
+// Whether user reads the value of row, also as the index of an array element
+bool mcc_ir_uses_row(struct mcc_ir_row *user, struct mcc_ir_row *row);
+
+// Whether arg is the identifier ident, arg may be NULL
+bool mcc_ir_is_identifier(struct mcc_ir_arg *arg, char *ident);
+
+// Whether arg is the value of row, arg may be NULL
+bool mcc_ir_is_row(struct mcc_ir_arg *arg, struct mcc_ir_row *row);
+
+// Replace every reference to row from head onwards, array indices included, by a copy of arg. Returns false if
+// memory allocation fails.
+bool mcc_ir_replace_row_uses(struct mcc_ir_row *head, struct mcc_ir_row *row, struct mcc_ir_arg *arg);
+
+// Gives a label number that is not used anywhere in the IR that row belongs to
+unsigned mcc_ir_get_unused_label(struct mcc_ir_row *row);
+
+// Renumber the temporaries, e.g. after rows have been moved or added
+void mcc_ir_number_rows(struct mcc_ir_row *head);
+
 //---------------------------------------------------------------------------------------- Cleanup
 
 void mcc_ir_delete_ir_arg(struct mcc_ir_arg *arg);
@@ -0,0 +1,154 @@
+// Instruction Selection
+//
+// This module selects the instructions for int arithmetic with a bottom-up rewrite system (BURS). The code generation
+// builds expression trees over the PLUS, MINUS and MULTIPLY rows of a basic block, where the operand rows that are
+// used only once are folded into the tree of their user. The leaves of a tree are identifiers, array elements, literals
+// and the stack slots of rows that are not folded.
+// Every tree is labelled bottom-up: for each node and nonterminal the cheapest rule that derives the node is kept.
+// The rules are written in src/isel.rules together with the cost model and translated into the table mcc_isel_rules
+// by scripts/gen_isel.py at build time. Emitting the instructions of the selected rules is left to the code
+// generation (see asm.h).
+
+#ifndef MCC_ISEL_H
+#define MCC_ISEL_H
+
+#include <stdbool.h>
+
+#include "mcc/asm.h"
+#include "mcc/ir.h"
+
+#define MCC_ISEL_MAX_PATTERN 7
+
+#define MCC_ISEL_MAX_LEAVES 4
+
+#define MCC_ISEL_MAX_LINES 3
+
+//---------------------------------------------------------------------------------------- Data structure: Rules
+
+// Leaves of patterns come first, they are also the nonterminals a node is labelled with
+enum mcc_isel_symbol {
+	// A value in a register
+	MCC_ISEL_REG,
+	// An identifier, array element or the stack slot of a row
+	MCC_ISEL_MEM,
+	// Any int literal
+	MCC_ISEL_IMM,
+	// The literal 1
+	MCC_ISEL_ONE,
+	// A power of two greater than 1
+	MCC_ISEL_POW2,
+	// The literal 2, 4 or 8, a scale of an address
+	MCC_ISEL_SCALE,
+	// The literal 3, 5 or 9, which leal multiplies with
+	MCC_ISEL_LEA,
+	// 3, 5 or 9 times a power of two greater than 1
+	MCC_ISEL_LEA_POW2,
+	// A power of two greater than 1, plus 1
+	MCC_ISEL_POW2_INC,
+	// A power of two greater than 2, minus 1
+	MCC_ISEL_POW2_DEC,
+	// The literal -1
+	MCC_ISEL_NEG_ONE,
+	// A negated power of two greater than 1
+	MCC_ISEL_NEG_POW2,
+	// The literal -3, -5 or -9
+	MCC_ISEL_NEG_LEA,
+	MCC_ISEL_NUM_LEAVES,
+	MCC_ISEL_PLUS = MCC_ISEL_NUM_LEAVES,
+	MCC_ISEL_MINUS,
+	MCC_ISEL_MULTIPLY,
+};
+
+enum mcc_isel_operand_kind {
+	MCC_ISEL_OPERAND_NONE,
+	// The register of the result
+	MCC_ISEL_OPERAND_RESULT,
+	// The register, memory operand or literal of a leaf
+	MCC_ISEL_OPERAND_LEAF,
+	// The exponent of the power of two in a literal leaf
+	MCC_ISEL_OPERAND_LEAF_LOG,
+	// A literal leaf minus 1, the factor of leal minus 1 for leaves with one
+	MCC_ISEL_OPERAND_LEAF_PRED,
+	// A register that is free while the lines of the rule are emitted
+	MCC_ISEL_OPERAND_SCRATCH,
+	// The address base + index * scale, with the registers of two leaves and a literal leaf
+	MCC_ISEL_OPERAND_ADDRESS,
+	// Same with the literal leaf minus 1 as scale
+	MCC_ISEL_OPERAND_ADDRESS_PRED,
+};
+
+struct mcc_isel_operand {
+	enum mcc_isel_operand_kind kind;
+	// Leaves are counted from 1. leaf is the base register of addresses.
+	unsigned leaf;
+	unsigned index;
+	unsigned scale;
+};
+
+struct mcc_isel_line {
+	enum mcc_asm_opcode opcode;
+	struct mcc_isel_operand first;
+	struct mcc_isel_operand second;
+};
+
+struct mcc_isel_rule {
+	const char *name;
+	enum mcc_isel_symbol lhs;
+	unsigned cost;
+	// Symbols of the pattern in preorder. A pattern of a single leaf is a chain rule.
+	unsigned pattern_length;
+	enum mcc_isel_symbol pattern[MCC_ISEL_MAX_PATTERN];
+	unsigned num_lines;
+	struct mcc_isel_line lines[MCC_ISEL_MAX_LINES];
+};
+
+// Generated from src/isel.rules
+extern const struct mcc_isel_rule mcc_isel_rules[];
+
+extern const unsigned mcc_isel_num_rules;
+
+//---------------------------------------------------------------------------------------- Data structure: Trees
+
+struct mcc_isel_node {
+	// MCC_ISEL_PLUS, MCC_ISEL_MINUS or MCC_ISEL_MULTIPLY for rows, MCC_ISEL_MEM or MCC_ISEL_IMM for leaves
+	enum mcc_isel_symbol symbol;
+	struct mcc_ir_row *row;
+	struct mcc_ir_arg *arg;
+	struct mcc_isel_node *kids[2];
+	// Registers needed to compute the node, counting one for every leaf. That of a literal leaf is the scratch register
+	// of rules that need one.
+	unsigned need;
+	// Set by mcc_isel_label for every nonterminal, UINT_MAX and NULL if the node cannot be derived from it
+	unsigned cost[MCC_ISEL_NUM_LEAVES];
+	const struct mcc_isel_rule *rule[MCC_ISEL_NUM_LEAVES];
+};
+
+//------------------------------------------------------------------------------------ Functions: Trees
+
+// Whether the row is computed by the rules, i.e. an int PLUS, MINUS or MULTIPLY
+bool mcc_isel_is_tree_row(struct mcc_ir_row *row);
+
+// Node of a tree row without kids
+struct mcc_isel_node *mcc_isel_new_row_node(struct mcc_ir_row *row);
+
+// Leaf for an operand of a tree row
+struct mcc_isel_node *mcc_isel_new_leaf(struct mcc_ir_arg *arg);
+
+// Sets the kids of a row node and computes its need. Literal operands of PLUS and MULTIPLY are moved to the right.
+void mcc_isel_set_kids(struct mcc_isel_node *node, struct mcc_isel_node *left, struct mcc_isel_node *right);
+
+void mcc_isel_delete_tree(struct mcc_isel_node *tree);
+
+//------------------------------------------------------------------------------------ Functions: Labelling
+
+// Label all nodes of the tree. Returns false if the root cannot be derived as MCC_ISEL_REG.
+bool mcc_isel_label(struct mcc_isel_node *tree);
+
+// Stores the nodes matched by the leaves of the rule selected for node as nonterminal and the symbols of the leaves,
+// and returns their number. A chain rule matches node itself.
+unsigned mcc_isel_get_leaves(struct mcc_isel_node *node,
+                             enum mcc_isel_symbol nonterminal,
+                             struct mcc_isel_node *leaves[MCC_ISEL_MAX_LEAVES],
+                             enum mcc_isel_symbol symbols[MCC_ISEL_MAX_LEAVES]);
+
+#endif // MCC_ISEL_H
@@ -0,0 +1,22 @@
+// Loop-Invariant Code Motion (LICM)
+//
+// This module moves computations out of loops if their result is the same in every iteration. They are placed in
+// front of the loop header, so they are executed once each time the loop is entered.
+// Since a loop body may not be executed at all, only rows without side effects that cannot trap are moved. Loads of
+// array elements stay in the loop.
+
+#ifndef MCC_LICM_H
+#define MCC_LICM_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+#include "mcc/pass_manager.h"
+
+// Hoist invariant rows out of all loops of the IR. Returns false if memory allocation fails.
+bool mcc_licm_run(struct mcc_ir_row *ir);
+
+// Same, taking the CFG analyses from the cache of the pass manager and invalidating them on every change
+bool mcc_licm_run_with_manager(struct mcc_pass_manager *manager);
+
+#endif // MCC_LICM_H
@@ -0,0 +1,52 @@
+// Liveness Analysis
+//
+// This module computes which variables are live at the beginning and the end of each basic block of a function. The
+// variables are the identifiers of the function and its rows that are used as operands, since the value of a row is
+// held in a stack slot like the value of an identifier. Array elements live in memory and are not tracked.
+// A variable is live at a point if its value may be read later without being assigned before. Identifiers are
+// assigned by ASSIGN rows, rows by themselves.
+// The analysis is computed on top of a CFG analysis (see cfg_analysis.h) and has to be computed again whenever that
+// one is.
+
+#ifndef MCC_LIVENESS_H
+#define MCC_LIVENESS_H
+
+#include <stdbool.h>
+
+#include "mcc/cfg_analysis.h"
+#include "mcc/ir.h"
+
+//---------------------------------------------------------------------------------------- Data structure
+
+// Either ident or row is set
+struct mcc_liveness_variable {
+	char *ident;
+	struct mcc_ir_row *row;
+};
+
+struct mcc_liveness {
+	struct mcc_cfg_analysis *analysis;
+	unsigned num_variables;
+	struct mcc_liveness_variable *variables;
+	// Bit sets of variable numbers, indexed by block id
+	unsigned long **live_in;
+	unsigned long **live_out;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+// Compute the liveness of the variables of the analysed function. Returns NULL if memory allocation fails.
+struct mcc_liveness *mcc_liveness_analyse(struct mcc_cfg_analysis *analysis);
+
+void mcc_liveness_delete(struct mcc_liveness *liveness);
+
+// Number of the variable, or -1 if it does not occur in the function
+int mcc_liveness_find_identifier(struct mcc_liveness *liveness, char *ident);
+
+int mcc_liveness_find_row(struct mcc_liveness *liveness, struct mcc_ir_row *row);
+
+bool mcc_liveness_is_live_in(struct mcc_liveness *liveness, struct mcc_basic_block *block, int variable);
+
+bool mcc_liveness_is_live_out(struct mcc_liveness *liveness, struct mcc_basic_block *block, int variable);
+
+#endif // MCC_LIVENESS_H
@@ -0,0 +1,28 @@
+// Loop Rotation
+//
+// This module moves the condition of while loops to the bottom. A while loop is generated with the condition at the
+// top and an unconditional jump back at the bottom, so every iteration executes two jumps:
+//
+//     L0: condition; jumpfalse L1; body; jump L0; L1:
+//
+// The rotated loop tests the condition once in front of the loop and again at the end of every iteration, where the
+// inverted condition jumps back to the body:
+//
+//     condition; jumpfalse L1; L0: body; inverted condition; jumpfalse L0; L1:
+//
+// Comparisons are inverted by swapping the operator, negations by dropping them, other conditions get a negation.
+// The condition is evaluated as often as before. Only conditions without control flow of their own are copied,
+// conditions with || are left at the top. Loops with a literal condition are not rotated either.
+// The pass runs after the passes that expect loops in the generated shape.
+
+#ifndef MCC_LOOP_ROTATION_H
+#define MCC_LOOP_ROTATION_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+
+// Rotate all while loops of the IR. Returns false if memory allocation fails.
+bool mcc_loop_rotation_run(struct mcc_ir_row *ir);
+
+#endif // MCC_LOOP_ROTATION_H
@@ -0,0 +1,139 @@
+// Pass Manager
+//
+// This module runs the IR optimisation passes in a configurable order. The passes are registered in mcc_passes, each
+// with the lowest optimisation level (-O1, -O2) it is run at. A pipeline is either the passes of a level or an
+// explicit list of pass names, in which passes may also be repeated.
+// Analyses of a function are computed on demand and cached until a pass invalidates them. After each pass, all
+// analyses except those the pass preserves are dropped. Passes that change the IR in between asking for analyses have
+// to invalidate them themselves.
+// Every pass is timed, and the IR can be printed after each pass to see what it changed.
+
+#ifndef MCC_PASS_MANAGER_H
+#define MCC_PASS_MANAGER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mcc/cfg_analysis.h"
+#include "mcc/ir.h"
+#include "mcc/liveness.h"
+
+#define MCC_PASS_MAX_LEVEL 2
+
+//---------------------------------------------------------------------------------------- Data structure
+
+// Bit set of analyses
+enum mcc_pass_analysis {
+	MCC_PASS_ANALYSIS_NONE = 0,
+	// CFG with predecessors, dominators and loops (see cfg_analysis.h)
+	MCC_PASS_ANALYSIS_CFG = 1 << 0,
+	// Liveness of variables (see liveness.h), which is computed on top of the CFG
+	MCC_PASS_ANALYSIS_LIVENESS = 1 << 1,
+	MCC_PASS_ANALYSIS_ALL = MCC_PASS_ANALYSIS_CFG | MCC_PASS_ANALYSIS_LIVENESS,
+};
+
+struct mcc_pass_manager;
+
+struct mcc_pass {
+	const char *name;
+	const char *description;
+	// Lowest optimisation level the pass is run at
+	unsigned level;
+	// Returns false if memory allocation fails
+	bool (*run)(struct mcc_pass_manager *manager);
+	// Analyses that are still valid after the pass has run
+	unsigned preserves;
+};
+
+struct mcc_pass_options {
+	unsigned inline_limit;
+	// Counted loops are unrolled this many times, below 2 they are only unrolled completely
+	unsigned unroll_factor;
+	// Vector rows need SSE2 and the x86 target, the vectorize pass does nothing otherwise
+	bool vectorize;
+	// If not NULL, the vectorize pass tells here why loops were vectorized or not
+	FILE *vectorize_report;
+	// If not NULL, the IR is printed here after every pass
+	FILE *dump;
+};
+
+// Measured when a pass is run
+struct mcc_pass_timing {
+	const struct mcc_pass *pass;
+	double seconds;
+	unsigned rows_before;
+	unsigned rows_after;
+	// Analyses computed while the pass ran
+	unsigned analyses;
+};
+
+// Cached analyses of one function, NULL if not computed or invalidated
+struct mcc_pass_function_analyses {
+	struct mcc_ir_row *function_label;
+	struct mcc_cfg_analysis *cfg;
+	struct mcc_liveness *liveness;
+	struct mcc_pass_function_analyses *next;
+};
+
+struct mcc_pass_manager {
+	// Passes that remove or replace the first row of the IR update this
+	struct mcc_ir_row *ir;
+	struct mcc_pass_options options;
+	unsigned num_passes;
+	const struct mcc_pass **passes;
+	// One for each pass of the pipeline once it has run
+	struct mcc_pass_timing *timings;
+	struct mcc_pass_function_analyses *analyses;
+	// Analyses computed so far
+	unsigned num_computed;
+};
+
+// All passes, in the order the optimisation levels run them
+extern const struct mcc_pass mcc_passes[];
+
+extern const unsigned mcc_num_passes;
+
+//---------------------------------------------------------------------------------------- Functions: Pipeline
+
+// Returns NULL if there is no pass of that name
+const struct mcc_pass *mcc_pass_find(const char *name);
+
+// Whether list is a comma separated list of pass names
+bool mcc_pass_is_valid_list(const char *list);
+
+// Create a manager with an empty pipeline. Without options, all of them are 0 or NULL.
+struct mcc_pass_manager *mcc_pass_manager_new(struct mcc_ir_row *ir, const struct mcc_pass_options *options);
+
+void mcc_pass_manager_delete(struct mcc_pass_manager *manager);
+
+// Append a pass to the pipeline. Returns false if memory allocation fails.
+bool mcc_pass_manager_add(struct mcc_pass_manager *manager, const struct mcc_pass *pass);
+
+// Append all passes of the optimisation level. Level 0 has none.
+bool mcc_pass_manager_add_level(struct mcc_pass_manager *manager, unsigned level);
+
+// Append the passes of a list that is valid according to mcc_pass_is_valid_list
+bool mcc_pass_manager_add_list(struct mcc_pass_manager *manager, const char *list);
+
+// Run the pipeline. Returns false if a pass fails.
+bool mcc_pass_manager_run(struct mcc_pass_manager *manager);
+
+// Print how long each pass took and how it changed the number of IR rows
+void mcc_pass_manager_print_timings(FILE *out, struct mcc_pass_manager *manager);
+
+//---------------------------------------------------------------------------------------- Functions: Analyses
+
+// The cached analyses of the function starting at function_label, computed if needed. Returns NULL if memory
+// allocation fails.
+struct mcc_cfg_analysis *mcc_pass_manager_get_cfg(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label);
+
+struct mcc_liveness *mcc_pass_manager_get_liveness(struct mcc_pass_manager *manager,
+                                                   struct mcc_ir_row *function_label);
+
+// Drop the given analyses of the function, or of all functions if function_label is NULL. Analyses that are computed
+// on top of a dropped one are dropped as well.
+void mcc_pass_manager_invalidate(struct mcc_pass_manager *manager,
+                                 struct mcc_ir_row *function_label,
+                                 unsigned analyses);
+
+#endif // MCC_PASS_MANAGER_H
@@ -0,0 +1,78 @@
+// Peephole Optimisation
+//
+// This module removes redundant instructions from the generated assembly code. A window slides over the lines of each
+// function and is compared against the patterns of a list of rules. If a pattern matches, its lines are replaced by
+// the replacement of the rule.
+// The rules are written in src/peephole.rules and translated into the table mcc_peephole_rules by
+// scripts/gen_peephole.py at build time.
+
+#ifndef MCC_PEEPHOLE_H
+#define MCC_PEEPHOLE_H
+
+#include <stdbool.h>
+
+#include "mcc/asm.h"
+
+#define MCC_PEEPHOLE_MAX_LINES 6
+
+#define MCC_PEEPHOLE_MAX_VARIABLES 4
+
+//---------------------------------------------------------------------------------------- Data structure: Rules
+
+enum mcc_peephole_operand_kind {
+	MCC_PEEPHOLE_OPERAND_NONE,
+	// A register without offset, e.g. %eax
+	MCC_PEEPHOLE_OPERAND_REGISTER,
+	// A literal with the given value, e.g. $0
+	MCC_PEEPHOLE_OPERAND_LITERAL,
+	// Any operand that is not a literal. All uses of a variable match equal operands.
+	MCC_PEEPHOLE_OPERAND_VARIABLE,
+	// Any literal, e.g. $c
+	MCC_PEEPHOLE_OPERAND_LITERAL_VARIABLE,
+	// The label of a label line or a jump
+	MCC_PEEPHOLE_OPERAND_LABEL_VARIABLE,
+};
+
+struct mcc_peephole_operand {
+	enum mcc_peephole_operand_kind kind;
+	union {
+		enum mcc_asm_register reg;
+		int literal;
+		unsigned variable;
+	};
+};
+
+struct mcc_peephole_line {
+	enum mcc_asm_opcode opcode;
+	// Label lines and jumps only use first, which is a label variable
+	struct mcc_peephole_operand first;
+	struct mcc_peephole_operand second;
+};
+
+struct mcc_peephole_rule {
+	const char *name;
+	unsigned pattern_length;
+	struct mcc_peephole_line pattern[MCC_PEEPHOLE_MAX_LINES];
+	unsigned replacement_length;
+	struct mcc_peephole_line replacement[MCC_PEEPHOLE_MAX_LINES];
+};
+
+// Generated from src/peephole.rules
+extern const struct mcc_peephole_rule mcc_peephole_rules[];
+
+extern const unsigned mcc_peephole_num_rules;
+
+//------------------------------------------------------------------------------------ Functions: Peephole optimisation
+
+// Returns the rule with the given name or NULL
+const struct mcc_peephole_rule *mcc_peephole_find_rule(const char *name);
+
+// Apply the rules to the function until none matches anymore. Returns false if memory allocation fails.
+bool mcc_peephole_optimise_function(struct mcc_asm_function *function,
+                                    const struct mcc_peephole_rule *rules,
+                                    unsigned num_rules);
+
+// Apply all rules to all functions. Returns false if memory allocation fails.
+bool mcc_peephole_run(struct mcc_asm *code);
+
+#endif // MCC_PEEPHOLE_H
@@ -0,0 +1,80 @@
+// Profile-Guided Optimisation
+//
+// This module counts how often the basic blocks of a program run, and hands such counts to the passes of a later
+// compilation of the same program.
+// mcc_profile_instrument puts a COUNT row at the start of every block, behind its label and, in the first block of a
+// function, behind the rows that take the parameters. The counters are 64 bits wide and numbered through the whole
+// program. The instrumented program describes them in MCC_PROFILE_HEADER_SYMBOL (see mcc_profile_header), and at exit
+// the runtime in mc_builtins.c adds them to the counts already in the profile file, so the runs of a program merge.
+// Blocks are numbered like in cfg.h, in the order of the IR as generated. A function is identified by its name and a
+// checksum of its CFG, made from the instructions of its rows and the successors of its blocks. Label numbers and
+// names of variables are left out, so a function keeps its profile while other functions change.
+// mcc_profile_annotate sets the profile_count of every row (see ir.h) to the count of its block, if the name,
+// checksum and number of blocks of the function match. Rows the passes add later have no count, and functions
+// without a matching profile keep the static estimates of the passes. The counts are used by
+//   - block_layout.h, as block frequencies and, from the counts of both successors, as branch probabilities,
+//   - inline.h, which leaves calls that never ran and inlines larger functions at calls that run in a loop,
+//   - unroll.h, which leaves loops that never ran and does not unroll loops partially that run fewer iterations than
+//     the factor on average.
+// The profile file is text:
+//
+//     mcc-profile 1
+//     function <name> <checksum in hex> <number of blocks>
+//     <count of block 0>
+//     ...
+
+#ifndef MCC_PROFILE_H
+#define MCC_PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mcc/cfg.h"
+#include "mcc/ir.h"
+
+#define MCC_PROFILE_DEFAULT_FILE "mcc.profile"
+
+#define MCC_PROFILE_VERSION 1
+
+// Symbols of the counters and of their description in the instrumented program
+#define MCC_PROFILE_COUNTERS_SYMBOL "__mcc_profile_counters"
+#define MCC_PROFILE_HEADER_SYMBOL "__mcc_profile_header"
+
+//---------------------------------------------------------------------------------------- Data structure
+
+struct mcc_profile_function {
+	char *name;
+	unsigned long checksum;
+	unsigned num_blocks;
+	// Indexed by block id, NULL in the description of an instrumented IR
+	unsigned long long *counts;
+};
+
+struct mcc_profile {
+	unsigned num_functions;
+	struct mcc_profile_function *functions;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+unsigned long mcc_profile_checksum(struct mcc_basic_block *cfg);
+
+// Insert the counters into all functions of the IR. Gives the functions in the order of their counters, or NULL if
+// memory allocation fails.
+struct mcc_profile *mcc_profile_instrument(struct mcc_ir_row *ir);
+
+unsigned mcc_profile_num_counters(struct mcc_profile *profile);
+
+// Description of the counters for the runtime: the profile file on the first line, then a line with the name,
+// checksum and number of blocks of each function. Returns NULL if memory allocation fails.
+char *mcc_profile_header(struct mcc_profile *profile, const char *file);
+
+// Returns NULL if the profile is malformed or memory allocation fails
+struct mcc_profile *mcc_profile_read(FILE *in);
+
+// Annotate the rows of all functions the profile matches. Returns false if memory allocation fails.
+bool mcc_profile_annotate(struct mcc_ir_row *ir, struct mcc_profile *profile);
+
+void mcc_profile_delete(struct mcc_profile *profile);
+
+#endif // MCC_PROFILE_H
@@ -0,0 +1,30 @@
+// Function Specialization
+//
+// This module clones functions for call sites that pass literal arguments. The clone has the literal parameters bound:
+// they are no longer taken from the caller, and their uses are replaced by the literals up to the first assignment to
+// them or the loop around it. Constants are then propagated through the clone. Integer and boolean rows with literal
+// operands are folded, conditional jumps on literals become jumps or disappear, and rows that cannot be reached
+// anymore are removed. A clone is only kept if this folds at least one row.
+// Call sites that pass the same literals to the same parameters share a clone. The original function is left as it
+// is for all other callers, so its calling convention does not change. Only int and bool parameters are bound, and
+// calls of functions that are not part of the IR, like the builtins, are never specialized.
+// The clones are named after the function with a suffix. Their number per function and their total size in IR rows
+// are bounded.
+
+#ifndef MCC_SPECIALIZE_H
+#define MCC_SPECIALIZE_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+
+// Most clones of one function
+#define MCC_SPECIALIZE_MAX_CLONES 4
+
+// Most IR rows of all clones together
+#define MCC_SPECIALIZE_BUDGET 400
+
+// Specialize calls with literal arguments in the whole IR. Returns false if memory allocation fails.
+bool mcc_specialize_run(struct mcc_ir_row *ir);
+
+#endif // MCC_SPECIALIZE_H
@@ -5,21 +5,40 @@
 // Each entry contains the size on the hardware stack that the line needs, and if it's possible to determine, the offset
 // to the base pointer on the stack.
 // Also string definitions are renamed, so that each string can be declared in the data section of the asm code.
+// Variables and arrays get a slot of their own at the top of the frame. The values of rows, temporaries, share slots
+// below them if their live ranges do not overlap, so the frame only grows with the number of temporaries that are live
+// at the same time.
+// Elements of bool arrays take a byte each, or a single bit if the arrays are packed.
 
 #ifndef MCC_STACK_SIZE_H
 #define MCC_STACK_SIZE_H
 
+#include <stdbool.h>
+
 #include "mcc/ir.h"
 
 #define DWORD_SIZE 4
 
+#define QWORD_SIZE 8
+
 // --------------------------------------------------------------------------------------- Data structure
 
+struct mcc_stack_layout {
+	// Bytes taken by every value and by the elements of int and float arrays
+	int slot_size;
+	// Store the elements of bool arrays in one bit each instead of one byte
+	bool pack_bool_arrays;
+};
+
 struct mcc_annotated_ir {
 	// Hold stack size (number of bytes needed on the stack) of current IR line.
 	// If line is func label, holds stack size of that function
 	int stack_size;
 	int stack_position;
+	// Set by the code generation: the expression tree the instructions of the row are selected from (see isel.h), and
+	// whether the row is computed inside the tree of another row instead
+	struct mcc_isel_node *tree;
+	bool is_folded;
 	struct mcc_annotated_ir *next;
 	struct mcc_annotated_ir *prev;
 	struct mcc_ir_row *row;
@@ -32,6 +51,13 @@ void mcc_delete_annotated_ir(struct mcc_annotated_ir *head);
 // Annotate IR to determine stack size of each IR line. Returned struct needs to be deleted with mcc_delete_annotated_ir
 struct mcc_annotated_ir *mcc_annotate_ir(struct mcc_ir_row *ir);
 
+// Same as mcc_annotate_ir, but every value and element of int and float arrays takes slot_size bytes instead of
+// DWORD_SIZE
+struct mcc_annotated_ir *mcc_annotate_ir_with_slot_size(struct mcc_ir_row *ir, int slot_size);
+
+// Same as mcc_annotate_ir, with the given layout of values and arrays
+struct mcc_annotated_ir *mcc_annotate_ir_with_layout(struct mcc_ir_row *ir, const struct mcc_stack_layout *layout);
+
 // Returns pointer to first IR line of function. Use existing mcc_annotated_ir struct with this function.
 struct mcc_annotated_ir *mcc_get_function_label(struct mcc_annotated_ir *an_ir);
 
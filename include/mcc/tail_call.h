@@ -0,0 +1,21 @@
+// Tail Call Elimination
+//
+// This module removes calls of a function to itself in tail position, i.e. calls whose result is returned right away
+// or calls of a void function that are directly followed by the return. The pushed arguments are assigned to the
+// parameters and the call is replaced by a jump to the start of the function body, so the recursion becomes a loop
+// that runs in constant stack space.
+// Arguments that read variables are first copied to temporaries, so parameters that are passed on in a different
+// position are not overwritten too early. An array parameter must be passed on unchanged.
+// Tail calls of other functions are handled by the assembly code generation, which reuses the frame of the caller.
+
+#ifndef MCC_TAIL_CALL_H
+#define MCC_TAIL_CALL_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+
+// Turn self tail calls in the whole IR into jumps. Returns false if memory allocation fails.
+bool mcc_tail_call_run(struct mcc_ir_row *ir);
+
+#endif // MCC_TAIL_CALL_H
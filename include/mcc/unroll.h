@@ -0,0 +1,42 @@
+// Loop Unrolling
+//
+// This module unrolls counted while loops, i.e. innermost loops of the form
+//
+//     while (i < n) { ...; i = i + c; }
+//
+// with a positive literal step c, where i is assigned nowhere else in the loop and the bound n is a literal or does not
+// change in the loop. The test may also be i <= n.
+// If i is set to a literal right in front of the loop and n is a literal, the number of iterations is known. If the
+// copies of the body for all iterations fit into the budget, the loop is replaced by them. i is a literal in each
+// copy, and sums and products of literals this gives, like the index of a[i + 1], are computed right away.
+// Other loops get a copy in front of them that runs the body factor times for every test, as long as at least that
+// many iterations are left. The test i + (factor - 1) * c < n is done as i < n - (factor - 1) * c, so the subtraction
+// can be done once. The original loop stays behind it and runs the remaining iterations. The factor is lowered until
+// the copies fit into the budget.
+// Loops right behind a vector loop (see vectorize.h) are left alone, they run fewer iterations than a vector has
+// lanes.
+// With a profile (see profile.h), loops that never ran are left alone, and loops that ran fewer iterations than the
+// factor per entry on average are not unrolled partially.
+
+#ifndef MCC_UNROLL_H
+#define MCC_UNROLL_H
+
+#include <stdbool.h>
+
+#include "mcc/ir.h"
+#include "mcc/pass_manager.h"
+
+#define MCC_UNROLL_DEFAULT_FACTOR 4
+
+// Most IR rows the copies of the body of one loop may have together
+#define MCC_UNROLL_BUDGET 64
+
+// Unroll all counted loops of the IR. A factor below 2 only replaces loops by the copies of all iterations. Returns
+// false if memory allocation fails.
+bool mcc_unroll_run(struct mcc_ir_row *ir, unsigned factor);
+
+// Same, with the factor from the options of the pass manager, taking the CFG analyses from its cache and invalidating
+// them on every change
+bool mcc_unroll_run_with_manager(struct mcc_pass_manager *manager);
+
+#endif // MCC_UNROLL_H
@@ -0,0 +1,28 @@
+// Loop Vectorization
+//
+// This module vectorizes counted while loops over int and float arrays, i.e. loops of the form
+//
+//     while (i < n) { ...; i = i + 1; }
+//
+// whose body is straight-line code that accesses arrays only at the index i and does not depend on values of other
+// iterations, except for int sum, minimum and maximum reductions like s = s + a[i] or if (a[i] < m) { m = a[i]; }.
+// A copy of the loop that runs four iterations at once is placed in front of it, made of vector rows (see
+// mcc_ir_row_type) that the code generation turns into packed SSE2 instructions. The original loop stays behind it
+// and runs the remaining iterations. Reductions are accumulated in one array element per lane, which are combined
+// after the vector loop.
+// Vector rows assume array elements of 4 bytes, so the pass may only be run for the x86 target with SSE2. Float
+// reductions are not vectorized, since computing them in a different order changes the result.
+
+#ifndef MCC_VECTORIZE_H
+#define MCC_VECTORIZE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mcc/ir.h"
+
+// Vectorize all loops of the IR that qualify. If report is not NULL, a line is written to it for every loop, telling
+// whether it was vectorized and if not, why. Returns false if memory allocation fails.
+bool mcc_vectorize_run(struct mcc_ir_row *ir, FILE *report);
+
+#endif // MCC_VECTORIZE_H
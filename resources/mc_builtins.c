@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 void __attribute__((cdecl)) print(const char *msg);
 void __attribute__((cdecl)) print_nl(void);
@@ -41,3 +43,100 @@ float read_float(void)
 	return ret;
 }
 
+
+// Profile of a program compiled with -fprofile-generate (see profile.h). The counts of the functions the program
+// describes are added to those already in the profile file for the same checksum. Other functions in the file are kept.
+extern const char __mcc_profile_header[] __attribute__((weak));
+extern unsigned long long __mcc_profile_counters[] __attribute__((weak));
+
+struct profile_function {
+	char name[1024];
+	unsigned long checksum;
+	unsigned num_blocks;
+	unsigned long long *counts;
+	int is_written;
+};
+
+static struct profile_function *read_profile(const char *file, unsigned *num_functions)
+{
+	*num_functions = 0;
+	FILE *in = fopen(file, "r");
+	if (!in)
+		return NULL;
+	struct profile_function *functions = NULL;
+	unsigned version = 0;
+	if (fscanf(in, " mcc-profile %u", &version) != 1 || version != 1) {
+		fclose(in);
+		return NULL;
+	}
+	struct profile_function function = {.is_written = 0};
+	while (fscanf(in, " function %1023s %lx %u", function.name, &function.checksum, &function.num_blocks) == 3) {
+		function.counts = calloc(function.num_blocks + 1, sizeof(*function.counts));
+		struct profile_function *grown = realloc(functions, sizeof(*functions) * (*num_functions + 1));
+		if (!function.counts || !grown) {
+			free(function.counts);
+			if (grown)
+				functions = grown;
+			break;
+		}
+		functions = grown;
+		for (unsigned i = 0; i < function.num_blocks; i++) {
+			if (fscanf(in, "%llu", &function.counts[i]) != 1)
+				break;
+		}
+		functions[(*num_functions)++] = function;
+	}
+	fclose(in);
+	return functions;
+}
+
+static void __attribute__((destructor)) write_profile(void)
+{
+	if (!__mcc_profile_header || !__mcc_profile_counters)
+		return;
+	char file[4096];
+	const char *line = strchr(__mcc_profile_header, '\n');
+	if (!line || (size_t)(line - __mcc_profile_header) >= sizeof(file))
+		return;
+	memcpy(file, __mcc_profile_header, line - __mcc_profile_header);
+	file[line - __mcc_profile_header] = '\0';
+
+	unsigned num_old = 0;
+	struct profile_function *old = read_profile(file, &num_old);
+	FILE *out = fopen(file, "w");
+	if (!out) {
+		free(old);
+		return;
+	}
+	fprintf(out, "mcc-profile 1\n");
+	unsigned long long *counters = __mcc_profile_counters;
+	struct profile_function function;
+	int length = 0;
+	while (sscanf(line, " %1023s %lx %u%n", function.name, &function.checksum, &function.num_blocks, &length) == 3) {
+		line += length;
+		// A function of another checksum has changed, its old counts are dropped
+		struct profile_function *merged = NULL;
+		for (unsigned i = 0; i < num_old; i++) {
+			if (strcmp(old[i].name, function.name) != 0)
+				continue;
+			old[i].is_written = 1;
+			if (old[i].checksum == function.checksum && old[i].num_blocks == function.num_blocks)
+				merged = &old[i];
+		}
+		fprintf(out, "function %s %lx %u\n", function.name, function.checksum, function.num_blocks);
+		for (unsigned i = 0; i < function.num_blocks; i++)
+			fprintf(out, "%llu\n", counters[i] + (merged ? merged->counts[i] : 0));
+		counters += function.num_blocks;
+	}
+	for (unsigned i = 0; i < num_old; i++) {
+		if (old[i].is_written)
+			continue;
+		fprintf(out, "function %s %lx %u\n", old[i].name, old[i].checksum, old[i].num_blocks);
+		for (unsigned j = 0; j < old[i].num_blocks; j++)
+			fprintf(out, "%llu\n", old[i].counts[j]);
+	}
+	fclose(out);
+	for (unsigned i = 0; i < num_old; i++)
+		free(old[i].counts);
+	free(old);
+}
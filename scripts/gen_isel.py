@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+#
+# Translates the instruction selection rules (src/isel.rules) into the C table mcc_isel_rules.
+#
+# usage: gen_isel.py <rules-file> <output-file>
+
+import re
+import sys
+
+MAX_PATTERN = 7
+MAX_LEAVES = 4
+MAX_LINES = 3
+
+LEAVES = ['reg', 'mem', 'imm', 'one', 'pow2', 'scale', 'lea', 'lea_pow2', 'pow2_inc', 'pow2_dec', 'neg_one', 'neg_pow2',
+          'neg_lea']
+LITERAL_LEAVES = {'imm', 'one', 'pow2', 'scale', 'lea', 'lea_pow2', 'pow2_inc', 'pow2_dec', 'neg_one', 'neg_pow2',
+                  'neg_lea'}
+POWER_LEAVES = {'pow2', 'lea_pow2', 'pow2_inc', 'pow2_dec', 'neg_pow2'}
+OPERATORS = ['PLUS', 'MINUS', 'MULTIPLY']
+
+
+class RuleError(Exception):
+    pass
+
+
+def symbol_name(symbol):
+    return 'MCC_ISEL_' + symbol.upper()
+
+
+def parse_pattern(text):
+    """Returns the symbols of the pattern in preorder"""
+    tokens = re.findall(r'\w+|[(),]', text)
+    position = 0
+
+    def parse():
+        nonlocal position
+        if position >= len(tokens):
+            raise RuleError('incomplete pattern "%s"' % text)
+        token = tokens[position]
+        position += 1
+        if token in LEAVES:
+            return [token]
+        if token not in OPERATORS:
+            raise RuleError('unknown symbol "%s"' % token)
+        symbols = [token]
+        for separator in ['(', None, ',', None, ')']:
+            if separator is None:
+                symbols += parse()
+            elif position >= len(tokens) or tokens[position] != separator:
+                raise RuleError('expected "%s" in pattern "%s"' % (separator, text))
+            else:
+                position += 1
+        return symbols
+
+    symbols = parse()
+    if position != len(tokens):
+        raise RuleError('unexpected "%s" in pattern "%s"' % (tokens[position], text))
+    if len(symbols) > MAX_PATTERN:
+        raise RuleError('pattern "%s" has more than %d symbols' % (text, MAX_PATTERN))
+    return symbols
+
+
+def parse_cost(text, costs):
+    total = 0
+    for term in text.split('+'):
+        term = term.strip()
+        if re.fullmatch(r'\d+', term):
+            total += int(term)
+        elif term in costs:
+            total += costs[term]
+        else:
+            raise RuleError('unknown cost "%s"' % term)
+    return total
+
+
+def leaf_number(text, leaves):
+    number = int(text)
+    if number < 1 or number > len(leaves):
+        raise RuleError('the pattern has no leaf $%d' % number)
+    return number
+
+
+def parse_operand(text, leaves):
+    match = re.fullmatch(r'\(\$(\d+),\$(\d+),\$(\d+)(\.pred)?\)', text)
+    if match:
+        base, index, scale = (leaf_number(match.group(i), leaves) for i in (1, 2, 3))
+        if leaves[base - 1] != 'reg' or leaves[index - 1] != 'reg':
+            raise RuleError('the registers of "%s" must be reg leaves' % text)
+        if leaves[scale - 1] not in LITERAL_LEAVES:
+            raise RuleError('the scale of "%s" must be a literal leaf' % text)
+        kind = 'MCC_ISEL_OPERAND_ADDRESS_PRED' if match.group(4) else 'MCC_ISEL_OPERAND_ADDRESS'
+        return (kind, base, index, scale)
+    if text == '$0':
+        return ('MCC_ISEL_OPERAND_RESULT', 0, 0, 0)
+    if text == '$t':
+        # The register a literal leaf counts in the need of a node is free for it
+        if not any(leaf in LITERAL_LEAVES for leaf in leaves):
+            raise RuleError('"$t" needs a literal leaf in the pattern')
+        return ('MCC_ISEL_OPERAND_SCRATCH', 0, 0, 0)
+    match = re.fullmatch(r'\$(\d+)(\.log|\.pred)?', text)
+    if not match:
+        raise RuleError('invalid operand "%s"' % text)
+    leaf = leaf_number(match.group(1), leaves)
+    if match.group(2) == '.log' and leaves[leaf - 1] not in POWER_LEAVES:
+        raise RuleError('"%s" needs a leaf with a power of two' % text)
+    if match.group(2) == '.pred' and leaves[leaf - 1] not in LITERAL_LEAVES:
+        raise RuleError('"%s" needs a literal leaf' % text)
+    kind = {None: 'MCC_ISEL_OPERAND_LEAF', '.log': 'MCC_ISEL_OPERAND_LEAF_LOG',
+            '.pred': 'MCC_ISEL_OPERAND_LEAF_PRED'}[match.group(2)]
+    return (kind, leaf, 0, 0)
+
+
+def parse_line(text, leaves):
+    parts = text.split(None, 1)
+    operands = re.findall(r'\([^)]*\)|[^,\s]+', parts[1]) if len(parts) > 1 else []
+    if len(operands) > 2:
+        raise RuleError('more than two operands in "%s"' % text)
+    operands = [parse_operand(o, leaves) for o in operands]
+    # Memory operands of array elements load their index into ebx right before the line
+    mem = [o for o in operands if o[0] == 'MCC_ISEL_OPERAND_LEAF' and leaves[o[1] - 1] == 'mem']
+    if len(mem) > 1:
+        raise RuleError('more than one memory operand in "%s"' % text)
+    return ('MCC_ASM_' + parts[0].upper(), operands)
+
+
+def parse_rules(text):
+    costs = {}
+    rules = []
+    rule = None
+    for number, raw in enumerate(text.splitlines(), 1):
+        line = raw.split('#', 1)[0].strip()
+        if not line:
+            continue
+        try:
+            if line.startswith('cost '):
+                match = re.fullmatch(r'cost\s+(\w+)\s+(\d+)', line)
+                if not match:
+                    raise RuleError('invalid cost "%s"' % line)
+                costs[match.group(1)] = int(match.group(2))
+            elif line.startswith('rule '):
+                match = re.fullmatch(r'rule\s+(\w+)\s+(\w+)\s*:\s*([^=]+?)\s*(?:=\s*(.+))?', line)
+                if not match:
+                    raise RuleError('invalid rule "%s"' % line)
+                if match.group(2) != 'reg':
+                    raise RuleError('rules can only derive reg')
+                pattern = parse_pattern(match.group(3))
+                if pattern == ['reg']:
+                    raise RuleError('reg cannot be derived from itself')
+                leaves = [s for s in pattern if s in LEAVES]
+                if len(leaves) > MAX_LEAVES:
+                    raise RuleError('more than %d leaves' % MAX_LEAVES)
+                cost = parse_cost(match.group(4), costs) if match.group(4) else 0
+                rule = {'name': match.group(1), 'lhs': match.group(2), 'cost': cost, 'pattern': pattern,
+                        'leaves': leaves, 'lines': []}
+                rules.append(rule)
+            elif rule is None:
+                raise RuleError('line outside of a rule')
+            else:
+                rule['lines'].append(parse_line(line, rule['leaves']))
+        except RuleError as error:
+            sys.exit('%d: %s' % (number, error))
+
+    names = set()
+    for rule in rules:
+        if rule['name'] in names:
+            sys.exit('rule %s: defined twice' % rule['name'])
+        names.add(rule['name'])
+        if len(rule['lines']) > MAX_LINES:
+            sys.exit('rule %s: more than %d lines' % (rule['name'], MAX_LINES))
+        if len(rule['pattern']) == 1 and not rule['lines']:
+            sys.exit('rule %s: a chain rule has to emit the value into $0' % rule['name'])
+    return rules
+
+
+def operand_to_c(operand):
+    return '{%s, %d, %d, %d}' % operand
+
+
+def line_to_c(line):
+    opcode, operands = line
+    operands = [operand_to_c(o) for o in operands]
+    operands += ['{MCC_ISEL_OPERAND_NONE, 0, 0, 0}'] * (2 - len(operands))
+    return '{%s, %s, %s}' % (opcode, operands[0], operands[1])
+
+
+def lines_to_c(lines):
+    if not lines:
+        return '{{0}}'
+    return '{\n' + ''.join('            %s,\n' % line_to_c(line) for line in lines) + '        }'
+
+
+def rules_to_c(rules, source):
+    out = ['// Generated by scripts/gen_isel.py from %s, do not edit.\n' % source,
+           '\n',
+           '#include "mcc/isel.h"\n',
+           '\n',
+           'const struct mcc_isel_rule mcc_isel_rules[] = {\n']
+    for rule in rules:
+        out.append('    {\n')
+        out.append('        "%s",\n' % rule['name'])
+        out.append('        %s,\n' % symbol_name(rule['lhs']))
+        out.append('        %d,\n' % rule['cost'])
+        out.append('        %d,\n' % len(rule['pattern']))
+        out.append('        {%s},\n' % ', '.join(symbol_name(s) for s in rule['pattern']))
+        out.append('        %d,\n' % len(rule['lines']))
+        out.append('        %s,\n' % lines_to_c(rule['lines']))
+        out.append('    },\n')
+    out.append('};\n')
+    out.append('\n')
+    out.append('const unsigned mcc_isel_num_rules = sizeof(mcc_isel_rules) / sizeof(mcc_isel_rules[0]);\n')
+    return ''.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gen_isel.py <rules-file> <output-file>')
+    with open(sys.argv[1]) as rules_file:
+        rules = parse_rules(rules_file.read())
+    with open(sys.argv[2], 'w') as output_file:
+        output_file.write(rules_to_c(rules, 'src/isel.rules'))
+
+
+if __name__ == '__main__':
+    main()
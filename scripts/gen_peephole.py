@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# Translates the peephole rules (src/peephole.rules) into the C table mcc_peephole_rules.
+#
+# usage: gen_peephole.py <rules-file> <output-file>
+
+import re
+import sys
+
+MAX_LINES = 6
+MAX_VARIABLES = 4
+
+REGISTERS = {'eax', 'ebx', 'ecx', 'edx', 'esp', 'ebp', 'st', 'dl', 'xmm0'}
+LABEL_OPCODES = {'label', 'je', 'jne', 'jl', 'jg', 'jle', 'jge', 'ja', 'jae', 'jb', 'jbe'}
+OPCODES = {'ret': 'RETURN'}
+
+
+class RuleError(Exception):
+    pass
+
+
+def opcode_name(mnemonic):
+    return 'MCC_ASM_' + OPCODES.get(mnemonic, mnemonic.upper())
+
+
+def parse_operand(text, variables, is_label):
+    if is_label:
+        if not re.fullmatch(r'[A-Za-z_]\w*', text):
+            raise RuleError('invalid label "%s"' % text)
+        return ('MCC_PEEPHOLE_OPERAND_LABEL_VARIABLE', variable(text, variables))
+    if text.startswith('%'):
+        if text[1:] not in REGISTERS:
+            raise RuleError('unknown register "%s"' % text)
+        return ('MCC_PEEPHOLE_OPERAND_REGISTER', 'MCC_ASM_' + text[1:].upper())
+    if re.fullmatch(r'\$-?\d+', text):
+        return ('MCC_PEEPHOLE_OPERAND_LITERAL', text[1:])
+    if re.fullmatch(r'\$[A-Za-z_]\w*', text):
+        return ('MCC_PEEPHOLE_OPERAND_LITERAL_VARIABLE', variable(text[1:], variables))
+    if re.fullmatch(r'[A-Za-z_]\w*', text):
+        return ('MCC_PEEPHOLE_OPERAND_VARIABLE', variable(text, variables))
+    raise RuleError('invalid operand "%s"' % text)
+
+
+def variable(name, variables):
+    if name not in variables:
+        if len(variables) == MAX_VARIABLES:
+            raise RuleError('more than %d variables' % MAX_VARIABLES)
+        variables[name] = len(variables)
+    return str(variables[name])
+
+
+def parse_line(text, variables, is_replacement):
+    parts = text.split(None, 1)
+    mnemonic = parts[0]
+    operands = [o.strip() for o in parts[1].split(',')] if len(parts) > 1 else []
+    if len(operands) > 2:
+        raise RuleError('more than two operands in "%s"' % text)
+    is_label = mnemonic in LABEL_OPCODES
+    if is_label and len(operands) != 1:
+        raise RuleError('"%s" needs exactly one label' % mnemonic)
+    for operand in operands:
+        name = operand.lstrip('$')
+        if is_replacement and re.fullmatch(r'[A-Za-z_]\w*', name) and name not in variables:
+            raise RuleError('variable "%s" is not bound by the pattern' % name)
+    return (opcode_name(mnemonic), [parse_operand(o, variables, is_label) for o in operands])
+
+
+def parse_rules(text):
+    rules = []
+    rule = None
+    for number, raw in enumerate(text.splitlines(), 1):
+        line = raw.split('#', 1)[0].strip()
+        if not line:
+            continue
+        try:
+            if line.startswith('rule '):
+                rule = {'name': line[5:].strip(), 'pattern': [], 'replacement': [], 'variables': {},
+                        'in_replacement': False}
+                rules.append(rule)
+            elif rule is None:
+                raise RuleError('line outside of a rule')
+            elif line == '=>':
+                rule['in_replacement'] = True
+            else:
+                part = 'replacement' if rule['in_replacement'] else 'pattern'
+                rule[part].append(parse_line(line, rule['variables'], rule['in_replacement']))
+        except RuleError as error:
+            sys.exit('%d: %s' % (number, error))
+
+    names = set()
+    for rule in rules:
+        if rule['name'] in names:
+            sys.exit('rule %s: defined twice' % rule['name'])
+        names.add(rule['name'])
+        if not rule['pattern'] or len(rule['pattern']) > MAX_LINES:
+            sys.exit('rule %s: the pattern needs 1 to %d lines' % (rule['name'], MAX_LINES))
+        if len(rule['replacement']) >= len(rule['pattern']):
+            sys.exit('rule %s: the replacement must be shorter than the pattern' % rule['name'])
+    return rules
+
+
+def operand_to_c(operand):
+    kind, value = operand
+    field = {
+        'MCC_PEEPHOLE_OPERAND_REGISTER': 'reg',
+        'MCC_PEEPHOLE_OPERAND_LITERAL': 'literal',
+    }.get(kind, 'variable')
+    return '{%s, {.%s = %s}}' % (kind, field, value)
+
+
+def line_to_c(line):
+    opcode, operands = line
+    operands = [operand_to_c(o) for o in operands]
+    operands += ['{MCC_PEEPHOLE_OPERAND_NONE, {0}}'] * (2 - len(operands))
+    return '{%s, %s, %s}' % (opcode, operands[0], operands[1])
+
+
+def lines_to_c(lines):
+    if not lines:
+        return '{{0}}'
+    return '{\n' + ''.join('            %s,\n' % line_to_c(line) for line in lines) + '        }'
+
+
+def rules_to_c(rules, source):
+    out = ['// Generated by scripts/gen_peephole.py from %s, do not edit.\n' % source,
+           '\n',
+           '#include "mcc/peephole.h"\n',
+           '\n',
+           'const struct mcc_peephole_rule mcc_peephole_rules[] = {\n']
+    for rule in rules:
+        out.append('    {\n')
+        out.append('        "%s",\n' % rule['name'])
+        out.append('        %d,\n' % len(rule['pattern']))
+        out.append('        %s,\n' % lines_to_c(rule['pattern']))
+        out.append('        %d,\n' % len(rule['replacement']))
+        out.append('        %s,\n' % lines_to_c(rule['replacement']))
+        out.append('    },\n')
+    out.append('};\n')
+    out.append('\n')
+    out.append('const unsigned mcc_peephole_num_rules = sizeof(mcc_peephole_rules) / sizeof(mcc_peephole_rules[0]);\n')
+    return ''.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gen_peephole.py <rules-file> <output-file>')
+    with open(sys.argv[1]) as rules_file:
+        rules = parse_rules(rules_file.read())
+    with open(sys.argv[2], 'w') as output_file:
+        output_file.write(rules_to_c(rules, 'src/peephole.rules'))
+
+
+if __name__ == '__main__':
+    main()
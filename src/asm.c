@@ -1,12 +1,15 @@
 #include "mcc/asm.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "mcc/ir.h"
+#include "mcc/isel.h"
+#include "mcc/profile.h"
 #include "mcc/stack_size.h"
 #include "utils/length_of_int.h"
 
@@ -31,7 +34,8 @@ static bool arg_is_local_array(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg
 	return false;
 }
 
-static int get_identifier_offset(struct mcc_annotated_ir *first, char *ident)
+// First assignment of ident in the function of first. It declares the variable and determines its stack slot.
+static struct mcc_annotated_ir *get_identifier_declaration(struct mcc_annotated_ir *first, char *ident)
 {
 	assert(first);
 	assert(ident);
@@ -45,16 +49,22 @@ static int get_identifier_offset(struct mcc_annotated_ir *first, char *ident)
 			if (strncmp(ident, "$tmp", 4) == 0) {
 				const char *tmp = &ident[1];
 				if (strcmp(first->row->arg1->ident, tmp) == 0) {
-					return first->stack_position;
+					return first;
 				}
 			}
 			if (strcmp(first->row->arg1->ident, ident) == 0) {
-				return first->stack_position;
+				return first;
 			}
 		}
 		first = first->next;
 	}
-	return 0;
+	return NULL;
+}
+
+static int get_identifier_offset(struct mcc_annotated_ir *first, char *ident)
+{
+	struct mcc_annotated_ir *declaration = get_identifier_declaration(first, ident);
+	return declaration ? declaration->stack_position : 0;
 }
 
 static int get_row_offset(struct mcc_annotated_ir *an_ir, struct mcc_ir_row *row)
@@ -165,6 +175,7 @@ struct mcc_asm_declaration *mcc_asm_new_float_declaration(char *identifier,
 	new->float_value = float_value;
 	new->next = next;
 	new->type = MCC_ASM_DECLARATION_TYPE_FLOAT;
+	new->is_global = false;
 	return new;
 }
 
@@ -187,6 +198,30 @@ struct mcc_asm_declaration *mcc_asm_new_string_declaration(char *identifier,
 	new->string_value = string_value;
 	new->next = next;
 	new->type = MCC_ASM_DECLARATION_TYPE_STRING;
+	new->is_global = false;
+	return new;
+}
+
+struct mcc_asm_declaration *mcc_asm_new_counters_declaration(char *identifier,
+                                                             unsigned num_counters,
+                                                             struct mcc_asm_declaration *next,
+                                                             struct mcc_asm_data *data)
+{
+	if (data->has_failed || !identifier)
+		return NULL;
+	struct mcc_asm_declaration *new = malloc(sizeof(*new));
+	char *id_new = strdup(identifier);
+	if (!new || !id_new) {
+		data->has_failed = true;
+		free(new);
+		free(id_new);
+		return NULL;
+	}
+	new->identifier = id_new;
+	new->num_counters = num_counters;
+	new->next = next;
+	new->type = MCC_ASM_DECLARATION_TYPE_COUNTERS;
+	new->is_global = true;
 	return new;
 }
 
@@ -205,6 +240,7 @@ mcc_asm_new_function(char *label, struct mcc_asm_line *head, struct mcc_asm_func
 	}
 	new->head = head;
 	new->label = lab_new;
+	new->is_global = true;
 	new->next = next;
 	return new;
 }
@@ -251,6 +287,26 @@ void mcc_asm_new_label(enum mcc_asm_opcode opcode, unsigned label, struct mcc_as
 	data->current = new;
 }
 
+bool mcc_asm_opcode_has_label(enum mcc_asm_opcode opcode)
+{
+	switch (opcode) {
+	case MCC_ASM_LABEL:
+	case MCC_ASM_JE:
+	case MCC_ASM_JNE:
+	case MCC_ASM_JL:
+	case MCC_ASM_JG:
+	case MCC_ASM_JLE:
+	case MCC_ASM_JGE:
+	case MCC_ASM_JA:
+	case MCC_ASM_JAE:
+	case MCC_ASM_JB:
+	case MCC_ASM_JBE:
+		return true;
+	default:
+		return false;
+	}
+}
+
 struct mcc_asm_operand *mcc_asm_new_function_operand(char *function_name, struct mcc_asm_data *data)
 {
 	struct mcc_asm_operand *new = malloc(sizeof(*new));
@@ -264,6 +320,7 @@ struct mcc_asm_operand *mcc_asm_new_function_operand(char *function_name, struct
 	new->type = MCC_ASM_OPERAND_FUNCTION;
 	new->func_name = func_name_new;
 	new->offset = 0;
+	new->rip_relative = false;
 	return new;
 }
 
@@ -277,6 +334,7 @@ struct mcc_asm_operand *mcc_asm_new_literal_operand(int literal, struct mcc_asm_
 	new->type = MCC_ASM_OPERAND_LITERAL;
 	new->literal = literal;
 	new->offset = 0;
+	new->rip_relative = false;
 	return new;
 }
 
@@ -290,6 +348,7 @@ struct mcc_asm_operand *mcc_asm_new_register_operand(enum mcc_asm_register reg,
 	new->type = MCC_ASM_OPERAND_REGISTER;
 	new->reg = reg;
 	new->offset = offset;
+	new->rip_relative = false;
 	return new;
 }
 
@@ -309,6 +368,8 @@ struct mcc_asm_operand *mcc_asm_new_computed_offset_operand(int offset_initial,
 	new->offset_base = offset_base;
 	new->offset_factor = offset_factor;
 	new->offset_size = offset_size;
+	new->offset = 0;
+	new->rip_relative = false;
 	return new;
 }
 
@@ -322,11 +383,71 @@ struct mcc_asm_operand *mcc_asm_new_data_operand(struct mcc_asm_declaration *dec
 	new->type = MCC_ASM_OPERAND_DATA;
 	new->decl = decl;
 	new->offset = 0;
+	new->rip_relative = false;
 	return new;
 }
 
 //------------------------------------------------------------------------------------ Functions: Registers
 
+static bool is_x86_64(struct mcc_asm_data *data)
+{
+	return data->options.target == MCC_ASM_TARGET_X86_64;
+}
+
+// Registers holding addresses are 64 bits wide on x86-64
+static enum mcc_asm_register address_register(enum mcc_asm_register reg, struct mcc_asm_data *data)
+{
+	if (!is_x86_64(data))
+		return reg;
+	switch (reg) {
+	case MCC_ASM_EAX:
+		return MCC_ASM_RAX;
+	case MCC_ASM_EBX:
+		return MCC_ASM_RBX;
+	case MCC_ASM_ECX:
+		return MCC_ASM_RCX;
+	case MCC_ASM_EDX:
+		return MCC_ASM_RDX;
+	case MCC_ASM_ESP:
+		return MCC_ASM_RSP;
+	case MCC_ASM_EBP:
+		return MCC_ASM_RBP;
+	default:
+		return reg;
+	}
+}
+
+// Opcode for moving addresses, e.g. movq instead of movl on x86-64
+static enum mcc_asm_opcode address_opcode(enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+{
+	if (!is_x86_64(data))
+		return opcode;
+	switch (opcode) {
+	case MCC_ASM_MOVL:
+		return MCC_ASM_MOVQ;
+	case MCC_ASM_LEAL:
+		return MCC_ASM_LEAQ;
+	case MCC_ASM_PUSHL:
+		return MCC_ASM_PUSHQ;
+	case MCC_ASM_POPL:
+		return MCC_ASM_POPQ;
+	case MCC_ASM_ADDL:
+		return MCC_ASM_ADDQ;
+	case MCC_ASM_SUBL:
+		return MCC_ASM_SUBQ;
+	case MCC_ASM_CALLL:
+		return MCC_ASM_CALLQ;
+	default:
+		return opcode;
+	}
+}
+
+// Size of a stack slot and of the elements of int and float arrays
+static int slot_size(struct mcc_asm_data *data)
+{
+	return is_x86_64(data) ? QWORD_SIZE : DWORD_SIZE;
+}
+
 static struct mcc_asm_operand *eax(struct mcc_asm_data *data)
 {
 	return mcc_asm_new_register_operand(MCC_ASM_EAX, 0, data);
@@ -337,11 +458,6 @@ static struct mcc_asm_operand *ebx(struct mcc_asm_data *data)
 	return mcc_asm_new_register_operand(MCC_ASM_EBX, 0, data);
 }
 
-static struct mcc_asm_operand *ecx(struct mcc_asm_data *data)
-{
-	return mcc_asm_new_register_operand(MCC_ASM_ECX, 0, data);
-}
-
 static struct mcc_asm_operand *edx(struct mcc_asm_data *data)
 {
 	return mcc_asm_new_register_operand(MCC_ASM_EDX, 0, data);
@@ -352,14 +468,30 @@ static struct mcc_asm_operand *dl(struct mcc_asm_data *data)
 	return mcc_asm_new_register_operand(MCC_ASM_DL, 0, data);
 }
 
+// eax, or rax on x86-64
+static struct mcc_asm_operand *address_eax(struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(address_register(MCC_ASM_EAX, data), 0, data);
+}
+
+static struct mcc_asm_operand *address_ebx(struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(address_register(MCC_ASM_EBX, data), 0, data);
+}
+
+static struct mcc_asm_operand *address_ecx(struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(address_register(MCC_ASM_ECX, data), 0, data);
+}
+
 static struct mcc_asm_operand *ebp(int offset, struct mcc_asm_data *data)
 {
-	return mcc_asm_new_register_operand(MCC_ASM_EBP, offset, data);
+	return mcc_asm_new_register_operand(address_register(MCC_ASM_EBP, data), offset, data);
 }
 
 static struct mcc_asm_operand *esp(struct mcc_asm_data *data)
 {
-	return mcc_asm_new_register_operand(MCC_ASM_ESP, 0, data);
+	return mcc_asm_new_register_operand(address_register(MCC_ASM_ESP, data), 0, data);
 }
 
 static struct mcc_asm_operand *st(int offset, struct mcc_asm_data *data)
@@ -367,6 +499,11 @@ static struct mcc_asm_operand *st(int offset, struct mcc_asm_data *data)
 	return mcc_asm_new_register_operand(MCC_ASM_ST, offset, data);
 }
 
+static struct mcc_asm_operand *xmm0(struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(MCC_ASM_XMM0, 0, data);
+}
+
 //------------------------------------------------------------------------------------ Functions: Delete data structures
 
 void mcc_asm_delete_asm(struct mcc_asm *head)
@@ -406,9 +543,7 @@ void mcc_asm_delete_declaration(struct mcc_asm_declaration *decl)
 {
 	if (!decl)
 		return;
-	if (decl->type == MCC_ASM_DECLARATION_TYPE_STRING || decl->type == MCC_ASM_DECLARATION_TYPE_FLOAT) {
-		free(decl->identifier);
-	}
+	free(decl->identifier);
 	free(decl);
 }
 
@@ -441,7 +576,7 @@ void mcc_asm_delete_line(struct mcc_asm_line *line)
 {
 	if (!line)
 		return;
-	if (line->opcode != MCC_ASM_LABEL && line->opcode != MCC_ASM_JE && line->opcode != MCC_ASM_JNE) {
+	if (!mcc_asm_opcode_has_label(line->opcode)) {
 		mcc_asm_delete_operand(line->first);
 		mcc_asm_delete_operand(line->second);
 	}
@@ -497,48 +632,77 @@ static bool array_is_reference(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg
 	return (an_ir->prev->row->instr == MCC_IR_INSTR_POP);
 }
 
-static struct mcc_asm_operand *
-get_array_element_operand(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
+static bool is_bool_array(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	assert(arg);
-	assert(arg->type == MCC_IR_TYPE_ARR_ELEM);
-	assert(data);
-	if (data->has_failed)
-		return NULL;
-
-	int index_offset;
-	int offset;
-	bool is_reference = array_is_reference(an_ir, arg, data);
+	an_ir = get_array_element_declaration(an_ir, arg, data);
+	return !data->has_failed && an_ir->row->type->type == MCC_IR_ROW_BOOL;
+}
 
-	if (is_reference)
-		offset = get_identifier_offset(an_ir, arg->arr_ident);
+static bool is_bool_element(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
+{
+	return arg->type == MCC_IR_TYPE_ARR_ELEM && is_bool_array(an_ir, arg, data);
+}
 
+// Loads the index of the element into ebx
+static void load_array_index(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
+{
 	switch (arg->index->type) {
 	case MCC_IR_TYPE_LIT_INT:
-		index_offset = arg->index->lit_int;
-		mcc_asm_new_line(MCC_ASM_MOVL, mcc_asm_new_literal_operand(index_offset, data), ebx(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVL, mcc_asm_new_literal_operand(arg->index->lit_int, data), ebx(data), data);
 		break;
 	case MCC_IR_TYPE_IDENTIFIER:
-		index_offset = get_identifier_offset(an_ir, arg->index->ident);
-		mcc_asm_new_line(MCC_ASM_MOVL, ebp(index_offset, data), ebx(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVL, ebp(get_identifier_offset(an_ir, arg->index->ident), data), ebx(data),
+		                 data);
 		break;
 	case MCC_IR_TYPE_ROW:
-		index_offset = get_row_offset(an_ir, arg->index->row);
-		mcc_asm_new_line(MCC_ASM_MOVL, ebp(index_offset, data), ebx(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVL, ebp(get_row_offset(an_ir, arg->index->row), data), ebx(data), data);
 		break;
 	default:
 		data->has_failed = true;
-		return NULL;
 	}
+}
 
-	if (is_reference) {
-		mcc_asm_new_line(MCC_ASM_MOVL, ebp(offset, data), ecx(data), data);
-		return mcc_asm_new_computed_offset_operand(0, MCC_ASM_ECX, MCC_ASM_EBX, DWORD_SIZE, data);
-	} else {
-		return mcc_asm_new_computed_offset_operand(mcc_get_array_base_stack_loc(an_ir, arg), MCC_ASM_EBP,
-		                                           MCC_ASM_EBX, DWORD_SIZE, data);
-	}
+// Loads the address of a reference array into ecx, unless it is kept there
+static void load_array_base(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
+{
+	if (!array_is_reference(an_ir, arg, data))
+		return;
+	if (data->pinned_array && strcmp(data->pinned_array, arg->arr_ident) == 0)
+		return;
+	mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), ebp(get_identifier_offset(an_ir, arg->arr_ident), data),
+	                 address_ecx(data), data);
+}
+
+// The memory size bytes times the value of the register index into the array, once load_array_base loaded it
+static struct mcc_asm_operand *get_element_at(struct mcc_annotated_ir *an_ir,
+                                              struct mcc_ir_arg *arg,
+                                              enum mcc_asm_register index,
+                                              int size,
+                                              struct mcc_asm_data *data)
+{
+	if (array_is_reference(an_ir, arg, data))
+		return mcc_asm_new_computed_offset_operand(0, address_register(MCC_ASM_ECX, data),
+		                                           address_register(index, data), size, data);
+	return mcc_asm_new_computed_offset_operand(mcc_get_array_base_stack_loc(an_ir, arg),
+	                                           address_register(MCC_ASM_EBP, data), address_register(index, data),
+	                                           size, data);
+}
+
+// Elements of bool arrays take a byte, the others a slot
+static struct mcc_asm_operand *
+get_array_element_operand(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	assert(arg);
+	assert(arg->type == MCC_IR_TYPE_ARR_ELEM);
+	assert(data);
+	if (data->has_failed)
+		return NULL;
+
+	int size = is_bool_array(an_ir, arg, data) ? 1 : slot_size(data);
+	load_array_index(an_ir, arg, data);
+	load_array_base(an_ir, arg, data);
+	return get_element_at(an_ir, arg, MCC_ASM_EBX, size, data);
 }
 
 // function to check if 'prefix' is a proper prefix of 'string'. It is proper if 'prefix' followed by _x is equal to
@@ -608,8 +772,13 @@ static bool is_float(struct mcc_ir_arg *arg, struct mcc_annotated_ir *an_ir, str
 		return false;
 	case MCC_IR_TYPE_ROW:
 		return (arg->row->type->type == MCC_IR_ROW_FLOAT);
-	case MCC_IR_TYPE_IDENTIFIER:
+	case MCC_IR_TYPE_IDENTIFIER: {
+		// The assignment that declares the variable carries its type
+		struct mcc_annotated_ir *declaration = get_identifier_declaration(an_ir, arg->ident);
+		if (declaration)
+			return declaration->row->type->type == MCC_IR_ROW_FLOAT;
 		return is_in_data_section(arg->ident, data);
+	}
 	case MCC_IR_TYPE_ARR_ELEM:
 		an_ir = get_array_element_declaration(an_ir, arg, data);
 		return (an_ir->row->type->type == MCC_IR_ROW_FLOAT);
@@ -648,7 +817,7 @@ arg_to_op(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg, struct mcc_asm
 		break;
 	case MCC_IR_TYPE_ROW:
 	case MCC_IR_TYPE_IDENTIFIER:
-		operand = mcc_asm_new_register_operand(MCC_ASM_EBP, get_offset_of(an_ir, arg), data);
+		operand = ebp(get_offset_of(an_ir, arg), data);
 		break;
 	case MCC_IR_TYPE_ARR_ELEM:
 		operand = get_array_element_operand(an_ir, arg, data);
@@ -689,6 +858,7 @@ static struct mcc_asm_operand *find_string_identifier(struct mcc_annotated_ir *a
 		op->decl = head;
 		op->type = MCC_ASM_OPERAND_DATA;
 		op->offset = 0;
+		op->rip_relative = is_x86_64(data);
 		return op;
 	}
 
@@ -722,6 +892,7 @@ static struct mcc_asm_operand *find_float_identifier(struct mcc_annotated_ir *an
 			op->decl = head;
 			op->type = MCC_ASM_OPERAND_DATA;
 			op->offset = 0;
+			op->rip_relative = is_x86_64(data);
 			return op;
 		}
 		head = head->next;
@@ -730,394 +901,1964 @@ static struct mcc_asm_operand *find_float_identifier(struct mcc_annotated_ir *an
 	return NULL;
 }
 
-static void generate_string_assignment(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
-{
-	struct mcc_asm_operand *string_id = find_string_identifier(an_ir, data);
-	mcc_asm_new_line(MCC_ASM_LEAL, string_id, eax(data), data);
-	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
-}
+//------------------------------------------------------------------------------------ Functions: Stack frame
 
-static void generate_assign_row_ident(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+// The prolog saves ebx, except in main. On x86-64 rbx is saved in every function, since it is callee-saved for the
+// C runtime as well.
+static bool saves_ebx(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
-	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+	return is_x86_64(data) || strcmp(mcc_get_function_label(an_ir)->row->arg1->func_label, "main") != 0;
 }
 
-static void generate_float_assign(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+// On x86-64 the stack pointer has to be 16 byte aligned at every call. The return address, the saved rbp and the
+// saved rbx take 24 bytes, so the local variables are padded to 8 bytes modulo 16.
+static int get_frame_size(struct mcc_annotated_ir *function_label, struct mcc_asm_data *data)
 {
-	mcc_asm_new_line(MCC_ASM_FLDS, find_float_identifier(an_ir, data), NULL, data);
-	mcc_asm_new_line(MCC_ASM_FSTPS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+	int size = function_label->stack_size;
+	if (is_x86_64(data) && size % 16 != 8)
+		size += size % 16 < 8 ? 8 - size % 16 : 24 - size % 16;
+	return size;
 }
 
-static void generate_instr_assign(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
-{
-	assert(an_ir);
-	assert(an_ir->row->instr == MCC_IR_INSTR_ASSIGN);
+//------------------------------------------------------------------------------------ Functions: Register arguments
 
-	if (data->has_failed)
-		return;
+// Calls between mC functions pass the first arguments in registers. On x86 the first three integer and address
+// arguments are passed in eax, edx and ecx, like with regparm(3). On x86-64 the System V convention passes the first
+// six in rdi, rsi, rdx, rcx, r8 and r9 and the first eight floats in xmm0 to xmm7. The remaining arguments are pushed
+// in stack slots, the last one first. PUSH rows of these calls generate no code, the call loads all arguments.
+// On x86 the builtins and main keep cdecl, since they are implemented in or called from C. The other functions are not
+// exported, so that no separately compiled cdecl caller can link against them.
 
-	switch (an_ir->row->arg2->type) {
-	case MCC_IR_TYPE_LIT_INT:
-	case MCC_IR_TYPE_LIT_BOOL:
-		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data),
-		                 arg_to_op(an_ir, an_ir->row->arg1, data), data);
-		break;
-	case MCC_IR_TYPE_LIT_FLOAT:
-		generate_float_assign(an_ir, data);
-		break;
-	case MCC_IR_TYPE_ROW:
-	case MCC_IR_TYPE_IDENTIFIER:
-	case MCC_IR_TYPE_ARR_ELEM:
-		generate_assign_row_ident(an_ir, data);
-		break;
-	case MCC_IR_TYPE_LIT_STRING:
-		generate_string_assignment(an_ir, data);
-		break;
-	default:
-		break;
+static const enum mcc_asm_register x86_arg_registers[] = {MCC_ASM_EAX, MCC_ASM_EDX, MCC_ASM_ECX};
+
+static const enum mcc_asm_register x86_64_int_arg_registers[] = {MCC_ASM_RDI, MCC_ASM_RSI, MCC_ASM_RDX,
+                                                                 MCC_ASM_RCX, MCC_ASM_R8,  MCC_ASM_R9};
+
+static const enum mcc_asm_register x86_64_float_arg_registers[] = {MCC_ASM_XMM0, MCC_ASM_XMM1, MCC_ASM_XMM2,
+                                                                   MCC_ASM_XMM3, MCC_ASM_XMM4, MCC_ASM_XMM5,
+                                                                   MCC_ASM_XMM6, MCC_ASM_XMM7};
+
+#define NUM_X86_ARG_REGISTERS (sizeof(x86_arg_registers) / sizeof(x86_arg_registers[0]))
+
+#define NUM_X86_64_INT_ARG_REGISTERS (sizeof(x86_64_int_arg_registers) / sizeof(x86_64_int_arg_registers[0]))
+
+#define NUM_X86_64_FLOAT_ARG_REGISTERS (sizeof(x86_64_float_arg_registers) / sizeof(x86_64_float_arg_registers[0]))
+
+enum arg_kind {
+	ARG_KIND_INT,
+	ARG_KIND_FLOAT,
+	// Strings and arrays passed by reference
+	ARG_KIND_ADDRESS,
+	// Arrays of the calling function, their address is computed with lea
+	ARG_KIND_LOCAL_ARRAY,
+};
+
+struct arg_location {
+	bool in_register;
+	enum mcc_asm_register reg;
+	// Index of the slot on the stack, 0 is the slot next to the return address
+	int stack_slot;
+};
+
+// Registers and stack slots taken by the previous arguments
+struct arg_counters {
+	unsigned num_ints;
+	unsigned num_floats;
+	int num_stack_slots;
+};
+
+static bool is_defined_function(struct mcc_annotated_ir *an_ir, char *name)
+{
+	while (an_ir->prev) {
+		an_ir = an_ir->prev;
 	}
+	for (; an_ir; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_FUNC_LABEL && strcmp(an_ir->row->arg1->func_label, name) == 0)
+			return true;
+	}
+	return false;
 }
 
-static void
-generate_arithm_int_op(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+static bool is_register_call(struct mcc_annotated_ir *call, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	if (data->has_failed) {
-		return;
-	}
+	char *name = call->row->arg1->func_label;
+	return is_x86_64(data) || (strcmp(name, "main") != 0 && is_defined_function(call, name));
+}
 
-	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+static bool takes_register_args(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	return is_x86_64(data) || strcmp(mcc_get_function_label(an_ir)->row->arg1->func_label, "main") != 0;
+}
 
-	if (opcode == MCC_ASM_IDIVL) {
-		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data), ebx(data), data);
-		// line to clear EDX
-		mcc_asm_new_line(MCC_ASM_XORL, edx(data), edx(data), data);
-		mcc_asm_new_line(opcode, ebx(data), NULL, data);
-	} else {
-		mcc_asm_new_line(opcode, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+static struct mcc_annotated_ir *get_call(struct mcc_annotated_ir *push)
+{
+	while (push->row->instr == MCC_IR_INSTR_PUSH) {
+		push = push->next;
 	}
-	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+	return push;
 }
 
-static void generate_unary(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+static struct arg_location
+next_arg_location(bool is_float_arg, struct arg_counters *counters, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	if (data->has_failed)
-		return;
+	const enum mcc_asm_register *int_registers = is_x86_64(data) ? x86_64_int_arg_registers : x86_arg_registers;
+	unsigned num_int_registers = is_x86_64(data) ? NUM_X86_64_INT_ARG_REGISTERS : NUM_X86_ARG_REGISTERS;
+	unsigned num_float_registers = is_x86_64(data) ? NUM_X86_64_FLOAT_ARG_REGISTERS : 0;
 
-	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-	if (opcode == MCC_ASM_XORL) {
-		struct mcc_asm_operand *lit_1 = mcc_asm_new_literal_operand((int)1, data);
-		mcc_asm_new_line(MCC_ASM_XORL, lit_1, eax(data), data);
+	struct arg_location location = {.in_register = true, .reg = int_registers[0], .stack_slot = 0};
+	if (is_float_arg && counters->num_floats < num_float_registers) {
+		location.reg = x86_64_float_arg_registers[counters->num_floats++];
+	} else if (!is_float_arg && counters->num_ints < num_int_registers) {
+		location.reg = int_registers[counters->num_ints++];
 	} else {
-		mcc_asm_new_line(opcode, eax(data), NULL, data);
+		location.in_register = false;
+		location.stack_slot = counters->num_stack_slots++;
 	}
-	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+	return location;
 }
 
-static void generate_cmp_op_int(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static enum arg_kind get_arg_kind(struct mcc_annotated_ir *push)
 {
-	assert(an_ir);
-	if (data->has_failed)
-		return;
-
-	if ((an_ir->row->arg1->type == MCC_IR_TYPE_ROW || an_ir->row->arg1->type == MCC_IR_TYPE_IDENTIFIER ||
-	     an_ir->row->arg1->type == MCC_IR_TYPE_ARR_ELEM) &&
-	    (an_ir->row->arg2->type == MCC_IR_TYPE_ROW || an_ir->row->arg2->type == MCC_IR_TYPE_IDENTIFIER ||
-	     an_ir->row->arg2->type == MCC_IR_TYPE_ARR_ELEM)) {
-		// 1a. move arg1 in eax
-		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-		// 1b. cmp eax and arg2
-		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
-
-	} else if (an_ir->row->arg1->type == MCC_IR_TYPE_ROW || an_ir->row->arg1->type == MCC_IR_TYPE_IDENTIFIER) {
-		// 1. cmp arg1 arg2
-		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data),
-		                 arg_to_op(an_ir, an_ir->row->arg1, data), data);
-	} else {
-		// 1.a mov lit eax
-		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-		// 1b. cmp arg1 arg2
-		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+	struct mcc_ir_arg *arg = push->row->arg1;
+	if (arg_is_local_array(push, arg))
+		return ARG_KIND_LOCAL_ARRAY;
+	if (arg->type == MCC_IR_TYPE_IDENTIFIER) {
+		// Array parameters are declared by an assignment with an array type
+		struct mcc_annotated_ir *declaration = get_identifier_declaration(push, arg->ident);
+		if (declaration && declaration->row->type->array_size >= 0)
+			return ARG_KIND_ADDRESS;
+	}
+	switch (push->row->type->type) {
+	case MCC_IR_ROW_STRING:
+		return ARG_KIND_ADDRESS;
+	case MCC_IR_ROW_FLOAT:
+		return ARG_KIND_FLOAT;
+	default:
+		return ARG_KIND_INT;
 	}
 }
 
-static void generate_return(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static bool is_float_param(struct mcc_ir_row *pop)
 {
-	assert(an_ir);
-	assert(an_ir->row->instr == MCC_IR_INSTR_RETURN);
-
-	if (data->has_failed)
-		return;
+	return pop->type->type == MCC_IR_ROW_FLOAT && pop->type->array_size < 0;
+}
 
-	if (an_ir->row->arg1) {
-		if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-			mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
-		} else {
-			mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-		}
-	}
-	// pop ebx
-	an_ir = mcc_get_function_label(an_ir);
-	if (strcmp(an_ir->row->arg1->func_label, "main") != 0) {
-		mcc_asm_new_line(MCC_ASM_POPL, ebx(data), NULL, data);
+// The PUSH right in front of the call holds the first argument
+static struct arg_location locate_arg(struct mcc_annotated_ir *push, struct mcc_asm_data *data)
+{
+	struct arg_counters counters = {0, 0, 0};
+	struct mcc_annotated_ir *an_ir = get_call(push)->prev;
+	struct arg_location location = next_arg_location(get_arg_kind(an_ir) == ARG_KIND_FLOAT, &counters, data);
+	while (an_ir != push) {
+		an_ir = an_ir->prev;
+		location = next_arg_location(get_arg_kind(an_ir) == ARG_KIND_FLOAT, &counters, data);
 	}
-	mcc_asm_new_line(MCC_ASM_LEAVE, NULL, NULL, data);
-	mcc_asm_new_line(MCC_ASM_RETURN, NULL, NULL, data);
+	return location;
 }
 
-static void generate_push(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static struct arg_location locate_param(struct mcc_annotated_ir *pop, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	assert(an_ir->row->arg1);
-	if (arg_is_local_array(an_ir, an_ir->row->arg1)) {
-		mcc_asm_new_line(MCC_ASM_LEAL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-		mcc_asm_new_line(MCC_ASM_PUSHL, eax(data), NULL, data);
-		return;
+	struct arg_counters counters = {0, 0, 0};
+	struct mcc_annotated_ir *an_ir = mcc_get_function_label(pop)->next;
+	struct arg_location location = next_arg_location(is_float_param(an_ir->row), &counters, data);
+	while (an_ir != pop) {
+		an_ir = an_ir->next->next;
+		location = next_arg_location(is_float_param(an_ir->row), &counters, data);
 	}
-	assert(an_ir->row->instr == MCC_IR_INSTR_PUSH);
-	mcc_asm_new_line(MCC_ASM_PUSHL, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+	return location;
 }
 
-static void generate_jumpfalse(enum mcc_asm_opcode opcode, struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static int count_stack_args(struct mcc_annotated_ir *call, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	if (data->has_failed)
-		return;
-
-	if (opcode == MCC_ASM_JNE) {
-		struct mcc_asm_operand *one = mcc_asm_new_literal_operand(1, data);
-		mcc_asm_new_line(MCC_ASM_MOVL, one, eax(data), data);
-		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
-	} else { // case of MCC_ASM_JE
-		mcc_asm_new_line(MCC_ASM_CMPL, eax(data), eax(data), data);
+	struct arg_counters counters = {0, 0, 0};
+	for (struct mcc_annotated_ir *push = call->prev; push->row->instr == MCC_IR_INSTR_PUSH; push = push->prev) {
+		next_arg_location(get_arg_kind(push) == ARG_KIND_FLOAT, &counters, data);
 	}
+	return counters.num_stack_slots;
+}
 
-	unsigned label = opcode == MCC_ASM_JNE ? an_ir->row->arg2->label : an_ir->row->arg1->label;
-	mcc_asm_new_label(opcode, label, data);
+// Parameters of the function that are passed on the stack
+static int count_stack_params(struct mcc_annotated_ir *function_label, struct mcc_asm_data *data)
+{
+	struct arg_counters counters = {0, 0, 0};
+	for (struct mcc_annotated_ir *an_ir = function_label->next; an_ir && an_ir->row->instr == MCC_IR_INSTR_POP;
+	     an_ir = an_ir->next->next) {
+		if (takes_register_args(function_label, data))
+			next_arg_location(is_float_param(an_ir->row), &counters, data);
+		else
+			counters.num_stack_slots++;
+	}
+	return counters.num_stack_slots;
 }
 
-static void
-generate_arithm_float_op(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+static bool is_literal(struct mcc_ir_arg *arg)
 {
-	assert(an_ir);
-	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg2, data), NULL, data);
-	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
-	mcc_asm_new_line(opcode, st(0, data), st(1, data), data);
-	mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+	return arg->type == MCC_IR_TYPE_LIT_INT || arg->type == MCC_IR_TYPE_LIT_BOOL;
 }
 
-static void generate_plus(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static void generate_register_arg(struct mcc_annotated_ir *push, enum mcc_asm_register reg, struct mcc_asm_data *data)
 {
-	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
-		generate_arithm_int_op(an_ir, MCC_ASM_ADDL, data);
-	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-		generate_arithm_float_op(an_ir, MCC_ASM_FADDP, data);
+	struct mcc_ir_arg *arg = push->row->arg1;
+	enum mcc_asm_opcode opcode = address_opcode(MCC_ASM_MOVL, data);
+	switch (get_arg_kind(push)) {
+	case ARG_KIND_LOCAL_ARRAY:
+		opcode = address_opcode(MCC_ASM_LEAL, data);
+		break;
+	case ARG_KIND_FLOAT:
+		opcode = MCC_ASM_MOVSS;
+		break;
+	case ARG_KIND_INT:
+		// Ints are sign extended on x86-64, since the builtins take longs
+		if (is_x86_64(data) && !is_literal(arg))
+			opcode = MCC_ASM_MOVSLQ;
+		break;
+	case ARG_KIND_ADDRESS:
+		break;
 	}
+	mcc_asm_new_line(opcode, arg_to_op(push, arg, data), mcc_asm_new_register_operand(reg, 0, data), data);
 }
 
-static void generate_minus(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static void generate_stack_arg(struct mcc_annotated_ir *push, struct mcc_asm_data *data)
 {
-	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
-		generate_arithm_int_op(an_ir, MCC_ASM_SUBL, data);
-	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-		generate_arithm_float_op(an_ir, MCC_ASM_FSUBP, data);
+	struct mcc_ir_arg *arg = push->row->arg1;
+	enum arg_kind kind = get_arg_kind(push);
+	enum mcc_asm_opcode push_opcode = address_opcode(MCC_ASM_PUSHL, data);
+	if (kind == ARG_KIND_LOCAL_ARRAY) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_LEAL, data), arg_to_op(push, arg, data), address_eax(data),
+		                 data);
+		mcc_asm_new_line(push_opcode, address_eax(data), NULL, data);
+	} else if (kind == ARG_KIND_INT && is_x86_64(data) && !is_literal(arg)) {
+		mcc_asm_new_line(MCC_ASM_MOVSLQ, arg_to_op(push, arg, data), address_eax(data), data);
+		mcc_asm_new_line(push_opcode, address_eax(data), NULL, data);
+	} else {
+		mcc_asm_new_line(push_opcode, arg_to_op(push, arg, data), NULL, data);
 	}
 }
 
-static void generate_cmp_op_float(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static void generate_stack_args(struct mcc_annotated_ir *call, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	if (data->has_failed) {
-		return;
+	struct mcc_annotated_ir *push = call;
+	while (push->prev->row->instr == MCC_IR_INSTR_PUSH) {
+		push = push->prev;
 	}
+	for (; push != call; push = push->next) {
+		if (!locate_arg(push, data).in_register)
+			generate_stack_arg(push, data);
+	}
+}
 
-	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg2, data), NULL, data);
-	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
-	mcc_asm_new_line(MCC_ASM_FCOMIP, st(1, data), st(0, data), data);
-	mcc_asm_new_line(MCC_ASM_FSTP, st(0, data), NULL, data);
+// Array elements of reference arrays are addressed with ecx, so the argument passed in ecx is loaded last
+static void generate_register_args(struct mcc_annotated_ir *call, struct mcc_asm_data *data)
+{
+	enum mcc_asm_register base = address_register(MCC_ASM_ECX, data);
+	struct mcc_annotated_ir *base_arg = NULL;
+	for (struct mcc_annotated_ir *push = call->prev; push->row->instr == MCC_IR_INSTR_PUSH; push = push->prev) {
+		struct arg_location location = locate_arg(push, data);
+		if (!location.in_register)
+			continue;
+		if (location.reg == base) {
+			base_arg = push;
+			continue;
+		}
+		generate_register_arg(push, location.reg, data);
+	}
+	if (base_arg)
+		generate_register_arg(base_arg, base, data);
 }
 
-static void generate_cmp(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+// Parameters are copied from their registers or from above the return address into their stack slots. The argument
+// registers may still hold parameters, so stack parameters are copied with ebx, which the prolog saved.
+static void generate_register_pop(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct arg_location location = locate_param(an_ir, data);
+	struct mcc_annotated_ir *assign = an_ir->next;
+	enum mcc_asm_opcode move = address_opcode(MCC_ASM_MOVL, data);
+	if (location.in_register) {
+		enum mcc_asm_opcode opcode = is_float_param(an_ir->row) ? MCC_ASM_MOVSS : move;
+		mcc_asm_new_line(opcode, mcc_asm_new_register_operand(location.reg, 0, data),
+		                 arg_to_op(assign, assign->row->arg1, data), data);
+		return;
+	}
+	int offset = 2 * slot_size(data) + location.stack_slot * slot_size(data);
+	mcc_asm_new_line(move, ebp(offset, data), address_ebx(data), data);
+	mcc_asm_new_line(move, address_ebx(data), arg_to_op(assign, assign->row->arg1, data), data);
+}
+
+//------------------------------------------------------------------------------------ Functions: Constant operands
+
+// Integer divisions by a literal are selected as shifts for powers of two instead of idivl. Divisions by other
+// constants multiply with a magic number and keep the high half of the product (Hacker's Delight, chapter 10).
+
+static struct mcc_asm_operand *literal(int value, struct mcc_asm_data *data)
+{
+	return mcc_asm_new_literal_operand(value, data);
+}
+
+// Returns k if value is 2^k, else -1
+static int get_power_of_two(unsigned value)
+{
+	if (value == 0 || (value & (value - 1)) != 0)
+		return -1;
+	int k = 0;
+	while (value >>= 1)
+		k++;
+	return k;
+}
+
+static void generate_store_eax(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+}
+
+// Magic number and shift for the signed division by 2 < divisor < 2^31 that is no power of two (Hacker's Delight,
+// figure 10-1)
+static void get_magic_number(unsigned divisor, int *magic, int *shift)
+{
+	const unsigned two_31 = 0x80000000u;
+	unsigned abs_nc = two_31 - 1 - two_31 % divisor;
+	unsigned q1 = two_31 / abs_nc;
+	unsigned r1 = two_31 - q1 * abs_nc;
+	unsigned q2 = two_31 / divisor;
+	unsigned r2 = two_31 - q2 * divisor;
+	unsigned delta;
+	int p = 31;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= abs_nc) {
+			q1++;
+			r1 -= abs_nc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= divisor) {
+			q2++;
+			r2 -= divisor;
+		}
+		delta = divisor - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	*magic = (int)(q2 + 1);
+	*shift = p - 32;
+}
+
+// eax = eax / 2^k, rounded towards zero like idivl
+static void generate_power_of_two_division(int k, struct mcc_asm_data *data)
+{
+	// Negative dividends are biased by 2^k - 1 before the arithmetic shift
+	mcc_asm_new_line(MCC_ASM_CLTD, NULL, NULL, data);
+	mcc_asm_new_line(MCC_ASM_AND, literal((int)((1u << k) - 1), data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_ADDL, edx(data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_SARL, literal(k, data), eax(data), data);
+}
+
+// eax = eax / divisor, rounded towards zero like idivl
+static void generate_magic_division(unsigned divisor, struct mcc_asm_data *data)
+{
+	int magic, shift;
+	get_magic_number(divisor, &magic, &shift);
+
+	// The high half of the product is in edx
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebx(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, literal(magic, data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_IMULL, edx(data), NULL, data);
+	if (magic < 0)
+		mcc_asm_new_line(MCC_ASM_ADDL, ebx(data), edx(data), data);
+	if (shift > 0)
+		mcc_asm_new_line(MCC_ASM_SARL, literal(shift, data), edx(data), data);
+
+	// Add 1 for negative dividends
+	mcc_asm_new_line(MCC_ASM_MOVL, ebx(data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_SHRL, literal(31, data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_ADDL, edx(data), eax(data), data);
+}
+
+// Returns false if the division is left to idivl
+static bool generate_constant_division(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_ir_arg *constant = an_ir->row->arg2;
+	if (constant->type != MCC_IR_TYPE_LIT_INT || constant->lit_int == 0)
+		return false;
+
+	long divisor = constant->lit_int;
+	bool negate = divisor < 0;
+	unsigned magnitude = (unsigned)(negate ? -divisor : divisor);
+
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+	int k = get_power_of_two(magnitude);
+	if (k > 0)
+		generate_power_of_two_division(k, data);
+	else if (k < 0)
+		generate_magic_division(magnitude, data);
+	if (negate)
+		mcc_asm_new_line(MCC_ASM_NEGL, eax(data), NULL, data);
+	generate_store_eax(an_ir, data);
+	return true;
+}
+
+//------------------------------------------------------------------------------------ Functions: IR instructions
+
+static void generate_string_assignment(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_asm_operand *string_id = find_string_identifier(an_ir, data);
+	mcc_asm_new_line(address_opcode(MCC_ASM_LEAL, data), string_id, address_eax(data), data);
+	mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), address_eax(data), ebp(an_ir->stack_position, data), data);
+}
+
+static void generate_assign_row_ident(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	// Strings are addresses
+	if (an_ir->row->type->type == MCC_IR_ROW_STRING) {
+		enum mcc_asm_opcode opcode = address_opcode(MCC_ASM_MOVL, data);
+		mcc_asm_new_line(opcode, arg_to_op(an_ir, an_ir->row->arg2, data), address_eax(data), data);
+		mcc_asm_new_line(opcode, address_eax(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+}
+
+static void generate_float_assign(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	if (data->options.sse2) {
+		mcc_asm_new_line(MCC_ASM_MOVSS, find_float_identifier(an_ir, data), xmm0(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVSS, xmm0(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_FLDS, find_float_identifier(an_ir, data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_FSTPS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+}
+
+// Elements of bool arrays are only moved by assignments (see ir.h). A byte is loaded with movzbl and stored from dl.
+// Packed arrays are accessed a DWORD of 32 elements at a time: the DWORD is at the index shifted right by 5, and bt,
+// bts and similar instructions with a register operand take the bit at the index modulo 32.
+
+static void generate_bool_element_load(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_ir_arg *element = an_ir->row->arg2;
+	if (!data->options.pack_bool_arrays) {
+		mcc_asm_new_line(MCC_ASM_MOVZBL, get_array_element_operand(an_ir, element, data), eax(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+		return;
+	}
+
+	load_array_index(an_ir, element, data);
+	load_array_base(an_ir, element, data);
+	mcc_asm_new_line(MCC_ASM_MOVL, ebx(data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_SHRL, mcc_asm_new_literal_operand(5, data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, get_element_at(an_ir, element, MCC_ASM_EDX, DWORD_SIZE, data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_BTL, ebx(data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_SETB, dl(data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_MOVZBL, dl(data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir, an_ir->row->arg1, data), data);
+}
+
+// Stores a packed element: ORs in the mask of its bit to set it, ANDs with the inverted mask to clear it. Values that
+// are not known are negated to all ones or zero and ANDed with the mask before.
+static void generate_packed_bool_store(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_ir_arg *element = an_ir->row->arg1;
+	struct mcc_ir_arg *value = an_ir->row->arg2;
+	bool is_literal = value->type == MCC_IR_TYPE_LIT_BOOL;
+	if (!is_literal)
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, value, data), eax(data), data);
+	load_array_index(an_ir, element, data);
+	load_array_base(an_ir, element, data);
+	mcc_asm_new_line(MCC_ASM_XORL, edx(data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_BTSL, ebx(data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_SHRL, mcc_asm_new_literal_operand(5, data), ebx(data), data);
+
+	if (is_literal && value->lit_bool) {
+		mcc_asm_new_line(MCC_ASM_OR, edx(data), get_element_at(an_ir, element, MCC_ASM_EBX, DWORD_SIZE, data), data);
+		return;
+	}
+	if (!is_literal) {
+		mcc_asm_new_line(MCC_ASM_NEGL, eax(data), NULL, data);
+		mcc_asm_new_line(MCC_ASM_AND, edx(data), eax(data), data);
+	}
+	mcc_asm_new_line(MCC_ASM_NOTL, edx(data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_AND, edx(data), get_element_at(an_ir, element, MCC_ASM_EBX, DWORD_SIZE, data), data);
+	if (!is_literal)
+		mcc_asm_new_line(MCC_ASM_OR, eax(data), get_element_at(an_ir, element, MCC_ASM_EBX, DWORD_SIZE, data),
+		                 data);
+}
+
+static void generate_bool_element_store(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	if (data->options.pack_bool_arrays) {
+		generate_packed_bool_store(an_ir, data);
+		return;
+	}
+	struct mcc_ir_arg *value = an_ir->row->arg2;
+	if (value->type == MCC_IR_TYPE_LIT_BOOL) {
+		struct mcc_asm_operand *element = get_array_element_operand(an_ir, an_ir->row->arg1, data);
+		mcc_asm_new_line(MCC_ASM_MOVB, mcc_asm_new_literal_operand(value->lit_bool, data), element, data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, value, data), edx(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVB, dl(data), get_array_element_operand(an_ir, an_ir->row->arg1, data), data);
+}
+
+static void generate_instr_assign(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
 {
 	assert(an_ir);
+	assert(an_ir->row->instr == MCC_IR_INSTR_ASSIGN);
+
 	if (data->has_failed)
 		return;
+	if (is_bool_element(an_ir, an_ir->row->arg1, data)) {
+		generate_bool_element_store(an_ir, data);
+		return;
+	}
+	if (is_bool_element(an_ir, an_ir->row->arg2, data)) {
+		generate_bool_element_load(an_ir, data);
+		return;
+	}
 
-	// line 1 to line 1c or line 1d (depended on case)
-	if (is_float(an_ir->row->arg1, an_ir, data)) {
-		generate_cmp_op_float(an_ir, data);
-		// use unsigned opcode in case of float:
-		if (opcode == MCC_ASM_SETG)
-			opcode = MCC_ASM_SETA;
-		if (opcode == MCC_ASM_SETGE)
-			opcode = MCC_ASM_SETAE;
-		if (opcode == MCC_ASM_SETL)
-			opcode = MCC_ASM_SETB;
-		if (opcode == MCC_ASM_SETLE)
-			opcode = MCC_ASM_SETBE;
+	switch (an_ir->row->arg2->type) {
+	case MCC_IR_TYPE_LIT_INT:
+	case MCC_IR_TYPE_LIT_BOOL:
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data),
+		                 arg_to_op(an_ir, an_ir->row->arg1, data), data);
+		break;
+	case MCC_IR_TYPE_LIT_FLOAT:
+		generate_float_assign(an_ir, data);
+		break;
+	case MCC_IR_TYPE_ROW:
+	case MCC_IR_TYPE_IDENTIFIER:
+	case MCC_IR_TYPE_ARR_ELEM:
+		generate_assign_row_ident(an_ir, data);
+		break;
+	case MCC_IR_TYPE_LIT_STRING:
+		generate_string_assignment(an_ir, data);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+generate_arithm_int_op(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed) {
+		return;
+	}
+
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+
+	if (opcode == MCC_ASM_IDIVL) {
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data), ebx(data), data);
+		// Sign extend eax into edx
+		mcc_asm_new_line(MCC_ASM_CLTD, NULL, NULL, data);
+		mcc_asm_new_line(opcode, ebx(data), NULL, data);
 	} else {
-		generate_cmp_op_int(an_ir, data);
+		mcc_asm_new_line(opcode, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
 	}
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+}
 
-	// 2. setcc dl
-	mcc_asm_new_line(opcode, dl(data), NULL, data);
-	// 3. movcc dl eax
-	mcc_asm_new_line(MCC_ASM_MOVZBL, dl(data), eax(data), data);
-	// 4. movl eax -x(ebp)
+static void generate_unary(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed)
+		return;
+
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+	if (opcode == MCC_ASM_XORL) {
+		struct mcc_asm_operand *lit_1 = mcc_asm_new_literal_operand((int)1, data);
+		mcc_asm_new_line(MCC_ASM_XORL, lit_1, eax(data), data);
+	} else {
+		mcc_asm_new_line(opcode, eax(data), NULL, data);
+	}
 	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
 }
 
-static void generate_mult(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static void generate_cmp_op_int(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed)
+		return;
+
+	if ((an_ir->row->arg1->type == MCC_IR_TYPE_ROW || an_ir->row->arg1->type == MCC_IR_TYPE_IDENTIFIER ||
+	     an_ir->row->arg1->type == MCC_IR_TYPE_ARR_ELEM) &&
+	    (an_ir->row->arg2->type == MCC_IR_TYPE_ROW || an_ir->row->arg2->type == MCC_IR_TYPE_IDENTIFIER ||
+	     an_ir->row->arg2->type == MCC_IR_TYPE_ARR_ELEM)) {
+		// 1a. move arg1 in eax
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+		// 1b. cmp eax and arg2
+		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+
+	} else if (an_ir->row->arg1->type == MCC_IR_TYPE_ROW || an_ir->row->arg1->type == MCC_IR_TYPE_IDENTIFIER) {
+		// 1. cmp arg1 arg2
+		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data),
+		                 arg_to_op(an_ir, an_ir->row->arg1, data), data);
+	} else {
+		// 1.a mov lit eax
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+		// 1b. cmp arg1 arg2
+		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+	}
+}
+
+static void generate_return(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	assert(an_ir->row->instr == MCC_IR_INSTR_RETURN);
+
+	if (data->has_failed)
+		return;
+
+	// Floats are returned in st(0), on x86-64 in xmm0
+	if (an_ir->row->arg1) {
+		if (an_ir->row->type->type == MCC_IR_ROW_FLOAT && is_x86_64(data)) {
+			mcc_asm_new_line(MCC_ASM_MOVSS, arg_to_op(an_ir, an_ir->row->arg1, data), xmm0(data), data);
+		} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+			mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+		} else if (an_ir->row->type->type == MCC_IR_ROW_STRING) {
+			mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), arg_to_op(an_ir, an_ir->row->arg1, data),
+			                 address_eax(data), data);
+		} else {
+			mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+		}
+	}
+	// pop ebx
+	if (saves_ebx(an_ir, data)) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_POPL, data), address_ebx(data), NULL, data);
+	}
+	mcc_asm_new_line(MCC_ASM_LEAVE, NULL, NULL, data);
+	mcc_asm_new_line(MCC_ASM_RETURN, NULL, NULL, data);
+}
+
+static void generate_push(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	assert(an_ir->row->instr == MCC_IR_INSTR_PUSH);
+	assert(an_ir->row->arg1);
+	// Calls with register arguments load all arguments themselves
+	if (is_register_call(get_call(an_ir), data))
+		return;
+	generate_stack_arg(an_ir, data);
+}
+
+static void generate_jumpfalse(enum mcc_asm_opcode opcode, struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed)
+		return;
+
+	if (opcode == MCC_ASM_JNE) {
+		struct mcc_asm_operand *one = mcc_asm_new_literal_operand(1, data);
+		mcc_asm_new_line(MCC_ASM_MOVL, one, eax(data), data);
+		mcc_asm_new_line(MCC_ASM_CMPL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+	} else { // case of MCC_ASM_JE
+		mcc_asm_new_line(MCC_ASM_CMPL, eax(data), eax(data), data);
+	}
+
+	unsigned label = opcode == MCC_ASM_JNE ? an_ir->row->arg2->label : an_ir->row->arg1->label;
+	mcc_asm_new_label(opcode, label, data);
+}
+
+// x87_opcode computes st(1) op st(0) and pops, sse2_opcode computes xmm0 op source
+static void generate_arithm_float_op(struct mcc_annotated_ir *an_ir,
+                                     enum mcc_asm_opcode x87_opcode,
+                                     enum mcc_asm_opcode sse2_opcode,
+                                     struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->options.sse2) {
+		mcc_asm_new_line(MCC_ASM_MOVSS, arg_to_op(an_ir, an_ir->row->arg1, data), xmm0(data), data);
+		mcc_asm_new_line(sse2_opcode, arg_to_op(an_ir, an_ir->row->arg2, data), xmm0(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVSS, xmm0(data), ebp(an_ir->stack_position, data), data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg2, data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+	mcc_asm_new_line(x87_opcode, st(0, data), st(1, data), data);
+	mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+}
+
+static void generate_plus(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		generate_arithm_float_op(an_ir, MCC_ASM_FADDP, MCC_ASM_ADDSS, data);
+	}
+}
+
+static void generate_minus(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		generate_arithm_float_op(an_ir, MCC_ASM_FSUBP, MCC_ASM_SUBSS, data);
+	}
+}
+
+static void generate_cmp_op_float(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed) {
+		return;
+	}
+
+	// ucomiss sets the flags like fcomip
+	if (data->options.sse2) {
+		mcc_asm_new_line(MCC_ASM_MOVSS, arg_to_op(an_ir, an_ir->row->arg1, data), xmm0(data), data);
+		mcc_asm_new_line(MCC_ASM_UCOMISS, arg_to_op(an_ir, an_ir->row->arg2, data), xmm0(data), data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg2, data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_FCOMIP, st(1, data), st(0, data), data);
+	mcc_asm_new_line(MCC_ASM_FSTP, st(0, data), NULL, data);
+}
+
+static void generate_cmp(struct mcc_annotated_ir *an_ir, enum mcc_asm_opcode opcode, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (data->has_failed)
+		return;
+
+	// line 1 to line 1c or line 1d (depended on case)
+	if (is_float(an_ir->row->arg1, an_ir, data)) {
+		generate_cmp_op_float(an_ir, data);
+		// use unsigned opcode in case of float:
+		if (opcode == MCC_ASM_SETG)
+			opcode = MCC_ASM_SETA;
+		if (opcode == MCC_ASM_SETGE)
+			opcode = MCC_ASM_SETAE;
+		if (opcode == MCC_ASM_SETL)
+			opcode = MCC_ASM_SETB;
+		if (opcode == MCC_ASM_SETLE)
+			opcode = MCC_ASM_SETBE;
+	} else {
+		generate_cmp_op_int(an_ir, data);
+	}
+
+	// 2. setcc dl
+	mcc_asm_new_line(opcode, dl(data), NULL, data);
+	// 3. movcc dl eax
+	mcc_asm_new_line(MCC_ASM_MOVZBL, dl(data), eax(data), data);
+	// 4. movl eax -x(ebp)
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+}
+
+static void generate_mult(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		generate_arithm_float_op(an_ir, MCC_ASM_FMULP, MCC_ASM_MULSS, data);
+	}
+}
+
+static void generate_div(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
+		if (!generate_constant_division(an_ir, data))
+			generate_arithm_int_op(an_ir, MCC_ASM_IDIVL, data);
+	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		generate_arithm_float_op(an_ir, MCC_ASM_FDIVP, MCC_ASM_DIVSS, data);
+	}
+}
+
+static void generate_call(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	// count pushes before call and add to esp afterwards
+	int num_stack_slots = count_pushes(an_ir);
+	if (is_register_call(an_ir, data)) {
+		num_stack_slots = count_stack_args(an_ir, data);
+		// On x86-64 rsp has to stay 16 byte aligned
+		if (is_x86_64(data) && num_stack_slots % 2 != 0) {
+			mcc_asm_new_line(MCC_ASM_SUBQ, mcc_asm_new_literal_operand(QWORD_SIZE, data), esp(data), data);
+			num_stack_slots++;
+		}
+		generate_stack_args(an_ir, data);
+		generate_register_args(an_ir, data);
+	}
+	struct mcc_asm_operand *func = mcc_asm_new_function_operand(an_ir->row->arg1->func_label, data);
+	mcc_asm_new_line(address_opcode(MCC_ASM_CALLL, data), func, NULL, data);
+	if (num_stack_slots != 0) {
+		struct mcc_asm_operand *size = mcc_asm_new_literal_operand(num_stack_slots * slot_size(data), data);
+		mcc_asm_new_line(address_opcode(MCC_ASM_ADDL, data), size, esp(data), data);
+	}
+	// if function is void do no move instruction. Floats are returned in st(0), on x86-64 in xmm0.
+	if (an_ir->row->type->type == MCC_IR_ROW_FLOAT && is_x86_64(data)) {
+		mcc_asm_new_line(MCC_ASM_MOVSS, xmm0(data), ebp(an_ir->stack_position, data), data);
+	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+	} else if (an_ir->row->type->type != MCC_IR_ROW_TYPELESS) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), address_eax(data),
+		                 ebp(an_ir->stack_position, data), data);
+	}
+}
+
+static void generate_pop(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	assert(an_ir->row->instr == MCC_IR_INSTR_POP);
+	if (takes_register_args(an_ir, data)) {
+		generate_register_pop(an_ir, data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_MOVL, ebp(an_ir->stack_position, data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir->next, an_ir->next->row->arg1, data), data);
+}
+
+static void generate_neg_float(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	// SSE2 has no negation, the sign bit is flipped in eax instead
+	if (data->options.sse2) {
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg1, data), eax(data), data);
+		mcc_asm_new_line(MCC_ASM_XORL, mcc_asm_new_literal_operand(INT_MIN, data), eax(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+		return;
+	}
+	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+	mcc_asm_new_line(MCC_ASM_FCHS, NULL, NULL, data);
+	mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+}
+
+static void generate_negative(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
+		generate_unary(an_ir, MCC_ASM_NEGL, data);
+	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
+		generate_neg_float(an_ir, data);
+	}
+}
+
+// Counters are 64 bits wide. On x86 the carry of the low half is added to the high half. Counters are only placed at
+// the start of blocks, where the flags are not live.
+static void generate_count(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+	assert(an_ir->row->instr == MCC_IR_INSTR_COUNT);
+
+	struct mcc_asm_declaration *counters = data->data_section->head;
+	while (counters && counters->type != MCC_ASM_DECLARATION_TYPE_COUNTERS)
+		counters = counters->next;
+	long index = an_ir->row->arg1->lit_int;
+	if (!counters || index < 0 || (unsigned long)index >= counters->num_counters) {
+		data->has_failed = true;
+		return;
+	}
+
+	struct mcc_asm_operand *low = mcc_asm_new_data_operand(counters, data);
+	if (!low)
+		return;
+	low->offset = (int)index * 8;
+	low->rip_relative = is_x86_64(data);
+	if (is_x86_64(data)) {
+		mcc_asm_new_line(MCC_ASM_ADDQ, literal(1, data), low, data);
+		return;
+	}
+	struct mcc_asm_operand *high = mcc_asm_new_data_operand(counters, data);
+	if (high)
+		high->offset = low->offset + 4;
+	mcc_asm_new_line(MCC_ASM_ADDL, literal(1, data), low, data);
+	mcc_asm_new_line(MCC_ASM_ADCL, literal(0, data), high, data);
+}
+
+//------------------------------------------------------------------------------------ Functions: Instruction selection
+
+// Int PLUS, MINUS and MULTIPLY rows are computed from the expression trees of isel.h, with the instructions of the
+// rules selected for their nodes. Values of a tree are held in eax and edx, so that ebx and ecx stay free for the index
+// and base of array elements.
+
+static const enum mcc_asm_register tree_registers[] = {MCC_ASM_EAX, MCC_ASM_EDX};
+
+#define NUM_TREE_REGISTERS (sizeof(tree_registers) / sizeof(tree_registers[0]))
+
+// Leaves of the rule selected for a node and the registers of its reg leaves
+struct reduction {
+	unsigned num_leaves;
+	struct mcc_isel_node *leaves[MCC_ISEL_MAX_LEAVES];
+	enum mcc_isel_symbol symbols[MCC_ISEL_MAX_LEAVES];
+	enum mcc_asm_register registers[MCC_ISEL_MAX_LEAVES];
+	enum mcc_asm_register result;
+	// Used by the lines of the rule in passing, the result if the rule needs no scratch register
+	enum mcc_asm_register scratch;
+};
+
+static enum mcc_asm_register allocate_register(bool used[], struct mcc_asm_data *data)
+{
+	for (unsigned i = 0; i < NUM_TREE_REGISTERS; i++) {
+		if (!used[i]) {
+			used[i] = true;
+			return tree_registers[i];
+		}
+	}
+	// Trees are cut to the number of registers before
+	data->has_failed = true;
+	return MCC_ASM_EAX;
+}
+
+static void free_register(enum mcc_asm_register reg, bool used[])
+{
+	for (unsigned i = 0; i < NUM_TREE_REGISTERS; i++) {
+		if (tree_registers[i] == reg)
+			used[i] = false;
+	}
+}
+
+// The row that has the operand of a leaf, the row of the tree or one folded into it
+static struct mcc_annotated_ir *find_leaf_row(struct mcc_annotated_ir *an_ir, struct mcc_ir_arg *arg)
+{
+	for (struct mcc_annotated_ir *row = an_ir; row; row = row->prev) {
+		if (row->row->arg1 == arg || row->row->arg2 == arg)
+			return row;
+	}
+	return an_ir;
+}
+
+static int get_leaf_literal(struct reduction *reduction, unsigned leaf)
+{
+	return (int)reduction->leaves[leaf - 1]->arg->lit_int;
+}
+
+// The k of a leaf that is 2^k, 3, 5 or 9 times 2^k, 2^k + 1, 2^k - 1 or -2^k
+static int get_leaf_log(struct reduction *reduction, unsigned leaf)
+{
+	unsigned value = (unsigned)get_leaf_literal(reduction, leaf);
+	switch (reduction->symbols[leaf - 1]) {
+	case MCC_ISEL_POW2_INC:
+		value--;
+		break;
+	case MCC_ISEL_POW2_DEC:
+		value++;
+		break;
+	case MCC_ISEL_NEG_POW2:
+		value = -value;
+		break;
+	default:
+		break;
+	}
+	// Drops the factor of leal from lea_pow2
+	int k = 0;
+	while (value % 2 == 0) {
+		value /= 2;
+		k++;
+	}
+	return k;
+}
+
+// The leaf minus 1, for leaves with a factor of leal that factor minus 1
+static int get_leaf_pred(struct reduction *reduction, unsigned leaf)
+{
+	int value = get_leaf_literal(reduction, leaf);
+	if (reduction->symbols[leaf - 1] == MCC_ISEL_NEG_LEA)
+		value = -value;
+	if (reduction->symbols[leaf - 1] == MCC_ISEL_LEA_POW2)
+		value >>= get_leaf_log(reduction, leaf);
+	return value - 1;
+}
+
+static bool uses_scratch(const struct mcc_isel_rule *rule)
+{
+	for (unsigned i = 0; i < rule->num_lines; i++) {
+		if (rule->lines[i].first.kind == MCC_ISEL_OPERAND_SCRATCH ||
+		    rule->lines[i].second.kind == MCC_ISEL_OPERAND_SCRATCH)
+			return true;
+	}
+	return false;
+}
+
+static struct mcc_asm_operand *get_rule_operand(struct mcc_annotated_ir *an_ir,
+                                                const struct mcc_isel_operand *operand,
+                                                struct reduction *reduction,
+                                                struct mcc_asm_data *data)
+{
+	switch (operand->kind) {
+	case MCC_ISEL_OPERAND_NONE:
+		return NULL;
+	case MCC_ISEL_OPERAND_RESULT:
+		return mcc_asm_new_register_operand(reduction->result, 0, data);
+	case MCC_ISEL_OPERAND_LEAF: {
+		if (reduction->symbols[operand->leaf - 1] == MCC_ISEL_REG)
+			return mcc_asm_new_register_operand(reduction->registers[operand->leaf - 1], 0, data);
+		struct mcc_ir_arg *arg = reduction->leaves[operand->leaf - 1]->arg;
+		return arg_to_op(find_leaf_row(an_ir, arg), arg, data);
+	}
+	case MCC_ISEL_OPERAND_LEAF_LOG:
+		return literal(get_leaf_log(reduction, operand->leaf), data);
+	case MCC_ISEL_OPERAND_LEAF_PRED:
+		return literal(get_leaf_pred(reduction, operand->leaf), data);
+	case MCC_ISEL_OPERAND_SCRATCH:
+		return mcc_asm_new_register_operand(reduction->scratch, 0, data);
+	case MCC_ISEL_OPERAND_ADDRESS:
+	case MCC_ISEL_OPERAND_ADDRESS_PRED: {
+		int scale = operand->kind == MCC_ISEL_OPERAND_ADDRESS_PRED ? get_leaf_pred(reduction, operand->scale)
+		                                                           : get_leaf_literal(reduction, operand->scale);
+		return mcc_asm_new_computed_offset_operand(
+		    0, address_register(reduction->registers[operand->leaf - 1], data),
+		    address_register(reduction->registers[operand->index - 1], data), scale, data);
+	}
+	}
+	return NULL;
+}
+
+// Emits the instructions of the rule selected for node and returns the register holding its value
+static enum mcc_asm_register
+reduce(struct mcc_annotated_ir *an_ir, struct mcc_isel_node *node, bool used[], struct mcc_asm_data *data)
+{
+	const struct mcc_isel_rule *rule = node->rule[MCC_ISEL_REG];
+	struct reduction reduction;
+	reduction.num_leaves = mcc_isel_get_leaves(node, MCC_ISEL_REG, reduction.leaves, reduction.symbols);
+
+	// Reg leaves are computed first, the one that needs the most registers first
+	bool is_computed[MCC_ISEL_MAX_LEAVES] = {false};
+	int first_reg = -1;
+	for (;;) {
+		int next = -1;
+		for (unsigned i = 0; i < reduction.num_leaves; i++) {
+			if (reduction.symbols[i] != MCC_ISEL_REG || is_computed[i])
+				continue;
+			if (first_reg < 0)
+				first_reg = (int)i;
+			if (next < 0 || reduction.leaves[i]->need > reduction.leaves[next]->need)
+				next = (int)i;
+		}
+		if (next < 0)
+			break;
+		reduction.registers[next] = reduce(an_ir, reduction.leaves[next], used, data);
+		is_computed[next] = true;
+	}
+	reduction.result = first_reg >= 0 ? reduction.registers[first_reg] : allocate_register(used, data);
+
+	reduction.scratch = uses_scratch(rule) ? allocate_register(used, data) : reduction.result;
+
+	for (unsigned i = 0; i < rule->num_lines && !data->has_failed; i++) {
+		const struct mcc_isel_line *line = &rule->lines[i];
+		struct mcc_asm_operand *first = get_rule_operand(an_ir, &line->first, &reduction, data);
+		struct mcc_asm_operand *second = get_rule_operand(an_ir, &line->second, &reduction, data);
+		if (data->has_failed) {
+			mcc_asm_delete_operand(first);
+			mcc_asm_delete_operand(second);
+			break;
+		}
+		mcc_asm_new_line(line->opcode, first, second, data);
+	}
+
+	for (unsigned i = 0; i < reduction.num_leaves; i++) {
+		if (reduction.symbols[i] == MCC_ISEL_REG && (int)i != first_reg)
+			free_register(reduction.registers[i], used);
+	}
+	if (reduction.scratch != reduction.result)
+		free_register(reduction.scratch, used);
+	return reduction.result;
+}
+
+// Tree of a row whose operands are all leaves
+static struct mcc_isel_node *new_flat_tree(struct mcc_ir_row *row)
+{
+	struct mcc_isel_node *tree = mcc_isel_new_row_node(row);
+	struct mcc_isel_node *left = mcc_isel_new_leaf(row->arg1);
+	struct mcc_isel_node *right = mcc_isel_new_leaf(row->arg2);
+	if (!tree || !left || !right) {
+		mcc_isel_delete_tree(tree);
+		mcc_isel_delete_tree(left);
+		mcc_isel_delete_tree(right);
+		return NULL;
+	}
+	mcc_isel_set_kids(tree, left, right);
+	return tree;
+}
+
+// Computes the tree of the row and stores its value into the stack slot of the row, or into the identifier or array
+// element that an assignment assigns to
+static void generate_tree(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_isel_node *tree = an_ir->tree;
+	// Trees are prepared for whole functions, see select_trees
+	if (!tree) {
+		tree = new_flat_tree(an_ir->row);
+		if (!tree || !mcc_isel_label(tree)) {
+			mcc_isel_delete_tree(tree);
+			data->has_failed = true;
+			return;
+		}
+	}
+
+	bool used[NUM_TREE_REGISTERS] = {false};
+	enum mcc_asm_register result = reduce(an_ir, tree, used, data);
+	struct mcc_asm_operand *destination = an_ir->row->instr == MCC_IR_INSTR_ASSIGN
+	                                          ? arg_to_op(an_ir, an_ir->row->arg1, data)
+	                                          : ebp(an_ir->stack_position, data);
+	mcc_asm_new_line(MCC_ASM_MOVL, mcc_asm_new_register_operand(result, 0, data), destination, data);
+
+	if (tree != an_ir->tree)
+		mcc_isel_delete_tree(tree);
+}
+
+//------------------------------------------------------------------------------------ Functions: Vector rows
+
+// Rows of the loop vectorizer work on four int or float lanes at once. Vector temporaries and array elements are
+// accessed with unaligned moves, since neither the stack nor arrays are 16 byte aligned.
+
+static struct mcc_asm_operand *xmm(enum mcc_asm_register reg, struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(reg, 0, data);
+}
+
+static bool is_vector_arg(struct mcc_ir_arg *arg)
+{
+	return arg->type == MCC_IR_TYPE_ARR_ELEM || (arg->type == MCC_IR_TYPE_ROW && arg->row->type->lanes > 1);
+}
+
+static enum mcc_asm_opcode get_vector_move(bool is_float)
+{
+	return is_float ? MCC_ASM_MOVUPS : MCC_ASM_MOVDQU;
+}
+
+// Loads the lanes of arg into reg. Scalar operands are copied to every lane.
+static void generate_vector_load(struct mcc_annotated_ir *an_ir,
+                                 struct mcc_ir_arg *arg,
+                                 enum mcc_asm_register reg,
+                                 struct mcc_asm_data *data)
+{
+	bool is_float = an_ir->row->type->type == MCC_IR_ROW_FLOAT;
+	if (is_vector_arg(arg)) {
+		mcc_asm_new_line(get_vector_move(is_float), arg_to_op(an_ir, arg, data), xmm(reg, data), data);
+		return;
+	}
+
+	if (is_float) {
+		struct mcc_asm_operand *source = arg->type == MCC_IR_TYPE_LIT_FLOAT ? find_float_identifier(an_ir, data)
+		                                                                    : arg_to_op(an_ir, arg, data);
+		mcc_asm_new_line(MCC_ASM_MOVSS, source, xmm(reg, data), data);
+		mcc_asm_new_line(MCC_ASM_UNPCKLPS, xmm(reg, data), xmm(reg, data), data);
+		mcc_asm_new_line(MCC_ASM_MOVLHPS, xmm(reg, data), xmm(reg, data), data);
+		return;
+	}
+	if (arg->type == MCC_IR_TYPE_LIT_INT) {
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, arg, data), eax(data), data);
+		mcc_asm_new_line(MCC_ASM_MOVD, eax(data), xmm(reg, data), data);
+	} else {
+		mcc_asm_new_line(MCC_ASM_MOVD, arg_to_op(an_ir, arg, data), xmm(reg, data), data);
+	}
+	mcc_asm_new_line(MCC_ASM_PUNPCKLDQ, xmm(reg, data), xmm(reg, data), data);
+	mcc_asm_new_line(MCC_ASM_PUNPCKLQDQ, xmm(reg, data), xmm(reg, data), data);
+}
+
+static enum mcc_asm_opcode get_vector_opcode(struct mcc_ir_row *row)
+{
+	bool is_float = row->type->type == MCC_IR_ROW_FLOAT;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+		return is_float ? MCC_ASM_ADDPS : MCC_ASM_PADDD;
+	case MCC_IR_INSTR_MINUS:
+		return is_float ? MCC_ASM_SUBPS : MCC_ASM_PSUBD;
+	case MCC_IR_INSTR_MULTIPLY:
+		return MCC_ASM_MULPS;
+	default:
+		return MCC_ASM_DIVPS;
+	}
+}
+
+// SSE2 has no packed int minimum or maximum. The lanes are selected with a mask from pcmpgtd instead.
+static void generate_vector_select(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	if (an_ir->row->instr == MCC_IR_INSTR_MIN) {
+		// xmm2 = arg2 > arg1
+		mcc_asm_new_line(MCC_ASM_MOVDQA, xmm(MCC_ASM_XMM1, data), xmm(MCC_ASM_XMM2, data), data);
+		mcc_asm_new_line(MCC_ASM_PCMPGTD, xmm(MCC_ASM_XMM0, data), xmm(MCC_ASM_XMM2, data), data);
+	} else {
+		// xmm2 = arg1 > arg2
+		mcc_asm_new_line(MCC_ASM_MOVDQA, xmm(MCC_ASM_XMM0, data), xmm(MCC_ASM_XMM2, data), data);
+		mcc_asm_new_line(MCC_ASM_PCMPGTD, xmm(MCC_ASM_XMM1, data), xmm(MCC_ASM_XMM2, data), data);
+	}
+	// xmm0 = (arg1 & xmm2) | (arg2 & ~xmm2)
+	mcc_asm_new_line(MCC_ASM_PAND, xmm(MCC_ASM_XMM2, data), xmm(MCC_ASM_XMM0, data), data);
+	mcc_asm_new_line(MCC_ASM_PANDN, xmm(MCC_ASM_XMM1, data), xmm(MCC_ASM_XMM2, data), data);
+	mcc_asm_new_line(MCC_ASM_POR, xmm(MCC_ASM_XMM2, data), xmm(MCC_ASM_XMM0, data), data);
+}
+
+static void generate_vector_row(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_ir_row *row = an_ir->row;
+	enum mcc_asm_opcode move = get_vector_move(row->type->type == MCC_IR_ROW_FLOAT);
+
+	if (row->instr == MCC_IR_INSTR_ASSIGN) {
+		generate_vector_load(an_ir, row->arg2, MCC_ASM_XMM0, data);
+		mcc_asm_new_line(move, xmm(MCC_ASM_XMM0, data), arg_to_op(an_ir, row->arg1, data), data);
+		return;
+	}
+
+	generate_vector_load(an_ir, row->arg1, MCC_ASM_XMM0, data);
+	generate_vector_load(an_ir, row->arg2, MCC_ASM_XMM1, data);
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_DIVIDE:
+		mcc_asm_new_line(get_vector_opcode(row), xmm(MCC_ASM_XMM1, data), xmm(MCC_ASM_XMM0, data), data);
+		break;
+	case MCC_IR_INSTR_MIN:
+	case MCC_IR_INSTR_MAX:
+		generate_vector_select(an_ir, data);
+		break;
+	default:
+		data->has_failed = true;
+		return;
+	}
+	mcc_asm_new_line(move, xmm(MCC_ASM_XMM0, data), ebp(an_ir->stack_position, data), data);
+}
+
+void mcc_asm_generate_asm_from_ir(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	assert(an_ir);
+
+	if (data->has_failed)
+		return;
+
+	if (an_ir->row->type->lanes > 1) {
+		generate_vector_row(an_ir, data);
+		return;
+	}
+	// Computed inside the tree of its user
+	if (an_ir->is_folded)
+		return;
+	if (an_ir->tree || mcc_isel_is_tree_row(an_ir->row)) {
+		generate_tree(an_ir, data);
+		return;
+	}
+
+	switch (an_ir->row->instr) {
+	case MCC_IR_INSTR_ASSIGN:
+		generate_instr_assign(an_ir, data);
+		break;
+	case MCC_IR_INSTR_LABEL:
+		mcc_asm_new_label(MCC_ASM_LABEL, an_ir->row->arg1->label, data);
+		break;
+	case MCC_IR_INSTR_FUNC_LABEL:
+		break;
+	case MCC_IR_INSTR_JUMP:
+		generate_jumpfalse(MCC_ASM_JE, an_ir, data);
+		break;
+	case MCC_IR_INSTR_CALL:
+		generate_call(an_ir, data);
+		break;
+	case MCC_IR_INSTR_JUMPFALSE:
+		generate_jumpfalse(MCC_ASM_JNE, an_ir, data);
+		break;
+	case MCC_IR_INSTR_PUSH:
+		generate_push(an_ir, data);
+		break;
+	case MCC_IR_INSTR_POP:
+		generate_pop(an_ir, data);
+		break;
+	case MCC_IR_INSTR_EQUALS:
+		generate_cmp(an_ir, MCC_ASM_SETE, data);
+		break;
+	case MCC_IR_INSTR_NOTEQUALS:
+		generate_cmp(an_ir, MCC_ASM_SETNE, data);
+		break;
+	case MCC_IR_INSTR_SMALLER:
+		generate_cmp(an_ir, MCC_ASM_SETL, data);
+		break;
+	case MCC_IR_INSTR_GREATER:
+		generate_cmp(an_ir, MCC_ASM_SETG, data);
+		break;
+	case MCC_IR_INSTR_SMALLEREQ:
+		generate_cmp(an_ir, MCC_ASM_SETLE, data);
+		break;
+	case MCC_IR_INSTR_GREATEREQ:
+		generate_cmp(an_ir, MCC_ASM_SETGE, data);
+		break;
+	case MCC_IR_INSTR_AND:
+		generate_arithm_int_op(an_ir, MCC_ASM_AND, data);
+		break;
+	case MCC_IR_INSTR_OR:
+		generate_arithm_int_op(an_ir, MCC_ASM_OR, data);
+		break;
+	case MCC_IR_INSTR_PLUS:
+		generate_plus(an_ir, data);
+		break;
+	case MCC_IR_INSTR_MINUS:
+		generate_minus(an_ir, data);
+		break;
+	case MCC_IR_INSTR_MULTIPLY:
+		generate_mult(an_ir, data);
+		break;
+	case MCC_IR_INSTR_DIVIDE:
+		generate_div(an_ir, data);
+		break;
+	case MCC_IR_INSTR_RETURN:
+		generate_return(an_ir, data);
+		break;
+	// In these cases nothing needs to happen
+	case MCC_IR_INSTR_ARRAY:
+		break;
+	case MCC_IR_INSTR_NEGATIV:
+		generate_negative(an_ir, data);
+		break;
+	case MCC_IR_INSTR_NOT:
+		generate_unary(an_ir, MCC_ASM_XORL, data);
+		break;
+	// Only vector rows select lanes
+	case MCC_IR_INSTR_MIN:
+	case MCC_IR_INSTR_MAX:
+		data->has_failed = true;
+		break;
+	case MCC_IR_INSTR_COUNT:
+		generate_count(an_ir, data);
+		break;
+	case MCC_IR_INSTR_UNKNOWN:
+		break;
+	}
+}
+
+//------------------------------------------------------------------------------------ Functions: Array bases in loops
+
+// The base address of a reference array is loaded into ecx for every access. Inside a loop that accesses only one
+// reference array and calls no function, ecx keeps its value, so the base is loaded once in front of the loop.
+
+static struct mcc_ir_arg *get_jump_target(struct mcc_ir_row *row)
+{
+	switch (row->instr) {
+	case MCC_IR_INSTR_JUMP:
+		return row->arg1;
+	case MCC_IR_INSTR_JUMPFALSE:
+		return row->arg2;
+	default:
+		return NULL;
+	}
+}
+
+// The loop ends with the last backward jump to its header
+static struct mcc_annotated_ir *find_loop_end(struct mcc_annotated_ir *header)
+{
+	assert(header->row->instr == MCC_IR_INSTR_LABEL);
+
+	struct mcc_annotated_ir *end = NULL;
+	for (struct mcc_annotated_ir *an_ir = header->next; an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     an_ir = an_ir->next) {
+		struct mcc_ir_arg *target = get_jump_target(an_ir->row);
+		if (target && target->label == header->row->arg1->label)
+			end = an_ir;
+	}
+	return end;
+}
+
+static bool is_label_in_loop(unsigned label, struct mcc_annotated_ir *header, struct mcc_annotated_ir *end)
+{
+	for (struct mcc_annotated_ir *an_ir = header; an_ir != end; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_LABEL && an_ir->row->arg1->label == label)
+			return true;
+	}
+	return false;
+}
+
+// Jumps from outside the loop would skip the load in front of it
+static bool loop_is_entered_at_top(struct mcc_annotated_ir *header, struct mcc_annotated_ir *end)
+{
+	bool is_inside = false;
+	struct mcc_annotated_ir *an_ir = mcc_get_function_label(header)->next;
+	for (; an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL; an_ir = an_ir->next) {
+		if (an_ir == header)
+			is_inside = true;
+		struct mcc_ir_arg *target = get_jump_target(an_ir->row);
+		if (!is_inside && target && is_label_in_loop(target->label, header, end))
+			return false;
+		if (an_ir == end)
+			is_inside = false;
+	}
+	return true;
+}
+
+static char *find_pinnable_array(struct mcc_annotated_ir *header, struct mcc_annotated_ir *end, struct mcc_asm_data *data)
+{
+	char *array = NULL;
+	for (struct mcc_annotated_ir *an_ir = header; an_ir != end->next; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_CALL)
+			return NULL;
+		struct mcc_ir_arg *args[] = {an_ir->row->arg1, an_ir->row->arg2};
+		for (unsigned i = 0; i < 2; i++) {
+			if (!args[i] || args[i]->type != MCC_IR_TYPE_ARR_ELEM || !array_is_reference(an_ir, args[i], data))
+				continue;
+			if (array && strcmp(array, args[i]->arr_ident) != 0)
+				return NULL;
+			array = args[i]->arr_ident;
+		}
+	}
+	return array;
+}
+
+static void pin_array_base(struct mcc_annotated_ir *header, struct mcc_asm_data *data)
+{
+	struct mcc_annotated_ir *end = find_loop_end(header);
+	if (!end || !loop_is_entered_at_top(header, end))
+		return;
+	char *array = find_pinnable_array(header, end, data);
+	if (!array || data->has_failed)
+		return;
+
+	mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), ebp(get_identifier_offset(header, array), data),
+	                 address_ecx(data), data);
+	data->pinned_array = array;
+	data->pinned_until = end->row;
+}
+
+//------------------------------------------------------------------------------------ Functions: Increments in place
+
+// x = x + c is computed in a temporary and then copied to x. If the temporary is not used otherwise, x is changed in
+// its stack slot directly.
+
+static bool row_is_used_by_other_rows(struct mcc_annotated_ir *an_ir, struct mcc_ir_row *row, struct mcc_ir_row *user)
+{
+	for (an_ir = mcc_get_function_label(an_ir)->next; an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     an_ir = an_ir->next) {
+		if (an_ir->row == user)
+			continue;
+		struct mcc_ir_arg *args[] = {an_ir->row->arg1, an_ir->row->arg2};
+		for (unsigned i = 0; i < 2; i++) {
+			struct mcc_ir_arg *arg = args[i];
+			if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+				arg = arg->index;
+			if (arg && arg->type == MCC_IR_TYPE_ROW && arg->row == row)
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool is_increment_in_place(struct mcc_annotated_ir *an_ir)
+{
+	struct mcc_ir_row *row = an_ir->row;
+	if (row->instr != MCC_IR_INSTR_PLUS && row->instr != MCC_IR_INSTR_MINUS)
+		return false;
+	if (row->type->type != MCC_IR_ROW_INT || row->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+	    row->arg2->type != MCC_IR_TYPE_LIT_INT)
+		return false;
+
+	if (!an_ir->next)
+		return false;
+	struct mcc_ir_row *assign = an_ir->next->row;
+	if (assign->instr != MCC_IR_INSTR_ASSIGN || assign->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+	    strcmp(assign->arg1->ident, row->arg1->ident) != 0 || assign->arg2->type != MCC_IR_TYPE_ROW ||
+	    assign->arg2->row != row)
+		return false;
+
+	return !row_is_used_by_other_rows(an_ir, row, assign);
+}
+
+static void generate_increment_in_place(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	long increment = an_ir->row->arg2->lit_int;
+	if (an_ir->row->instr == MCC_IR_INSTR_MINUS)
+		increment = -increment;
+	if (increment == 1 || increment == -1) {
+		enum mcc_asm_opcode opcode = increment > 0 ? MCC_ASM_INCL : MCC_ASM_DECL;
+		mcc_asm_new_line(opcode, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
+		return;
+	}
+	enum mcc_asm_opcode opcode = an_ir->row->instr == MCC_IR_INSTR_PLUS ? MCC_ASM_ADDL : MCC_ASM_SUBL;
+	mcc_asm_new_line(opcode, arg_to_op(an_ir, an_ir->row->arg2, data), arg_to_op(an_ir, an_ir->row->arg1, data),
+	                 data);
+}
+
+//------------------------------------------------------------------------------------ Functions: Expression trees
+
+// Before a function is generated, the operand rows of tree rows and int assignments are folded into the tree of their
+// user if it is their only use and only rows without side effects are in between, so that the operands of the folded
+// row still hold their values. Trees that would need more registers than there are for them keep their second operand
+// in its stack slot.
+
+static bool has_no_side_effects(struct mcc_ir_row *row)
+{
+	if (row->type && row->type->lanes > 1)
+		return false;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_DIVIDE:
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+	case MCC_IR_INSTR_AND:
+	case MCC_IR_INSTR_OR:
+	case MCC_IR_INSTR_NEGATIV:
+	case MCC_IR_INSTR_NOT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// The row computing an operand, if only rows without side effects are between it and the user
+static struct mcc_annotated_ir *find_operand_row(struct mcc_annotated_ir *user, struct mcc_ir_arg *arg)
+{
+	if (arg->type != MCC_IR_TYPE_ROW)
+		return NULL;
+	for (struct mcc_annotated_ir *an_ir = user->prev; an_ir; an_ir = an_ir->prev) {
+		if (an_ir->row == arg->row)
+			return an_ir;
+		if (!has_no_side_effects(an_ir->row))
+			return NULL;
+	}
+	return NULL;
+}
+
+// Number of operands and array indices of the user that are the value of row
+static unsigned count_uses(struct mcc_ir_row *user, struct mcc_ir_row *row, bool count_indices)
+{
+	unsigned uses = 0;
+	struct mcc_ir_arg *args[] = {user->arg1, user->arg2};
+	for (unsigned i = 0; i < 2; i++) {
+		struct mcc_ir_arg *arg = args[i];
+		if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+			arg = count_indices ? arg->index : NULL;
+		if (arg && arg->type == MCC_IR_TYPE_ROW && arg->row == row)
+			uses++;
+	}
+	return uses;
+}
+
+static bool can_fold(struct mcc_annotated_ir *operand, struct mcc_annotated_ir *user)
+{
+	return operand && mcc_isel_is_tree_row(operand->row) && !is_increment_in_place(operand) &&
+	       count_uses(user->row, operand->row, false) == 1 && count_uses(user->row, operand->row, true) == 1 &&
+	       !row_is_used_by_other_rows(user, operand->row, user->row);
+}
+
+static struct mcc_isel_node *build_tree(struct mcc_annotated_ir *an_ir);
+
+static struct mcc_isel_node *build_operand(struct mcc_annotated_ir *user, struct mcc_ir_arg *arg)
+{
+	struct mcc_annotated_ir *operand = find_operand_row(user, arg);
+	if (!can_fold(operand, user))
+		return mcc_isel_new_leaf(arg);
+	operand->is_folded = true;
+	return build_tree(operand);
+}
+
+static struct mcc_isel_node *build_tree(struct mcc_annotated_ir *an_ir)
+{
+	struct mcc_ir_arg *args[] = {an_ir->row->arg1, an_ir->row->arg2};
+	struct mcc_isel_node *kids[2];
+	for (unsigned i = 0; i < 2; i++)
+		kids[i] = build_operand(an_ir, args[i]);
+
+	// Both kids would hold a register while the other one is computed
+	if (kids[0] && kids[1] && kids[0]->need >= NUM_TREE_REGISTERS && kids[1]->need >= NUM_TREE_REGISTERS) {
+		find_operand_row(an_ir, args[1])->is_folded = false;
+		mcc_isel_delete_tree(kids[1]);
+		kids[1] = mcc_isel_new_leaf(args[1]);
+	}
+
+	struct mcc_isel_node *tree = mcc_isel_new_row_node(an_ir->row);
+	if (!tree || !kids[0] || !kids[1]) {
+		mcc_isel_delete_tree(tree);
+		mcc_isel_delete_tree(kids[0]);
+		mcc_isel_delete_tree(kids[1]);
+		return NULL;
+	}
+	mcc_isel_set_kids(tree, kids[0], kids[1]);
+	return tree;
+}
+
+// Builds and labels the trees of the function. Rows are visited from the end, so that users are seen before the rows
+// they fold.
+static void select_trees(struct mcc_annotated_ir *function_label, struct mcc_asm_data *data)
+{
+	struct mcc_annotated_ir *last = function_label;
+	while (last->next && last->next->row->instr != MCC_IR_INSTR_FUNC_LABEL)
+		last = last->next;
+
+	for (struct mcc_annotated_ir *an_ir = last; an_ir != function_label && !data->has_failed; an_ir = an_ir->prev) {
+		if (an_ir->is_folded)
+			continue;
+		struct mcc_ir_row *row = an_ir->row;
+		if (mcc_isel_is_tree_row(row)) {
+			if (is_increment_in_place(an_ir))
+				continue;
+			an_ir->tree = build_tree(an_ir);
+		} else if (row->instr == MCC_IR_INSTR_ASSIGN) {
+			struct mcc_annotated_ir *operand = find_operand_row(an_ir, row->arg2);
+			if (!can_fold(operand, an_ir))
+				continue;
+			operand->is_folded = true;
+			an_ir->tree = build_tree(operand);
+		} else {
+			continue;
+		}
+		if (!an_ir->tree || !mcc_isel_label(an_ir->tree))
+			data->has_failed = true;
+	}
+}
+
+static void delete_trees(struct mcc_annotated_ir *function_label)
+{
+	for (struct mcc_annotated_ir *an_ir = function_label->next;
+	     an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL; an_ir = an_ir->next) {
+		mcc_isel_delete_tree(an_ir->tree);
+		an_ir->tree = NULL;
+		an_ir->is_folded = false;
+	}
+}
+
+//------------------------------------------------------------------------------------ Functions: Compare and branch
+
+// A comparison whose bool is only used by the following conditional jump sets the flags for the jump directly. The
+// bool is not stored.
+
+static bool is_compare_and_branch(struct mcc_annotated_ir *an_ir)
+{
+	struct mcc_ir_row *row = an_ir->row;
+	if (!mcc_ir_is_compare(row) || !an_ir->next)
+		return false;
+
+	struct mcc_ir_row *jump = an_ir->next->row;
+	if (jump->instr != MCC_IR_INSTR_JUMPFALSE || jump->arg1->type != MCC_IR_TYPE_ROW || jump->arg1->row != row)
+		return false;
+
+	return !row_is_used_by_other_rows(an_ir, row, jump);
+}
+
+// Jump taken if the comparison is false. fcomip and ucomiss set the flags like an unsigned comparison.
+static enum mcc_asm_opcode get_jump_if_false(enum mcc_ir_instruction instr, bool is_float)
+{
+	switch (instr) {
+	case MCC_IR_INSTR_EQUALS:
+		return MCC_ASM_JNE;
+	case MCC_IR_INSTR_NOTEQUALS:
+		return MCC_ASM_JE;
+	case MCC_IR_INSTR_SMALLER:
+		return is_float ? MCC_ASM_JAE : MCC_ASM_JGE;
+	case MCC_IR_INSTR_GREATER:
+		return is_float ? MCC_ASM_JBE : MCC_ASM_JLE;
+	case MCC_IR_INSTR_SMALLEREQ:
+		return is_float ? MCC_ASM_JA : MCC_ASM_JG;
+	default: // MCC_IR_INSTR_GREATEREQ
+		return is_float ? MCC_ASM_JB : MCC_ASM_JL;
+	}
+}
+
+static void generate_compare_and_branch(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	bool is_float_compare = is_float(an_ir->row->arg1, an_ir, data);
+	if (is_float_compare) {
+		generate_cmp_op_float(an_ir, data);
+	} else {
+		generate_cmp_op_int(an_ir, data);
+	}
+	enum mcc_asm_opcode opcode = get_jump_if_false(an_ir->row->instr, is_float_compare);
+	mcc_asm_new_label(opcode, an_ir->next->row->arg2->label, data);
+}
+
+//------------------------------------------------------------------------------------ Functions: Conditional moves
+
+// An if statement whose branches only assign int or bool values to variables is computed without jumps. The rows of
+// both branches are generated, and each assignment uses cmov to keep the old value of the variable if its branch is
+// not taken. The condition stays in the flags if the branches only move values. Branches with arithmetic keep it in
+// ebx instead and test it again in front of every cmov. Branches with array elements are left alone, since the index
+// may only be valid if the branch is taken.
+
+#define MAX_BRANCH_ROWS 4
+
+struct conditional_move {
+	// Int comparison that sets the flags, NULL if the condition is a stored bool
+	struct mcc_annotated_ir *compare;
+	struct mcc_annotated_ir *jump;
+	// The rows of each branch end in front of the last row, the else branch of an if statement without else is empty
+	struct mcc_annotated_ir *then_first;
+	struct mcc_annotated_ir *then_last;
+	struct mcc_annotated_ir *else_first;
+	struct mcc_annotated_ir *else_last;
+	// The end label, where the code generation continues
+	struct mcc_annotated_ir *next;
+	bool keeps_flags;
+};
+
+static bool is_scalar_operand(struct mcc_ir_arg *arg)
 {
-	assert(an_ir);
-	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
-		generate_arithm_int_op(an_ir, MCC_ASM_IMULL, data);
-	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-		generate_arithm_float_op(an_ir, MCC_ASM_FMULP, data);
+	switch (arg->type) {
+	case MCC_IR_TYPE_LIT_INT:
+	case MCC_IR_TYPE_LIT_BOOL:
+	case MCC_IR_TYPE_ROW:
+	case MCC_IR_TYPE_IDENTIFIER:
+		return true;
+	default:
+		return false;
 	}
 }
 
-static void generate_div(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static bool is_scalar_assignment(struct mcc_ir_row *row)
 {
-	assert(an_ir);
-	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
-		generate_arithm_int_op(an_ir, MCC_ASM_IDIVL, data);
-	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-		generate_arithm_float_op(an_ir, MCC_ASM_FDIVP, data);
-	}
+	return row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+	       (row->type->type == MCC_IR_ROW_INT || row->type->type == MCC_IR_ROW_BOOL) &&
+	       row->type->array_size == -1 && row->type->lanes == 1 && is_scalar_operand(row->arg2);
 }
 
-static void generate_call(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+// The first row of the branch starting at first that cannot be computed without jumps, NULL if the branch is too long.
+// Arithmetic in the branch clears keeps_flags.
+static struct mcc_annotated_ir *find_branch_end(struct mcc_annotated_ir *first, bool *keeps_flags)
 {
-	assert(an_ir);
-	struct mcc_asm_operand *func = mcc_asm_new_function_operand(an_ir->row->arg1->func_label, data);
-	mcc_asm_new_line(MCC_ASM_CALLL, func, NULL, data);
-	// count pushes before call and add to esp afterwards
-	int literal = count_pushes(an_ir);
-	if (literal != 0) {
-		mcc_asm_new_line(MCC_ASM_ADDL, mcc_asm_new_literal_operand(literal * 4, data), esp(data), data);
-	}
-	// if function is void do no move instruction
-	if (an_ir->row->type->type != MCC_IR_ROW_TYPELESS) {
-		if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-			mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+	struct mcc_annotated_ir *an_ir = first;
+	for (unsigned num_rows = 0; an_ir; an_ir = an_ir->next, num_rows++) {
+		struct mcc_ir_row *row = an_ir->row;
+		if (is_scalar_assignment(row)) {
+			*keeps_flags = *keeps_flags && !an_ir->tree;
+		} else if (mcc_isel_is_tree_row(row) && is_scalar_operand(row->arg1) && is_scalar_operand(row->arg2)) {
+			*keeps_flags = false;
 		} else {
-			mcc_asm_new_line(MCC_ASM_MOVL, eax(data), ebp(an_ir->stack_position, data), data);
+			break;
 		}
+		if (num_rows == MAX_BRANCH_ROWS)
+			return NULL;
 	}
+	return an_ir;
 }
 
-static void generate_pop(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static bool is_label(struct mcc_annotated_ir *an_ir, unsigned label)
 {
-	assert(an_ir);
-	assert(an_ir->row->instr == MCC_IR_INSTR_POP);
-	mcc_asm_new_line(MCC_ASM_MOVL, ebp(an_ir->stack_position, data), eax(data), data);
-	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(an_ir->next, an_ir->next->row->arg1, data), data);
+	return an_ir && an_ir->row->instr == MCC_IR_INSTR_LABEL && an_ir->row->arg1->label == label;
 }
 
-static void generate_neg_float(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static unsigned count_jumps_to(struct mcc_annotated_ir *an_ir, unsigned label)
 {
-	assert(an_ir);
-	mcc_asm_new_line(MCC_ASM_FLDS, arg_to_op(an_ir, an_ir->row->arg1, data), NULL, data);
-	mcc_asm_new_line(MCC_ASM_FCHS, NULL, NULL, data);
-	mcc_asm_new_line(MCC_ASM_FSTPS, ebp(an_ir->stack_position, data), NULL, data);
+	unsigned num_jumps = 0;
+	for (an_ir = mcc_get_function_label(an_ir)->next; an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     an_ir = an_ir->next) {
+		struct mcc_ir_arg *target = get_jump_target(an_ir->row);
+		if (target && target->label == label)
+			num_jumps++;
+	}
+	return num_jumps;
 }
 
-static void generate_negative(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static bool
+find_conditional_move(struct mcc_annotated_ir *an_ir, struct conditional_move *move, struct mcc_asm_data *data)
 {
-	assert(an_ir);
-	if (an_ir->row->type->type == MCC_IR_ROW_INT) {
-		generate_unary(an_ir, MCC_ASM_NEGL, data);
-	} else if (an_ir->row->type->type == MCC_IR_ROW_FLOAT) {
-		generate_neg_float(an_ir, data);
+	move->compare = NULL;
+	move->jump = an_ir;
+	if (is_compare_and_branch(an_ir)) {
+		if (is_float(an_ir->row->arg1, an_ir, data))
+			return false;
+		move->compare = an_ir;
+		move->jump = an_ir->next;
+	}
+	struct mcc_ir_row *jump = move->jump->row;
+	if (jump->instr != MCC_IR_INSTR_JUMPFALSE)
+		return false;
+	if (!move->compare && jump->arg1->type != MCC_IR_TYPE_ROW && jump->arg1->type != MCC_IR_TYPE_IDENTIFIER)
+		return false;
+
+	move->keeps_flags = true;
+	move->then_first = move->jump->next;
+	move->then_last = find_branch_end(move->then_first, &move->keeps_flags);
+	if (!move->then_last)
+		return false;
+	unsigned else_label = jump->arg2->label;
+
+	// If statement without else
+	if (is_label(move->then_last, else_label)) {
+		move->else_first = move->then_last;
+		move->else_last = move->then_last;
+		move->next = move->then_last;
+		return move->then_first != move->then_last;
 	}
+
+	// The else branch must only be entered by the conditional jump, since its label is not generated
+	if (move->then_last->row->instr != MCC_IR_INSTR_JUMP || !is_label(move->then_last->next, else_label) ||
+	    count_jumps_to(an_ir, else_label) != 1)
+		return false;
+	move->else_first = move->then_last->next->next;
+	move->else_last = find_branch_end(move->else_first, &move->keeps_flags);
+	if (!move->else_last || !is_label(move->else_last, move->then_last->row->arg1->label))
+		return false;
+	move->next = move->else_last;
+	return move->then_first != move->then_last || move->else_first != move->else_last;
 }
 
-void mcc_asm_generate_asm_from_ir(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+static enum mcc_asm_opcode get_set_if_true(enum mcc_ir_instruction instr)
 {
-	assert(an_ir);
-
-	if (data->has_failed)
-		return;
+	switch (instr) {
+	case MCC_IR_INSTR_EQUALS:
+		return MCC_ASM_SETE;
+	case MCC_IR_INSTR_NOTEQUALS:
+		return MCC_ASM_SETNE;
+	case MCC_IR_INSTR_SMALLER:
+		return MCC_ASM_SETL;
+	case MCC_IR_INSTR_GREATER:
+		return MCC_ASM_SETG;
+	case MCC_IR_INSTR_SMALLEREQ:
+		return MCC_ASM_SETLE;
+	default: // MCC_IR_INSTR_GREATEREQ
+		return MCC_ASM_SETGE;
+	}
+}
 
-	switch (an_ir->row->instr) {
-	case MCC_IR_INSTR_ASSIGN:
-		generate_instr_assign(an_ir, data);
-		break;
-	case MCC_IR_INSTR_LABEL:
-		mcc_asm_new_label(MCC_ASM_LABEL, an_ir->row->arg1->label, data);
-		break;
-	case MCC_IR_INSTR_FUNC_LABEL:
-		break;
-	case MCC_IR_INSTR_JUMP:
-		generate_jumpfalse(MCC_ASM_JE, an_ir, data);
-		break;
-	case MCC_IR_INSTR_CALL:
-		generate_call(an_ir, data);
-		break;
-	case MCC_IR_INSTR_JUMPFALSE:
-		generate_jumpfalse(MCC_ASM_JNE, an_ir, data);
-		break;
-	case MCC_IR_INSTR_PUSH:
-		generate_push(an_ir, data);
-		break;
-	case MCC_IR_INSTR_POP:
-		generate_pop(an_ir, data);
-		break;
+static enum mcc_asm_opcode get_move_if(enum mcc_ir_instruction instr, bool is_true)
+{
+	switch (instr) {
 	case MCC_IR_INSTR_EQUALS:
-		generate_cmp(an_ir, MCC_ASM_SETE, data);
-		break;
+		return is_true ? MCC_ASM_CMOVE : MCC_ASM_CMOVNE;
 	case MCC_IR_INSTR_NOTEQUALS:
-		generate_cmp(an_ir, MCC_ASM_SETNE, data);
-		break;
+		return is_true ? MCC_ASM_CMOVNE : MCC_ASM_CMOVE;
 	case MCC_IR_INSTR_SMALLER:
-		generate_cmp(an_ir, MCC_ASM_SETL, data);
-		break;
+		return is_true ? MCC_ASM_CMOVL : MCC_ASM_CMOVGE;
 	case MCC_IR_INSTR_GREATER:
-		generate_cmp(an_ir, MCC_ASM_SETG, data);
-		break;
+		return is_true ? MCC_ASM_CMOVG : MCC_ASM_CMOVLE;
 	case MCC_IR_INSTR_SMALLEREQ:
-		generate_cmp(an_ir, MCC_ASM_SETLE, data);
-		break;
-	case MCC_IR_INSTR_GREATEREQ:
-		generate_cmp(an_ir, MCC_ASM_SETGE, data);
-		break;
-	case MCC_IR_INSTR_AND:
-		generate_arithm_int_op(an_ir, MCC_ASM_AND, data);
-		break;
-	case MCC_IR_INSTR_OR:
-		generate_arithm_int_op(an_ir, MCC_ASM_OR, data);
-		break;
-	case MCC_IR_INSTR_PLUS:
-		generate_plus(an_ir, data);
-		break;
-	case MCC_IR_INSTR_MINUS:
-		generate_minus(an_ir, data);
-		break;
-	case MCC_IR_INSTR_MULTIPLY:
-		generate_mult(an_ir, data);
-		break;
-	case MCC_IR_INSTR_DIVIDE:
-		generate_div(an_ir, data);
-		break;
-	case MCC_IR_INSTR_RETURN:
-		generate_return(an_ir, data);
-		break;
-	// In these cases nothing needs to happen
-	case MCC_IR_INSTR_ARRAY:
-		break;
-	case MCC_IR_INSTR_NEGATIV:
-		generate_negative(an_ir, data);
-		break;
-	case MCC_IR_INSTR_NOT:
-		generate_unary(an_ir, MCC_ASM_XORL, data);
-		break;
-	case MCC_IR_INSTR_UNKNOWN:
-		break;
+		return is_true ? MCC_ASM_CMOVLE : MCC_ASM_CMOVG;
+	default: // MCC_IR_INSTR_GREATEREQ
+		return is_true ? MCC_ASM_CMOVGE : MCC_ASM_CMOVL;
+	}
+}
+
+// keep_old is the cmov that loads the old value of the variable if the branch of the assignment is not taken
+static void generate_conditional_assign(struct mcc_annotated_ir *an_ir,
+                                        enum mcc_asm_opcode keep_old,
+                                        bool keeps_flags,
+                                        struct mcc_asm_data *data)
+{
+	enum mcc_asm_register value = MCC_ASM_EAX;
+	if (an_ir->tree) {
+		bool used[NUM_TREE_REGISTERS] = {false};
+		value = reduce(an_ir, an_ir->tree, used, data);
+	} else {
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(an_ir, an_ir->row->arg2, data), eax(data), data);
+	}
+	if (!keeps_flags)
+		mcc_asm_new_line(MCC_ASM_CMPL, literal(0, data), ebx(data), data);
+	mcc_asm_new_line(keep_old, arg_to_op(an_ir, an_ir->row->arg1, data), mcc_asm_new_register_operand(value, 0, data),
+	                 data);
+	mcc_asm_new_line(MCC_ASM_MOVL, mcc_asm_new_register_operand(value, 0, data),
+	                 arg_to_op(an_ir, an_ir->row->arg1, data), data);
+}
+
+static void generate_branch(struct mcc_annotated_ir *first,
+                            struct mcc_annotated_ir *last,
+                            enum mcc_asm_opcode keep_old,
+                            bool keeps_flags,
+                            struct mcc_asm_data *data)
+{
+	for (struct mcc_annotated_ir *an_ir = first; an_ir != last && !data->has_failed; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_ASSIGN) {
+			generate_conditional_assign(an_ir, keep_old, keeps_flags, data);
+		} else {
+			mcc_asm_generate_asm_from_ir(an_ir, data);
+		}
+	}
+}
+
+// Both branches assign one value to the same variable without arithmetic, as in if (a < b) m = a; else m = b;
+static bool is_select(struct conditional_move *move)
+{
+	if (!move->keeps_flags || move->then_first->next != move->then_last || move->else_first->next != move->else_last)
+		return false;
+	struct mcc_ir_row *then_row = move->then_first->row;
+	struct mcc_ir_row *else_row = move->else_first->row;
+	return then_row->instr == MCC_IR_INSTR_ASSIGN && else_row->instr == MCC_IR_INSTR_ASSIGN &&
+	       strcmp(then_row->arg1->ident, else_row->arg1->ident) == 0 &&
+	       (!is_literal(then_row->arg2) || !is_literal(else_row->arg2));
+}
+
+// Loads the value of the other branch and moves the value that is not a literal over it, since cmov takes no literals
+static void generate_select(struct conditional_move *move, enum mcc_ir_instruction condition, struct mcc_asm_data *data)
+{
+	struct mcc_annotated_ir *moved = move->then_first;
+	struct mcc_annotated_ir *loaded = move->else_first;
+	bool is_true = true;
+	if (is_literal(moved->row->arg2)) {
+		moved = move->else_first;
+		loaded = move->then_first;
+		is_true = false;
+	}
+	mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(loaded, loaded->row->arg2, data), eax(data), data);
+	mcc_asm_new_line(get_move_if(condition, is_true), arg_to_op(moved, moved->row->arg2, data), eax(data), data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax(data), arg_to_op(moved, moved->row->arg1, data), data);
+}
+
+static void generate_conditional_move(struct conditional_move *move, struct mcc_asm_data *data)
+{
+	// A stored bool is true if it is not 0
+	enum mcc_ir_instruction condition = MCC_IR_INSTR_NOTEQUALS;
+	if (move->compare) {
+		condition = move->compare->row->instr;
+		generate_cmp_op_int(move->compare, data);
+		if (!move->keeps_flags) {
+			mcc_asm_new_line(get_set_if_true(condition), dl(data), NULL, data);
+			mcc_asm_new_line(MCC_ASM_MOVZBL, dl(data), ebx(data), data);
+			condition = MCC_IR_INSTR_NOTEQUALS;
+		}
+	} else if (move->keeps_flags) {
+		mcc_asm_new_line(MCC_ASM_CMPL, literal(0, data), arg_to_op(move->jump, move->jump->row->arg1, data), data);
+	} else {
+		mcc_asm_new_line(MCC_ASM_MOVL, arg_to_op(move->jump, move->jump->row->arg1, data), ebx(data), data);
 	}
+
+	if (is_select(move)) {
+		generate_select(move, condition, data);
+		return;
+	}
+	generate_branch(move->then_first, move->then_last, get_move_if(condition, false), move->keeps_flags, data);
+	generate_branch(move->else_first, move->else_last, get_move_if(condition, true), move->keeps_flags, data);
+}
+
+//------------------------------------------------------------------------------------ Functions: Tail calls
+
+// A call whose result is returned right away jumps to the called function instead. The stack arguments are copied
+// into the parameter area of the current function, so the called function returns directly to the caller of this one.
+
+static bool is_tail_jump(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	struct mcc_ir_row *call = an_ir->row;
+	if (call->instr != MCC_IR_INSTR_CALL || !an_ir->next)
+		return false;
+	struct mcc_ir_row *ret = an_ir->next->row;
+	if (ret->instr != MCC_IR_INSTR_RETURN)
+		return false;
+	if (call->type->type == MCC_IR_ROW_TYPELESS) {
+		if (ret->arg1)
+			return false;
+	} else if (!ret->arg1 || ret->arg1->type != MCC_IR_TYPE_ROW || ret->arg1->row != call ||
+	           ret->type->type != call->type->type) {
+		return false;
+	}
+
+	// The stack arguments must fit into the parameter area. No argument may point into the frame that is given up.
+	int num_stack_args = is_register_call(an_ir, data) ? count_stack_args(an_ir, data) : count_pushes(an_ir);
+	if (num_stack_args > count_stack_params(mcc_get_function_label(an_ir), data))
+		return false;
+	int num_pushes = count_pushes(an_ir);
+	struct mcc_annotated_ir *push = an_ir->prev;
+	for (int i = 0; i < num_pushes; i++, push = push->prev) {
+		if (arg_is_local_array(push, push->row->arg1))
+			return false;
+	}
+	return is_defined_function(an_ir, call->arg1->func_label);
+}
+
+static void generate_tail_jump(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
+{
+	bool is_register = is_register_call(an_ir, data);
+	int num_stack_args = count_pushes(an_ir);
+	if (is_register) {
+		num_stack_args = count_stack_args(an_ir, data);
+		generate_stack_args(an_ir, data);
+	}
+	// The first argument was pushed last
+	enum mcc_asm_opcode move = address_opcode(MCC_ASM_MOVL, data);
+	for (int i = 0; i < num_stack_args; i++) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_POPL, data), address_eax(data), NULL, data);
+		mcc_asm_new_line(move, address_eax(data), ebp(2 * slot_size(data) + slot_size(data) * i, data), data);
+	}
+	if (is_register)
+		generate_register_args(an_ir, data);
+	if (saves_ebx(an_ir, data)) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_POPL, data), address_ebx(data), NULL, data);
+	}
+	mcc_asm_new_line(MCC_ASM_LEAVE, NULL, NULL, data);
+	mcc_asm_new_line(MCC_ASM_JMP, mcc_asm_new_function_operand(an_ir->row->arg1->func_label, data), NULL, data);
 }
 
 void mcc_asm_generate_function_body(struct mcc_asm_function *function,
@@ -1131,14 +2872,48 @@ void mcc_asm_generate_function_body(struct mcc_asm_function *function,
 	if (data->has_failed)
 		return;
 
+	struct mcc_annotated_ir *function_label = an_ir;
+	select_trees(function_label, data);
 	an_ir = an_ir->next;
+	data->pinned_array = NULL;
 
 	// Iterate up to next function
 	while (an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL) {
 
+		if (an_ir->row->instr == MCC_IR_INSTR_LABEL && !data->pinned_array) {
+			pin_array_base(an_ir, data);
+		}
+		// The return behind a tail call is not needed
+		if (is_tail_jump(an_ir, data)) {
+			generate_tail_jump(an_ir, data);
+			an_ir = an_ir->next->next;
+			continue;
+		}
+		if (is_increment_in_place(an_ir)) {
+			generate_increment_in_place(an_ir, data);
+			an_ir = an_ir->next->next;
+			continue;
+		}
+		struct conditional_move move;
+		if (find_conditional_move(an_ir, &move, data)) {
+			generate_conditional_move(&move, data);
+			an_ir = move.next;
+			continue;
+		}
+		if (is_compare_and_branch(an_ir)) {
+			generate_compare_and_branch(an_ir, data);
+			if (an_ir->next->row == data->pinned_until) {
+				data->pinned_array = NULL;
+			}
+			an_ir = an_ir->next->next;
+			continue;
+		}
 		mcc_asm_generate_asm_from_ir(an_ir, data);
 		if (data->has_failed) {
-			return;
+			break;
+		}
+		if (an_ir->row == data->pinned_until) {
+			data->pinned_array = NULL;
 		}
 		// if pop, omit the next assign instruction, since it is already handled with the pop instruction
 		if (an_ir->row->instr == MCC_IR_INSTR_POP) {
@@ -1147,6 +2922,133 @@ void mcc_asm_generate_function_body(struct mcc_asm_function *function,
 			an_ir = an_ir->next;
 		}
 	}
+	delete_trees(function_label);
+}
+
+//------------------------------------------------------------------------------------ Functions: Frame pointer omission
+
+// With -fomit-frame-pointer, functions that call no other function address their stack frame from esp, which does not
+// change in their body. ebp is neither saved nor set up, and ebx is only saved if the body uses it. The local variables
+// stay right below the return address, the stack arguments move up by the slot of the saved ebp. The lowest local
+// variable must not be addressed as 0(%esp), which is printed like the register itself, so a slot is left free below
+// it if ebx is not saved there.
+
+static bool is_leaf_function(struct mcc_annotated_ir *function_label)
+{
+	for (struct mcc_annotated_ir *an_ir = function_label->next;
+	     an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_CALL)
+			return false;
+	}
+	return true;
+}
+
+static bool is_ebx_or_ebp(enum mcc_asm_register reg, enum mcc_asm_register ebx_or_ebp)
+{
+	return reg == ebx_or_ebp || reg == (ebx_or_ebp == MCC_ASM_EBX ? MCC_ASM_RBX : MCC_ASM_RBP);
+}
+
+static bool uses_register(struct mcc_asm_operand *operand, enum mcc_asm_register reg)
+{
+	if (!operand)
+		return false;
+	if (operand->type == MCC_ASM_OPERAND_REGISTER)
+		return is_ebx_or_ebp(operand->reg, reg);
+	if (operand->type == MCC_ASM_OPERAND_COMPUTED_OFFSET)
+		return is_ebx_or_ebp(operand->offset_base, reg) || is_ebx_or_ebp(operand->offset_factor, reg);
+	return false;
+}
+
+static bool is_register_operand(struct mcc_asm_operand *operand, enum mcc_asm_register reg)
+{
+	return operand && operand->type == MCC_ASM_OPERAND_REGISTER && operand->offset == 0 &&
+	       is_ebx_or_ebp(operand->reg, reg);
+}
+
+// The pop of ebx in front of leave in the epilog
+static bool is_ebx_restore(struct mcc_asm_line *line)
+{
+	return (line->opcode == MCC_ASM_POPL || line->opcode == MCC_ASM_POPQ) &&
+	       is_register_operand(line->first, MCC_ASM_EBX) && line->next && line->next->opcode == MCC_ASM_LEAVE;
+}
+
+static void move_to_esp(struct mcc_asm_operand *operand, int frame_size, struct mcc_asm_data *data)
+{
+	if (!operand || !uses_register(operand, MCC_ASM_EBP))
+		return;
+	if (operand->type == MCC_ASM_OPERAND_REGISTER) {
+		operand->reg = address_register(MCC_ASM_ESP, data);
+		operand->offset += operand->offset > 0 ? frame_size - slot_size(data) : frame_size;
+	} else {
+		operand->offset_base = address_register(MCC_ASM_ESP, data);
+		operand->offset_initial += frame_size;
+	}
+}
+
+static void remove_line(struct mcc_asm_line **link)
+{
+	struct mcc_asm_line *line = *link;
+	*link = line->next;
+	mcc_asm_delete_line(line);
+}
+
+static void omit_frame_pointer(struct mcc_asm_function *function,
+                               struct mcc_annotated_ir *function_label,
+                               struct mcc_asm_data *data)
+{
+	if (!data->options.omit_frame_pointer || !is_leaf_function(function_label))
+		return;
+
+	// Prolog: push ebp, set ebp, reserve the frame and save ebx
+	bool saves = saves_ebx(function_label, data);
+	struct mcc_asm_line *reserve = function->head->next->next;
+	struct mcc_asm_line *body = saves ? reserve->next->next : reserve->next;
+	bool uses_ebx = false;
+	for (struct mcc_asm_line *line = body; line; line = line->next) {
+		if (mcc_asm_opcode_has_label(line->opcode) || is_ebx_restore(line))
+			continue;
+		// The frame pointer itself is needed, not only slots addressed from it
+		if (is_register_operand(line->first, MCC_ASM_EBP) || is_register_operand(line->second, MCC_ASM_EBP))
+			return;
+		uses_ebx = uses_ebx || uses_register(line->first, MCC_ASM_EBX) || uses_register(line->second, MCC_ASM_EBX);
+	}
+
+	int locals_size = function_label->stack_size;
+	bool keeps_ebx = saves && uses_ebx;
+	int reserved = locals_size > 0 && !keeps_ebx ? locals_size + slot_size(data) : locals_size;
+	int frame_size = keeps_ebx ? reserved + slot_size(data) : reserved;
+
+	remove_line(&function->head);
+	remove_line(&function->head);
+	struct mcc_asm_line **link = &function->head;
+	reserve->first->literal = reserved;
+	if (reserved == 0)
+		remove_line(link);
+	else
+		link = &reserve->next;
+	if (saves && !keeps_ebx)
+		remove_line(link);
+
+	while (*link && !data->has_failed) {
+		struct mcc_asm_line *line = *link;
+		if (is_ebx_restore(line) && !keeps_ebx) {
+			remove_line(link);
+			continue;
+		}
+		if (line->opcode == MCC_ASM_LEAVE) {
+			if (reserved == 0) {
+				remove_line(link);
+				continue;
+			}
+			line->opcode = address_opcode(MCC_ASM_ADDL, data);
+			line->first = mcc_asm_new_literal_operand(reserved, data);
+			line->second = esp(data);
+		} else if (!mcc_asm_opcode_has_label(line->opcode)) {
+			move_to_esp(line->first, frame_size, data);
+			move_to_esp(line->second, frame_size, data);
+		}
+		link = &line->next;
+	}
 }
 
 struct mcc_asm_function *mcc_asm_generate_function(struct mcc_annotated_ir *an_ir, struct mcc_asm_data *data)
@@ -1163,6 +3065,7 @@ struct mcc_asm_function *mcc_asm_generate_function(struct mcc_annotated_ir *an_i
 		data->has_failed = true;
 		return NULL;
 	}
+	function->is_global = is_x86_64(data) || !takes_register_args(an_ir, data);
 
 	// Prolog
 	struct mcc_asm_line *push_ebp = malloc(sizeof *push_ebp);
@@ -1171,28 +3074,28 @@ struct mcc_asm_function *mcc_asm_generate_function(struct mcc_annotated_ir *an_i
 		mcc_asm_delete_function(function);
 		return NULL;
 	}
-	push_ebp->opcode = MCC_ASM_PUSHL;
+	push_ebp->opcode = address_opcode(MCC_ASM_PUSHL, data);
 	push_ebp->first = ebp(0, data);
 	push_ebp->second = NULL;
 	data->current = push_ebp;
-	mcc_asm_new_line(MCC_ASM_MOVL, esp(data), ebp(0, data), data);
+	mcc_asm_new_line(address_opcode(MCC_ASM_MOVL, data), esp(data), ebp(0, data), data);
 	// Func args
-	struct mcc_asm_operand *size_literal = mcc_asm_new_literal_operand(an_ir->stack_size, data);
-	mcc_asm_new_line(MCC_ASM_SUBL, size_literal, esp(data), data);
+	struct mcc_asm_operand *size_literal = mcc_asm_new_literal_operand(get_frame_size(an_ir, data), data);
+	mcc_asm_new_line(address_opcode(MCC_ASM_SUBL, data), size_literal, esp(data), data);
 	// store ebx except for main
-	if (strcmp(an_ir->row->arg1->func_label, "main") != 0) {
-		mcc_asm_new_line(MCC_ASM_PUSHL, ebx(data), NULL, data);
+	if (saves_ebx(an_ir, data)) {
+		mcc_asm_new_line(address_opcode(MCC_ASM_PUSHL, data), address_ebx(data), NULL, data);
 	}
 
 	// Function body
 	mcc_asm_generate_function_body(function, an_ir, data);
+	function->head = push_ebp;
+	omit_frame_pointer(function, an_ir, data);
 
 	if (data->has_failed) {
-		mcc_asm_delete_all_lines(push_ebp);
 		mcc_asm_delete_function(function);
 		return NULL;
 	}
-	function->head = push_ebp;
 
 	return function;
 }
@@ -1311,17 +3214,47 @@ void mcc_asm_generate_data_section(struct mcc_asm_data_section *data_section,
 		an_ir = an_ir->next;
 	}
 
-	return;
+	// Counters of an instrumented program and their description for the runtime
+	if (data->options.num_profile_counters == 0)
+		return;
+	struct mcc_asm_declaration *counters = mcc_asm_new_counters_declaration(
+	    MCC_PROFILE_COUNTERS_SYMBOL, data->options.num_profile_counters, NULL, data);
+	struct mcc_asm_declaration *header =
+	    mcc_asm_new_string_declaration(MCC_PROFILE_HEADER_SYMBOL, data->options.profile_header, counters, data);
+	if (!counters || !header) {
+		mcc_asm_delete_declaration(counters);
+		return;
+	}
+	header->is_global = true;
+	if (!head)
+		data_section->head = header;
+	else
+		head->next = header;
 }
 
 struct mcc_asm *mcc_asm_generate(struct mcc_ir_row *ir)
 {
+	struct mcc_asm_options options = {.sse2 = false, .target = MCC_ASM_TARGET_X86};
+	return mcc_asm_generate_with_options(ir, &options);
+}
+
+struct mcc_asm *mcc_asm_generate_with_options(struct mcc_ir_row *ir, const struct mcc_asm_options *options)
+{
+	assert(options);
+
 	struct mcc_asm_data *data = malloc(sizeof(*data));
 	if (!data) {
 		return NULL;
 	}
 	data->has_failed = false;
-	struct mcc_annotated_ir *an_ir = mcc_annotate_ir(ir);
+	data->options = *options;
+	data->pinned_array = NULL;
+	data->pinned_until = NULL;
+	// x86-64 always has SSE2
+	if (is_x86_64(data))
+		data->options.sse2 = true;
+	struct mcc_stack_layout layout = {.slot_size = slot_size(data), .pack_bool_arrays = options->pack_bool_arrays};
+	struct mcc_annotated_ir *an_ir = mcc_annotate_ir_with_layout(ir, &layout);
 	struct mcc_asm *assembly = mcc_asm_new_asm(NULL, NULL, data);
 	struct mcc_asm_text_section *text_section = mcc_asm_new_text_section(NULL, data);
 	struct mcc_asm_data_section *data_section = mcc_asm_new_data_section(NULL, data);
@@ -21,6 +21,8 @@ static char *opcode_to_string(enum mcc_asm_opcode op)
 		return "movl";
 	case MCC_ASM_MOVZBL:
 		return "movzbl";
+	case MCC_ASM_MOVB:
+		return "movb";
 	case MCC_ASM_CMPL:
 		return "cmpl";
 	case MCC_ASM_PUSHL:
@@ -29,6 +31,8 @@ static char *opcode_to_string(enum mcc_asm_opcode op)
 		return "popl";
 	case MCC_ASM_ADDL:
 		return "addl";
+	case MCC_ASM_ADCL:
+		return "adcl";
 	case MCC_ASM_SUBL:
 		return "subl";
 	case MCC_ASM_IMULL:
@@ -63,14 +67,38 @@ static char *opcode_to_string(enum mcc_asm_opcode op)
 		return "leave";
 	case MCC_ASM_CALLL:
 		return "calll";
+	case MCC_ASM_JMP:
+		return "jmp";
 	case MCC_ASM_XORL:
 		return "xorl";
 	case MCC_ASM_NEGL:
 		return "negl";
+	case MCC_ASM_NOTL:
+		return "notl";
+	case MCC_ASM_BTL:
+		return "btl";
+	case MCC_ASM_BTSL:
+		return "btsl";
 	case MCC_ASM_JE:
 		return "je";
 	case MCC_ASM_JNE:
 		return "jne";
+	case MCC_ASM_JL:
+		return "jl";
+	case MCC_ASM_JG:
+		return "jg";
+	case MCC_ASM_JLE:
+		return "jle";
+	case MCC_ASM_JGE:
+		return "jge";
+	case MCC_ASM_JA:
+		return "ja";
+	case MCC_ASM_JAE:
+		return "jae";
+	case MCC_ASM_JB:
+		return "jb";
+	case MCC_ASM_JBE:
+		return "jbe";
 	case MCC_ASM_RETURN:
 		return "ret";
 	case MCC_ASM_LEAL:
@@ -95,6 +123,94 @@ static char *opcode_to_string(enum mcc_asm_opcode op)
 		return "fdivp";
 	case MCC_ASM_FCHS:
 		return "fchs";
+	case MCC_ASM_MOVSS:
+		return "movss";
+	case MCC_ASM_ADDSS:
+		return "addss";
+	case MCC_ASM_SUBSS:
+		return "subss";
+	case MCC_ASM_MULSS:
+		return "mulss";
+	case MCC_ASM_DIVSS:
+		return "divss";
+	case MCC_ASM_UCOMISS:
+		return "ucomiss";
+	case MCC_ASM_MOVQ:
+		return "movq";
+	case MCC_ASM_MOVSLQ:
+		return "movslq";
+	case MCC_ASM_LEAQ:
+		return "leaq";
+	case MCC_ASM_PUSHQ:
+		return "pushq";
+	case MCC_ASM_POPQ:
+		return "popq";
+	case MCC_ASM_ADDQ:
+		return "addq";
+	case MCC_ASM_SUBQ:
+		return "subq";
+	case MCC_ASM_CALLQ:
+		return "callq";
+	case MCC_ASM_MOVUPS:
+		return "movups";
+	case MCC_ASM_MOVDQU:
+		return "movdqu";
+	case MCC_ASM_MOVDQA:
+		return "movdqa";
+	case MCC_ASM_MOVD:
+		return "movd";
+	case MCC_ASM_UNPCKLPS:
+		return "unpcklps";
+	case MCC_ASM_MOVLHPS:
+		return "movlhps";
+	case MCC_ASM_PUNPCKLDQ:
+		return "punpckldq";
+	case MCC_ASM_PUNPCKLQDQ:
+		return "punpcklqdq";
+	case MCC_ASM_ADDPS:
+		return "addps";
+	case MCC_ASM_SUBPS:
+		return "subps";
+	case MCC_ASM_MULPS:
+		return "mulps";
+	case MCC_ASM_DIVPS:
+		return "divps";
+	case MCC_ASM_PADDD:
+		return "paddd";
+	case MCC_ASM_PSUBD:
+		return "psubd";
+	case MCC_ASM_PCMPGTD:
+		return "pcmpgtd";
+	case MCC_ASM_PAND:
+		return "pand";
+	case MCC_ASM_PANDN:
+		return "pandn";
+	case MCC_ASM_POR:
+		return "por";
+	case MCC_ASM_CLTD:
+		return "cltd";
+	case MCC_ASM_SHLL:
+		return "shll";
+	case MCC_ASM_SARL:
+		return "sarl";
+	case MCC_ASM_SHRL:
+		return "shrl";
+	case MCC_ASM_INCL:
+		return "incl";
+	case MCC_ASM_DECL:
+		return "decl";
+	case MCC_ASM_CMOVE:
+		return "cmove";
+	case MCC_ASM_CMOVNE:
+		return "cmovne";
+	case MCC_ASM_CMOVL:
+		return "cmovl";
+	case MCC_ASM_CMOVG:
+		return "cmovg";
+	case MCC_ASM_CMOVLE:
+		return "cmovle";
+	case MCC_ASM_CMOVGE:
+		return "cmovge";
 	default:
 		return "unknown opcode";
 	}
@@ -120,6 +236,42 @@ static char *register_name_to_string(enum mcc_asm_register reg)
 		return "%st";
 	case MCC_ASM_DL:
 		return "%dl";
+	case MCC_ASM_XMM0:
+		return "%xmm0";
+	case MCC_ASM_XMM1:
+		return "%xmm1";
+	case MCC_ASM_XMM2:
+		return "%xmm2";
+	case MCC_ASM_XMM3:
+		return "%xmm3";
+	case MCC_ASM_XMM4:
+		return "%xmm4";
+	case MCC_ASM_XMM5:
+		return "%xmm5";
+	case MCC_ASM_XMM6:
+		return "%xmm6";
+	case MCC_ASM_XMM7:
+		return "%xmm7";
+	case MCC_ASM_RAX:
+		return "%rax";
+	case MCC_ASM_RBX:
+		return "%rbx";
+	case MCC_ASM_RCX:
+		return "%rcx";
+	case MCC_ASM_RDX:
+		return "%rdx";
+	case MCC_ASM_RSI:
+		return "%rsi";
+	case MCC_ASM_RDI:
+		return "%rdi";
+	case MCC_ASM_R8:
+		return "%r8";
+	case MCC_ASM_R9:
+		return "%r9";
+	case MCC_ASM_RSP:
+		return "%rsp";
+	case MCC_ASM_RBP:
+		return "%rbp";
 	default:
 		return "unknown register";
 	}
@@ -131,9 +283,9 @@ static void register_to_string(char *dest, int len, enum mcc_asm_register reg, i
 		snprintf(dest, len, "%s", register_name_to_string(reg));
 	} else {
 		if (reg == MCC_ASM_ST) {
-			snprintf(dest, len + length_of_int(offset) + 2, "%s(%d)", register_name_to_string(reg), offset);
+			snprintf(dest, len, "%s(%d)", register_name_to_string(reg), offset);
 		} else {
-			snprintf(dest, len + length_of_int(offset) + 2, "%d(%s)", offset, register_name_to_string(reg));
+			snprintf(dest, len, "%d(%s)", offset, register_name_to_string(reg));
 		}
 	}
 }
@@ -159,7 +311,10 @@ static char *op_to_string(char *dest, int len, struct mcc_asm_operand *op)
 		register_to_string(dest, len, op->reg, op->offset);
 		break;
 	case MCC_ASM_OPERAND_DATA:
-		snprintf(dest, len, "%s", op->decl->identifier);
+		if (op->offset != 0)
+			snprintf(dest, len, op->rip_relative ? "%s+%d(%%rip)" : "%s+%d", op->decl->identifier, op->offset);
+		else
+			snprintf(dest, len, op->rip_relative ? "%s(%%rip)" : "%s", op->decl->identifier);
 		break;
 	case MCC_ASM_OPERAND_LITERAL:
 		snprintf(dest, len, "$%d", op->literal);
@@ -202,10 +357,14 @@ static int length_of_op(struct mcc_asm_operand *op)
 	}
 	switch (op->type) {
 	case MCC_ASM_OPERAND_REGISTER:
-		return 4;
+		// -4(%ebp) and %st(1) have two more chars than the offset
+		if (op->offset == 0 && op->reg != MCC_ASM_ST)
+			return strlen(register_name_to_string(op->reg));
+		return strlen(register_name_to_string(op->reg)) + length_of_int(op->offset) + 2;
 	case MCC_ASM_OPERAND_DATA:
-		return strlen(op->decl->identifier);
-		break;
+		// name(%rip) has six more chars than the name, name+8 one more than the offset
+		return strlen(op->decl->identifier) + (op->rip_relative ? 6 : 0) +
+		       (op->offset != 0 ? length_of_int(op->offset) + 1 : 0);
 	case MCC_ASM_OPERAND_LITERAL:
 		return length_of_int(op->literal) + 1;
 	case MCC_ASM_OPERAND_FUNCTION:
@@ -223,7 +382,7 @@ static void asm_print_line(FILE *out, struct mcc_asm_line *line)
 	if (line->opcode == MCC_ASM_LABEL) {
 		fprintf(out, "    L%d:\n", line->label);
 		return;
-	} else if (line->opcode == MCC_ASM_JE || line->opcode == MCC_ASM_JNE) {
+	} else if (mcc_asm_opcode_has_label(line->opcode)) {
 		fprintf(out, "        %-7s L%d\n", opcode_to_string(line->opcode), line->label);
 		return;
 	}
@@ -241,19 +400,58 @@ static void asm_print_line(FILE *out, struct mcc_asm_line *line)
 	}
 }
 
+// Loop headers are the labels a jump further down goes back to. Returns NULL if memory allocation fails, the loop
+// headers are then not aligned.
+static bool *find_loop_headers(struct mcc_asm_function *func)
+{
+	unsigned num_labels = 0;
+	for (struct mcc_asm_line *line = func->head; line; line = line->next) {
+		if (mcc_asm_opcode_has_label(line->opcode) && line->label >= num_labels)
+			num_labels = line->label + 1;
+	}
+	bool *is_placed = calloc(num_labels + 1, sizeof(*is_placed));
+	bool *is_header = calloc(num_labels + 1, sizeof(*is_header));
+	if (!is_placed || !is_header) {
+		free(is_placed);
+		free(is_header);
+		return NULL;
+	}
+	for (struct mcc_asm_line *line = func->head; line; line = line->next) {
+		if (line->opcode == MCC_ASM_LABEL)
+			is_placed[line->label] = true;
+		else if (mcc_asm_opcode_has_label(line->opcode) && is_placed[line->label])
+			is_header[line->label] = true;
+	}
+	free(is_placed);
+	return is_header;
+}
+
 void mcc_asm_print_func(FILE *out, struct mcc_asm_function *func)
 {
-	fprintf(out, "\n        .globl %s\n", func->label);
+	// Functions start at 16 byte boundaries, loop headers too unless that takes more than 10 bytes of padding
+	fprintf(out, "\n");
+	if (func->is_global)
+		fprintf(out, "        .globl %s\n", func->label);
+	fprintf(out, "        .p2align 4\n");
 	fprintf(out, "%s:\n", func->label);
+	bool *is_loop_header = find_loop_headers(func);
 	struct mcc_asm_line *line = func->head;
 	while (line) {
+		if (is_loop_header && line->opcode == MCC_ASM_LABEL && is_loop_header[line->label])
+			fprintf(out, "        .p2align 4,,10\n");
 		asm_print_line(out, line);
 		line = line->next;
 	}
+	free(is_loop_header);
 }
 
 void mcc_asm_print_decl(FILE *out, struct mcc_asm_declaration *decl)
 {
+	if (decl->is_global)
+		fprintf(out, "        .globl %s\n", decl->identifier);
+	// Counters are read and written as a whole
+	if (decl->type == MCC_ASM_DECLARATION_TYPE_COUNTERS)
+		fprintf(out, "        .p2align 3\n");
 	fprintf(out, "\t%s:", decl->identifier);
 	switch (decl->type) {
 	case MCC_ASM_DECLARATION_TYPE_FLOAT:
@@ -264,6 +462,9 @@ void mcc_asm_print_decl(FILE *out, struct mcc_asm_declaration *decl)
 		mcc_print_string_literal(out, decl->string_value, false);
 		fprintf(out, "\"\n");
 		break;
+	case MCC_ASM_DECLARATION_TYPE_COUNTERS:
+		fprintf(out, "       .zero %u\n", decl->num_counters * 8);
+		break;
 	default:
 		break;
 	}
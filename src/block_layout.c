@@ -0,0 +1,483 @@
+#include "mcc/block_layout.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "mcc/cfg_analysis.h"
+
+struct edge {
+	unsigned source;
+	unsigned target;
+	double weight;
+	// Whether the target follows the source in the current order
+	bool is_fall_through;
+};
+
+struct layout {
+	struct mcc_cfg_analysis *analysis;
+	unsigned num_blocks;
+	// Whether the frequencies are the counts of a profile
+	bool is_profiled;
+	// Estimated number of runs of each block, indexed by block id
+	double *frequencies;
+	// Id of the first block of the chain each block belongs to
+	unsigned *chains;
+	// Id of the block behind each block in its chain, num_blocks at the end of a chain
+	unsigned *next;
+	// Id of the last block of each chain, indexed by the id of its first block
+	unsigned *tails;
+	unsigned num_edges;
+	struct edge *edges;
+	// Block ids in the new order
+	unsigned *order;
+	// First row of each block, which is a label once the block is jumped to
+	struct mcc_ir_row **first_rows;
+};
+
+//---------------------------------------------------------------------------------------- Estimates
+
+static struct mcc_basic_block *get_fall_through(struct mcc_basic_block *block)
+{
+	switch (block->last->instr) {
+	case MCC_IR_INSTR_JUMP:
+	case MCC_IR_INSTR_RETURN:
+		return NULL;
+	case MCC_IR_INSTR_JUMPFALSE:
+		return block->child_left;
+	default:
+		return block->child_right;
+	}
+}
+
+static struct mcc_basic_block *get_jump_target(struct mcc_basic_block *block)
+{
+	if (block->last->instr != MCC_IR_INSTR_JUMP && block->last->instr != MCC_IR_INSTR_JUMPFALSE)
+		return NULL;
+	return block->child_right;
+}
+
+static bool falls_through(struct mcc_basic_block *block)
+{
+	return block->last->instr != MCC_IR_INSTR_JUMP && block->last->instr != MCC_IR_INSTR_RETURN;
+}
+
+static struct mcc_cfg_loop *get_innermost_loop(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *block)
+{
+	for (struct mcc_cfg_loop *loop = analysis->loops; loop; loop = loop->next) {
+		if (mcc_cfg_loop_contains(loop, block))
+			return loop;
+	}
+	return NULL;
+}
+
+static double estimate_frequency(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *block)
+{
+	if (!analysis->is_reachable[block->id])
+		return 0.0;
+	struct mcc_cfg_loop *loop = get_innermost_loop(analysis, block);
+	double frequency = 1.0;
+	for (unsigned depth = loop ? loop->depth : 0; depth > 0; depth--)
+		frequency *= MCC_BLOCK_LAYOUT_LOOP_SCALE;
+	return frequency;
+}
+
+// Rows added by the passes have no count, the count of the rows behind them is taken then
+static double get_profile_frequency(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *block)
+{
+	for (struct mcc_ir_row *row = block->leader; row && row->instr != MCC_IR_INSTR_FUNC_LABEL; row = row->next_row) {
+		if (row->profile_count >= 0)
+			return (double)row->profile_count;
+	}
+	return analysis->is_reachable[block->id] ? 1.0 : 0.0;
+}
+
+static double estimate_probability(struct layout *layout,
+                                   struct mcc_basic_block *block,
+                                   struct mcc_basic_block *successor)
+{
+	if (block->last->instr != MCC_IR_INSTR_JUMPFALSE || block->child_left == block->child_right)
+		return 1.0;
+	struct mcc_basic_block *other = successor == block->child_left ? block->child_right : block->child_left;
+
+	// The counts of successors with other predecessors include their runs from there
+	if (layout->is_profiled) {
+		double frequency = layout->frequencies[successor->id];
+		double total = frequency + layout->frequencies[other->id];
+		return total > 0.0 ? frequency / total : 0.5;
+	}
+	struct mcc_cfg_analysis *analysis = layout->analysis;
+
+	struct mcc_cfg_loop *loop = get_innermost_loop(analysis, block);
+	if (loop && mcc_cfg_loop_contains(loop, successor) != mcc_cfg_loop_contains(loop, other))
+		return mcc_cfg_loop_contains(loop, successor) ? MCC_BLOCK_LAYOUT_LOOP_PROBABILITY
+		                                              : 1.0 - MCC_BLOCK_LAYOUT_LOOP_PROBABILITY;
+
+	bool returns = successor->last->instr == MCC_IR_INSTR_RETURN;
+	if (returns != (other->last->instr == MCC_IR_INSTR_RETURN))
+		return returns ? MCC_BLOCK_LAYOUT_RETURN_PROBABILITY : 1.0 - MCC_BLOCK_LAYOUT_RETURN_PROBABILITY;
+	return 0.5;
+}
+
+//---------------------------------------------------------------------------------------- Chains
+
+static void delete_layout(struct layout *layout)
+{
+	free(layout->frequencies);
+	free(layout->chains);
+	free(layout->next);
+	free(layout->tails);
+	free(layout->edges);
+	free(layout->order);
+	free(layout->first_rows);
+}
+
+static bool new_layout(struct layout *layout, struct mcc_cfg_analysis *analysis)
+{
+	unsigned n = analysis->num_blocks;
+	*layout = (struct layout){
+	    .analysis = analysis, .num_blocks = n, .is_profiled = analysis->function_label->profile_count >= 0};
+	layout->frequencies = malloc(sizeof(*layout->frequencies) * n);
+	layout->chains = malloc(sizeof(*layout->chains) * n);
+	layout->next = malloc(sizeof(*layout->next) * n);
+	layout->tails = malloc(sizeof(*layout->tails) * n);
+	layout->edges = malloc(sizeof(*layout->edges) * 2 * n);
+	layout->order = malloc(sizeof(*layout->order) * n);
+	layout->first_rows = malloc(sizeof(*layout->first_rows) * n);
+	if (!layout->frequencies || !layout->chains || !layout->next || !layout->tails || !layout->edges ||
+	    !layout->order || !layout->first_rows) {
+		delete_layout(layout);
+		return false;
+	}
+
+	for (unsigned i = 0; i < n; i++) {
+		layout->frequencies[i] = layout->is_profiled ? get_profile_frequency(analysis, analysis->blocks[i])
+		                                             : estimate_frequency(analysis, analysis->blocks[i]);
+		layout->chains[i] = i;
+		layout->next[i] = n;
+		layout->tails[i] = i;
+		layout->first_rows[i] = analysis->blocks[i]->leader;
+	}
+	return true;
+}
+
+static void add_edge(struct layout *layout, struct mcc_basic_block *block, struct mcc_basic_block *successor)
+{
+	if (!successor)
+		return;
+	double probability = estimate_probability(layout, block, successor);
+	layout->edges[layout->num_edges++] = (struct edge){.source = block->id,
+	                                                   .target = successor->id,
+	                                                   .weight = layout->frequencies[block->id] * probability,
+	                                                   .is_fall_through = successor->id == block->id + 1};
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+	const struct edge *edge_a = a;
+	const struct edge *edge_b = b;
+	if (edge_a->weight != edge_b->weight)
+		return edge_a->weight > edge_b->weight ? -1 : 1;
+	if (edge_a->is_fall_through != edge_b->is_fall_through)
+		return edge_a->is_fall_through ? -1 : 1;
+	if (edge_a->source != edge_b->source)
+		return edge_a->source < edge_b->source ? -1 : 1;
+	if (edge_a->target != edge_b->target)
+		return edge_a->target < edge_b->target ? -1 : 1;
+	return 0;
+}
+
+static bool can_invert_condition(struct mcc_ir_row *function_label, struct mcc_basic_block *block);
+
+// A conditional jump to the block placed behind it needs its condition inverted
+static bool can_follow(struct layout *layout, struct edge *edge)
+{
+	struct mcc_basic_block *source = layout->analysis->blocks[edge->source];
+	struct mcc_basic_block *target = layout->analysis->blocks[edge->target];
+	if (edge->source == edge->target || edge->target == 0)
+		return false;
+	if (layout->next[edge->source] != layout->num_blocks || layout->chains[edge->target] != edge->target ||
+	    layout->chains[edge->source] == edge->target)
+		return false;
+	if (mcc_cfg_dominates(layout->analysis, target, source))
+		return false;
+	if (source->last->instr == MCC_IR_INSTR_JUMPFALSE && target != get_fall_through(source))
+		return can_invert_condition(layout->analysis->function_label, source);
+	return true;
+}
+
+static void join_chains(struct layout *layout, unsigned source, unsigned target)
+{
+	unsigned first = layout->chains[source];
+	layout->next[source] = target;
+	for (unsigned block = target; block != layout->num_blocks; block = layout->next[block])
+		layout->chains[block] = first;
+	layout->tails[first] = layout->tails[target];
+}
+
+static void build_chains(struct layout *layout)
+{
+	for (unsigned i = 0; i < layout->num_blocks; i++) {
+		struct mcc_basic_block *block = layout->analysis->blocks[i];
+		struct mcc_basic_block *fall_through = get_fall_through(block);
+		struct mcc_basic_block *jump_target = get_jump_target(block);
+		add_edge(layout, block, fall_through);
+		if (jump_target != fall_through)
+			add_edge(layout, block, jump_target);
+	}
+	qsort(layout->edges, layout->num_edges, sizeof(*layout->edges), compare_edges);
+
+	for (unsigned i = 0; i < layout->num_edges; i++) {
+		if (can_follow(layout, &layout->edges[i]))
+			join_chains(layout, layout->edges[i].source, layout->edges[i].target);
+	}
+}
+
+// Returns whether the order differs from the current one
+static bool build_order(struct layout *layout)
+{
+	unsigned size = 0;
+	for (unsigned first = 0; first < layout->num_blocks; first++) {
+		if (layout->chains[first] != first)
+			continue;
+		for (unsigned block = first; block != layout->num_blocks; block = layout->next[block])
+			layout->order[size++] = block;
+	}
+	assert(size == layout->num_blocks);
+
+	for (unsigned i = 0; i < layout->num_blocks; i++) {
+		if (layout->order[i] != i)
+			return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------- Rewriting
+
+static bool is_only_used_by(struct mcc_ir_row *function_label, struct mcc_ir_row *row, struct mcc_ir_row *user)
+{
+	for (struct mcc_ir_row *other = function_label->next_row; other && other->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     other = other->next_row) {
+		if (other != user && mcc_ir_uses_row(other, row))
+			return false;
+	}
+	return true;
+}
+
+// Only conditions that are inverted without a row of their own. A negation costs more than the jump it saves.
+static bool can_invert_condition(struct mcc_ir_row *function_label, struct mcc_basic_block *block)
+{
+	struct mcc_ir_row *jump = block->last;
+	struct mcc_ir_arg *condition = jump->arg1;
+	if (condition->type != MCC_IR_TYPE_ROW || !is_only_used_by(function_label, condition->row, jump))
+		return false;
+	struct mcc_ir_row *row = condition->row;
+	return mcc_ir_is_compare(row) || (row->instr == MCC_IR_INSTR_NOT && row->next_row == jump && row != block->leader);
+}
+
+// Make the conditional jump ending the block jump if it did not before
+static bool invert_condition(struct mcc_ir_row *function_label, struct mcc_basic_block *block)
+{
+	struct mcc_ir_row *jump = block->last;
+	struct mcc_ir_arg *condition = jump->arg1;
+	if (condition->type == MCC_IR_TYPE_ROW && is_only_used_by(function_label, condition->row, jump)) {
+		struct mcc_ir_row *row = condition->row;
+		if (mcc_ir_is_compare(row)) {
+			row->instr = mcc_ir_invert_compare(row->instr);
+			return true;
+		}
+		// The negated value itself is the inverted condition
+		if (row->instr == MCC_IR_INSTR_NOT && row->next_row == jump && row != block->leader) {
+			struct mcc_ir_arg *negated = mcc_ir_copy_arg(row->arg1);
+			if (!negated)
+				return false;
+			jump->arg1 = negated;
+			mcc_ir_delete_ir_arg(condition);
+			mcc_ir_unlink_row(row);
+			mcc_ir_delete_ir_row(row);
+			return true;
+		}
+	}
+
+	struct mcc_ir_arg *arg = mcc_ir_copy_arg(condition);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_BOOL, -1);
+	struct mcc_ir_row *negation = arg && type ? mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_NOT, type) : NULL;
+	struct mcc_ir_arg *inverted = negation ? mcc_ir_new_arg_row(negation) : NULL;
+	if (!inverted) {
+		if (negation) {
+			mcc_ir_delete_ir_row(negation);
+		} else {
+			mcc_ir_delete_ir_arg(arg);
+			mcc_ir_delete_ir_row_type(type);
+		}
+		return false;
+	}
+	mcc_ir_insert_row_before(jump, negation);
+	jump->arg1 = inverted;
+	mcc_ir_delete_ir_arg(condition);
+	return true;
+}
+
+// Gives the label the block starts with, put in front of it if it has none. Returns -1 if memory allocation fails.
+static long get_label(struct layout *layout, unsigned block)
+{
+	struct mcc_ir_row *first = layout->first_rows[block];
+	if (first->instr == MCC_IR_INSTR_LABEL)
+		return first->arg1->label;
+
+	unsigned label = mcc_ir_get_unused_label(first);
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_row *row = arg && type ? mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_LABEL, type) : NULL;
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg);
+		mcc_ir_delete_ir_row_type(type);
+		return -1;
+	}
+	mcc_ir_insert_row_before(first, row);
+	layout->first_rows[block] = row;
+	return label;
+}
+
+static bool insert_jump(struct mcc_ir_row *position, unsigned label)
+{
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_row *row = arg && type ? mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_JUMP, type) : NULL;
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg);
+		mcc_ir_delete_ir_row_type(type);
+		return false;
+	}
+	mcc_ir_insert_row_after(position, row);
+	return true;
+}
+
+// Labels of the fall-throughs that are no longer placed behind their block, -1 for the others. Labels are put in
+// front of the blocks while the rows are still in their old order.
+static bool find_fall_through_labels(struct layout *layout, long *labels)
+{
+	for (unsigned i = 0; i < layout->num_blocks; i++) {
+		unsigned block = layout->order[i];
+		unsigned next = i + 1 < layout->num_blocks ? layout->order[i + 1] : layout->num_blocks;
+		struct mcc_basic_block *fall_through = get_fall_through(layout->analysis->blocks[block]);
+		labels[block] = -1;
+		if (fall_through && fall_through->id != next) {
+			labels[block] = get_label(layout, fall_through->id);
+			if (labels[block] < 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+static void link_rows(struct layout *layout)
+{
+	struct mcc_ir_row *end = layout->analysis->blocks[layout->num_blocks - 1]->last->next_row;
+	struct mcc_ir_row *previous = NULL;
+	for (unsigned i = 0; i < layout->num_blocks; i++) {
+		unsigned block = layout->order[i];
+		if (previous) {
+			previous->next_row = layout->first_rows[block];
+			layout->first_rows[block]->prev_row = previous;
+		}
+		previous = layout->analysis->blocks[block]->last;
+	}
+	previous->next_row = end;
+	if (end)
+		end->prev_row = previous;
+}
+
+static bool fix_jumps(struct layout *layout, long *labels)
+{
+	struct mcc_ir_row *function_label = layout->analysis->function_label;
+	for (unsigned i = 0; i < layout->num_blocks; i++) {
+		struct mcc_basic_block *block = layout->analysis->blocks[layout->order[i]];
+		unsigned next = i + 1 < layout->num_blocks ? layout->order[i + 1] : layout->num_blocks;
+		struct mcc_basic_block *jump_target = get_jump_target(block);
+		struct mcc_ir_row *last = block->last;
+
+		if (last->instr == MCC_IR_INSTR_JUMP && jump_target && jump_target->id == next) {
+			mcc_ir_unlink_row(last);
+			mcc_ir_delete_ir_row(last);
+			continue;
+		}
+		if (labels[block->id] < 0)
+			continue;
+		if (last->instr == MCC_IR_INSTR_JUMPFALSE && jump_target && jump_target->id == next) {
+			if (!invert_condition(function_label, block))
+				return false;
+			last->arg2->label = (unsigned)labels[block->id];
+		} else if (!insert_jump(last, (unsigned)labels[block->id])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Layout
+
+// Returns 1 if the blocks were reordered, 0 if not, and -1 if memory allocation fails
+static int layout_function(struct mcc_cfg_analysis *analysis)
+{
+	// A block falling off the end of the function has to stay there
+	for (unsigned i = 0; i < analysis->num_blocks; i++) {
+		if (falls_through(analysis->blocks[i]) && !get_fall_through(analysis->blocks[i]))
+			return 0;
+	}
+
+	struct layout layout;
+	if (!new_layout(&layout, analysis))
+		return -1;
+	build_chains(&layout);
+	if (!build_order(&layout)) {
+		delete_layout(&layout);
+		return 0;
+	}
+
+	long *labels = malloc(sizeof(*labels) * layout.num_blocks);
+	if (!labels || !find_fall_through_labels(&layout, labels)) {
+		free(labels);
+		delete_layout(&layout);
+		return -1;
+	}
+	link_rows(&layout);
+	bool success = fix_jumps(&layout, labels);
+	free(labels);
+	delete_layout(&layout);
+	return success ? 1 : -1;
+}
+
+bool mcc_block_layout_run_with_manager(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	bool changed = false;
+	for (struct mcc_ir_row *row = manager->ir; row; row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_FUNC_LABEL)
+			continue;
+		struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, row);
+		if (!analysis)
+			return false;
+		int result = layout_function(analysis);
+		if (result != 0)
+			mcc_pass_manager_invalidate(manager, row, MCC_PASS_ANALYSIS_ALL);
+		if (result < 0)
+			return false;
+		changed = changed || result > 0;
+	}
+	if (changed)
+		mcc_ir_number_rows(manager->ir);
+	return true;
+}
+
+bool mcc_block_layout_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	if (!manager)
+		return false;
+	bool success = mcc_block_layout_run_with_manager(manager);
+	mcc_pass_manager_delete(manager);
+	return success;
+}
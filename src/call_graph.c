@@ -0,0 +1,210 @@
+#include "mcc/call_graph.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/ast_visit.h"
+
+struct call_userdata {
+	struct mcc_call_graph *graph;
+	struct mcc_call_graph_function *caller;
+	bool has_failed;
+};
+
+//---------------------------------------------------------------------------------------- Build
+
+static char *get_name(struct mcc_call_graph_function *function)
+{
+	return function->definition->identifier->identifier_name;
+}
+
+// Returns the number of functions if there is no function of that name
+static unsigned find_function(struct mcc_call_graph *graph, const char *name)
+{
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		if (strcmp(get_name(&graph->functions[i]), name) == 0)
+			return i;
+	}
+	return graph->num_functions;
+}
+
+static bool add_callee(struct mcc_call_graph_function *caller, unsigned callee)
+{
+	for (unsigned i = 0; i < caller->num_callees; i++) {
+		if (caller->callees[i] == callee)
+			return true;
+	}
+	unsigned *callees = realloc(caller->callees, sizeof(*callees) * (caller->num_callees + 1));
+	if (!callees)
+		return false;
+	callees[caller->num_callees++] = callee;
+	caller->callees = callees;
+	return true;
+}
+
+static void cb_function_call(struct mcc_ast_expression *expression, void *data)
+{
+	assert(expression);
+	assert(data);
+
+	struct call_userdata *userdata = data;
+	unsigned callee = find_function(userdata->graph, expression->function_identifier->identifier_name);
+	if (callee == userdata->graph->num_functions)
+		return;
+	if (!add_callee(userdata->caller, callee))
+		userdata->has_failed = true;
+}
+
+static struct mcc_ast_visitor call_visitor(struct call_userdata *userdata)
+{
+	return (struct mcc_ast_visitor){
+	    .order = MCC_AST_VISIT_PRE_ORDER,
+
+	    .userdata = userdata,
+
+	    .expression_function_call = cb_function_call,
+	};
+}
+
+static void mark_reachable(struct mcc_call_graph *graph, unsigned *stack)
+{
+	unsigned root = find_function(graph, "main");
+	if (root == graph->num_functions)
+		return;
+
+	// Every function is pushed once, when it is marked
+	unsigned size = 0;
+	graph->functions[root].is_reachable = true;
+	stack[size++] = root;
+	while (size > 0) {
+		struct mcc_call_graph_function *function = &graph->functions[stack[--size]];
+		for (unsigned i = 0; i < function->num_callees; i++) {
+			struct mcc_call_graph_function *callee = &graph->functions[function->callees[i]];
+			if (callee->is_reachable)
+				continue;
+			callee->is_reachable = true;
+			stack[size++] = function->callees[i];
+		}
+	}
+}
+
+struct mcc_call_graph *mcc_call_graph_build(struct mcc_ast_program *program)
+{
+	assert(program);
+
+	struct mcc_call_graph *graph = calloc(1, sizeof(*graph));
+	if (!graph)
+		return NULL;
+	for (struct mcc_ast_program *node = program; node; node = node->next_function) {
+		if (node->function)
+			graph->num_functions++;
+	}
+	graph->functions = calloc(graph->num_functions + 1, sizeof(*graph->functions));
+	unsigned *stack = malloc(sizeof(*stack) * (graph->num_functions + 1));
+	if (!graph->functions || !stack) {
+		free(stack);
+		mcc_call_graph_delete(graph);
+		return NULL;
+	}
+
+	unsigned i = 0;
+	for (struct mcc_ast_program *node = program; node; node = node->next_function) {
+		if (node->function)
+			graph->functions[i++].definition = node->function;
+	}
+
+	struct call_userdata userdata = {.graph = graph, .has_failed = false};
+	struct mcc_ast_visitor visitor = call_visitor(&userdata);
+	for (i = 0; i < graph->num_functions && !userdata.has_failed; i++) {
+		userdata.caller = &graph->functions[i];
+		mcc_ast_visit(graph->functions[i].definition->compound_stmt, &visitor);
+	}
+	if (userdata.has_failed) {
+		free(stack);
+		mcc_call_graph_delete(graph);
+		return NULL;
+	}
+
+	mark_reachable(graph, stack);
+	free(stack);
+	return graph;
+}
+
+void mcc_call_graph_delete(struct mcc_call_graph *graph)
+{
+	if (!graph)
+		return;
+	for (unsigned i = 0; graph->functions && i < graph->num_functions; i++)
+		free(graph->functions[i].callees);
+	free(graph->functions);
+	free(graph);
+}
+
+//---------------------------------------------------------------------------------------- Remove unreachable functions
+
+// Put the definitions that are reachable or not into the nodes from node on. Returns the last node filled.
+static struct mcc_ast_program *fill_nodes(struct mcc_call_graph *graph, struct mcc_ast_program *node, bool reachable)
+{
+	struct mcc_ast_program *last = NULL;
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		if (graph->functions[i].is_reachable != reachable)
+			continue;
+		node->function = graph->functions[i].definition;
+		last = node;
+		node = node->next_function;
+	}
+	return last;
+}
+
+bool mcc_call_graph_remove_unreachable(struct mcc_ast_program *program)
+{
+	assert(program);
+
+	struct mcc_call_graph *graph = mcc_call_graph_build(program);
+	if (!graph)
+		return false;
+
+	unsigned num_reachable = 0;
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		if (graph->functions[i].is_reachable)
+			num_reachable++;
+	}
+	// Without main nothing is reachable
+	if (num_reachable == 0 || num_reachable == graph->num_functions) {
+		mcc_call_graph_delete(graph);
+		return true;
+	}
+
+	// The program nodes stay where they are, so whoever holds the first one still holds the program. The reachable
+	// definitions are moved to the front in their order, the others to the nodes behind them.
+	struct mcc_ast_program *last_reachable = fill_nodes(graph, program, true);
+	fill_nodes(graph, last_reachable->next_function, false);
+	mcc_call_graph_delete(graph);
+
+	struct mcc_ast_program *unreachable = last_reachable->next_function;
+	last_reachable->has_next_function = false;
+	last_reachable->next_function = NULL;
+	mcc_ast_delete_program(unreachable);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Print
+
+void mcc_call_graph_print_dot(FILE *out, struct mcc_call_graph *graph)
+{
+	assert(out);
+	assert(graph);
+
+	fprintf(out, "digraph A {\n");
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		struct mcc_call_graph_function *function = &graph->functions[i];
+		fprintf(out, "\"%s\" [shape=box%s];\n", get_name(function), function->is_reachable ? "" : " style=dashed");
+	}
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		struct mcc_call_graph_function *function = &graph->functions[i];
+		for (unsigned j = 0; j < function->num_callees; j++)
+			fprintf(out, "\"%s\"->\"%s\";\n", get_name(function), get_name(&graph->functions[function->callees[j]]));
+	}
+	fprintf(out, "}\n");
+}
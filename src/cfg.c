@@ -176,6 +176,7 @@ static void set_children(struct mcc_basic_block *head, struct mcc_basic_block *f
 	assert(head);
 	assert(first);
 	struct mcc_ir_row *last_row = get_last_row(head);
+	head->last = last_row;
 
 	switch (last_row->instr) {
 	case MCC_IR_INSTR_JUMP:
@@ -215,14 +216,6 @@ static void sort_cfg(struct mcc_basic_block *head, struct mcc_basic_block *first
 	set_children(head, first);
 }
 
-static void mcc_delete_cfg(struct mcc_basic_block *head)
-{
-	if (!head)
-		return;
-	mcc_delete_cfg(head->next);
-	free(head);
-}
-
 // Put all basic block leaders into their own BB. Link them to a single linear chain of BBs with the "next" field
 static struct mcc_basic_block *get_basic_blocks(struct annotated_ir *an_ir)
 {
@@ -238,9 +231,10 @@ static struct mcc_basic_block *get_basic_blocks(struct annotated_ir *an_ir)
 		if (an_ir->is_leader) {
 			struct mcc_basic_block *new = mcc_cfg_new_basic_block(an_ir->row, NULL, NULL);
 			if (!new) {
-				mcc_delete_cfg(bb_first);
+				mcc_cfg_delete_cfg(bb_first);
 				return NULL;
 			}
+			new->id = bb_head->id + 1;
 			bb_head->next = new;
 			bb_head = new;
 		}
@@ -337,6 +331,70 @@ struct mcc_basic_block *mcc_cfg_limit_to_function(char *function_identifier, str
 	return head;
 }
 
+//---------------------------------------------------------------------------------------- Functions: CFG of one function
+
+static struct mcc_basic_block *find_label_block(struct mcc_basic_block *head, unsigned label)
+{
+	while (head) {
+		if (row_is_target_label(head->leader, label))
+			return head;
+		head = head->next;
+	}
+	return NULL;
+}
+
+// Set children for one basic block of a function CFG. The convention matches set_children: a fall-through edge is
+// the right child, except after a conditional jump where the jump target is the right child.
+static void set_function_children(struct mcc_basic_block *block, struct mcc_basic_block *first)
+{
+	switch (block->last->instr) {
+	case MCC_IR_INSTR_JUMP:
+		block->child_right = find_label_block(first, block->last->arg1->label);
+		return;
+	case MCC_IR_INSTR_JUMPFALSE:
+		block->child_left = block->next;
+		block->child_right = find_label_block(first, block->last->arg2->label);
+		return;
+	case MCC_IR_INSTR_RETURN:
+		return;
+	default:
+		block->child_right = block->next;
+		return;
+	}
+}
+
+struct mcc_basic_block *mcc_cfg_generate_function(struct mcc_ir_row *function_label)
+{
+	assert(function_label);
+	assert(function_label->instr == MCC_IR_INSTR_FUNC_LABEL);
+
+	struct mcc_basic_block *first = mcc_cfg_new_basic_block(function_label, NULL, NULL);
+	if (!first)
+		return NULL;
+
+	struct mcc_basic_block *current = first;
+	struct mcc_ir_row *row = function_label->next_row;
+	while (!mcc_ir_is_function_end(row)) {
+		if (is_leader(row->instr, row->prev_row->instr)) {
+			struct mcc_basic_block *new = mcc_cfg_new_basic_block(row, NULL, NULL);
+			if (!new) {
+				mcc_cfg_delete_cfg(first);
+				return NULL;
+			}
+			new->id = current->id + 1;
+			current->next = new;
+			current = new;
+		}
+		current->last = row;
+		row = row->next_row;
+	}
+
+	for (current = first; current; current = current->next) {
+		set_function_children(current, first);
+	}
+	return first;
+}
+
 //---------------------------------------------------------------------------------------- Functions: Set up
 // datastructs
 
@@ -352,6 +410,8 @@ struct mcc_basic_block *mcc_cfg_new_basic_block(struct mcc_ir_row *leader,
 	block->child_left = child_left;
 	block->child_right = child_right;
 	block->leader = leader;
+	block->last = leader;
+	block->id = 0;
 	return block;
 }
 
@@ -364,3 +424,11 @@ void mcc_delete_cfg_and_ir(struct mcc_basic_block *head)
 	free(head);
 }
 
+void mcc_cfg_delete_cfg(struct mcc_basic_block *head)
+{
+	while (head) {
+		struct mcc_basic_block *next = head->next;
+		free(head);
+		head = next;
+	}
+}
@@ -0,0 +1,490 @@
+#include "mcc/cfg_analysis.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITS_PER_WORD (sizeof(unsigned long) * CHAR_BIT)
+
+//---------------------------------------------------------------------------------------- Bit sets
+
+static unsigned words_for(unsigned bits)
+{
+	return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+static bool bit_is_set(unsigned long *set, unsigned bit)
+{
+	return (set[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1UL;
+}
+
+static void set_bit(unsigned long *set, unsigned bit)
+{
+	set[bit / BITS_PER_WORD] |= 1UL << (bit % BITS_PER_WORD);
+}
+
+//---------------------------------------------------------------------------------------- Blocks and predecessors
+
+static bool set_up_blocks(struct mcc_cfg_analysis *analysis)
+{
+	unsigned num_blocks = 0;
+	for (struct mcc_basic_block *block = analysis->cfg; block; block = block->next) {
+		num_blocks++;
+	}
+	analysis->num_blocks = num_blocks;
+	analysis->blocks = calloc(num_blocks, sizeof(*analysis->blocks));
+	analysis->num_predecessors = calloc(num_blocks, sizeof(*analysis->num_predecessors));
+	analysis->predecessors = calloc(num_blocks, sizeof(*analysis->predecessors));
+	analysis->is_reachable = calloc(num_blocks, sizeof(*analysis->is_reachable));
+	if (!analysis->blocks || !analysis->num_predecessors || !analysis->predecessors || !analysis->is_reachable)
+		return false;
+
+	for (struct mcc_basic_block *block = analysis->cfg; block; block = block->next) {
+		analysis->blocks[block->id] = block;
+		if (block->child_left)
+			analysis->num_predecessors[block->child_left->id]++;
+		if (block->child_right && block->child_right != block->child_left)
+			analysis->num_predecessors[block->child_right->id]++;
+	}
+	for (unsigned i = 0; i < num_blocks; i++) {
+		analysis->predecessors[i] = calloc(analysis->num_predecessors[i] + 1, sizeof(struct mcc_basic_block *));
+		if (!analysis->predecessors[i])
+			return false;
+		analysis->num_predecessors[i] = 0;
+	}
+	for (struct mcc_basic_block *block = analysis->cfg; block; block = block->next) {
+		struct mcc_basic_block *left = block->child_left;
+		struct mcc_basic_block *right = block->child_right;
+		if (left)
+			analysis->predecessors[left->id][analysis->num_predecessors[left->id]++] = block;
+		if (right && right != left)
+			analysis->predecessors[right->id][analysis->num_predecessors[right->id]++] = block;
+	}
+	return true;
+}
+
+static bool mark_reachable(struct mcc_cfg_analysis *analysis)
+{
+	struct mcc_basic_block **stack = malloc(sizeof(*stack) * analysis->num_blocks);
+	if (!stack)
+		return false;
+	unsigned size = 0;
+	stack[size++] = analysis->cfg;
+	analysis->is_reachable[analysis->cfg->id] = true;
+	while (size > 0) {
+		struct mcc_basic_block *block = stack[--size];
+		struct mcc_basic_block *children[] = {block->child_left, block->child_right};
+		for (unsigned i = 0; i < 2; i++) {
+			if (children[i] && !analysis->is_reachable[children[i]->id]) {
+				analysis->is_reachable[children[i]->id] = true;
+				stack[size++] = children[i];
+			}
+		}
+	}
+	free(stack);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Dominators
+
+static bool compute_dominators(struct mcc_cfg_analysis *analysis)
+{
+	unsigned n = analysis->num_blocks;
+	unsigned words = words_for(n);
+	analysis->dominators = calloc(n, sizeof(*analysis->dominators));
+	unsigned long *new_set = calloc(words, sizeof(*new_set));
+	if (!analysis->dominators || !new_set) {
+		free(new_set);
+		return false;
+	}
+	for (unsigned i = 0; i < n; i++) {
+		analysis->dominators[i] = calloc(words, sizeof(**analysis->dominators));
+		if (!analysis->dominators[i]) {
+			free(new_set);
+			return false;
+		}
+		if (i == 0) {
+			set_bit(analysis->dominators[i], 0);
+		} else {
+			memset(analysis->dominators[i], 0xff, words * sizeof(**analysis->dominators));
+		}
+	}
+
+	// Blocks are in IR order, which is close to reverse post order, so few iterations are needed
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned i = 1; i < n; i++) {
+			if (!analysis->is_reachable[i])
+				continue;
+			memset(new_set, 0xff, words * sizeof(*new_set));
+			for (unsigned p = 0; p < analysis->num_predecessors[i]; p++) {
+				unsigned pred = analysis->predecessors[i][p]->id;
+				if (!analysis->is_reachable[pred])
+					continue;
+				for (unsigned w = 0; w < words; w++) {
+					new_set[w] &= analysis->dominators[pred][w];
+				}
+			}
+			set_bit(new_set, i);
+			if (memcmp(new_set, analysis->dominators[i], words * sizeof(*new_set)) != 0) {
+				memcpy(analysis->dominators[i], new_set, words * sizeof(*new_set));
+				changed = true;
+			}
+		}
+	}
+	free(new_set);
+	return true;
+}
+
+bool mcc_cfg_dominates(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *a, struct mcc_basic_block *b)
+{
+	assert(analysis);
+	assert(a);
+	assert(b);
+
+	if (!analysis->is_reachable[b->id])
+		return false;
+	return bit_is_set(analysis->dominators[b->id], a->id);
+}
+
+//---------------------------------------------------------------------------------------- Natural loops
+
+static void delete_loops(struct mcc_cfg_loop *loop)
+{
+	while (loop) {
+		struct mcc_cfg_loop *next = loop->next;
+		free(loop->contains);
+		free(loop);
+		loop = next;
+	}
+}
+
+static struct mcc_cfg_loop *get_loop_with_header(struct mcc_cfg_analysis *analysis, struct mcc_basic_block *header)
+{
+	for (struct mcc_cfg_loop *loop = analysis->loops; loop; loop = loop->next) {
+		if (loop->header == header)
+			return loop;
+	}
+
+	struct mcc_cfg_loop *loop = malloc(sizeof(*loop));
+	bool *contains = calloc(analysis->num_blocks, sizeof(*contains));
+	if (!loop || !contains) {
+		free(loop);
+		free(contains);
+		return NULL;
+	}
+	contains[header->id] = true;
+	loop->header = header;
+	loop->contains = contains;
+	loop->depth = 1;
+	loop->parent = NULL;
+	loop->next = analysis->loops;
+	analysis->loops = loop;
+	return loop;
+}
+
+// Add all blocks that reach latch without passing through the header of the loop
+static bool add_loop_body(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop, struct mcc_basic_block *latch)
+{
+	struct mcc_basic_block **stack = malloc(sizeof(*stack) * analysis->num_blocks);
+	if (!stack)
+		return false;
+	unsigned size = 0;
+	if (!loop->contains[latch->id]) {
+		loop->contains[latch->id] = true;
+		stack[size++] = latch;
+	}
+	while (size > 0) {
+		struct mcc_basic_block *block = stack[--size];
+		for (unsigned p = 0; p < analysis->num_predecessors[block->id]; p++) {
+			struct mcc_basic_block *pred = analysis->predecessors[block->id][p];
+			if (analysis->is_reachable[pred->id] && !loop->contains[pred->id]) {
+				loop->contains[pred->id] = true;
+				stack[size++] = pred;
+			}
+		}
+	}
+	free(stack);
+	return true;
+}
+
+static unsigned loop_size(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop)
+{
+	unsigned size = 0;
+	for (unsigned i = 0; i < analysis->num_blocks; i++) {
+		if (loop->contains[i])
+			size++;
+	}
+	return size;
+}
+
+static void set_loop_nesting(struct mcc_cfg_analysis *analysis)
+{
+	// The parent is the smallest other loop that contains the header
+	for (struct mcc_cfg_loop *loop = analysis->loops; loop; loop = loop->next) {
+		unsigned best_size = 0;
+		for (struct mcc_cfg_loop *other = analysis->loops; other; other = other->next) {
+			if (other == loop || !other->contains[loop->header->id])
+				continue;
+			unsigned size = loop_size(analysis, other);
+			if (!loop->parent || size < best_size) {
+				loop->parent = other;
+				best_size = size;
+			}
+		}
+	}
+	for (struct mcc_cfg_loop *loop = analysis->loops; loop; loop = loop->next) {
+		loop->depth = 1;
+		for (struct mcc_cfg_loop *parent = loop->parent; parent; parent = parent->parent) {
+			loop->depth++;
+		}
+	}
+
+	// Sort innermost loops first; loops of the same depth in IR order
+	struct mcc_cfg_loop *sorted = NULL;
+	while (analysis->loops) {
+		struct mcc_cfg_loop *loop = analysis->loops;
+		analysis->loops = loop->next;
+		struct mcc_cfg_loop **position = &sorted;
+		while (*position && ((*position)->depth > loop->depth ||
+		                     ((*position)->depth == loop->depth && (*position)->header->id < loop->header->id))) {
+			position = &(*position)->next;
+		}
+		loop->next = *position;
+		*position = loop;
+	}
+	analysis->loops = sorted;
+}
+
+static bool find_loops(struct mcc_cfg_analysis *analysis)
+{
+	for (unsigned i = 0; i < analysis->num_blocks; i++) {
+		struct mcc_basic_block *block = analysis->blocks[i];
+		if (!analysis->is_reachable[i])
+			continue;
+		struct mcc_basic_block *children[] = {block->child_left, block->child_right};
+		for (unsigned c = 0; c < 2; c++) {
+			struct mcc_basic_block *header = children[c];
+			// A back edge leads to a block that dominates its source
+			if (!header || !mcc_cfg_dominates(analysis, header, block))
+				continue;
+			struct mcc_cfg_loop *loop = get_loop_with_header(analysis, header);
+			if (!loop || !add_loop_body(analysis, loop, block))
+				return false;
+		}
+	}
+	set_loop_nesting(analysis);
+	return true;
+}
+
+bool mcc_cfg_loop_contains(struct mcc_cfg_loop *loop, struct mcc_basic_block *block)
+{
+	assert(loop);
+	assert(block);
+	return loop->contains[block->id];
+}
+
+//---------------------------------------------------------------------------------------- Blocks of rows
+
+static int compare_row_entries(const void *a, const void *b)
+{
+	const struct mcc_cfg_row_entry *entry_a = a;
+	const struct mcc_cfg_row_entry *entry_b = b;
+	if (entry_a->row < entry_b->row)
+		return -1;
+	if (entry_a->row > entry_b->row)
+		return 1;
+	return 0;
+}
+
+static bool index_rows(struct mcc_cfg_analysis *analysis)
+{
+	unsigned num_rows = 0;
+	for (struct mcc_basic_block *block = analysis->cfg; block; block = block->next) {
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			num_rows++;
+		}
+	}
+	analysis->rows = malloc(sizeof(*analysis->rows) * num_rows);
+	if (!analysis->rows)
+		return false;
+	analysis->num_rows = num_rows;
+
+	unsigned i = 0;
+	for (struct mcc_basic_block *block = analysis->cfg; block; block = block->next) {
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			analysis->rows[i].row = row;
+			analysis->rows[i].block = block;
+			i++;
+		}
+	}
+	qsort(analysis->rows, num_rows, sizeof(*analysis->rows), compare_row_entries);
+	return true;
+}
+
+struct mcc_basic_block *mcc_cfg_get_block_of_row(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *row)
+{
+	assert(analysis);
+	assert(row);
+
+	struct mcc_cfg_row_entry key = {.row = row, .block = NULL};
+	struct mcc_cfg_row_entry *entry =
+	    bsearch(&key, analysis->rows, analysis->num_rows, sizeof(*analysis->rows), compare_row_entries);
+	if (!entry)
+		return NULL;
+	return entry->block;
+}
+
+bool mcc_cfg_loop_contains_row(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop, struct mcc_ir_row *row)
+{
+	struct mcc_basic_block *block = mcc_cfg_get_block_of_row(analysis, row);
+	return block && mcc_cfg_loop_contains(loop, block);
+}
+
+//---------------------------------------------------------------------------------------- Counted loops
+
+struct mcc_ir_row *mcc_cfg_find_back_jump(struct mcc_ir_row *header)
+{
+	assert(header);
+
+	struct mcc_ir_row *back_jump = NULL;
+	for (struct mcc_ir_row *row = header->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_JUMP && row->arg1->label == header->arg1->label)
+			back_jump = row;
+	}
+	return back_jump;
+}
+
+bool mcc_cfg_match_counted_loop(struct mcc_ir_row *header, struct mcc_cfg_counted_loop *loop)
+{
+	assert(header);
+	assert(loop);
+
+	if (header->instr != MCC_IR_INSTR_LABEL || mcc_ir_is_function_end(header->next_row))
+		return false;
+	struct mcc_ir_row *test = header->next_row;
+	struct mcc_ir_row *exit_jump = test->next_row;
+	struct mcc_ir_row *back_jump = mcc_cfg_find_back_jump(header);
+	if ((test->instr != MCC_IR_INSTR_SMALLER && test->instr != MCC_IR_INSTR_SMALLEREQ) ||
+	    test->arg1->type != MCC_IR_TYPE_IDENTIFIER || mcc_ir_is_function_end(exit_jump) ||
+	    exit_jump->instr != MCC_IR_INSTR_JUMPFALSE || !mcc_ir_is_row(exit_jump->arg1, test) || !back_jump)
+		return false;
+
+	struct mcc_ir_row *exit_label = back_jump->next_row;
+	if (!exit_label || exit_label->instr != MCC_IR_INSTR_LABEL || exit_label->arg1->label != exit_jump->arg2->label)
+		return false;
+
+	loop->header = header;
+	loop->test = test;
+	loop->exit_jump = exit_jump;
+	loop->back_jump = back_jump;
+	loop->counter = test->arg1->ident;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Preheader
+
+static bool falls_through(struct mcc_ir_row *row)
+{
+	return row->instr != MCC_IR_INSTR_JUMP && row->instr != MCC_IR_INSTR_RETURN;
+}
+
+static struct mcc_ir_arg *jump_target(struct mcc_ir_row *row)
+{
+	switch (row->instr) {
+	case MCC_IR_INSTR_JUMP:
+		return row->arg1;
+	case MCC_IR_INSTR_JUMPFALSE:
+		return row->arg2;
+	default:
+		return NULL;
+	}
+}
+
+struct mcc_ir_row *mcc_cfg_loop_preheader(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop)
+{
+	assert(analysis);
+	assert(loop);
+
+	struct mcc_ir_row *header_label = loop->header->leader;
+	if (header_label->instr != MCC_IR_INSTR_LABEL)
+		return NULL;
+
+	// Code in front of the header must not be reached through a fall-through from inside the loop
+	struct mcc_ir_row *previous = header_label->prev_row;
+	if (falls_through(previous) && mcc_cfg_loop_contains_row(analysis, loop, previous))
+		return NULL;
+
+	bool entered_by_jump = false;
+	for (unsigned p = 0; p < analysis->num_predecessors[loop->header->id]; p++) {
+		struct mcc_basic_block *pred = analysis->predecessors[loop->header->id][p];
+		struct mcc_ir_arg *target = jump_target(pred->last);
+		if (!loop->contains[pred->id] && target && target->label == header_label->arg1->label)
+			entered_by_jump = true;
+	}
+	if (!entered_by_jump && falls_through(previous))
+		return previous;
+
+	// Put a new label in front of the header and let all jumps from outside the loop go there
+	unsigned label = mcc_ir_get_unused_label(header_label);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	struct mcc_ir_row *preheader = mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_LABEL, type);
+	if (!type || !arg || !preheader) {
+		mcc_ir_delete_ir_row_type(type);
+		mcc_ir_delete_ir_arg(arg);
+		free(preheader);
+		return NULL;
+	}
+	for (unsigned p = 0; p < analysis->num_predecessors[loop->header->id]; p++) {
+		struct mcc_basic_block *pred = analysis->predecessors[loop->header->id][p];
+		struct mcc_ir_arg *target = jump_target(pred->last);
+		if (!loop->contains[pred->id] && target && target->label == header_label->arg1->label)
+			target->label = label;
+	}
+	mcc_ir_insert_row_before(header_label, preheader);
+	return preheader;
+}
+
+//---------------------------------------------------------------------------------------- Set up and delete
+
+struct mcc_cfg_analysis *mcc_cfg_analyse_function(struct mcc_ir_row *function_label)
+{
+	assert(function_label);
+	assert(function_label->instr == MCC_IR_INSTR_FUNC_LABEL);
+
+	struct mcc_cfg_analysis *analysis = calloc(1, sizeof(*analysis));
+	if (!analysis)
+		return NULL;
+	analysis->function_label = function_label;
+	analysis->cfg = mcc_cfg_generate_function(function_label);
+	if (!analysis->cfg || !set_up_blocks(analysis) || !mark_reachable(analysis) || !compute_dominators(analysis) ||
+	    !find_loops(analysis) || !index_rows(analysis)) {
+		mcc_cfg_delete_analysis(analysis);
+		return NULL;
+	}
+	return analysis;
+}
+
+void mcc_cfg_delete_analysis(struct mcc_cfg_analysis *analysis)
+{
+	if (!analysis)
+		return;
+	for (unsigned i = 0; i < analysis->num_blocks; i++) {
+		if (analysis->predecessors)
+			free(analysis->predecessors[i]);
+		if (analysis->dominators)
+			free(analysis->dominators[i]);
+	}
+	free(analysis->predecessors);
+	free(analysis->dominators);
+	free(analysis->num_predecessors);
+	free(analysis->is_reachable);
+	free(analysis->blocks);
+	free(analysis->rows);
+	delete_loops(analysis->loops);
+	mcc_cfg_delete_cfg(analysis->cfg);
+	free(analysis);
+}
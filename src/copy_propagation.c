@@ -0,0 +1,456 @@
+#include "mcc/copy_propagation.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/cfg_analysis.h"
+#include "mcc/liveness.h"
+#include "mcc/pass_manager.h"
+
+//---------------------------------------------------------------------------------------- Variables
+
+static bool assigns(struct mcc_ir_row *row, char *ident)
+{
+	return row->instr == MCC_IR_INSTR_ASSIGN && mcc_ir_is_identifier(row->arg1, ident);
+}
+
+// The operand of the row that is read, the index for array elements. NULL for the assigned identifier.
+static struct mcc_ir_arg **get_read_operand(struct mcc_ir_row *row, unsigned i)
+{
+	struct mcc_ir_arg **arg = i == 0 ? &row->arg1 : &row->arg2;
+	if (*arg && (*arg)->type == MCC_IR_TYPE_ARR_ELEM)
+		return &(*arg)->index;
+	if (i == 0 && row->instr == MCC_IR_INSTR_ASSIGN)
+		return NULL;
+	return arg;
+}
+
+static bool reads(struct mcc_ir_row *row, char *ident)
+{
+	for (unsigned i = 0; i < 2; i++) {
+		struct mcc_ir_arg **arg = get_read_operand(row, i);
+		if (arg && mcc_ir_is_identifier(*arg, ident))
+			return true;
+	}
+	return false;
+}
+
+static bool is_read(struct mcc_ir_row *function_label, char *ident)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (reads(row, ident))
+			return true;
+	}
+	return false;
+}
+
+static unsigned count_assignments(struct mcc_ir_row *function_label, char *ident)
+{
+	unsigned count = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (assigns(row, ident))
+			count++;
+	}
+	return count;
+}
+
+static struct mcc_ir_row *find_assignment(struct mcc_ir_row *function_label, char *ident)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (assigns(row, ident))
+			return row;
+	}
+	return NULL;
+}
+
+// Arrays are declared by ARRAY rows or taken as parameters, and used through their elements
+static bool is_array(struct mcc_ir_row *function_label, char *ident)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if ((row->instr == MCC_IR_INSTR_ARRAY || row->instr == MCC_IR_INSTR_ASSIGN) && row->type->array_size >= 0 &&
+		    mcc_ir_is_identifier(row->arg1, ident))
+			return true;
+		struct mcc_ir_arg *args[] = {row->arg1, row->arg2};
+		for (unsigned i = 0; i < 2; i++) {
+			if (args[i] && args[i]->type == MCC_IR_TYPE_ARR_ELEM && strcmp(args[i]->arr_ident, ident) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+// Assignment of a whole variable that may be deleted. The code generation stores the parameters with the assignments
+// behind their pops.
+static bool is_copy(struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_IDENTIFIER || row->type->lanes > 1)
+		return false;
+	if (row->prev_row && row->prev_row->instr == MCC_IR_INSTR_POP)
+		return false;
+	return !is_array(function_label, row->arg1->ident);
+}
+
+// Replace every read of ident in the function by a copy of value. Returns false if memory allocation fails.
+static bool replace_reads(struct mcc_ir_row *function_label, char *ident, struct mcc_ir_arg *value)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		for (unsigned i = 0; i < 2; i++) {
+			struct mcc_ir_arg **arg = get_read_operand(row, i);
+			if (!arg || !mcc_ir_is_identifier(*arg, ident))
+				continue;
+			struct mcc_ir_arg *copy = mcc_ir_copy_arg(value);
+			if (!copy)
+				return false;
+			mcc_ir_delete_ir_arg(*arg);
+			*arg = copy;
+		}
+	}
+	return true;
+}
+
+static void delete_row(struct mcc_ir_row *row)
+{
+	mcc_ir_unlink_row(row);
+	mcc_ir_delete_ir_row(row);
+}
+
+//---------------------------------------------------------------------------------------- Dead copies
+
+static bool is_live_after(struct mcc_liveness *liveness, struct mcc_basic_block *block, struct mcc_ir_row *row)
+{
+	char *ident = row->arg1->ident;
+	for (struct mcc_ir_row *next = row; next != block->last;) {
+		next = next->next_row;
+		if (reads(next, ident))
+			return true;
+		if (assigns(next, ident))
+			return false;
+	}
+	int variable = mcc_liveness_find_identifier(liveness, ident);
+	return variable >= 0 && mcc_liveness_is_live_out(liveness, block, variable);
+}
+
+// Returns the number of deleted copies, or -1 if memory allocation fails
+static int delete_dead_copies(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	struct mcc_liveness *liveness = mcc_pass_manager_get_liveness(manager, function_label);
+	if (!liveness)
+		return -1;
+	struct mcc_cfg_analysis *analysis = liveness->analysis;
+	struct mcc_ir_row **dead = malloc(sizeof(*dead) * analysis->num_rows);
+	if (!dead)
+		return -1;
+
+	unsigned num_dead = 0;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!analysis->is_reachable[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			if (is_copy(function_label, row) && !is_live_after(liveness, block, row))
+				dead[num_dead++] = row;
+		}
+	}
+
+	// A variable that is read keeps an assignment, even if none of the reads can be reached from it
+	int num_deleted = 0;
+	for (unsigned i = 0; i < num_dead; i++) {
+		char *ident = dead[i]->arg1->ident;
+		if (count_assignments(function_label, ident) > 1 || !is_read(function_label, ident)) {
+			delete_row(dead[i]);
+			num_deleted++;
+		}
+	}
+	free(dead);
+	return num_deleted;
+}
+
+//---------------------------------------------------------------------------------------- Propagation
+
+struct copy {
+	struct mcc_ir_row *row;
+	// Temporary holding the same literal that replaces the one of row, NULL if the value of row replaces it
+	struct mcc_ir_row *constant;
+};
+
+// Whether definition has been executed whenever use is
+static bool dominates(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *definition, struct mcc_ir_row *use)
+{
+	struct mcc_basic_block *block = mcc_cfg_get_block_of_row(analysis, definition);
+	struct mcc_basic_block *use_block = mcc_cfg_get_block_of_row(analysis, use);
+	if (!block || !use_block)
+		return false;
+	if (block != use_block)
+		return mcc_cfg_dominates(analysis, block, use_block);
+	for (struct mcc_ir_row *row = definition; row != block->last;) {
+		row = row->next_row;
+		if (row == use)
+			return true;
+	}
+	return false;
+}
+
+// Reads that cannot be reached are replaced as well, but need not be dominated
+static bool
+dominates_reads(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	for (struct mcc_ir_row *use = function_label->next_row; !mcc_ir_is_function_end(use); use = use->next_row) {
+		if (!reads(use, row->arg1->ident))
+			continue;
+		struct mcc_basic_block *block = mcc_cfg_get_block_of_row(analysis, use);
+		if (block && analysis->is_reachable[block->id] && !dominates(analysis, row, use))
+			return false;
+	}
+	return true;
+}
+
+static bool is_constant_literal(struct mcc_ir_arg *arg)
+{
+	return arg->type == MCC_IR_TYPE_LIT_FLOAT || arg->type == MCC_IR_TYPE_LIT_STRING;
+}
+
+static bool is_same_literal(struct mcc_ir_arg *a, struct mcc_ir_arg *b)
+{
+	if (a->type != b->type)
+		return false;
+	if (a->type == MCC_IR_TYPE_LIT_FLOAT)
+		return a->lit_float == b->lit_float;
+	return strcmp(a->lit_string, b->lit_string) == 0;
+}
+
+// Float and string literals are held in temporaries that are assigned exactly once
+static bool is_constant_temporary(struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_IDENTIFIER)
+		return false;
+	if (!is_constant_literal(row->arg2) || strncmp(row->arg1->ident, "$tmp", 4) != 0)
+		return false;
+	return count_assignments(function_label, row->arg1->ident) == 1;
+}
+
+// The temporaries holding the same literal as row whose assignments dominate it dominate each other, the first one
+// is kept
+static struct mcc_ir_row *
+find_equal_constant(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	struct mcc_ir_row *found = NULL;
+	for (struct mcc_ir_row *other = function_label->next_row; !mcc_ir_is_function_end(other); other = other->next_row) {
+		if (other == row || other->instr != MCC_IR_INSTR_ASSIGN || !is_constant_literal(other->arg2) ||
+		    !is_same_literal(other->arg2, row->arg2) || !is_constant_temporary(function_label, other))
+			continue;
+		if (dominates(analysis, other, row) && (!found || dominates(analysis, other, found)))
+			found = other;
+	}
+	return found;
+}
+
+static bool is_propagated_value(struct mcc_cfg_analysis *analysis,
+                                struct mcc_ir_row *function_label,
+                                struct mcc_ir_row *row)
+{
+	struct mcc_ir_arg *value = row->arg2;
+	switch (value->type) {
+	case MCC_IR_TYPE_LIT_INT:
+	case MCC_IR_TYPE_LIT_BOOL:
+		return true;
+	case MCC_IR_TYPE_ROW:
+		return value->row->type->lanes == 1 && value->row->instr != MCC_IR_INSTR_POP;
+	case MCC_IR_TYPE_IDENTIFIER:
+		// A variable assigned once keeps its value from the assignment on
+		if (strcmp(value->ident, row->arg1->ident) == 0 || count_assignments(function_label, value->ident) != 1 ||
+		    is_array(function_label, value->ident))
+			return false;
+		return dominates(analysis, find_assignment(function_label, value->ident), row);
+	default:
+		return false;
+	}
+}
+
+static bool is_propagated(struct mcc_cfg_analysis *analysis, struct mcc_ir_row *function_label, struct copy *copy)
+{
+	struct mcc_ir_row *row = copy->row;
+	copy->constant = NULL;
+	if (!is_copy(function_label, row) || count_assignments(function_label, row->arg1->ident) != 1 ||
+	    !dominates_reads(analysis, function_label, row))
+		return false;
+	if (is_constant_temporary(function_label, row)) {
+		copy->constant = find_equal_constant(analysis, function_label, row);
+		return copy->constant != NULL;
+	}
+	return is_propagated_value(analysis, function_label, row);
+}
+
+// All copies are found before any is deleted. The value of a copy may itself be replaced by the value of an earlier
+// copy in the meantime, which then dominates the reads as well.
+// Returns the number of propagated copies, or -1 if memory allocation fails.
+static int propagate_copies(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, function_label);
+	if (!analysis)
+		return -1;
+	struct copy *copies = malloc(sizeof(*copies) * analysis->num_rows);
+	if (!copies)
+		return -1;
+
+	unsigned num_copies = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		copies[num_copies].row = row;
+		if (is_propagated(analysis, function_label, &copies[num_copies]))
+			num_copies++;
+	}
+
+	for (unsigned i = 0; i < num_copies; i++) {
+		struct mcc_ir_row *row = copies[i].row;
+		struct mcc_ir_arg *value =
+		    copies[i].constant ? mcc_ir_new_arg_identifier(copies[i].constant->arg1->ident) : row->arg2;
+		bool success = value && replace_reads(function_label, row->arg1->ident, value);
+		if (copies[i].constant)
+			mcc_ir_delete_ir_arg(value);
+		if (!success) {
+			free(copies);
+			return -1;
+		}
+		delete_row(row);
+	}
+	free(copies);
+	return (int)num_copies;
+}
+
+//---------------------------------------------------------------------------------------- Coalescing
+
+// Name of temporaries whose uses do not overlap
+struct shared_name {
+	char *ident;
+	enum mcc_ir_row_types type;
+	// Position of the last read so far
+	unsigned end;
+};
+
+// Whether all reads of the temporary assigned by row are behind it in its block, and at least one is. Float and
+// string literals stay in temporaries of their own, the data section declares them by that name. Gives the position
+// of the last read.
+static bool is_block_local(struct mcc_cfg_analysis *analysis,
+                           struct mcc_ir_row *function_label,
+                           struct mcc_ir_row *row,
+                           unsigned position,
+                           unsigned *end)
+{
+	if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_IDENTIFIER || row->type->lanes > 1 ||
+	    strncmp(row->arg1->ident, "$tmp", 4) != 0 || is_constant_literal(row->arg2))
+		return false;
+	char *ident = row->arg1->ident;
+	struct mcc_basic_block *block = mcc_cfg_get_block_of_row(analysis, row);
+	if (!block || count_assignments(function_label, ident) != 1)
+		return false;
+
+	unsigned num_reads = 0;
+	for (struct mcc_ir_row *next = row; next != block->last;) {
+		next = next->next_row;
+		position++;
+		if (reads(next, ident)) {
+			*end = position;
+			num_reads++;
+		}
+	}
+	unsigned num_all_reads = 0;
+	for (struct mcc_ir_row *use = function_label->next_row; !mcc_ir_is_function_end(use); use = use->next_row) {
+		if (reads(use, ident))
+			num_all_reads++;
+	}
+	return num_reads > 0 && num_reads == num_all_reads;
+}
+
+// Temporaries take the first name whose last read is in front of them. The uses of a block-local temporary lie
+// between its assignment and its last read in IR order, so those of a shared name never overlap.
+// Returns the number of renamed temporaries, or -1 if memory allocation fails.
+static int coalesce_temporaries(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, function_label);
+	if (!analysis)
+		return -1;
+	struct shared_name *names = malloc(sizeof(*names) * analysis->num_rows);
+	if (!names)
+		return -1;
+
+	unsigned num_names = 0;
+	int num_renamed = 0;
+	unsigned position = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row);
+	     row = row->next_row, position++) {
+		unsigned end = 0;
+		if (!is_block_local(analysis, function_label, row, position, &end))
+			continue;
+		struct shared_name *name = NULL;
+		for (unsigned n = 0; n < num_names && !name; n++) {
+			if (names[n].type == row->type->type && names[n].end < position)
+				name = &names[n];
+		}
+		if (!name) {
+			names[num_names++] = (struct shared_name){.ident = row->arg1->ident, .type = row->type->type, .end = end};
+			continue;
+		}
+
+		struct mcc_ir_arg *value = mcc_ir_new_arg_identifier(name->ident);
+		char *ident = strdup(name->ident);
+		bool success = value && ident && replace_reads(function_label, row->arg1->ident, value);
+		mcc_ir_delete_ir_arg(value);
+		if (!success) {
+			free(ident);
+			free(names);
+			return -1;
+		}
+		free(row->arg1->ident);
+		row->arg1->ident = ident;
+		name->end = end;
+		num_renamed++;
+	}
+	free(names);
+	return num_renamed;
+}
+
+//---------------------------------------------------------------------------------------- Pass
+
+static bool propagate_function(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	int num_deleted = delete_dead_copies(manager, function_label);
+	if (num_deleted != 0)
+		mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+	if (num_deleted < 0)
+		return false;
+
+	int num_propagated = propagate_copies(manager, function_label);
+	if (num_propagated != 0)
+		mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+	if (num_propagated < 0)
+		return false;
+
+	// Renaming leaves the CFG as it is
+	int num_renamed = coalesce_temporaries(manager, function_label);
+	if (num_renamed != 0)
+		mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_LIVENESS);
+	return num_renamed >= 0;
+}
+
+bool mcc_copy_propagation_run_with_manager(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	for (struct mcc_ir_row *row = manager->ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !propagate_function(manager, row))
+			return false;
+	}
+	return true;
+}
+
+bool mcc_copy_propagation_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	if (!manager)
+		return false;
+	bool success = mcc_copy_propagation_run_with_manager(manager);
+	mcc_pass_manager_delete(manager);
+	return success;
+}
@@ -0,0 +1,572 @@
+#include "mcc/induction.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/cfg_analysis.h"
+#include "mcc/pass_manager.h"
+
+// i = i + step, assigned exactly once in the loop
+struct basic_iv {
+	char *ident;
+	struct mcc_ir_row *update;
+	struct mcc_ir_row *assign;
+	long step;
+};
+
+// Variable that holds basic * factor, created by this pass
+struct derived_iv {
+	char *basic;
+	char *name;
+	struct mcc_ir_arg *factor;
+	// Label row of the loop header and the multiplication in front of it
+	struct mcc_ir_row *header;
+	struct mcc_ir_row *init;
+	bool exit_test_replaced;
+	struct derived_iv *next;
+};
+
+struct induction_data {
+	struct mcc_ir_row *function_label;
+	unsigned counter;
+	struct derived_iv *derived;
+};
+
+struct loop_rows {
+	unsigned num_rows;
+	struct mcc_ir_row **rows;
+};
+
+static void delete_derived(struct derived_iv *derived)
+{
+	while (derived) {
+		struct derived_iv *next = derived->next;
+		free(derived->basic);
+		free(derived->name);
+		mcc_ir_delete_ir_arg(derived->factor);
+		free(derived);
+		derived = next;
+	}
+}
+
+//---------------------------------------------------------------------------------------- Loop rows
+
+static bool collect_loop_rows(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop, struct loop_rows *loop_rows)
+{
+	unsigned num_rows = 0;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!loop->contains[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			num_rows++;
+		}
+	}
+
+	loop_rows->num_rows = 0;
+	loop_rows->rows = malloc(sizeof(*loop_rows->rows) * num_rows);
+	if (!loop_rows->rows)
+		return false;
+
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!loop->contains[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			loop_rows->rows[loop_rows->num_rows++] = row;
+		}
+	}
+	return true;
+}
+
+static bool is_assignment_to(struct mcc_ir_row *row, char *ident)
+{
+	return row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+	       strcmp(row->arg1->ident, ident) == 0;
+}
+
+static unsigned count_assignments_in_loop(struct loop_rows *loop_rows, char *ident, struct mcc_ir_row **last)
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < loop_rows->num_rows; i++) {
+		if (is_assignment_to(loop_rows->rows[i], ident)) {
+			*last = loop_rows->rows[i];
+			count++;
+		}
+	}
+	return count;
+}
+
+//---------------------------------------------------------------------------------------- Induction variables
+
+static bool find_basic_iv(struct mcc_cfg_analysis *analysis,
+                          struct mcc_cfg_loop *loop,
+                          struct loop_rows *loop_rows,
+                          char *ident,
+                          struct basic_iv *iv)
+{
+	struct mcc_ir_row *assign = NULL;
+	if (count_assignments_in_loop(loop_rows, ident, &assign) != 1)
+		return false;
+	if (assign->arg2->type != MCC_IR_TYPE_ROW || !mcc_cfg_loop_contains_row(analysis, loop, assign->arg2->row))
+		return false;
+
+	struct mcc_ir_row *update = assign->arg2->row;
+	if (update->type->type != MCC_IR_ROW_INT)
+		return false;
+
+	if (update->instr == MCC_IR_INSTR_PLUS && mcc_ir_is_identifier(update->arg1, ident) &&
+	    update->arg2->type == MCC_IR_TYPE_LIT_INT) {
+		iv->step = update->arg2->lit_int;
+	} else if (update->instr == MCC_IR_INSTR_PLUS && mcc_ir_is_identifier(update->arg2, ident) &&
+	           update->arg1->type == MCC_IR_TYPE_LIT_INT) {
+		iv->step = update->arg1->lit_int;
+	} else if (update->instr == MCC_IR_INSTR_MINUS && mcc_ir_is_identifier(update->arg1, ident) &&
+	           update->arg2->type == MCC_IR_TYPE_LIT_INT) {
+		iv->step = -update->arg2->lit_int;
+	} else {
+		return false;
+	}
+
+	iv->ident = ident;
+	iv->update = update;
+	iv->assign = assign;
+	return true;
+}
+
+static bool is_invariant_factor(struct mcc_cfg_analysis *analysis,
+                                struct mcc_cfg_loop *loop,
+                                struct loop_rows *loop_rows,
+                                struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_row *last = NULL;
+	switch (arg->type) {
+	case MCC_IR_TYPE_LIT_INT:
+		return true;
+	case MCC_IR_TYPE_IDENTIFIER:
+		return count_assignments_in_loop(loop_rows, arg->ident, &last) == 0;
+	case MCC_IR_TYPE_ROW:
+		return !mcc_cfg_loop_contains_row(analysis, loop, arg->row);
+	default:
+		return false;
+	}
+}
+
+static bool same_factor(struct mcc_ir_arg *a, struct mcc_ir_arg *b)
+{
+	if (a->type != b->type)
+		return false;
+	switch (a->type) {
+	case MCC_IR_TYPE_LIT_INT:
+		return a->lit_int == b->lit_int;
+	case MCC_IR_TYPE_IDENTIFIER:
+		return strcmp(a->ident, b->ident) == 0;
+	case MCC_IR_TYPE_ROW:
+		return a->row == b->row;
+	default:
+		return false;
+	}
+}
+
+// Checks whether row multiplies a basic induction variable with an invariant factor
+static bool is_derived_iv(struct mcc_cfg_analysis *analysis,
+                          struct mcc_cfg_loop *loop,
+                          struct loop_rows *loop_rows,
+                          struct mcc_ir_row *row,
+                          struct basic_iv *iv,
+                          struct mcc_ir_arg **factor)
+{
+	if (row->instr != MCC_IR_INSTR_MULTIPLY || row->type->type != MCC_IR_ROW_INT)
+		return false;
+
+	struct mcc_ir_arg *operands[] = {row->arg1, row->arg2};
+	for (unsigned i = 0; i < 2; i++) {
+		struct mcc_ir_arg *variable = operands[i];
+		struct mcc_ir_arg *other = operands[1 - i];
+		if (variable->type != MCC_IR_TYPE_IDENTIFIER || !is_invariant_factor(analysis, loop, loop_rows, other))
+			continue;
+		if (find_basic_iv(analysis, loop, loop_rows, variable->ident, iv)) {
+			*factor = other;
+			return true;
+		}
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------- Strength reduction
+
+static struct mcc_ir_row *new_int_row(struct mcc_ir_arg *arg1, struct mcc_ir_arg *arg2, enum mcc_ir_instruction instr)
+{
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_INT, -1);
+	struct mcc_ir_row *row = NULL;
+	if (arg1 && arg2 && type)
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+	}
+	return row;
+}
+
+// Appends name = basic * factor after position and returns the last inserted row
+static struct mcc_ir_row *
+insert_initialisation(struct mcc_ir_row *position, struct derived_iv *derived, struct mcc_ir_row **product)
+{
+	*product = new_int_row(mcc_ir_new_arg_identifier(derived->basic), mcc_ir_copy_arg(derived->factor),
+	                       MCC_IR_INSTR_MULTIPLY);
+	if (!*product)
+		return NULL;
+	mcc_ir_insert_row_after(position, *product);
+
+	struct mcc_ir_row *assign =
+	    new_int_row(mcc_ir_new_arg_identifier(derived->name), mcc_ir_new_arg_row(*product), MCC_IR_INSTR_ASSIGN);
+	if (!assign)
+		return NULL;
+	mcc_ir_insert_row_after(*product, assign);
+	return assign;
+}
+
+// Gives the amount name changes by in every iteration, computing it in front of the loop if the factor is no literal
+static struct mcc_ir_arg *get_derived_step(struct mcc_ir_row *position, struct derived_iv *derived, long step)
+{
+	if (derived->factor->type == MCC_IR_TYPE_LIT_INT)
+		return mcc_ir_new_arg_int(step * derived->factor->lit_int);
+
+	struct mcc_ir_row *row =
+	    new_int_row(mcc_ir_copy_arg(derived->factor), mcc_ir_new_arg_int(step), MCC_IR_INSTR_MULTIPLY);
+	if (!row)
+		return NULL;
+	mcc_ir_insert_row_after(position, row);
+	return mcc_ir_new_arg_row(row);
+}
+
+static bool insert_update(struct basic_iv *iv, struct derived_iv *derived, struct mcc_ir_arg *step)
+{
+	struct mcc_ir_row *plus = new_int_row(mcc_ir_new_arg_identifier(derived->name), step, MCC_IR_INSTR_PLUS);
+	if (!plus)
+		return false;
+	mcc_ir_insert_row_after(iv->assign, plus);
+
+	struct mcc_ir_row *assign =
+	    new_int_row(mcc_ir_new_arg_identifier(derived->name), mcc_ir_new_arg_row(plus), MCC_IR_INSTR_ASSIGN);
+	if (!assign)
+		return false;
+	mcc_ir_insert_row_after(plus, assign);
+	return true;
+}
+
+static struct derived_iv *new_derived(struct induction_data *data, struct basic_iv *iv, struct mcc_ir_arg *factor)
+{
+	struct derived_iv *derived = calloc(1, sizeof(*derived));
+	if (!derived)
+		return NULL;
+	derived->next = data->derived;
+	data->derived = derived;
+
+	size_t size = strlen(iv->ident) + 16;
+	derived->basic = strdup(iv->ident);
+	derived->name = malloc(size);
+	derived->factor = mcc_ir_copy_arg(factor);
+	if (!derived->basic || !derived->name || !derived->factor)
+		return NULL;
+	snprintf(derived->name, size, "%s.iv%u", iv->ident, data->counter++);
+	return derived;
+}
+
+static bool replace_products(struct induction_data *data,
+                             struct mcc_cfg_analysis *analysis,
+                             struct mcc_cfg_loop *loop,
+                             struct loop_rows *loop_rows,
+                             struct derived_iv *derived)
+{
+	struct mcc_ir_arg *name = mcc_ir_new_arg_identifier(derived->name);
+	bool *is_product = calloc(loop_rows->num_rows, sizeof(*is_product));
+	if (!name || !is_product) {
+		mcc_ir_delete_ir_arg(name);
+		free(is_product);
+		return false;
+	}
+
+	// Find all products first, deleting them changes the operands of the others
+	for (unsigned i = 0; i < loop_rows->num_rows; i++) {
+		struct basic_iv iv;
+		struct mcc_ir_arg *factor = NULL;
+		is_product[i] = is_derived_iv(analysis, loop, loop_rows, loop_rows->rows[i], &iv, &factor) &&
+		                strcmp(iv.ident, derived->basic) == 0 && same_factor(factor, derived->factor);
+	}
+
+	bool ok = true;
+	for (unsigned i = 0; i < loop_rows->num_rows && ok; i++) {
+		struct mcc_ir_row *row = loop_rows->rows[i];
+		if (!is_product[i])
+			continue;
+		ok = mcc_ir_replace_row_uses(data->function_label, row, name);
+		// The initialisation of an inner loop's variable may be reduced as part of an enclosing loop
+		for (struct derived_iv *other = data->derived; other; other = other->next) {
+			if (other->init == row)
+				other->init = NULL;
+		}
+		mcc_ir_unlink_row(row);
+		mcc_ir_delete_ir_row(row);
+	}
+	mcc_ir_delete_ir_arg(name);
+	free(is_product);
+	return ok;
+}
+
+// Returns 1 if a multiplication was replaced, 0 if there is none, and -1 if memory allocation fails
+static int reduce_loop(struct induction_data *data, struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop)
+{
+	struct loop_rows loop_rows;
+	if (!collect_loop_rows(analysis, loop, &loop_rows))
+		return -1;
+
+	struct basic_iv iv;
+	struct mcc_ir_arg *factor = NULL;
+	bool found = false;
+	for (unsigned i = 0; i < loop_rows.num_rows && !found; i++) {
+		found = is_derived_iv(analysis, loop, &loop_rows, loop_rows.rows[i], &iv, &factor);
+	}
+	if (!found) {
+		free(loop_rows.rows);
+		return 0;
+	}
+
+	struct mcc_ir_row *position = mcc_cfg_loop_preheader(analysis, loop);
+	if (!position) {
+		free(loop_rows.rows);
+		return 0;
+	}
+
+	struct derived_iv *derived = new_derived(data, &iv, factor);
+	struct mcc_ir_arg *step = NULL;
+	bool ok = derived && (position = insert_initialisation(position, derived, &derived->init)) &&
+	          (step = get_derived_step(position, derived, iv.step)) && insert_update(&iv, derived, step) &&
+	          replace_products(data, analysis, loop, &loop_rows, derived);
+	if (derived)
+		derived->header = loop->header->leader;
+
+	free(loop_rows.rows);
+	return ok ? 1 : -1;
+}
+
+//---------------------------------------------------------------------------------------- Exit test replacement
+
+static bool arg_reads(struct mcc_ir_arg *arg, char *ident)
+{
+	if (!arg)
+		return false;
+	if (arg->type == MCC_IR_TYPE_ARR_ELEM)
+		return arg_reads(arg->index, ident);
+	return mcc_ir_is_identifier(arg, ident);
+}
+
+// Checks that ident is read nowhere in the function but by the given rows
+static bool is_only_read_by(struct mcc_ir_row *function_label, char *ident, struct mcc_ir_row **readers, unsigned n)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; row && row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     row = row->next_row) {
+		bool reads = arg_reads(row->arg2, ident);
+		// The variable on the left side of an assignment is written, not read
+		if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type == MCC_IR_TYPE_ARR_ELEM)
+			reads = reads || arg_reads(row->arg1, ident);
+		if (!reads)
+			continue;
+
+		bool allowed = false;
+		for (unsigned i = 0; i < n; i++) {
+			allowed = allowed || readers[i] == row;
+		}
+		if (!allowed)
+			return false;
+	}
+	return true;
+}
+
+static bool is_row_used_only_by(struct mcc_ir_row *function_label, struct mcc_ir_row *row, struct mcc_ir_row *user)
+{
+	for (struct mcc_ir_row *other = function_label->next_row; other && other->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     other = other->next_row) {
+		if (other == user)
+			continue;
+		struct mcc_ir_arg *args[] = {other->arg1, other->arg2};
+		for (unsigned i = 0; i < 2; i++) {
+			struct mcc_ir_arg *arg = args[i];
+			if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+				arg = arg->index;
+			if (arg && arg->type == MCC_IR_TYPE_ROW && arg->row == row)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Literal value the variable gets in the block in front of the loop
+static bool find_initial_value(struct derived_iv *derived, long *value)
+{
+	for (struct mcc_ir_row *row = derived->init->prev_row; row; row = row->prev_row) {
+		switch (row->instr) {
+		case MCC_IR_INSTR_LABEL:
+		case MCC_IR_INSTR_FUNC_LABEL:
+		case MCC_IR_INSTR_JUMP:
+		case MCC_IR_INSTR_JUMPFALSE:
+		case MCC_IR_INSTR_RETURN:
+			return false;
+		default:
+			break;
+		}
+		if (is_assignment_to(row, derived->basic)) {
+			if (row->arg2->type != MCC_IR_TYPE_LIT_INT)
+				return false;
+			*value = row->arg2->lit_int;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool fits_int(long long value)
+{
+	return value >= INT_MIN && value <= INT_MAX;
+}
+
+// All values of the variable lie between the initial value and the bound plus one step, so the products of these
+// must not overflow
+static bool products_fit(long initial, long bound, long step, long factor)
+{
+	long long low = step > 0 ? (initial < bound ? initial : bound) : (initial < bound + step ? initial : bound + step);
+	long long high = step > 0 ? (initial > bound + step ? initial : bound + step) : (initial > bound ? initial : bound);
+	if (!fits_int(low) || !fits_int(high))
+		return false;
+	return fits_int(low * factor) && fits_int(high * factor);
+}
+
+// A step of 0 only checks for a comparison
+static bool is_exit_test_of(struct mcc_ir_row *compare, long step)
+{
+	switch (compare->instr) {
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_SMALLEREQ:
+		return step >= 0;
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_GREATEREQ:
+		return step <= 0;
+	default:
+		return false;
+	}
+}
+
+// Returns true if the exit test was replaced
+static bool
+replace_exit_test(struct induction_data *data, struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop)
+{
+	struct mcc_ir_row *jumpfalse = loop->header->last;
+	if (jumpfalse->instr != MCC_IR_INSTR_JUMPFALSE || jumpfalse->arg1->type != MCC_IR_TYPE_ROW)
+		return false;
+	struct mcc_ir_row *compare = jumpfalse->arg1->row;
+	if (mcc_cfg_get_block_of_row(analysis, compare) != loop->header || !is_exit_test_of(compare, 0) ||
+	    compare->arg1->type != MCC_IR_TYPE_IDENTIFIER || compare->arg2->type != MCC_IR_TYPE_LIT_INT)
+		return false;
+
+	struct derived_iv *derived = data->derived;
+	while (derived && (derived->header != loop->header->leader || derived->exit_test_replaced || !derived->init ||
+	                   strcmp(derived->basic, compare->arg1->ident) != 0 ||
+	                   derived->factor->type != MCC_IR_TYPE_LIT_INT || derived->factor->lit_int <= 0)) {
+		derived = derived->next;
+	}
+	if (!derived)
+		return false;
+
+	struct loop_rows loop_rows;
+	if (!collect_loop_rows(analysis, loop, &loop_rows))
+		return false;
+	struct basic_iv iv;
+	bool is_basic = find_basic_iv(analysis, loop, &loop_rows, derived->basic, &iv);
+	free(loop_rows.rows);
+
+	long initial = 0;
+	long bound = compare->arg2->lit_int;
+	long factor = derived->factor->lit_int;
+	if (!is_basic || !is_exit_test_of(compare, iv.step) || !find_initial_value(derived, &initial) ||
+	    !products_fit(initial, bound, iv.step, factor))
+		return false;
+
+	struct mcc_ir_row *readers[] = {iv.update, compare, derived->init};
+	if (!is_only_read_by(data->function_label, derived->basic, readers, 3) ||
+	    !is_row_used_only_by(data->function_label, iv.update, iv.assign))
+		return false;
+
+	struct mcc_ir_arg *name = mcc_ir_new_arg_identifier(derived->name);
+	if (!name)
+		return false;
+	mcc_ir_delete_ir_arg(compare->arg1);
+	compare->arg1 = name;
+	compare->arg2->lit_int = bound * factor;
+	derived->exit_test_replaced = true;
+
+	// The old induction variable is not needed in the loop anymore
+	mcc_ir_unlink_row(iv.update);
+	mcc_ir_delete_ir_row(iv.update);
+	mcc_ir_unlink_row(iv.assign);
+	mcc_ir_delete_ir_row(iv.assign);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Run
+
+static bool reduce_function(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	struct induction_data data = {.function_label = function_label, .counter = 0, .derived = NULL};
+
+	// Every transformation changes the CFG, so analyse again until nothing changes. Inner loops come first. The
+	// analysis of the unchanged function stays cached for the following passes.
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, function_label);
+		if (!analysis) {
+			delete_derived(data.derived);
+			return false;
+		}
+		for (struct mcc_cfg_loop *loop = analysis->loops; loop && !changed; loop = loop->next) {
+			int reduced = reduce_loop(&data, analysis, loop);
+			if (reduced < 0) {
+				mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+				delete_derived(data.derived);
+				return false;
+			}
+			changed = reduced > 0 || replace_exit_test(&data, analysis, loop);
+		}
+		if (changed)
+			mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+	}
+	delete_derived(data.derived);
+	return true;
+}
+
+bool mcc_induction_run_with_manager(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	for (struct mcc_ir_row *row = manager->ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !reduce_function(manager, row))
+			return false;
+	}
+	return true;
+}
+
+bool mcc_induction_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	if (!manager)
+		return false;
+	bool success = mcc_induction_run_with_manager(manager);
+	mcc_pass_manager_delete(manager);
+	return success;
+}
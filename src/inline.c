@@ -0,0 +1,531 @@
+#include "mcc/inline.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct function_info {
+	struct mcc_ir_row *label;
+	unsigned num_params;
+	// Number of rows without the function label and the rows that take the parameters
+	unsigned size;
+	unsigned num_calls;
+	bool is_recursive;
+};
+
+struct inline_data {
+	unsigned num_functions;
+	struct function_info *functions;
+	unsigned limit;
+	unsigned counter;
+};
+
+// State for copying the body of a function into one call site
+struct copy_data {
+	struct function_info *callee;
+	// Push rows of the call, indexed by parameter
+	struct mcc_ir_row **pushes;
+	char *suffix;
+	char *result;
+	unsigned num_rows;
+	struct mcc_ir_row **old_rows;
+	struct mcc_ir_row **new_rows;
+	unsigned num_labels;
+	unsigned *old_labels;
+	unsigned first_label;
+	unsigned end_label;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+static unsigned count_params(struct mcc_ir_row *label)
+{
+	unsigned num_params = 0;
+	struct mcc_ir_row *row = label->next_row;
+	while (row && row->instr == MCC_IR_INSTR_POP && row->next_row && row->next_row->instr == MCC_IR_INSTR_ASSIGN) {
+		num_params++;
+		row = row->next_row->next_row;
+	}
+	return num_params;
+}
+
+// POP row of the parameter with the given index, it is followed by the assignment to the parameter
+static struct mcc_ir_row *get_param_pop(struct function_info *function, unsigned index)
+{
+	struct mcc_ir_row *row = function->label->next_row;
+	for (unsigned i = 0; i < index; i++) {
+		row = row->next_row->next_row;
+	}
+	return row;
+}
+
+static struct mcc_ir_row *get_body(struct function_info *function)
+{
+	struct mcc_ir_row *row = function->label->next_row;
+	for (unsigned i = 0; i < function->num_params; i++) {
+		row = row->next_row->next_row;
+	}
+	return row;
+}
+
+static struct function_info *find_function(struct inline_data *data, char *name)
+{
+	for (unsigned i = 0; i < data->num_functions; i++) {
+		if (strcmp(data->functions[i].label->arg1->func_label, name) == 0)
+			return &data->functions[i];
+	}
+	return NULL;
+}
+
+static bool collect_functions(struct mcc_ir_row *ir, struct inline_data *data)
+{
+	data->num_functions = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL)
+			data->num_functions++;
+	}
+	data->functions = calloc(data->num_functions, sizeof(*data->functions));
+	if (!data->functions)
+		return false;
+
+	unsigned i = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL) {
+			data->functions[i].label = row;
+			data->functions[i].num_params = count_params(row);
+			i++;
+		}
+	}
+	return true;
+}
+
+static void update_function_info(struct mcc_ir_row *ir, struct inline_data *data)
+{
+	for (unsigned i = 0; i < data->num_functions; i++) {
+		struct function_info *function = &data->functions[i];
+		function->size = 0;
+		function->num_calls = 0;
+		for (struct mcc_ir_row *row = get_body(function); !mcc_ir_is_function_end(row); row = row->next_row) {
+			function->size++;
+		}
+	}
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_CALL)
+			continue;
+		struct function_info *callee = find_function(data, row->arg1->func_label);
+		if (callee)
+			callee->num_calls++;
+	}
+}
+
+// A function is recursive if it can reach itself in the call graph
+static bool mark_recursive_functions(struct inline_data *data)
+{
+	unsigned n = data->num_functions;
+	bool *calls = calloc(n * n, sizeof(*calls));
+	if (!calls)
+		return false;
+
+	for (unsigned i = 0; i < n; i++) {
+		for (struct mcc_ir_row *row = data->functions[i].label->next_row; !mcc_ir_is_function_end(row);
+		     row = row->next_row) {
+			if (row->instr != MCC_IR_INSTR_CALL)
+				continue;
+			struct function_info *callee = find_function(data, row->arg1->func_label);
+			if (callee)
+				calls[i * n + (unsigned)(callee - data->functions)] = true;
+		}
+	}
+	for (unsigned k = 0; k < n; k++) {
+		for (unsigned i = 0; i < n; i++) {
+			for (unsigned j = 0; j < n; j++) {
+				if (calls[i * n + k] && calls[k * n + j])
+					calls[i * n + j] = true;
+			}
+		}
+	}
+	for (unsigned i = 0; i < n; i++) {
+		data->functions[i].is_recursive = calls[i * n + i];
+	}
+	free(calls);
+	return true;
+}
+
+// A call is hot if the profile says it ran at least twice per run of its function
+static bool is_hot(struct function_info *caller, struct mcc_ir_row *call)
+{
+	long long entries = caller->label->profile_count;
+	return entries > 0 && call->profile_count >= 2 * entries;
+}
+
+static bool should_inline(struct inline_data *data,
+                          struct function_info *caller,
+                          struct function_info *callee,
+                          struct mcc_ir_row *call)
+{
+	if (!caller || !callee || caller == callee || callee->is_recursive)
+		return false;
+	if (strcmp(callee->label->arg1->func_label, "main") == 0)
+		return false;
+	if (call->profile_count == 0)
+		return false;
+	if (callee->size <= data->limit)
+		return true;
+	if (is_hot(caller, call))
+		return callee->size <= 4 * data->limit;
+	// The out-of-line copy of a function that is called once is not needed anymore afterwards
+	return callee->num_calls == 1 && callee->size <= 4 * data->limit;
+}
+
+//---------------------------------------------------------------------------------------- Renaming
+
+static bool is_array_param(struct copy_data *copy, char *ident, unsigned *index)
+{
+	for (unsigned i = 0; i < copy->callee->num_params; i++) {
+		struct mcc_ir_row *pop = get_param_pop(copy->callee, i);
+		if (pop->type->array_size >= 0 && strcmp(pop->next_row->arg1->ident, ident) == 0) {
+			*index = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Array parameters are replaced by the passed array, all other variables get the suffix of the call site
+static char *rename_ident(struct copy_data *copy, char *ident)
+{
+	unsigned index = 0;
+	if (is_array_param(copy, ident, &index))
+		return strdup(copy->pushes[index]->arg1->ident);
+
+	size_t size = strlen(ident) + strlen(copy->suffix) + 1;
+	char *name = malloc(size);
+	if (name)
+		snprintf(name, size, "%s%s", ident, copy->suffix);
+	return name;
+}
+
+static struct mcc_ir_row *get_new_row(struct copy_data *copy, struct mcc_ir_row *row)
+{
+	for (unsigned i = 0; i < copy->num_rows; i++) {
+		if (copy->old_rows[i] == row)
+			return copy->new_rows[i];
+	}
+	return row;
+}
+
+static unsigned get_new_label(struct copy_data *copy, unsigned label)
+{
+	for (unsigned i = 0; i < copy->num_labels; i++) {
+		if (copy->old_labels[i] == label)
+			return copy->first_label + i;
+	}
+	return label;
+}
+
+// Rename a copied argument in place
+static bool rename_arg(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	char *name = NULL;
+	switch (arg->type) {
+	case MCC_IR_TYPE_IDENTIFIER:
+		name = rename_ident(copy, arg->ident);
+		if (!name)
+			return false;
+		free(arg->ident);
+		arg->ident = name;
+		return true;
+	case MCC_IR_TYPE_ARR_ELEM:
+		name = rename_ident(copy, arg->arr_ident);
+		if (!name)
+			return false;
+		free(arg->arr_ident);
+		arg->arr_ident = name;
+		return rename_arg(copy, arg->index);
+	case MCC_IR_TYPE_ROW:
+		arg->row = get_new_row(copy, arg->row);
+		return true;
+	case MCC_IR_TYPE_LABEL:
+		arg->label = get_new_label(copy, arg->label);
+		return true;
+	default:
+		return true;
+	}
+}
+
+static struct mcc_ir_arg *copy_renamed_arg(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_arg *new_arg = mcc_ir_copy_arg(arg);
+	if (new_arg && !rename_arg(copy, new_arg)) {
+		mcc_ir_delete_ir_arg(new_arg);
+		return NULL;
+	}
+	return new_arg;
+}
+
+//---------------------------------------------------------------------------------------- Copying
+
+static struct mcc_ir_row *new_row(struct mcc_ir_arg *arg1,
+                                  struct mcc_ir_arg *arg2,
+                                  enum mcc_ir_instruction instr,
+                                  struct mcc_ir_row_type *type,
+                                  bool args_ok)
+{
+	struct mcc_ir_row *row = NULL;
+	if (args_ok && type)
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+	}
+	return row;
+}
+
+static struct mcc_ir_row *copy_row(struct copy_data *copy, struct mcc_ir_row *row)
+{
+	struct mcc_ir_arg *arg1 = NULL;
+	// The called function is an identifier as well, but must keep its name
+	if (row->instr == MCC_IR_INSTR_CALL)
+		arg1 = mcc_ir_copy_arg(row->arg1);
+	else if (row->arg1)
+		arg1 = copy_renamed_arg(copy, row->arg1);
+	struct mcc_ir_arg *arg2 = row->arg2 ? copy_renamed_arg(copy, row->arg2) : NULL;
+	bool args_ok = (!row->arg1 || arg1) && (!row->arg2 || arg2);
+	return new_row(arg1, arg2, row->instr, mcc_ir_new_row_type(row->type->type, row->type->array_size), args_ok);
+}
+
+static struct mcc_ir_row *new_jump(unsigned label)
+{
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	return new_row(arg, NULL, MCC_IR_INSTR_JUMP, mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1), arg != NULL);
+}
+
+static struct mcc_ir_row *new_label(unsigned label)
+{
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	return new_row(arg, NULL, MCC_IR_INSTR_LABEL, mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1), arg != NULL);
+}
+
+static struct mcc_ir_row *new_assignment(char *ident, struct mcc_ir_arg *value, struct mcc_ir_row_type *type)
+{
+	struct mcc_ir_arg *variable = mcc_ir_new_arg_identifier(ident);
+	return new_row(variable, value, MCC_IR_INSTR_ASSIGN, type, variable && value);
+}
+
+// The parameters become variables that get the pushed values
+static bool copy_params(struct copy_data *copy, struct mcc_ir_row *position)
+{
+	for (unsigned i = 0; i < copy->callee->num_params; i++) {
+		struct mcc_ir_row *pop = get_param_pop(copy->callee, i);
+		if (pop->type->array_size >= 0)
+			continue;
+		struct mcc_ir_row *param = pop->next_row;
+		char *name = rename_ident(copy, param->arg1->ident);
+		struct mcc_ir_row *assign =
+		    name ? new_assignment(name, mcc_ir_copy_arg(copy->pushes[i]->arg1),
+		                          mcc_ir_new_row_type(param->type->type, param->type->array_size))
+		         : NULL;
+		free(name);
+		if (!assign)
+			return false;
+		mcc_ir_insert_row_before(position, assign);
+	}
+	return true;
+}
+
+static bool copy_return(struct copy_data *copy,
+                        struct mcc_ir_row *row,
+                        struct mcc_ir_row *call,
+                        struct mcc_ir_row *position)
+{
+	if (row->arg1 && call->type->type != MCC_IR_ROW_TYPELESS) {
+		struct mcc_ir_row *assign = new_assignment(copy->result, copy_renamed_arg(copy, row->arg1),
+		                                           mcc_ir_new_row_type(call->type->type, -1));
+		if (!assign)
+			return false;
+		mcc_ir_insert_row_before(position, assign);
+	}
+	// The last return falls through to the end of the copy
+	if (mcc_ir_is_function_end(row->next_row))
+		return true;
+	struct mcc_ir_row *jump = new_jump(copy->end_label);
+	if (!jump)
+		return false;
+	mcc_ir_insert_row_before(position, jump);
+	return true;
+}
+
+static bool copy_body(struct copy_data *copy, struct mcc_ir_row *call, struct mcc_ir_row *position)
+{
+	copy->num_rows = 0;
+	bool has_jump_to_end = false;
+	for (struct mcc_ir_row *row = get_body(copy->callee); !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_RETURN) {
+			if (!copy_return(copy, row, call, position))
+				return false;
+			has_jump_to_end = has_jump_to_end || !mcc_ir_is_function_end(row->next_row);
+			continue;
+		}
+		struct mcc_ir_row *new = copy_row(copy, row);
+		if (!new)
+			return false;
+		mcc_ir_insert_row_before(position, new);
+		copy->old_rows[copy->num_rows] = row;
+		copy->new_rows[copy->num_rows] = new;
+		copy->num_rows++;
+	}
+	if (has_jump_to_end) {
+		struct mcc_ir_row *label = new_label(copy->end_label);
+		if (!label)
+			return false;
+		mcc_ir_insert_row_before(position, label);
+	}
+	return true;
+}
+
+static bool collect_labels(struct copy_data *copy, struct mcc_ir_row *ir)
+{
+	copy->num_labels = 0;
+	for (struct mcc_ir_row *row = get_body(copy->callee); !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL)
+			copy->old_labels[copy->num_labels++] = row->arg1->label;
+	}
+	copy->first_label = mcc_ir_get_unused_label(ir);
+	copy->end_label = copy->first_label + copy->num_labels;
+	return true;
+}
+
+static bool set_up_copy(struct copy_data *copy, struct inline_data *data, struct mcc_ir_row *call)
+{
+	struct function_info *callee = copy->callee;
+	char *name = callee->label->arg1->func_label;
+	unsigned number = data->counter++;
+	size_t suffix_size = 16;
+	size_t result_size = strlen(name) + 16;
+
+	copy->pushes = malloc(sizeof(*copy->pushes) * (callee->num_params + 1));
+	copy->suffix = malloc(suffix_size);
+	copy->result = malloc(result_size);
+	copy->old_rows = malloc(sizeof(*copy->old_rows) * (callee->size + 1));
+	copy->new_rows = malloc(sizeof(*copy->new_rows) * (callee->size + 1));
+	copy->old_labels = malloc(sizeof(*copy->old_labels) * (callee->size + 1));
+	if (!copy->pushes || !copy->suffix || !copy->result || !copy->old_rows || !copy->new_rows || !copy->old_labels)
+		return false;
+
+	snprintf(copy->suffix, suffix_size, ".i%u", number);
+	snprintf(copy->result, result_size, "%s.r%u", name, number);
+
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < callee->num_params; i++) {
+		copy->pushes[i] = push;
+		push = push->prev_row;
+	}
+	return collect_labels(copy, call);
+}
+
+static void delete_copy(struct copy_data *copy)
+{
+	free(copy->pushes);
+	free(copy->suffix);
+	free(copy->result);
+	free(copy->old_rows);
+	free(copy->new_rows);
+	free(copy->old_labels);
+}
+
+//---------------------------------------------------------------------------------------- Inlining
+
+// Arguments are pushed in reverse order right before the call
+static bool has_matching_pushes(struct function_info *callee, struct mcc_ir_row *call)
+{
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < callee->num_params; i++) {
+		if (!push || push->instr != MCC_IR_INSTR_PUSH)
+			return false;
+		// Array parameters are replaced by the name of the passed array
+		if (get_param_pop(callee, i)->type->array_size >= 0 && push->arg1->type != MCC_IR_TYPE_IDENTIFIER)
+			return false;
+		push = push->prev_row;
+	}
+	return true;
+}
+
+// Returns 1 if the call was inlined, 0 if it cannot be inlined and -1 if memory allocation fails
+static int inline_call(struct inline_data *data, struct mcc_ir_row *call, struct function_info *callee)
+{
+	if (!has_matching_pushes(callee, call))
+		return 0;
+
+	struct copy_data copy = {.callee = callee};
+	struct mcc_ir_row *first_push = call;
+	for (unsigned i = 0; i < callee->num_params; i++) {
+		first_push = first_push->prev_row;
+	}
+
+	bool ok = set_up_copy(&copy, data, call) && copy_params(&copy, first_push) &&
+	          copy_body(&copy, call, first_push);
+	if (ok && call->type->type != MCC_IR_ROW_TYPELESS) {
+		struct mcc_ir_arg *result = mcc_ir_new_arg_identifier(copy.result);
+		ok = result && mcc_ir_replace_row_uses(call->next_row, call, result);
+		mcc_ir_delete_ir_arg(result);
+	}
+	delete_copy(&copy);
+	if (!ok)
+		return -1;
+
+	for (unsigned i = 0; i < callee->num_params; i++) {
+		struct mcc_ir_row *push = call->prev_row;
+		mcc_ir_unlink_row(push);
+		mcc_ir_delete_ir_row(push);
+	}
+	mcc_ir_unlink_row(call);
+	mcc_ir_delete_ir_row(call);
+	return 1;
+}
+
+// Inline the first call that qualifies. Returns 1 if a call was inlined, 0 if there is none, -1 on failure.
+static int inline_next_call(struct mcc_ir_row *ir, struct inline_data *data)
+{
+	struct function_info *caller = NULL;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL) {
+			caller = find_function(data, row->arg1->func_label);
+			continue;
+		}
+		if (row->instr != MCC_IR_INSTR_CALL)
+			continue;
+		struct function_info *callee = find_function(data, row->arg1->func_label);
+		if (!should_inline(data, caller, callee, row))
+			continue;
+		int inlined = inline_call(data, row, callee);
+		if (inlined != 0)
+			return inlined;
+	}
+	return 0;
+}
+
+bool mcc_inline_run(struct mcc_ir_row *ir, unsigned limit)
+{
+	assert(ir);
+
+	if (limit == 0)
+		return true;
+
+	struct inline_data data = {.limit = limit, .counter = 0};
+	if (!collect_functions(ir, &data) || !mark_recursive_functions(&data)) {
+		free(data.functions);
+		return false;
+	}
+
+	// Sizes and numbers of calls change with every inlined call
+	int inlined = 1;
+	while (inlined > 0) {
+		update_function_info(ir, &data);
+		inlined = inline_next_call(ir, &data);
+	}
+	free(data.functions);
+	mcc_ir_number_rows(ir);
+	return inlined == 0;
+}
@@ -85,6 +85,7 @@ new_ir_row_type(enum mcc_ir_row_types row_type, signed size, struct ir_generatio
 	}
 	type->type = row_type;
 	type->array_size = size;
+	type->lanes = 1;
 	return type;
 }
 
@@ -260,6 +261,7 @@ static struct mcc_ir_row *new_row(struct mcc_ir_arg *arg1,
 	row->arg2 = arg2;
 	row->instr = instr;
 	row->type = type;
+	row->profile_count = -1;
 	row->next_row = NULL;
 	row->prev_row = NULL;
 	return row;
@@ -435,6 +437,47 @@ static struct mcc_ir_arg *copy_label_arg(struct mcc_ir_arg *arg, struct ir_gener
 	return new;
 }
 
+static struct mcc_ir_arg *copy_arg(struct mcc_ir_arg *arg, struct ir_generation_userdata *data);
+
+static struct mcc_ir_arg *copy_arr_elem_arg(struct mcc_ir_arg *arg, struct ir_generation_userdata *data)
+{
+	assert(arg);
+	assert(data);
+
+	struct mcc_ir_arg *new = malloc(sizeof(*new));
+	char *str = strdup(arg->arr_ident);
+	struct mcc_ir_arg *index = copy_arg(arg->index, data);
+	if (!new || !str || !index) {
+		data->has_failed = true;
+		free(new);
+		free(str);
+		mcc_ir_delete_ir_arg(index);
+		return NULL;
+	}
+	new->type = MCC_IR_TYPE_ARR_ELEM;
+	new->arr_ident = str;
+	new->index = index;
+	return new;
+}
+
+static struct mcc_ir_arg *copy_func_label_arg(struct mcc_ir_arg *arg, struct ir_generation_userdata *data)
+{
+	assert(arg);
+	assert(data);
+
+	struct mcc_ir_arg *new = malloc(sizeof(*new));
+	char *str = strdup(arg->func_label);
+	if (!new || !str) {
+		data->has_failed = true;
+		free(new);
+		free(str);
+		return NULL;
+	}
+	new->type = MCC_IR_TYPE_FUNC_LABEL;
+	new->func_label = str;
+	return new;
+}
+
 static struct mcc_ir_arg *copy_arg(struct mcc_ir_arg *arg, struct ir_generation_userdata *data)
 {
 	if (data->has_failed)
@@ -458,6 +501,10 @@ static struct mcc_ir_arg *copy_arg(struct mcc_ir_arg *arg, struct ir_generation_
 		return copy_label_arg(arg, data);
 	case MCC_IR_TYPE_ROW:
 		return new_arg_row(arg->row, data);
+	case MCC_IR_TYPE_ARR_ELEM:
+		return copy_arr_elem_arg(arg, data);
+	case MCC_IR_TYPE_FUNC_LABEL:
+		return copy_func_label_arg(arg, data);
 	default:
 		return NULL;
 	}
@@ -465,6 +512,12 @@ static struct mcc_ir_arg *copy_arg(struct mcc_ir_arg *arg, struct ir_generation_
 
 //------------------------------------------------------------------------------ IR generation
 
+static bool is_short_circuit(struct mcc_ast_expression *expression)
+{
+	return expression->type == MCC_AST_EXPRESSION_TYPE_BINARY_OP &&
+	       (expression->op == MCC_AST_BINARY_OP_CONJ || expression->op == MCC_AST_BINARY_OP_DISJ);
+}
+
 static struct mcc_ir_row_type *
 st_row_to_ir_type(struct mcc_symbol_table_row *row, int array_size, struct ir_generation_userdata *data)
 {
@@ -514,6 +567,12 @@ ident_to_ir_type(struct mcc_ir_arg *arg, struct mcc_ast_expression *exp, struct
 	if (strncmp(arg->ident, "$tmp", 4) == 0) {
 		return new_ir_row_type(MCC_IR_ROW_FLOAT, -1, data);
 	}
+	while (exp->type == MCC_AST_EXPRESSION_TYPE_PARENTH)
+		exp = exp->expression;
+	// result variable of && and ||
+	if (is_short_circuit(exp)) {
+		return new_ir_row_type(MCC_IR_ROW_BOOL, -1, data);
+	}
 	struct mcc_symbol_table_row *row = NULL;
 	if (exp->type == MCC_AST_EXPRESSION_TYPE_VARIABLE) {
 		row = mcc_symbol_table_check_upwards_for_declaration(arg->ident, exp->variable_row);
@@ -558,6 +617,79 @@ get_type_of_row(struct mcc_ir_arg *arg, struct mcc_ast_expression *exp, struct i
 	return NULL;
 }
 
+// The right operand of && and || is only evaluated if the left one does not decide the result. A condition jumps to
+// false_label if it is false and falls through otherwise.
+static void generate_condition(struct mcc_ast_expression *condition,
+                               struct mcc_ir_arg *false_label,
+                               struct ir_generation_userdata *data)
+{
+	assert(condition);
+	assert(data);
+	if (data->has_failed)
+		return;
+
+	if (condition->type == MCC_AST_EXPRESSION_TYPE_PARENTH) {
+		generate_condition(condition->expression, false_label, data);
+		return;
+	}
+
+	if (is_short_circuit(condition) && condition->op == MCC_AST_BINARY_OP_CONJ) {
+		generate_condition(condition->lhs, false_label, data);
+		generate_condition(condition->rhs, false_label, data);
+		return;
+	}
+
+	if (is_short_circuit(condition)) {
+		// Lhs false: evaluate rhs at rhs_label, lhs true: skip rhs
+		struct mcc_ir_arg *rhs_label = new_arg_label(data);
+		struct mcc_ir_arg *true_label = new_arg_label(data);
+		if (!rhs_label || !true_label) {
+			mcc_ir_delete_ir_arg(rhs_label);
+			mcc_ir_delete_ir_arg(true_label);
+			return;
+		}
+		generate_condition(condition->lhs, rhs_label, data);
+		struct mcc_ir_row *jump_row = new_row(true_label, NULL, MCC_IR_INSTR_JUMP, typeless(data), data);
+		append_row(jump_row, data);
+		struct mcc_ir_row *rhs_row = new_row(rhs_label, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+		append_row(rhs_row, data);
+		generate_condition(condition->rhs, false_label, data);
+		struct mcc_ir_row *true_row =
+		    new_row(copy_arg(true_label, data), NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+		append_row(true_row, data);
+		return;
+	}
+
+	struct mcc_ir_arg *cond = mcc_ir_generate_expression(condition, data);
+	struct mcc_ir_row *jumpfalse =
+	    new_row(cond, copy_arg(false_label, data), MCC_IR_INSTR_JUMPFALSE, typeless(data), data);
+	append_row(jumpfalse, data);
+}
+
+// The value of && and || is held in a variable, which is false unless the condition falls through
+static struct mcc_ir_arg *generate_short_circuit_value(struct mcc_ast_expression *expression,
+                                                      struct ir_generation_userdata *data)
+{
+	struct mcc_ir_arg *end_label = new_arg_label(data);
+	if (!end_label)
+		return NULL;
+	unsigned size = 3 + length_of_int(end_label->label) + 1;
+	char ident[size];
+	snprintf(ident, size, "sc.%u", end_label->label);
+
+	struct mcc_ir_row *false_row = new_row(new_arg_identifier_from_string(ident, data), new_arg_bool(false, data),
+	                                       MCC_IR_INSTR_ASSIGN, new_ir_row_type(MCC_IR_ROW_BOOL, -1, data), data);
+	append_row(false_row, data);
+	generate_condition(expression, end_label, data);
+	struct mcc_ir_row *true_row = new_row(new_arg_identifier_from_string(ident, data), new_arg_bool(true, data),
+	                                      MCC_IR_INSTR_ASSIGN, new_ir_row_type(MCC_IR_ROW_BOOL, -1, data), data);
+	append_row(true_row, data);
+	struct mcc_ir_row *end_row = new_row(end_label, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+	append_row(end_row, data);
+
+	return new_arg_identifier_from_string(ident, data);
+}
+
 struct mcc_ir_arg *mcc_ir_generate_expression_binary_op(struct mcc_ast_expression *expression,
                                                         struct ir_generation_userdata *data)
 {
@@ -565,6 +697,9 @@ struct mcc_ir_arg *mcc_ir_generate_expression_binary_op(struct mcc_ast_expressio
 	assert(expression->rhs);
 	assert(data);
 
+	if (is_short_circuit(expression))
+		return generate_short_circuit_value(expression, data);
+
 	struct mcc_ir_arg *lhs = mcc_ir_generate_expression(expression->lhs, data);
 	struct mcc_ir_arg *rhs = mcc_ir_generate_expression(expression->rhs, data);
 
@@ -645,6 +780,11 @@ struct mcc_ir_arg *mcc_ir_generate_expression_unary_op(struct mcc_ast_expression
 
 	switch (expression->u_op) {
 	case MCC_AST_UNARY_OP_NEGATIV:
+		// Negative int literals stay literals, so that constant operands see them
+		if (child->type == MCC_IR_TYPE_LIT_INT) {
+			child->lit_int = -child->lit_int;
+			return child;
+		}
 		instr = MCC_IR_INSTR_NEGATIV;
 		type = get_type_of_row(child, expression->child, data);
 		break;
@@ -839,13 +979,11 @@ void mcc_ir_generate_statememt_while_stmt(struct mcc_ast_statement *stmt, struct
 	struct mcc_ir_row *label_row = new_row(l0, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
 	append_row(label_row, data);
 
-	// Condition
-	struct mcc_ir_arg *cond = mcc_ir_generate_expression(stmt->if_condition, data);
-
-	// Jumpfalse L1
+	// Condition, jumpfalse L1
 	struct mcc_ir_arg *l1 = new_arg_label(data);
-	struct mcc_ir_row *jumpfalse = new_row(cond, l1, MCC_IR_INSTR_JUMPFALSE, typeless(data), data);
-	append_row(jumpfalse, data);
+	if (!l1)
+		return;
+	generate_condition(stmt->if_condition, l1, data);
 
 	// On true
 	mcc_ir_generate_statement(stmt->while_on_true, data);
@@ -855,7 +993,7 @@ void mcc_ir_generate_statememt_while_stmt(struct mcc_ast_statement *stmt, struct
 	append_row(jump_row, data);
 
 	// Label L1
-	struct mcc_ir_row *label_row_2 = new_row(copy_arg(l1, data), NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+	struct mcc_ir_row *label_row_2 = new_row(l1, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
 	append_row(label_row_2, data);
 }
 
@@ -864,15 +1002,11 @@ void mcc_ir_generate_statememt_if_else_stmt(struct mcc_ast_statement *stmt, stru
 	if (data->has_failed)
 		return;
 
-	// Condition
-	struct mcc_ir_arg *cond = mcc_ir_generate_expression(stmt->if_condition, data);
-
-	// Jumpfalse L1
+	// Condition, jumpfalse L1
 	struct mcc_ir_arg *l1 = new_arg_label(data);
 	if (!l1)
 		return;
-	struct mcc_ir_row *jumpfalse = new_row(cond, l1, MCC_IR_INSTR_JUMPFALSE, typeless(data), data);
-	append_row(jumpfalse, data);
+	generate_condition(stmt->if_condition, l1, data);
 
 	// If true
 	mcc_ir_generate_statement(stmt->if_else_on_true, data);
@@ -890,7 +1024,7 @@ void mcc_ir_generate_statememt_if_else_stmt(struct mcc_ast_statement *stmt, stru
 	}
 
 	// Label L1
-	struct mcc_ir_row *label_row = new_row(copy_arg(l1, data), NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+	struct mcc_ir_row *label_row = new_row(l1, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
 	append_row(label_row, data);
 
 	// If false
@@ -910,14 +1044,12 @@ void mcc_ir_generate_statememt_if_stmt(struct mcc_ast_statement *stmt, struct ir
 {
 	if (data->has_failed)
 		return;
-	struct mcc_ir_arg *cond = mcc_ir_generate_expression(stmt->if_condition, data);
 	struct mcc_ir_arg *label = new_arg_label(data);
 	if (!label)
 		return;
-	struct mcc_ir_row *jumpfalse = new_row(cond, label, MCC_IR_INSTR_JUMPFALSE, typeless(data), data);
-	append_row(jumpfalse, data);
+	generate_condition(stmt->if_condition, label, data);
 	mcc_ir_generate_statement(stmt->if_on_true, data);
-	struct mcc_ir_row *label_row = new_row(copy_arg(label, data), NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
+	struct mcc_ir_row *label_row = new_row(label, NULL, MCC_IR_INSTR_LABEL, typeless(data), data);
 	append_row(label_row, data);
 }
 
@@ -1283,6 +1415,82 @@ static void modify_ast(struct mcc_ast_program *ast, struct ir_generation_userdat
 	free(re_data);
 }
 
+// --------------------------------------------------------------------------------------- Bool array elements
+
+// Elements of bool arrays take a byte or a bit instead of a stack slot (see stack_size.h), so only assignments move
+// them from and to variables. Other rows read the element from a temporary assigned right in front of them. The
+// pushes of a call follow each other, so the temporaries of arguments are assigned in front of the first push.
+
+// Local arrays are declared by an array row, array parameters by the assignment behind their pop
+static bool is_bool_array_declaration(struct mcc_ir_row *row, char *array)
+{
+	if (row->instr != MCC_IR_INSTR_ARRAY && (row->instr != MCC_IR_INSTR_ASSIGN || row->type->array_size < 0))
+		return false;
+	return row->type->type == MCC_IR_ROW_BOOL && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+	       strcmp(row->arg1->ident, array) == 0;
+}
+
+static bool is_bool_element(struct mcc_ir_row *function_label, struct mcc_ir_arg *arg)
+{
+	if (!arg || arg->type != MCC_IR_TYPE_ARR_ELEM)
+		return false;
+	for (struct mcc_ir_row *row = function_label->next_row; row && row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     row = row->next_row) {
+		if (is_bool_array_declaration(row, arg->arr_ident))
+			return true;
+	}
+	return false;
+}
+
+static void
+load_into_temporary(struct mcc_ir_row *position, struct mcc_ir_arg **arg, struct ir_generation_userdata *data)
+{
+	unsigned size = 4 + length_of_int(data->tmp_counter) + 1;
+	char *ident = malloc(sizeof(char) * size);
+	if (!ident) {
+		data->has_failed = true;
+		return;
+	}
+	snprintf(ident, size, "$tmp%d", data->tmp_counter);
+	data->tmp_counter++;
+	struct mcc_ir_arg *tmp = new_arg_identifier_from_string(ident, data);
+	struct mcc_ir_arg *read = new_arg_identifier_from_string(ident, data);
+	free(ident);
+	struct mcc_ir_row_type *type = new_ir_row_type(MCC_IR_ROW_BOOL, -1, data);
+	struct mcc_ir_row *row = new_row(tmp, *arg, MCC_IR_INSTR_ASSIGN, type, data);
+	if (!row) {
+		mcc_ir_delete_ir_arg(tmp);
+		mcc_ir_delete_ir_arg(read);
+		mcc_ir_delete_ir_row_type(type);
+		return;
+	}
+	mcc_ir_insert_row_before(position, row);
+	*arg = read;
+}
+
+static void load_bool_elements(struct ir_generation_userdata *data)
+{
+	struct mcc_ir_row *function_label = NULL;
+	for (struct mcc_ir_row *row = data->head; row && !data->has_failed; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL) {
+			function_label = row;
+			continue;
+		}
+		// An assignment moves an element from or to a variable, but not from one element to another
+		bool is_assignment = row->instr == MCC_IR_INSTR_ASSIGN;
+		if (is_assignment && !is_bool_element(function_label, row->arg1))
+			continue;
+
+		struct mcc_ir_row *position = row;
+		while (position->instr == MCC_IR_INSTR_PUSH && position->prev_row->instr == MCC_IR_INSTR_PUSH)
+			position = position->prev_row;
+		if (!is_assignment && is_bool_element(function_label, row->arg1))
+			load_into_temporary(position, &row->arg1, data);
+		if (is_bool_element(function_label, row->arg2))
+			load_into_temporary(position, &row->arg2, data);
+	}
+}
+
 struct mcc_ir_row *mcc_ir_generate(struct mcc_ast_program *ast)
 {
 	struct ir_generation_userdata *data = malloc(sizeof(*data));
@@ -1308,6 +1516,7 @@ struct mcc_ir_row *mcc_ir_generate(struct mcc_ast_program *ast)
 		mcc_ir_generate_program(ast, data);
 		ast = ast->next_function;
 	}
+	load_bool_elements(data);
 
 	if (data->has_failed) {
 		mcc_ir_delete_ir(data->head);
@@ -1322,6 +1531,221 @@ struct mcc_ir_row *mcc_ir_generate(struct mcc_ast_program *ast)
 	return head;
 }
 
+//---------------------------------------------------------------------------------------- Modify IR
+
+struct mcc_ir_row_type *mcc_ir_new_row_type(enum mcc_ir_row_types row_type, signed array_size)
+{
+	struct ir_generation_userdata data = {.has_failed = false};
+	return new_ir_row_type(row_type, array_size, &data);
+}
+
+struct mcc_ir_row *mcc_ir_new_row(struct mcc_ir_arg *arg1,
+                                  struct mcc_ir_arg *arg2,
+                                  enum mcc_ir_instruction instr,
+                                  struct mcc_ir_row_type *type)
+{
+	struct ir_generation_userdata data = {.has_failed = false};
+	return new_row(arg1, arg2, instr, type, &data);
+}
+
+struct mcc_ir_arg *mcc_ir_new_arg_row(struct mcc_ir_row *row)
+{
+	struct ir_generation_userdata data = {.has_failed = false};
+	return new_arg_row(row, &data);
+}
+
+struct mcc_ir_arg *mcc_ir_new_arg_label(unsigned label)
+{
+	struct ir_generation_userdata data = {.has_failed = false, .label_counter = label};
+	return new_arg_label(&data);
+}
+
+struct mcc_ir_arg *mcc_ir_new_arg_int(long lit)
+{
+	struct ir_generation_userdata data = {.has_failed = false};
+	return new_arg_int(lit, &data);
+}
+
+struct mcc_ir_arg *mcc_ir_new_arg_identifier(char *ident)
+{
+	assert(ident);
+	struct ir_generation_userdata data = {.has_failed = false};
+	return new_arg_identifier_from_string(ident, &data);
+}
+
+struct mcc_ir_arg *mcc_ir_new_arg_array_element(char *ident, struct mcc_ir_arg *index)
+{
+	assert(ident);
+	assert(index);
+
+	struct mcc_ir_arg *new = malloc(sizeof(*new));
+	char *str = strdup(ident);
+	if (!new || !str) {
+		free(new);
+		free(str);
+		return NULL;
+	}
+	new->type = MCC_IR_TYPE_ARR_ELEM;
+	new->arr_ident = str;
+	new->index = index;
+	return new;
+}
+
+struct mcc_ir_arg *mcc_ir_copy_arg(struct mcc_ir_arg *arg)
+{
+	assert(arg);
+	struct ir_generation_userdata data = {.has_failed = false};
+	return copy_arg(arg, &data);
+}
+
+void mcc_ir_insert_row_before(struct mcc_ir_row *position, struct mcc_ir_row *row)
+{
+	assert(position);
+	assert(row);
+
+	row->prev_row = position->prev_row;
+	row->next_row = position;
+	if (position->prev_row)
+		position->prev_row->next_row = row;
+	position->prev_row = row;
+}
+
+void mcc_ir_insert_row_after(struct mcc_ir_row *position, struct mcc_ir_row *row)
+{
+	assert(position);
+	assert(row);
+
+	row->prev_row = position;
+	row->next_row = position->next_row;
+	if (position->next_row)
+		position->next_row->prev_row = row;
+	position->next_row = row;
+}
+
+void mcc_ir_unlink_row(struct mcc_ir_row *row)
+{
+	assert(row);
+
+	if (row->prev_row)
+		row->prev_row->next_row = row->next_row;
+	if (row->next_row)
+		row->next_row->prev_row = row->prev_row;
+	row->prev_row = NULL;
+	row->next_row = NULL;
+}
+
+static bool replace_row_use(struct mcc_ir_arg **use, struct mcc_ir_row *row, struct mcc_ir_arg *arg)
+{
+	if (!*use)
+		return true;
+	if ((*use)->type == MCC_IR_TYPE_ARR_ELEM)
+		return replace_row_use(&(*use)->index, row, arg);
+	if ((*use)->type != MCC_IR_TYPE_ROW || (*use)->row != row)
+		return true;
+
+	struct mcc_ir_arg *copy = mcc_ir_copy_arg(arg);
+	if (!copy)
+		return false;
+	mcc_ir_delete_ir_arg(*use);
+	*use = copy;
+	return true;
+}
+
+bool mcc_ir_is_function_end(struct mcc_ir_row *row)
+{
+	return !row || row->instr == MCC_IR_INSTR_FUNC_LABEL;
+}
+
+bool mcc_ir_is_compare(struct mcc_ir_row *row)
+{
+	switch (row->instr) {
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+		return true;
+	default:
+		return false;
+	}
+}
+
+enum mcc_ir_instruction mcc_ir_invert_compare(enum mcc_ir_instruction instr)
+{
+	switch (instr) {
+	case MCC_IR_INSTR_EQUALS:
+		return MCC_IR_INSTR_NOTEQUALS;
+	case MCC_IR_INSTR_NOTEQUALS:
+		return MCC_IR_INSTR_EQUALS;
+	case MCC_IR_INSTR_SMALLER:
+		return MCC_IR_INSTR_GREATEREQ;
+	case MCC_IR_INSTR_GREATER:
+		return MCC_IR_INSTR_SMALLEREQ;
+	case MCC_IR_INSTR_SMALLEREQ:
+		return MCC_IR_INSTR_GREATER;
+	default:
+		assert(instr == MCC_IR_INSTR_GREATEREQ);
+		return MCC_IR_INSTR_SMALLER;
+	}
+}
+
+bool mcc_ir_uses_row(struct mcc_ir_row *user, struct mcc_ir_row *row)
+{
+	struct mcc_ir_arg *args[] = {user->arg1, user->arg2};
+	for (unsigned i = 0; i < 2; i++) {
+		struct mcc_ir_arg *arg = args[i];
+		if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+			arg = arg->index;
+		if (mcc_ir_is_row(arg, row))
+			return true;
+	}
+	return false;
+}
+
+bool mcc_ir_is_identifier(struct mcc_ir_arg *arg, char *ident)
+{
+	return arg && arg->type == MCC_IR_TYPE_IDENTIFIER && strcmp(arg->ident, ident) == 0;
+}
+
+bool mcc_ir_is_row(struct mcc_ir_arg *arg, struct mcc_ir_row *row)
+{
+	return arg && arg->type == MCC_IR_TYPE_ROW && arg->row == row;
+}
+
+bool mcc_ir_replace_row_uses(struct mcc_ir_row *head, struct mcc_ir_row *row, struct mcc_ir_arg *arg)
+{
+	assert(row);
+	assert(arg);
+
+	for (; head; head = head->next_row) {
+		if (!replace_row_use(&head->arg1, row, arg) || !replace_row_use(&head->arg2, row, arg))
+			return false;
+	}
+	return true;
+}
+
+unsigned mcc_ir_get_unused_label(struct mcc_ir_row *row)
+{
+	assert(row);
+
+	while (row->prev_row) {
+		row = row->prev_row;
+	}
+	unsigned label = 0;
+	for (; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label >= label) {
+			label = row->arg1->label + 1;
+		}
+	}
+	return label;
+}
+
+void mcc_ir_number_rows(struct mcc_ir_row *head)
+{
+	number_rows(head);
+}
+
 //---------------------------------------------------------------------------------------- Cleanup
 
 void mcc_ir_delete_ir_arg(struct mcc_ir_arg *arg)
@@ -48,6 +48,7 @@ void mcc_ir_print_ir_row(FILE *out, struct mcc_ir_row *row, bool escape_quotes,
 	case MCC_IR_INSTR_JUMPFALSE:
 	case MCC_IR_INSTR_PUSH:
 	case MCC_IR_INSTR_RETURN:
+	case MCC_IR_INSTR_COUNT:
 		fprintf(out, "\t");
 		fprintf(out, "%s ", instr_to_string(row->instr));
 		print_arg(out, row->arg1, escape_quotes, doubly_escaped);
@@ -94,6 +95,8 @@ void mcc_ir_print_ir_row(FILE *out, struct mcc_ir_row *row, bool escape_quotes,
 	case MCC_IR_INSTR_MULTIPLY:
 	case MCC_IR_INSTR_OR:
 	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MIN:
+	case MCC_IR_INSTR_MAX:
 		fprintf(out, "\t");
 		fprintf(out, "$t%d = ", row->row_no);
 		print_arg(out, row->arg1, escape_quotes, doubly_escaped);
@@ -148,6 +151,8 @@ static void print_type(FILE *out, struct mcc_ir_row_type *type)
 		is_array = true;
 		fprintf(out, "[%d]", type->array_size);
 	}
+	if (type->lanes > 1)
+		fprintf(out, " x%u", type->lanes);
 	fprintf(out, ")");
 	// Fix alignment
 	if (type->type != MCC_IR_ROW_STRING)
@@ -200,8 +205,14 @@ char *instr_to_string(enum mcc_ir_instruction instr)
 		return "-";
 	case MCC_IR_INSTR_NOT:
 		return "!";
+	case MCC_IR_INSTR_MIN:
+		return "min";
+	case MCC_IR_INSTR_MAX:
+		return "max";
 	case MCC_IR_INSTR_RETURN:
 		return "return";
+	case MCC_IR_INSTR_COUNT:
+		return "count";
 	default:
 		return "";
 	}
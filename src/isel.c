@@ -0,0 +1,247 @@
+#include "mcc/isel.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#define NO_COST UINT_MAX
+
+//---------------------------------------------------------------------------------------- Functions: Trees
+
+bool mcc_isel_is_tree_row(struct mcc_ir_row *row)
+{
+	assert(row);
+
+	if (!row->type || row->type->type != MCC_IR_ROW_INT || row->type->lanes != 1)
+		return false;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static struct mcc_isel_node *new_node(enum mcc_isel_symbol symbol)
+{
+	struct mcc_isel_node *node = malloc(sizeof(*node));
+	if (!node)
+		return NULL;
+	node->symbol = symbol;
+	node->row = NULL;
+	node->arg = NULL;
+	node->kids[0] = NULL;
+	node->kids[1] = NULL;
+	node->need = 1;
+	for (unsigned i = 0; i < MCC_ISEL_NUM_LEAVES; i++) {
+		node->cost[i] = NO_COST;
+		node->rule[i] = NULL;
+	}
+	return node;
+}
+
+struct mcc_isel_node *mcc_isel_new_row_node(struct mcc_ir_row *row)
+{
+	assert(mcc_isel_is_tree_row(row));
+
+	enum mcc_isel_symbol symbol = MCC_ISEL_PLUS;
+	if (row->instr == MCC_IR_INSTR_MINUS)
+		symbol = MCC_ISEL_MINUS;
+	else if (row->instr == MCC_IR_INSTR_MULTIPLY)
+		symbol = MCC_ISEL_MULTIPLY;
+	struct mcc_isel_node *node = new_node(symbol);
+	if (node)
+		node->row = row;
+	return node;
+}
+
+struct mcc_isel_node *mcc_isel_new_leaf(struct mcc_ir_arg *arg)
+{
+	assert(arg);
+
+	struct mcc_isel_node *node = new_node(arg->type == MCC_IR_TYPE_LIT_INT ? MCC_ISEL_IMM : MCC_ISEL_MEM);
+	if (node)
+		node->arg = arg;
+	return node;
+}
+
+void mcc_isel_set_kids(struct mcc_isel_node *node, struct mcc_isel_node *left, struct mcc_isel_node *right)
+{
+	assert(node);
+	assert(left);
+	assert(right);
+
+	bool is_commutative = node->symbol == MCC_ISEL_PLUS || node->symbol == MCC_ISEL_MULTIPLY;
+	bool swap = left->symbol == MCC_ISEL_IMM && right->symbol != MCC_ISEL_IMM;
+	// Products are added with leal
+	if (node->symbol == MCC_ISEL_PLUS && left->symbol == MCC_ISEL_MULTIPLY && right->symbol != MCC_ISEL_MULTIPLY)
+		swap = true;
+	if (is_commutative && swap) {
+		struct mcc_isel_node *kid = left;
+		left = right;
+		right = kid;
+	}
+	node->kids[0] = left;
+	node->kids[1] = right;
+
+	// The kid that needs more registers is computed first and holds one while the other is computed
+	if (left->need == right->need)
+		node->need = left->need + 1;
+	else
+		node->need = left->need > right->need ? left->need : right->need;
+}
+
+void mcc_isel_delete_tree(struct mcc_isel_node *tree)
+{
+	if (!tree)
+		return;
+	mcc_isel_delete_tree(tree->kids[0]);
+	mcc_isel_delete_tree(tree->kids[1]);
+	free(tree);
+}
+
+//------------------------------------------------------------------------------------ Functions: Labelling
+
+static bool is_leaf_symbol(enum mcc_isel_symbol symbol)
+{
+	return symbol < MCC_ISEL_NUM_LEAVES;
+}
+
+static bool is_power_of_two(long value)
+{
+	return value > 1 && value <= INT_MAX && (value & (value - 1)) == 0;
+}
+
+static bool is_lea_factor(long value)
+{
+	return value == 3 || value == 5 || value == 9;
+}
+
+static void label_literal(struct mcc_isel_node *node)
+{
+	long value = node->arg->lit_int;
+	node->cost[MCC_ISEL_IMM] = 0;
+	if (value == 1)
+		node->cost[MCC_ISEL_ONE] = 0;
+	if (is_power_of_two(value))
+		node->cost[MCC_ISEL_POW2] = 0;
+	if (value == 2 || value == 4 || value == 8)
+		node->cost[MCC_ISEL_SCALE] = 0;
+	if (is_lea_factor(value))
+		node->cost[MCC_ISEL_LEA] = 0;
+	for (long factor = 3; factor <= 9; factor = factor * 2 - 1) {
+		if (value % factor == 0 && is_power_of_two(value / factor))
+			node->cost[MCC_ISEL_LEA_POW2] = 0;
+	}
+	if (is_power_of_two(value - 1))
+		node->cost[MCC_ISEL_POW2_INC] = 0;
+	if (value > 2 && is_power_of_two(value + 1))
+		node->cost[MCC_ISEL_POW2_DEC] = 0;
+	if (value == -1)
+		node->cost[MCC_ISEL_NEG_ONE] = 0;
+	if (is_power_of_two(-value))
+		node->cost[MCC_ISEL_NEG_POW2] = 0;
+	if (is_lea_factor(-value))
+		node->cost[MCC_ISEL_NEG_LEA] = 0;
+}
+
+// Matches the pattern of the rule from *position on against the node and adds up the costs of the leaves. The
+// matched leaves are appended to leaves if it is not NULL.
+static bool match(const struct mcc_isel_rule *rule,
+                  unsigned *position,
+                  struct mcc_isel_node *node,
+                  unsigned *cost,
+                  struct mcc_isel_node **leaves,
+                  enum mcc_isel_symbol *symbols,
+                  unsigned *num_leaves)
+{
+	enum mcc_isel_symbol symbol = rule->pattern[(*position)++];
+	if (is_leaf_symbol(symbol)) {
+		if (node->cost[symbol] == NO_COST)
+			return false;
+		*cost += node->cost[symbol];
+		if (leaves) {
+			leaves[*num_leaves] = node;
+			symbols[*num_leaves] = symbol;
+		}
+		(*num_leaves)++;
+		return true;
+	}
+	if (node->symbol != symbol)
+		return false;
+	return match(rule, position, node->kids[0], cost, leaves, symbols, num_leaves) &&
+	       match(rule, position, node->kids[1], cost, leaves, symbols, num_leaves);
+}
+
+static bool is_chain_rule(const struct mcc_isel_rule *rule)
+{
+	return rule->pattern_length == 1;
+}
+
+static void record(struct mcc_isel_node *node, const struct mcc_isel_rule *rule, unsigned cost, bool *changed)
+{
+	if (cost < node->cost[rule->lhs]) {
+		node->cost[rule->lhs] = cost;
+		node->rule[rule->lhs] = rule;
+		*changed = true;
+	}
+}
+
+static void label_node(struct mcc_isel_node *node)
+{
+	if (node->symbol == MCC_ISEL_MEM)
+		node->cost[MCC_ISEL_MEM] = 0;
+	else if (node->symbol == MCC_ISEL_IMM)
+		label_literal(node);
+
+	bool changed = false;
+	for (unsigned i = 0; i < mcc_isel_num_rules; i++) {
+		const struct mcc_isel_rule *rule = &mcc_isel_rules[i];
+		unsigned position = 0;
+		unsigned cost = rule->cost;
+		unsigned num_leaves = 0;
+		if (!is_chain_rule(rule) && match(rule, &position, node, &cost, NULL, NULL, &num_leaves))
+			record(node, rule, cost, &changed);
+	}
+
+	// Chain rules derive nonterminals from each other until no cost gets lower
+	do {
+		changed = false;
+		for (unsigned i = 0; i < mcc_isel_num_rules; i++) {
+			const struct mcc_isel_rule *rule = &mcc_isel_rules[i];
+			enum mcc_isel_symbol from = rule->pattern[0];
+			if (is_chain_rule(rule) && node->cost[from] != NO_COST)
+				record(node, rule, node->cost[from] + rule->cost, &changed);
+		}
+	} while (changed);
+}
+
+bool mcc_isel_label(struct mcc_isel_node *tree)
+{
+	assert(tree);
+
+	for (unsigned i = 0; i < 2; i++) {
+		if (tree->kids[i])
+			mcc_isel_label(tree->kids[i]);
+	}
+	label_node(tree);
+	return tree->rule[MCC_ISEL_REG] != NULL;
+}
+
+unsigned mcc_isel_get_leaves(struct mcc_isel_node *node,
+                             enum mcc_isel_symbol nonterminal,
+                             struct mcc_isel_node *leaves[MCC_ISEL_MAX_LEAVES],
+                             enum mcc_isel_symbol symbols[MCC_ISEL_MAX_LEAVES])
+{
+	assert(node);
+	assert(node->rule[nonterminal]);
+
+	const struct mcc_isel_rule *rule = node->rule[nonterminal];
+	unsigned position = 0;
+	unsigned cost = 0;
+	unsigned num_leaves = 0;
+	match(rule, &position, node, &cost, leaves, symbols, &num_leaves);
+	return num_leaves;
+}
@@ -0,0 +1,257 @@
+#include "mcc/licm.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/cfg_analysis.h"
+#include "mcc/pass_manager.h"
+
+// Rows of one loop in IR order, and the variables that are assigned inside the loop
+struct loop_rows {
+	unsigned num_rows;
+	struct mcc_ir_row **rows;
+	bool *is_invariant;
+	unsigned num_assigned;
+	char **assigned;
+};
+
+static void delete_loop_rows(struct loop_rows *loop_rows)
+{
+	free(loop_rows->rows);
+	free(loop_rows->is_invariant);
+	free(loop_rows->assigned);
+}
+
+//---------------------------------------------------------------------------------------- Candidates
+
+// Number of assignments to the variable ident in the function starting at function_label
+static unsigned count_assignments(struct mcc_ir_row *function_label, char *ident)
+{
+	unsigned count = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+		    strcmp(row->arg1->ident, ident) == 0)
+			count++;
+	}
+	return count;
+}
+
+// Float and string literals are held in temporaries that are assigned exactly once
+static bool is_constant_temporary(struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_IDENTIFIER)
+		return false;
+	if (row->arg2->type != MCC_IR_TYPE_LIT_FLOAT && row->arg2->type != MCC_IR_TYPE_LIT_STRING)
+		return false;
+	if (strncmp(row->arg1->ident, "$tmp", 4) != 0)
+		return false;
+	return count_assignments(function_label, row->arg1->ident) == 1;
+}
+
+static bool is_pure_value_row(struct mcc_ir_row *row)
+{
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+	case MCC_IR_INSTR_AND:
+	case MCC_IR_INSTR_OR:
+	case MCC_IR_INSTR_NEGATIV:
+	case MCC_IR_INSTR_NOT:
+		return true;
+	case MCC_IR_INSTR_DIVIDE:
+		// Integer division traps on a zero divisor
+		if (row->type->type == MCC_IR_ROW_FLOAT)
+			return true;
+		return row->arg2->type == MCC_IR_TYPE_LIT_INT && row->arg2->lit_int != 0;
+	default:
+		return false;
+	}
+}
+
+//---------------------------------------------------------------------------------------- Invariance
+
+static bool is_assigned_in_loop(struct loop_rows *loop_rows, char *ident)
+{
+	for (unsigned i = 0; i < loop_rows->num_assigned; i++) {
+		if (strcmp(loop_rows->assigned[i], ident) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool row_is_marked_invariant(struct loop_rows *loop_rows, unsigned before, struct mcc_ir_row *row)
+{
+	// Operands are computed before they are used, so only search backwards
+	for (unsigned i = before; i > 0; i--) {
+		if (loop_rows->rows[i - 1] == row)
+			return loop_rows->is_invariant[i - 1];
+	}
+	return false;
+}
+
+static bool arg_is_invariant(struct mcc_cfg_analysis *analysis,
+                             struct mcc_cfg_loop *loop,
+                             struct loop_rows *loop_rows,
+                             unsigned position,
+                             struct mcc_ir_arg *arg)
+{
+	if (!arg)
+		return true;
+
+	switch (arg->type) {
+	case MCC_IR_TYPE_LIT_INT:
+	case MCC_IR_TYPE_LIT_FLOAT:
+	case MCC_IR_TYPE_LIT_BOOL:
+	case MCC_IR_TYPE_LIT_STRING:
+		return true;
+	case MCC_IR_TYPE_IDENTIFIER:
+		return !is_assigned_in_loop(loop_rows, arg->ident);
+	case MCC_IR_TYPE_ROW:
+		if (!mcc_cfg_loop_contains_row(analysis, loop, arg->row))
+			return true;
+		return row_is_marked_invariant(loop_rows, position, arg->row);
+	default:
+		return false;
+	}
+}
+
+static bool collect_loop_rows(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop, struct loop_rows *loop_rows)
+{
+	unsigned num_rows = 0;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!loop->contains[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			num_rows++;
+		}
+	}
+
+	loop_rows->num_rows = num_rows;
+	loop_rows->num_assigned = 0;
+	loop_rows->rows = malloc(sizeof(*loop_rows->rows) * num_rows);
+	loop_rows->is_invariant = calloc(num_rows, sizeof(*loop_rows->is_invariant));
+	loop_rows->assigned = malloc(sizeof(*loop_rows->assigned) * num_rows);
+	if (!loop_rows->rows || !loop_rows->is_invariant || !loop_rows->assigned) {
+		delete_loop_rows(loop_rows);
+		return false;
+	}
+
+	unsigned i = 0;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!loop->contains[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			loop_rows->rows[i++] = row;
+			// Constant temporaries are moved as well, so they don't count as assigned in the loop
+			if (row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+			    !is_constant_temporary(analysis->function_label, row)) {
+				loop_rows->assigned[loop_rows->num_assigned++] = row->arg1->ident;
+			}
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Hoisting
+
+// Returns the number of hoisted rows, or -1 if memory allocation fails
+static int hoist_invariants(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *loop)
+{
+	struct loop_rows loop_rows;
+	if (!collect_loop_rows(analysis, loop, &loop_rows))
+		return -1;
+
+	int num_invariant = 0;
+	for (unsigned i = 0; i < loop_rows.num_rows; i++) {
+		struct mcc_ir_row *row = loop_rows.rows[i];
+		if (is_constant_temporary(analysis->function_label, row)) {
+			loop_rows.is_invariant[i] = true;
+		} else if (is_pure_value_row(row)) {
+			loop_rows.is_invariant[i] = arg_is_invariant(analysis, loop, &loop_rows, i, row->arg1) &&
+			                            arg_is_invariant(analysis, loop, &loop_rows, i, row->arg2);
+		}
+		if (loop_rows.is_invariant[i])
+			num_invariant++;
+	}
+	if (num_invariant == 0) {
+		delete_loop_rows(&loop_rows);
+		return 0;
+	}
+
+	struct mcc_ir_row *position = mcc_cfg_loop_preheader(analysis, loop);
+	if (!position) {
+		delete_loop_rows(&loop_rows);
+		return 0;
+	}
+
+	// Keep the original order, so operands are still computed before they are used
+	for (unsigned i = 0; i < loop_rows.num_rows; i++) {
+		if (!loop_rows.is_invariant[i])
+			continue;
+		struct mcc_ir_row *row = loop_rows.rows[i];
+		mcc_ir_unlink_row(row);
+		mcc_ir_insert_row_after(position, row);
+		position = row;
+	}
+	delete_loop_rows(&loop_rows);
+	return num_invariant;
+}
+
+static bool licm_function(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	// The CFG changes with every hoisting, so analyse again until no loop has invariant rows left. Inner loops
+	// come first; their hoisted rows may then be moved further out of enclosing loops. The analysis of the unchanged
+	// function stays cached for the following passes.
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, function_label);
+		if (!analysis)
+			return false;
+		for (struct mcc_cfg_loop *loop = analysis->loops; loop; loop = loop->next) {
+			int hoisted = hoist_invariants(analysis, loop);
+			if (hoisted != 0)
+				mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+			if (hoisted < 0)
+				return false;
+			if (hoisted > 0) {
+				changed = true;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool mcc_licm_run_with_manager(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	for (struct mcc_ir_row *row = manager->ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !licm_function(manager, row))
+			return false;
+	}
+	return true;
+}
+
+bool mcc_licm_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	if (!manager)
+		return false;
+	bool success = mcc_licm_run_with_manager(manager);
+	mcc_pass_manager_delete(manager);
+	return success;
+}
@@ -0,0 +1,256 @@
+#include "mcc/liveness.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITS_PER_WORD (sizeof(unsigned long) * CHAR_BIT)
+
+//---------------------------------------------------------------------------------------- Bit sets
+
+static unsigned words_for(unsigned bits)
+{
+	return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+static bool bit_is_set(unsigned long *set, unsigned bit)
+{
+	return (set[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1UL;
+}
+
+static void set_bit(unsigned long *set, unsigned bit)
+{
+	set[bit / BITS_PER_WORD] |= 1UL << (bit % BITS_PER_WORD);
+}
+
+static unsigned long **new_sets(unsigned num_sets, unsigned words)
+{
+	unsigned long **sets = calloc(num_sets, sizeof(*sets));
+	if (!sets)
+		return NULL;
+	for (unsigned i = 0; i < num_sets; i++) {
+		sets[i] = calloc(words, sizeof(**sets));
+		if (!sets[i]) {
+			for (unsigned j = 0; j < i; j++)
+				free(sets[j]);
+			free(sets);
+			return NULL;
+		}
+	}
+	return sets;
+}
+
+static void delete_sets(unsigned long **sets, unsigned num_sets)
+{
+	if (!sets)
+		return;
+	for (unsigned i = 0; i < num_sets; i++)
+		free(sets[i]);
+	free(sets);
+}
+
+//---------------------------------------------------------------------------------------- Variables
+
+int mcc_liveness_find_identifier(struct mcc_liveness *liveness, char *ident)
+{
+	assert(liveness);
+	assert(ident);
+
+	for (unsigned i = 0; i < liveness->num_variables; i++) {
+		if (liveness->variables[i].ident && strcmp(liveness->variables[i].ident, ident) == 0)
+			return (int)i;
+	}
+	return -1;
+}
+
+int mcc_liveness_find_row(struct mcc_liveness *liveness, struct mcc_ir_row *row)
+{
+	assert(liveness);
+	assert(row);
+
+	for (unsigned i = 0; i < liveness->num_variables; i++) {
+		if (liveness->variables[i].row == row)
+			return (int)i;
+	}
+	return -1;
+}
+
+// The variable an operand reads or assigns, or -1. With add set, it becomes a new variable if it is not one yet.
+static int get_variable(struct mcc_liveness *liveness, struct mcc_ir_arg *arg, bool add, unsigned *capacity)
+{
+	if (!arg || (arg->type != MCC_IR_TYPE_IDENTIFIER && arg->type != MCC_IR_TYPE_ROW))
+		return -1;
+	int variable = arg->type == MCC_IR_TYPE_IDENTIFIER ? mcc_liveness_find_identifier(liveness, arg->ident)
+	                                                   : mcc_liveness_find_row(liveness, arg->row);
+	if (variable >= 0 || !add)
+		return variable;
+
+	if (liveness->num_variables == *capacity) {
+		unsigned new_capacity = *capacity ? *capacity * 2 : 16;
+		struct mcc_liveness_variable *variables =
+		    realloc(liveness->variables, sizeof(*variables) * new_capacity);
+		if (!variables)
+			return -2;
+		liveness->variables = variables;
+		*capacity = new_capacity;
+	}
+	struct mcc_liveness_variable *new_variable = &liveness->variables[liveness->num_variables];
+	new_variable->ident = arg->type == MCC_IR_TYPE_IDENTIFIER ? arg->ident : NULL;
+	new_variable->row = arg->type == MCC_IR_TYPE_ROW ? arg->row : NULL;
+	return (int)liveness->num_variables++;
+}
+
+// Operand of the row whose variable is read, counting the indices of array elements
+static struct mcc_ir_arg *get_read_operand(struct mcc_ir_row *row, unsigned i)
+{
+	struct mcc_ir_arg *arg = i == 0 ? row->arg1 : row->arg2;
+	if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+		return arg->index;
+	// The assigned identifier is not read
+	if (i == 0 && row->instr == MCC_IR_INSTR_ASSIGN)
+		return NULL;
+	return arg;
+}
+
+static struct mcc_ir_arg *get_assigned_operand(struct mcc_ir_row *row)
+{
+	if (row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER)
+		return row->arg1;
+	return NULL;
+}
+
+static bool collect_variables(struct mcc_liveness *liveness)
+{
+	unsigned capacity = 0;
+	struct mcc_cfg_analysis *analysis = liveness->analysis;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			struct mcc_ir_arg *args[] = {get_read_operand(row, 0), get_read_operand(row, 1),
+			                             get_assigned_operand(row)};
+			for (unsigned i = 0; i < 3; i++) {
+				if (get_variable(liveness, args[i], true, &capacity) == -2)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Data flow
+
+// Variables read in the block before they are assigned, and variables assigned in the block
+static void compute_uses_and_definitions(struct mcc_liveness *liveness,
+                                         struct mcc_basic_block *block,
+                                         unsigned long *uses,
+                                         unsigned long *definitions)
+{
+	for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+		for (unsigned i = 0; i < 2; i++) {
+			int variable = get_variable(liveness, get_read_operand(row, i), false, NULL);
+			if (variable >= 0 && !bit_is_set(definitions, (unsigned)variable))
+				set_bit(uses, (unsigned)variable);
+		}
+		int assigned = get_variable(liveness, get_assigned_operand(row), false, NULL);
+		if (assigned >= 0)
+			set_bit(definitions, (unsigned)assigned);
+		int defined_row = mcc_liveness_find_row(liveness, row);
+		if (defined_row >= 0)
+			set_bit(definitions, (unsigned)defined_row);
+	}
+}
+
+static bool solve(struct mcc_liveness *liveness)
+{
+	struct mcc_cfg_analysis *analysis = liveness->analysis;
+	unsigned n = analysis->num_blocks;
+	unsigned words = words_for(liveness->num_variables) + 1;
+	unsigned long **uses = new_sets(n, words);
+	unsigned long **definitions = new_sets(n, words);
+	if (!uses || !definitions) {
+		delete_sets(uses, n);
+		delete_sets(definitions, n);
+		return false;
+	}
+	for (unsigned b = 0; b < n; b++)
+		compute_uses_and_definitions(liveness, analysis->blocks[b], uses[b], definitions[b]);
+
+	// Blocks are in IR order, so going backwards follows the flow of liveness
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned b = n; b-- > 0;) {
+			struct mcc_basic_block *block = analysis->blocks[b];
+			struct mcc_basic_block *children[] = {block->child_left, block->child_right};
+			for (unsigned c = 0; c < 2; c++) {
+				if (!children[c])
+					continue;
+				for (unsigned w = 0; w < words; w++)
+					liveness->live_out[b][w] |= liveness->live_in[children[c]->id][w];
+			}
+			for (unsigned w = 0; w < words; w++) {
+				unsigned long live_in = uses[b][w] | (liveness->live_out[b][w] & ~definitions[b][w]);
+				if (live_in != liveness->live_in[b][w]) {
+					liveness->live_in[b][w] = live_in;
+					changed = true;
+				}
+			}
+		}
+	}
+	delete_sets(uses, n);
+	delete_sets(definitions, n);
+	return true;
+}
+
+bool mcc_liveness_is_live_in(struct mcc_liveness *liveness, struct mcc_basic_block *block, int variable)
+{
+	assert(liveness);
+	assert(block);
+
+	return variable >= 0 && bit_is_set(liveness->live_in[block->id], (unsigned)variable);
+}
+
+bool mcc_liveness_is_live_out(struct mcc_liveness *liveness, struct mcc_basic_block *block, int variable)
+{
+	assert(liveness);
+	assert(block);
+
+	return variable >= 0 && bit_is_set(liveness->live_out[block->id], (unsigned)variable);
+}
+
+//---------------------------------------------------------------------------------------- Set up and delete
+
+struct mcc_liveness *mcc_liveness_analyse(struct mcc_cfg_analysis *analysis)
+{
+	assert(analysis);
+
+	struct mcc_liveness *liveness = calloc(1, sizeof(*liveness));
+	if (!liveness)
+		return NULL;
+	liveness->analysis = analysis;
+	if (!collect_variables(liveness)) {
+		mcc_liveness_delete(liveness);
+		return NULL;
+	}
+
+	// One word more, so that functions without variables get sets too
+	unsigned words = words_for(liveness->num_variables) + 1;
+	liveness->live_in = new_sets(analysis->num_blocks, words);
+	liveness->live_out = new_sets(analysis->num_blocks, words);
+	if (!liveness->live_in || !liveness->live_out || !solve(liveness)) {
+		mcc_liveness_delete(liveness);
+		return NULL;
+	}
+	return liveness;
+}
+
+void mcc_liveness_delete(struct mcc_liveness *liveness)
+{
+	if (!liveness)
+		return;
+	delete_sets(liveness->live_in, liveness->analysis->num_blocks);
+	delete_sets(liveness->live_out, liveness->analysis->num_blocks);
+	free(liveness->variables);
+	free(liveness);
+}
@@ -0,0 +1,332 @@
+#include "mcc/loop_rotation.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A while loop in the generated shape
+struct while_loop {
+	// Label L0 in front of the condition, the target of the jump back
+	struct mcc_ir_row *header;
+	// Jumpfalse to L1 after the condition
+	struct mcc_ir_row *exit_test;
+	// Jump to L0 right before L1
+	struct mcc_ir_row *back_jump;
+	// Rows computing the condition, between header and exit test
+	unsigned num_rows;
+};
+
+// Copies of the condition rows, in the same order
+struct condition_copy {
+	// Constant temporaries have no copy
+	unsigned num_rows;
+	struct mcc_ir_row **old_rows;
+	struct mcc_ir_row **new_rows;
+	// Row computing the inverted condition, or NULL if a copied row is used
+	struct mcc_ir_row *negation;
+	struct mcc_ir_row *latch_test;
+};
+
+//---------------------------------------------------------------------------------------- Loop shape
+
+static bool is_jump_to(struct mcc_ir_row *row, unsigned label)
+{
+	if (row->instr == MCC_IR_INSTR_JUMP)
+		return row->arg1->label == label;
+	if (row->instr == MCC_IR_INSTR_JUMPFALSE)
+		return row->arg2->label == label;
+	return false;
+}
+
+static unsigned count_jumps_to(struct mcc_ir_row *function_label, unsigned label)
+{
+	unsigned count = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (is_jump_to(row, label))
+			count++;
+	}
+	return count;
+}
+
+// Float and string literals are held in temporaries that are assigned exactly once, right where they are used. Their
+// assignment stays in front of the loop and is not copied, the copied condition reads the same temporary.
+static bool is_constant_temporary(struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_IDENTIFIER)
+		return false;
+	if (row->arg2->type != MCC_IR_TYPE_LIT_FLOAT && row->arg2->type != MCC_IR_TYPE_LIT_STRING)
+		return false;
+	if (strncmp(row->arg1->ident, "$tmp", 4) != 0)
+		return false;
+
+	unsigned count = 0;
+	for (struct mcc_ir_row *other = function_label->next_row; !mcc_ir_is_function_end(other); other = other->next_row) {
+		if (other->instr == MCC_IR_INSTR_ASSIGN && other->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+		    strcmp(other->arg1->ident, row->arg1->ident) == 0)
+			count++;
+	}
+	return count == 1;
+}
+
+// Rows that may be executed once more at the end of every iteration
+static bool can_copy(struct mcc_ir_row *function_label, struct mcc_ir_row *row)
+{
+	if (row->type->lanes > 1)
+		return false;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_DIVIDE:
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+	case MCC_IR_INSTR_AND:
+	case MCC_IR_INSTR_OR:
+	case MCC_IR_INSTR_NEGATIV:
+	case MCC_IR_INSTR_NOT:
+	case MCC_IR_INSTR_PUSH:
+	case MCC_IR_INSTR_CALL:
+	// The copy counts the tests at the end of the loop (see profile.h)
+	case MCC_IR_INSTR_COUNT:
+		return true;
+	case MCC_IR_INSTR_ASSIGN:
+		return is_constant_temporary(function_label, row);
+	default:
+		return false;
+	}
+}
+
+static bool is_condition_row(struct while_loop *loop, struct mcc_ir_row *row)
+{
+	for (struct mcc_ir_row *condition = loop->header->next_row; condition != loop->exit_test;
+	     condition = condition->next_row) {
+		if (condition == row)
+			return true;
+	}
+	return false;
+}
+
+// Whether a value of the condition is read after the exit test, which would then read the copy from the previous
+// iteration
+static bool is_condition_used_later(struct while_loop *loop)
+{
+	for (struct mcc_ir_row *row = loop->exit_test->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		for (struct mcc_ir_row *condition = loop->header->next_row; condition != loop->exit_test;
+		     condition = condition->next_row) {
+			if (mcc_ir_uses_row(row, condition))
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool find_while_loop(struct mcc_ir_row *function_label, struct mcc_ir_row *header, struct while_loop *loop)
+{
+	loop->header = header;
+	loop->num_rows = 0;
+	struct mcc_ir_row *row = header->next_row;
+	for (; !mcc_ir_is_function_end(row) && can_copy(function_label, row); row = row->next_row)
+		loop->num_rows++;
+	if (mcc_ir_is_function_end(row) || row->instr != MCC_IR_INSTR_JUMPFALSE)
+		return false;
+	loop->exit_test = row;
+	enum mcc_ir_arg_type condition_type = row->arg1->type;
+	if (condition_type != MCC_IR_TYPE_ROW && condition_type != MCC_IR_TYPE_IDENTIFIER)
+		return false;
+
+	// The jump back has to be the only jump to the header and come right before the exit label
+	unsigned exit_label = loop->exit_test->arg2->label;
+	for (row = loop->exit_test->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label == exit_label)
+			break;
+	}
+	if (mcc_ir_is_function_end(row) || row->prev_row->instr != MCC_IR_INSTR_JUMP ||
+	    !is_jump_to(row->prev_row, header->arg1->label))
+		return false;
+	loop->back_jump = row->prev_row;
+	return count_jumps_to(function_label, header->arg1->label) == 1 && !is_condition_used_later(loop);
+}
+
+//---------------------------------------------------------------------------------------- Copying
+
+static struct mcc_ir_row *get_new_row(struct condition_copy *copy, struct mcc_ir_row *row)
+{
+	for (unsigned i = 0; i < copy->num_rows; i++) {
+		if (copy->old_rows[i] == row && copy->new_rows[i])
+			return copy->new_rows[i];
+	}
+	return row;
+}
+
+// Copy of an argument that refers to the copies of the condition rows
+static struct mcc_ir_arg *copy_arg(struct condition_copy *copy, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_arg *new_arg = mcc_ir_copy_arg(arg);
+	if (!new_arg)
+		return NULL;
+	if (new_arg->type == MCC_IR_TYPE_ROW)
+		new_arg->row = get_new_row(copy, new_arg->row);
+	else if (new_arg->type == MCC_IR_TYPE_ARR_ELEM && new_arg->index->type == MCC_IR_TYPE_ROW)
+		new_arg->index->row = get_new_row(copy, new_arg->index->row);
+	return new_arg;
+}
+
+static struct mcc_ir_row *new_row(struct mcc_ir_arg *arg1,
+                                  struct mcc_ir_arg *arg2,
+                                  enum mcc_ir_instruction instr,
+                                  struct mcc_ir_row_type *type,
+                                  bool args_ok)
+{
+	struct mcc_ir_row *row = NULL;
+	if (args_ok && type)
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+	}
+	return row;
+}
+
+static struct mcc_ir_row *copy_row(struct condition_copy *copy, struct mcc_ir_row *row)
+{
+	struct mcc_ir_arg *arg1 = row->arg1 ? copy_arg(copy, row->arg1) : NULL;
+	struct mcc_ir_arg *arg2 = row->arg2 ? copy_arg(copy, row->arg2) : NULL;
+	bool args_ok = (!row->arg1 || arg1) && (!row->arg2 || arg2);
+	return new_row(arg1, arg2, row->instr, mcc_ir_new_row_type(row->type->type, row->type->array_size), args_ok);
+}
+
+static void delete_condition_copy(struct condition_copy *copy)
+{
+	for (unsigned i = 0; i < copy->num_rows; i++)
+		mcc_ir_delete_ir_row(copy->new_rows[i]);
+	mcc_ir_delete_ir_row(copy->negation);
+	mcc_ir_delete_ir_row(copy->latch_test);
+	free(copy->old_rows);
+	free(copy->new_rows);
+}
+
+// Argument holding the inverted condition, computed from the copied rows
+static struct mcc_ir_arg *invert_condition(struct while_loop *loop, struct condition_copy *copy)
+{
+	struct mcc_ir_arg *condition = loop->exit_test->arg1;
+	if (condition->type == MCC_IR_TYPE_ROW && is_condition_row(loop, condition->row)) {
+		struct mcc_ir_row *row = get_new_row(copy, condition->row);
+		bool is_only_used_by_test = true;
+		for (unsigned i = 0; i < copy->num_rows; i++)
+			is_only_used_by_test =
+			    is_only_used_by_test && (!copy->new_rows[i] || !mcc_ir_uses_row(copy->new_rows[i], row));
+
+		if (is_only_used_by_test && mcc_ir_is_compare(row)) {
+			row->instr = mcc_ir_invert_compare(row->instr);
+			return mcc_ir_new_arg_row(row);
+		}
+		// The negated value itself is the inverted condition, the negation is not copied
+		if (is_only_used_by_test && row->instr == MCC_IR_INSTR_NOT) {
+			struct mcc_ir_arg *negated = mcc_ir_copy_arg(row->arg1);
+			if (!negated)
+				return NULL;
+			for (unsigned i = 0; i < copy->num_rows; i++) {
+				if (copy->new_rows[i] == row)
+					copy->new_rows[i] = NULL;
+			}
+			mcc_ir_delete_ir_row(row);
+			return negated;
+		}
+	}
+
+	struct mcc_ir_arg *arg = copy_arg(copy, condition);
+	copy->negation = new_row(arg, NULL, MCC_IR_INSTR_NOT, mcc_ir_new_row_type(MCC_IR_ROW_BOOL, -1), arg != NULL);
+	return copy->negation ? mcc_ir_new_arg_row(copy->negation) : NULL;
+}
+
+static bool copy_condition(struct while_loop *loop, struct condition_copy *copy)
+{
+	copy->num_rows = loop->num_rows;
+	copy->old_rows = calloc(loop->num_rows + 1, sizeof(*copy->old_rows));
+	copy->new_rows = calloc(loop->num_rows + 1, sizeof(*copy->new_rows));
+	copy->negation = NULL;
+	copy->latch_test = NULL;
+	if (!copy->old_rows || !copy->new_rows)
+		return false;
+
+	struct mcc_ir_row *row = loop->header->next_row;
+	for (unsigned i = 0; i < loop->num_rows; i++, row = row->next_row) {
+		copy->old_rows[i] = row;
+		if (row->instr == MCC_IR_INSTR_ASSIGN)
+			continue;
+		copy->new_rows[i] = copy_row(copy, row);
+		if (!copy->new_rows[i])
+			return false;
+	}
+
+	struct mcc_ir_arg *inverted = invert_condition(loop, copy);
+	struct mcc_ir_arg *label = mcc_ir_new_arg_label(loop->header->arg1->label);
+	copy->latch_test = new_row(inverted, label, MCC_IR_INSTR_JUMPFALSE,
+	                           mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1), inverted && label);
+	return copy->latch_test != NULL;
+}
+
+//---------------------------------------------------------------------------------------- Rotation
+
+static bool rotate_loop(struct while_loop *loop)
+{
+	struct condition_copy copy;
+	if (!copy_condition(loop, &copy)) {
+		delete_condition_copy(&copy);
+		return false;
+	}
+
+	// The copied condition replaces the jump back, the original one is left in front of the loop as its guard
+	for (unsigned i = 0; i < copy.num_rows; i++) {
+		if (copy.new_rows[i])
+			mcc_ir_insert_row_before(loop->back_jump, copy.new_rows[i]);
+		copy.new_rows[i] = NULL;
+	}
+	if (copy.negation)
+		mcc_ir_insert_row_before(loop->back_jump, copy.negation);
+	mcc_ir_insert_row_before(loop->back_jump, copy.latch_test);
+	copy.negation = NULL;
+	copy.latch_test = NULL;
+	delete_condition_copy(&copy);
+
+	mcc_ir_unlink_row(loop->back_jump);
+	mcc_ir_delete_ir_row(loop->back_jump);
+	mcc_ir_unlink_row(loop->header);
+	mcc_ir_insert_row_after(loop->exit_test, loop->header);
+	return true;
+}
+
+static bool rotate_function(struct mcc_ir_row *function_label, bool *changed)
+{
+	struct mcc_ir_row *row = function_label->next_row;
+	while (!mcc_ir_is_function_end(row)) {
+		struct mcc_ir_row *next = row->next_row;
+		struct while_loop loop;
+		if (row->instr == MCC_IR_INSTR_LABEL && find_while_loop(function_label, row, &loop)) {
+			if (!rotate_loop(&loop))
+				return false;
+			*changed = true;
+		}
+		row = next;
+	}
+	return true;
+}
+
+bool mcc_loop_rotation_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	bool changed = false;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !rotate_function(row, &changed))
+			return false;
+	}
+	if (changed)
+		mcc_ir_number_rows(ir);
+	return true;
+}
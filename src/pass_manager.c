@@ -0,0 +1,309 @@
+#include "mcc/pass_manager.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mcc/block_layout.h"
+#include "mcc/copy_propagation.h"
+#include "mcc/induction.h"
+#include "mcc/inline.h"
+#include "mcc/ir_print.h"
+#include "mcc/licm.h"
+#include "mcc/loop_rotation.h"
+#include "mcc/specialize.h"
+#include "mcc/tail_call.h"
+#include "mcc/unroll.h"
+#include "mcc/vectorize.h"
+
+//---------------------------------------------------------------------------------------- Passes
+
+static bool run_inline(struct mcc_pass_manager *manager)
+{
+	return mcc_inline_run(manager->ir, manager->options.inline_limit);
+}
+
+static bool run_tail_call(struct mcc_pass_manager *manager)
+{
+	return mcc_tail_call_run(manager->ir);
+}
+
+static bool run_specialize(struct mcc_pass_manager *manager)
+{
+	return mcc_specialize_run(manager->ir);
+}
+
+static bool run_vectorize(struct mcc_pass_manager *manager)
+{
+	if (!manager->options.vectorize)
+		return true;
+	return mcc_vectorize_run(manager->ir, manager->options.vectorize_report);
+}
+
+static bool run_rotate(struct mcc_pass_manager *manager)
+{
+	return mcc_loop_rotation_run(manager->ir);
+}
+
+const struct mcc_pass mcc_passes[] = {
+    {"inline", "replace calls of small functions by their body", 1, run_inline, MCC_PASS_ANALYSIS_NONE},
+    {"tail-call", "turn self-recursive tail calls into loops", 1, run_tail_call, MCC_PASS_ANALYSIS_NONE},
+    {"specialize", "clone functions for calls with literal arguments", 2, run_specialize, MCC_PASS_ANALYSIS_NONE},
+    // These invalidate the analyses they change themselves
+    {"licm", "move loop-invariant rows in front of loops", 2, mcc_licm_run_with_manager, MCC_PASS_ANALYSIS_ALL},
+    {"induction", "strength-reduce induction variables", 2, mcc_induction_run_with_manager, MCC_PASS_ANALYSIS_ALL},
+    {"vectorize", "vectorize counted array loops with SSE2", 2, run_vectorize, MCC_PASS_ANALYSIS_NONE},
+    {"unroll", "unroll counted loops", 2, mcc_unroll_run_with_manager, MCC_PASS_ANALYSIS_ALL},
+    // The loop passes above look for the variables of loops, so the copies into them are kept until here
+    {"copy-prop", "replace variables assigned once by their value", 1, mcc_copy_propagation_run_with_manager,
+     MCC_PASS_ANALYSIS_ALL},
+    // The loop passes above expect the condition at the top
+    {"rotate", "test the condition of while loops at the bottom", 1, run_rotate, MCC_PASS_ANALYSIS_NONE},
+    {"layout", "place the likely successor of each block behind it", 2, mcc_block_layout_run_with_manager,
+     MCC_PASS_ANALYSIS_ALL},
+};
+
+const unsigned mcc_num_passes = sizeof(mcc_passes) / sizeof(mcc_passes[0]);
+
+//---------------------------------------------------------------------------------------- Pipeline
+
+const struct mcc_pass *mcc_pass_find(const char *name)
+{
+	assert(name);
+
+	for (unsigned i = 0; i < mcc_num_passes; i++) {
+		if (strcmp(mcc_passes[i].name, name) == 0)
+			return &mcc_passes[i];
+	}
+	return NULL;
+}
+
+// Find the pass whose name is the first length characters of name
+static const struct mcc_pass *find_pass_prefix(const char *name, size_t length)
+{
+	for (unsigned i = 0; i < mcc_num_passes; i++) {
+		if (strlen(mcc_passes[i].name) == length && strncmp(mcc_passes[i].name, name, length) == 0)
+			return &mcc_passes[i];
+	}
+	return NULL;
+}
+
+bool mcc_pass_is_valid_list(const char *list)
+{
+	assert(list);
+
+	while (true) {
+		size_t length = strcspn(list, ",");
+		if (!find_pass_prefix(list, length))
+			return false;
+		if (list[length] == '\0')
+			return true;
+		list += length + 1;
+	}
+}
+
+struct mcc_pass_manager *mcc_pass_manager_new(struct mcc_ir_row *ir, const struct mcc_pass_options *options)
+{
+	assert(ir);
+
+	struct mcc_pass_manager *manager = calloc(1, sizeof(*manager));
+	if (!manager)
+		return NULL;
+	manager->ir = ir;
+	if (options)
+		manager->options = *options;
+	return manager;
+}
+
+void mcc_pass_manager_delete(struct mcc_pass_manager *manager)
+{
+	if (!manager)
+		return;
+	mcc_pass_manager_invalidate(manager, NULL, MCC_PASS_ANALYSIS_ALL);
+	while (manager->analyses) {
+		struct mcc_pass_function_analyses *next = manager->analyses->next;
+		free(manager->analyses);
+		manager->analyses = next;
+	}
+	free(manager->passes);
+	free(manager->timings);
+	free(manager);
+}
+
+bool mcc_pass_manager_add(struct mcc_pass_manager *manager, const struct mcc_pass *pass)
+{
+	assert(manager);
+	assert(pass);
+
+	const struct mcc_pass **passes = realloc(manager->passes, sizeof(*passes) * (manager->num_passes + 1));
+	if (!passes)
+		return false;
+	passes[manager->num_passes++] = pass;
+	manager->passes = passes;
+	return true;
+}
+
+bool mcc_pass_manager_add_level(struct mcc_pass_manager *manager, unsigned level)
+{
+	assert(manager);
+
+	for (unsigned i = 0; i < mcc_num_passes; i++) {
+		if (mcc_passes[i].level <= level && !mcc_pass_manager_add(manager, &mcc_passes[i]))
+			return false;
+	}
+	return true;
+}
+
+bool mcc_pass_manager_add_list(struct mcc_pass_manager *manager, const char *list)
+{
+	assert(manager);
+	assert(mcc_pass_is_valid_list(list));
+
+	while (true) {
+		size_t length = strcspn(list, ",");
+		if (!mcc_pass_manager_add(manager, find_pass_prefix(list, length)))
+			return false;
+		if (list[length] == '\0')
+			return true;
+		list += length + 1;
+	}
+}
+
+static unsigned count_rows(struct mcc_ir_row *ir)
+{
+	unsigned rows = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row)
+		rows++;
+	return rows;
+}
+
+bool mcc_pass_manager_run(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	free(manager->timings);
+	manager->timings = calloc(manager->num_passes + 1, sizeof(*manager->timings));
+	if (!manager->timings)
+		return false;
+
+	for (unsigned i = 0; i < manager->num_passes; i++) {
+		const struct mcc_pass *pass = manager->passes[i];
+		struct mcc_pass_timing *timing = &manager->timings[i];
+		timing->pass = pass;
+		timing->rows_before = count_rows(manager->ir);
+		unsigned computed = manager->num_computed;
+
+		clock_t start = clock();
+		bool success = pass->run(manager);
+		timing->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		mcc_pass_manager_invalidate(manager, NULL, MCC_PASS_ANALYSIS_ALL & ~pass->preserves);
+		timing->rows_after = count_rows(manager->ir);
+		timing->analyses = manager->num_computed - computed;
+		if (!success)
+			return false;
+
+		if (manager->options.dump) {
+			fprintf(manager->options.dump, "// IR after %s\n", pass->name);
+			mcc_ir_print_ir(manager->options.dump, manager->ir, false, false);
+			fprintf(manager->options.dump, "\n");
+		}
+	}
+	return true;
+}
+
+void mcc_pass_manager_print_timings(FILE *out, struct mcc_pass_manager *manager)
+{
+	assert(out);
+	assert(manager);
+
+	double total = 0;
+	fprintf(out, "%-12s %10s %8s %8s %9s\n", "pass", "time (ms)", "rows", "change", "analyses");
+	for (unsigned i = 0; manager->timings && i < manager->num_passes; i++) {
+		struct mcc_pass_timing *timing = &manager->timings[i];
+		if (!timing->pass)
+			break;
+		total += timing->seconds;
+		fprintf(out, "%-12s %10.3f %8u %+8d %9u\n", timing->pass->name, timing->seconds * 1000,
+		        timing->rows_after, (int)timing->rows_after - (int)timing->rows_before, timing->analyses);
+	}
+	fprintf(out, "%-12s %10.3f\n", "total", total * 1000);
+}
+
+//---------------------------------------------------------------------------------------- Analyses
+
+static struct mcc_pass_function_analyses *get_function_analyses(struct mcc_pass_manager *manager,
+                                                                 struct mcc_ir_row *function_label)
+{
+	for (struct mcc_pass_function_analyses *analyses = manager->analyses; analyses; analyses = analyses->next) {
+		if (analyses->function_label == function_label)
+			return analyses;
+	}
+	struct mcc_pass_function_analyses *analyses = calloc(1, sizeof(*analyses));
+	if (!analyses)
+		return NULL;
+	analyses->function_label = function_label;
+	analyses->next = manager->analyses;
+	manager->analyses = analyses;
+	return analyses;
+}
+
+struct mcc_cfg_analysis *mcc_pass_manager_get_cfg(struct mcc_pass_manager *manager, struct mcc_ir_row *function_label)
+{
+	assert(manager);
+	assert(function_label);
+	assert(function_label->instr == MCC_IR_INSTR_FUNC_LABEL);
+
+	struct mcc_pass_function_analyses *analyses = get_function_analyses(manager, function_label);
+	if (!analyses)
+		return NULL;
+	if (!analyses->cfg) {
+		analyses->cfg = mcc_cfg_analyse_function(function_label);
+		if (analyses->cfg)
+			manager->num_computed++;
+	}
+	return analyses->cfg;
+}
+
+struct mcc_liveness *mcc_pass_manager_get_liveness(struct mcc_pass_manager *manager,
+                                                   struct mcc_ir_row *function_label)
+{
+	assert(manager);
+	assert(function_label);
+
+	struct mcc_cfg_analysis *cfg = mcc_pass_manager_get_cfg(manager, function_label);
+	if (!cfg)
+		return NULL;
+	struct mcc_pass_function_analyses *analyses = get_function_analyses(manager, function_label);
+	if (!analyses->liveness) {
+		analyses->liveness = mcc_liveness_analyse(cfg);
+		if (analyses->liveness)
+			manager->num_computed++;
+	}
+	return analyses->liveness;
+}
+
+void mcc_pass_manager_invalidate(struct mcc_pass_manager *manager,
+                                 struct mcc_ir_row *function_label,
+                                 unsigned analyses)
+{
+	assert(manager);
+
+	// Liveness is computed on top of the CFG
+	if (analyses & MCC_PASS_ANALYSIS_CFG)
+		analyses |= MCC_PASS_ANALYSIS_LIVENESS;
+
+	for (struct mcc_pass_function_analyses *cached = manager->analyses; cached; cached = cached->next) {
+		if (function_label && cached->function_label != function_label)
+			continue;
+		if (analyses & MCC_PASS_ANALYSIS_LIVENESS) {
+			mcc_liveness_delete(cached->liveness);
+			cached->liveness = NULL;
+		}
+		if (analyses & MCC_PASS_ANALYSIS_CFG) {
+			mcc_cfg_delete_analysis(cached->cfg);
+			cached->cfg = NULL;
+		}
+	}
+}
@@ -0,0 +1,251 @@
+#include "mcc/peephole.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Operand or label a variable of a rule is bound to while a pattern is matched
+struct binding {
+	bool is_bound;
+	struct mcc_asm_operand *operand;
+	unsigned label;
+};
+
+//---------------------------------------------------------------------------------------- Matching
+
+static bool operands_are_equal(struct mcc_asm_operand *a, struct mcc_asm_operand *b)
+{
+	if (a->type != b->type)
+		return false;
+	switch (a->type) {
+	case MCC_ASM_OPERAND_REGISTER:
+		return a->reg == b->reg && a->offset == b->offset;
+	case MCC_ASM_OPERAND_COMPUTED_OFFSET:
+		return a->offset_initial == b->offset_initial && a->offset_base == b->offset_base &&
+		       a->offset_factor == b->offset_factor && a->offset_size == b->offset_size;
+	case MCC_ASM_OPERAND_DATA:
+		return a->decl == b->decl && a->offset == b->offset && a->rip_relative == b->rip_relative;
+	case MCC_ASM_OPERAND_LITERAL:
+		return a->literal == b->literal;
+	case MCC_ASM_OPERAND_FUNCTION:
+		return strcmp(a->func_name, b->func_name) == 0;
+	}
+	return false;
+}
+
+static bool
+match_operand(const struct mcc_peephole_operand *pattern, struct mcc_asm_operand *operand, struct binding *bindings)
+{
+	switch (pattern->kind) {
+	case MCC_PEEPHOLE_OPERAND_NONE:
+		return !operand;
+	case MCC_PEEPHOLE_OPERAND_REGISTER:
+		return operand && operand->type == MCC_ASM_OPERAND_REGISTER && operand->reg == pattern->reg &&
+		       operand->offset == 0;
+	case MCC_PEEPHOLE_OPERAND_LITERAL:
+		return operand && operand->type == MCC_ASM_OPERAND_LITERAL && operand->literal == pattern->literal;
+	case MCC_PEEPHOLE_OPERAND_VARIABLE:
+	case MCC_PEEPHOLE_OPERAND_LITERAL_VARIABLE: {
+		if (!operand)
+			return false;
+		bool is_literal = operand->type == MCC_ASM_OPERAND_LITERAL;
+		if (is_literal != (pattern->kind == MCC_PEEPHOLE_OPERAND_LITERAL_VARIABLE))
+			return false;
+		struct binding *binding = &bindings[pattern->variable];
+		if (binding->is_bound)
+			return operands_are_equal(binding->operand, operand);
+		binding->is_bound = true;
+		binding->operand = operand;
+		return true;
+	}
+	case MCC_PEEPHOLE_OPERAND_LABEL_VARIABLE:
+		return false;
+	}
+	return false;
+}
+
+static bool match_label(const struct mcc_peephole_operand *pattern, unsigned label, struct binding *bindings)
+{
+	if (pattern->kind != MCC_PEEPHOLE_OPERAND_LABEL_VARIABLE)
+		return false;
+	struct binding *binding = &bindings[pattern->variable];
+	if (binding->is_bound)
+		return binding->label == label;
+	binding->is_bound = true;
+	binding->label = label;
+	return true;
+}
+
+static bool match_line(const struct mcc_peephole_line *pattern, struct mcc_asm_line *line, struct binding *bindings)
+{
+	if (line->opcode != pattern->opcode)
+		return false;
+	if (mcc_asm_opcode_has_label(line->opcode))
+		return match_label(&pattern->first, line->label, bindings);
+	return match_operand(&pattern->first, line->first, bindings) &&
+	       match_operand(&pattern->second, line->second, bindings);
+}
+
+// Returns the line behind the matched lines in after
+static bool match_rule(const struct mcc_peephole_rule *rule,
+                       struct mcc_asm_line *line,
+                       struct binding *bindings,
+                       struct mcc_asm_line **after)
+{
+	memset(bindings, 0, sizeof(*bindings) * MCC_PEEPHOLE_MAX_VARIABLES);
+	for (unsigned i = 0; i < rule->pattern_length; i++) {
+		if (!line || !match_line(&rule->pattern[i], line, bindings))
+			return false;
+		line = line->next;
+	}
+	*after = line;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Replacing
+
+static struct mcc_asm_operand *copy_operand(struct mcc_asm_operand *operand, struct mcc_asm_data *data)
+{
+	switch (operand->type) {
+	case MCC_ASM_OPERAND_REGISTER:
+		return mcc_asm_new_register_operand(operand->reg, operand->offset, data);
+	case MCC_ASM_OPERAND_COMPUTED_OFFSET:
+		return mcc_asm_new_computed_offset_operand(operand->offset_initial, operand->offset_base,
+		                                           operand->offset_factor, operand->offset_size, data);
+	case MCC_ASM_OPERAND_DATA: {
+		struct mcc_asm_operand *copy = mcc_asm_new_data_operand(operand->decl, data);
+		if (copy) {
+			copy->offset = operand->offset;
+			copy->rip_relative = operand->rip_relative;
+		}
+		return copy;
+	}
+	case MCC_ASM_OPERAND_LITERAL:
+		return mcc_asm_new_literal_operand(operand->literal, data);
+	case MCC_ASM_OPERAND_FUNCTION:
+		return mcc_asm_new_function_operand(operand->func_name, data);
+	}
+	return NULL;
+}
+
+static struct mcc_asm_operand *
+new_operand(const struct mcc_peephole_operand *pattern, struct binding *bindings, struct mcc_asm_data *data)
+{
+	switch (pattern->kind) {
+	case MCC_PEEPHOLE_OPERAND_REGISTER:
+		return mcc_asm_new_register_operand(pattern->reg, 0, data);
+	case MCC_PEEPHOLE_OPERAND_LITERAL:
+		return mcc_asm_new_literal_operand(pattern->literal, data);
+	case MCC_PEEPHOLE_OPERAND_VARIABLE:
+	case MCC_PEEPHOLE_OPERAND_LITERAL_VARIABLE:
+		return copy_operand(bindings[pattern->variable].operand, data);
+	default:
+		return NULL;
+	}
+}
+
+// Lines of the replacement are appended to data->current
+static void new_lines(const struct mcc_peephole_rule *rule, struct binding *bindings, struct mcc_asm_data *data)
+{
+	for (unsigned i = 0; i < rule->replacement_length && !data->has_failed; i++) {
+		const struct mcc_peephole_line *line = &rule->replacement[i];
+		if (mcc_asm_opcode_has_label(line->opcode)) {
+			mcc_asm_new_label(line->opcode, bindings[line->first.variable].label, data);
+			continue;
+		}
+		struct mcc_asm_operand *first = new_operand(&line->first, bindings, data);
+		struct mcc_asm_operand *second = new_operand(&line->second, bindings, data);
+		if (data->has_failed) {
+			mcc_asm_delete_operand(first);
+			mcc_asm_delete_operand(second);
+			return;
+		}
+		mcc_asm_new_line(line->opcode, first, second, data);
+	}
+}
+
+// Replace the lines from *link up to after. Returns false if memory allocation fails.
+static bool replace_lines(const struct mcc_peephole_rule *rule,
+                          struct binding *bindings,
+                          struct mcc_asm_line **link,
+                          struct mcc_asm_line *after)
+{
+	struct mcc_asm_line head = {.next = NULL};
+	struct mcc_asm_data data = {.has_failed = false, .current = &head};
+	new_lines(rule, bindings, &data);
+	if (data.has_failed) {
+		mcc_asm_delete_all_lines(head.next);
+		return false;
+	}
+
+	// The bound operands belong to the old lines, so they are deleted only now
+	struct mcc_asm_line *old = *link;
+	while (old != after) {
+		struct mcc_asm_line *next = old->next;
+		mcc_asm_delete_line(old);
+		old = next;
+	}
+	data.current->next = after;
+	*link = head.next ? head.next : after;
+	return true;
+}
+
+// Returns 1 if a rule was applied at *link, 0 if none matches and -1 if memory allocation fails
+static int apply_rules(struct mcc_asm_line **link, const struct mcc_peephole_rule *rules, unsigned num_rules)
+{
+	struct binding bindings[MCC_PEEPHOLE_MAX_VARIABLES];
+	struct mcc_asm_line *after = NULL;
+	for (unsigned i = 0; i < num_rules; i++) {
+		if (match_rule(&rules[i], *link, bindings, &after))
+			return replace_lines(&rules[i], bindings, link, after) ? 1 : -1;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------------ Functions: Peephole optimisation
+
+const struct mcc_peephole_rule *mcc_peephole_find_rule(const char *name)
+{
+	for (unsigned i = 0; i < mcc_peephole_num_rules; i++) {
+		if (strcmp(mcc_peephole_rules[i].name, name) == 0)
+			return &mcc_peephole_rules[i];
+	}
+	return NULL;
+}
+
+bool mcc_peephole_optimise_function(struct mcc_asm_function *function,
+                                    const struct mcc_peephole_rule *rules,
+                                    unsigned num_rules)
+{
+	assert(function);
+
+	// Every replacement is shorter than its pattern, so this terminates. A replacement may complete a pattern that
+	// starts in front of it, which the next round finds.
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		struct mcc_asm_line **link = &function->head;
+		while (*link) {
+			int applied = apply_rules(link, rules, num_rules);
+			if (applied < 0)
+				return false;
+			if (applied > 0) {
+				changed = true;
+				continue;
+			}
+			link = &(*link)->next;
+		}
+	}
+	return true;
+}
+
+bool mcc_peephole_run(struct mcc_asm *code)
+{
+	assert(code);
+
+	for (struct mcc_asm_function *function = code->text_section->function; function; function = function->next) {
+		if (!mcc_peephole_optimise_function(function, mcc_peephole_rules, mcc_peephole_num_rules))
+			return false;
+	}
+	return true;
+}
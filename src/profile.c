@@ -0,0 +1,271 @@
+#include "mcc/profile.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/length_of_int.h"
+
+// Longest function name a profile file may contain
+#define MAX_NAME_LENGTH 1023
+
+//---------------------------------------------------------------------------------------- Checksum
+
+// 32 bit FNV-1a, fed with one number at a time
+#define FNV_OFFSET_BASIS 2166136261ul
+#define FNV_PRIME 16777619ul
+
+static unsigned long hash(unsigned long checksum, unsigned long value)
+{
+	for (unsigned i = 0; i < 4; i++) {
+		checksum ^= (value >> (8 * i)) & 0xff;
+		checksum = (checksum * FNV_PRIME) & 0xffffffff;
+	}
+	return checksum;
+}
+
+static unsigned long hash_child(unsigned long checksum, struct mcc_basic_block *child)
+{
+	return hash(checksum, child ? child->id : 0xffffffff);
+}
+
+static unsigned count_blocks(struct mcc_basic_block *cfg)
+{
+	unsigned num_blocks = 0;
+	for (struct mcc_basic_block *block = cfg; block; block = block->next)
+		num_blocks++;
+	return num_blocks;
+}
+
+unsigned long mcc_profile_checksum(struct mcc_basic_block *cfg)
+{
+	assert(cfg);
+
+	unsigned long checksum = hash(FNV_OFFSET_BASIS, count_blocks(cfg));
+	for (struct mcc_basic_block *block = cfg; block; block = block->next) {
+		for (struct mcc_ir_row *row = block->leader; row; row = row->next_row) {
+			if (row->instr != MCC_IR_INSTR_COUNT)
+				checksum = hash(hash(checksum, row->instr), row->type->type);
+			if (row == block->last)
+				break;
+		}
+		checksum = hash_child(hash_child(checksum, block->child_left), block->child_right);
+	}
+	return checksum;
+}
+
+//---------------------------------------------------------------------------------------- Data structure
+
+static bool add_function(struct mcc_profile *profile, const char *name, unsigned long checksum, unsigned num_blocks)
+{
+	struct mcc_profile_function *functions =
+	    realloc(profile->functions, sizeof(*functions) * (profile->num_functions + 1));
+	if (!functions)
+		return false;
+	profile->functions = functions;
+	struct mcc_profile_function *function = &functions[profile->num_functions];
+	*function = (struct mcc_profile_function){.checksum = checksum, .num_blocks = num_blocks};
+	function->name = strdup(name);
+	if (!function->name)
+		return false;
+	profile->num_functions++;
+	return true;
+}
+
+static struct mcc_profile_function *find_function(struct mcc_profile *profile, const char *name)
+{
+	for (unsigned i = 0; i < profile->num_functions; i++) {
+		if (strcmp(profile->functions[i].name, name) == 0)
+			return &profile->functions[i];
+	}
+	return NULL;
+}
+
+void mcc_profile_delete(struct mcc_profile *profile)
+{
+	if (!profile)
+		return;
+	for (unsigned i = 0; i < profile->num_functions; i++) {
+		free(profile->functions[i].name);
+		free(profile->functions[i].counts);
+	}
+	free(profile->functions);
+	free(profile);
+}
+
+unsigned mcc_profile_num_counters(struct mcc_profile *profile)
+{
+	assert(profile);
+
+	unsigned num_counters = 0;
+	for (unsigned i = 0; i < profile->num_functions; i++)
+		num_counters += profile->functions[i].num_blocks;
+	return num_counters;
+}
+
+//---------------------------------------------------------------------------------------- Instrument
+
+// The first block takes the parameters before anything else
+static struct mcc_ir_row *get_counter_position(struct mcc_basic_block *block)
+{
+	struct mcc_ir_row *position = block->leader;
+	if (position->instr != MCC_IR_INSTR_FUNC_LABEL)
+		return position;
+	while (position->next_row && position->next_row->instr == MCC_IR_INSTR_POP && position->next_row->next_row &&
+	       position->next_row->next_row->instr == MCC_IR_INSTR_ASSIGN)
+		position = position->next_row->next_row;
+	return position;
+}
+
+static bool insert_counter(struct mcc_basic_block *block, unsigned counter)
+{
+	struct mcc_ir_arg *index = mcc_ir_new_arg_int(counter);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_row *row = index && type ? mcc_ir_new_row(index, NULL, MCC_IR_INSTR_COUNT, type) : NULL;
+	if (!row) {
+		mcc_ir_delete_ir_arg(index);
+		mcc_ir_delete_ir_row_type(type);
+		return false;
+	}
+
+	struct mcc_ir_row *position = get_counter_position(block);
+	if (block->leader->instr == MCC_IR_INSTR_LABEL || block->leader->instr == MCC_IR_INSTR_FUNC_LABEL)
+		mcc_ir_insert_row_after(position, row);
+	else
+		mcc_ir_insert_row_before(position, row);
+	return true;
+}
+
+struct mcc_profile *mcc_profile_instrument(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct mcc_profile *profile = calloc(1, sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	unsigned num_counters = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_FUNC_LABEL)
+			continue;
+		struct mcc_basic_block *cfg = mcc_cfg_generate_function(row);
+		bool ok = cfg && add_function(profile, row->arg1->func_label, mcc_profile_checksum(cfg), count_blocks(cfg));
+		for (struct mcc_basic_block *block = cfg; block && ok; block = block->next)
+			ok = insert_counter(block, num_counters + block->id);
+		num_counters += ok ? count_blocks(cfg) : 0;
+		mcc_cfg_delete_cfg(cfg);
+		if (!ok) {
+			mcc_profile_delete(profile);
+			return NULL;
+		}
+	}
+	return profile;
+}
+
+char *mcc_profile_header(struct mcc_profile *profile, const char *file)
+{
+	assert(profile);
+	assert(file);
+
+	// Checksums have at most 8 hex digits
+	size_t size = strlen(file) + 2;
+	for (unsigned i = 0; i < profile->num_functions; i++) {
+		size += strlen(profile->functions[i].name) + 1 + 8 + 1 + length_of_int(profile->functions[i].num_blocks) + 1;
+	}
+	char *header = malloc(size);
+	if (!header)
+		return NULL;
+	size_t length = snprintf(header, size, "%s\n", file);
+	for (unsigned i = 0; i < profile->num_functions; i++) {
+		struct mcc_profile_function *function = &profile->functions[i];
+		length += snprintf(header + length, size - length, "%s %lx %u\n", function->name, function->checksum,
+		                   function->num_blocks);
+	}
+	return header;
+}
+
+//---------------------------------------------------------------------------------------- Read
+
+static bool read_function(FILE *in, struct mcc_profile *profile, const char *name)
+{
+	unsigned long checksum = 0;
+	unsigned num_blocks = 0;
+	if (fscanf(in, "%lx %u", &checksum, &num_blocks) != 2)
+		return false;
+	unsigned long long *counts = malloc(sizeof(*counts) * (num_blocks > 0 ? num_blocks : 1));
+	if (!counts)
+		return false;
+	for (unsigned i = 0; i < num_blocks; i++) {
+		if (fscanf(in, "%llu", &counts[i]) != 1) {
+			free(counts);
+			return false;
+		}
+	}
+	if (!add_function(profile, name, checksum, num_blocks)) {
+		free(counts);
+		return false;
+	}
+	profile->functions[profile->num_functions - 1].counts = counts;
+	return true;
+}
+
+struct mcc_profile *mcc_profile_read(FILE *in)
+{
+	assert(in);
+
+	unsigned version = 0;
+	if (fscanf(in, " mcc-profile %u", &version) != 1 || version != MCC_PROFILE_VERSION)
+		return NULL;
+	struct mcc_profile *profile = calloc(1, sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	char name[MAX_NAME_LENGTH + 1];
+	int read = 0;
+	while ((read = fscanf(in, " function %1023s", name)) == 1) {
+		if (!read_function(in, profile, name)) {
+			mcc_profile_delete(profile);
+			return NULL;
+		}
+	}
+	// Anything but the end of the file is malformed
+	if (read != EOF) {
+		mcc_profile_delete(profile);
+		return NULL;
+	}
+	return profile;
+}
+
+//---------------------------------------------------------------------------------------- Annotate
+
+static void annotate_function(struct mcc_basic_block *cfg, struct mcc_profile_function *function)
+{
+	for (struct mcc_basic_block *block = cfg; block; block = block->next) {
+		for (struct mcc_ir_row *row = block->leader; row; row = row->next_row) {
+			row->profile_count = (long long)function->counts[block->id];
+			if (row == block->last)
+				break;
+		}
+	}
+}
+
+bool mcc_profile_annotate(struct mcc_ir_row *ir, struct mcc_profile *profile)
+{
+	assert(ir);
+	assert(profile);
+
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_FUNC_LABEL)
+			continue;
+		struct mcc_profile_function *function = find_function(profile, row->arg1->func_label);
+		if (!function || !function->counts)
+			continue;
+		struct mcc_basic_block *cfg = mcc_cfg_generate_function(row);
+		if (!cfg)
+			return false;
+		if (mcc_profile_checksum(cfg) == function->checksum && count_blocks(cfg) == function->num_blocks)
+			annotate_function(cfg, function);
+		mcc_cfg_delete_cfg(cfg);
+	}
+	return true;
+}
@@ -0,0 +1,818 @@
+#include "mcc/specialize.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct function_info {
+	struct mcc_ir_row *label;
+	unsigned num_params;
+	unsigned num_clones;
+};
+
+// A function with some of its parameters bound to literals
+struct clone {
+	struct function_info *function;
+	// One for each parameter, NULL if the parameter is not bound
+	struct mcc_ir_arg **values;
+	// NULL if the clone folded nothing and was dropped again
+	char *name;
+	struct clone *next;
+};
+
+struct specialize_data {
+	unsigned num_functions;
+	struct function_info *functions;
+	struct clone *clones;
+	// IR rows of all clones that were kept
+	unsigned size;
+	unsigned counter;
+};
+
+// State for copying a function into a clone
+struct copy_data {
+	struct clone *clone;
+	// One for each parameter, uses of bound parameters in the rows of the body before this position are replaced by
+	// the literal
+	unsigned *limits;
+	// Position of the copied row in the body
+	unsigned position;
+	unsigned num_rows;
+	struct mcc_ir_row **old_rows;
+	struct mcc_ir_row **new_rows;
+	unsigned num_labels;
+	unsigned *old_labels;
+	unsigned first_label;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+static unsigned count_params(struct mcc_ir_row *label)
+{
+	unsigned num_params = 0;
+	struct mcc_ir_row *row = label->next_row;
+	while (row && row->instr == MCC_IR_INSTR_POP && row->next_row && row->next_row->instr == MCC_IR_INSTR_ASSIGN) {
+		num_params++;
+		row = row->next_row->next_row;
+	}
+	return num_params;
+}
+
+// POP row of the parameter with the given index, it is followed by the assignment to the parameter. The index of the
+// first row after the parameters is the number of parameters.
+static struct mcc_ir_row *get_param_pop(struct function_info *function, unsigned index)
+{
+	struct mcc_ir_row *row = function->label->next_row;
+	for (unsigned i = 0; i < index; i++) {
+		row = row->next_row->next_row;
+	}
+	return row;
+}
+
+static char *get_param_name(struct function_info *function, unsigned index)
+{
+	return get_param_pop(function, index)->next_row->arg1->ident;
+}
+
+static unsigned count_rows(struct mcc_ir_row *label)
+{
+	unsigned size = 0;
+	for (struct mcc_ir_row *row = label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		size++;
+	}
+	return size;
+}
+
+static struct function_info *find_function(struct specialize_data *data, char *name)
+{
+	for (unsigned i = 0; i < data->num_functions; i++) {
+		if (strcmp(data->functions[i].label->arg1->func_label, name) == 0)
+			return &data->functions[i];
+	}
+	return NULL;
+}
+
+// Only the functions of the IR before specializing, clones are not specialized again
+static bool collect_functions(struct mcc_ir_row *ir, struct specialize_data *data)
+{
+	data->num_functions = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL)
+			data->num_functions++;
+	}
+	data->functions = calloc(data->num_functions + 1, sizeof(*data->functions));
+	if (!data->functions)
+		return false;
+
+	unsigned i = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL) {
+			data->functions[i].label = row;
+			data->functions[i].num_params = count_params(row);
+			i++;
+		}
+	}
+	return true;
+}
+
+static unsigned get_label_position(struct mcc_ir_row *body, unsigned label)
+{
+	unsigned position = 0;
+	for (struct mcc_ir_row *row = body; !mcc_ir_is_function_end(row); row = row->next_row, position++) {
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label == label)
+			return position;
+	}
+	return position;
+}
+
+// Rows of the body before the returned position see the value the parameter was passed. That is up to the first
+// assignment to the parameter, and up to the first target of a jump back from there. UINT_MAX if the function does
+// not assign the parameter.
+static unsigned get_param_limit(struct function_info *function, unsigned index)
+{
+	char *name = get_param_name(function, index);
+	struct mcc_ir_row *body = get_param_pop(function, function->num_params);
+	unsigned limit = UINT_MAX;
+	unsigned position = 0;
+	for (struct mcc_ir_row *row = body; !mcc_ir_is_function_end(row); row = row->next_row, position++) {
+		if (limit == UINT_MAX && row->instr == MCC_IR_INSTR_ASSIGN && row->arg1->type == MCC_IR_TYPE_IDENTIFIER &&
+		    strcmp(row->arg1->ident, name) == 0)
+			limit = position;
+		if (limit == UINT_MAX)
+			continue;
+		if (row->instr == MCC_IR_INSTR_JUMP && get_label_position(body, row->arg1->label) < limit)
+			limit = get_label_position(body, row->arg1->label);
+		if (row->instr == MCC_IR_INSTR_JUMPFALSE && get_label_position(body, row->arg2->label) < limit)
+			limit = get_label_position(body, row->arg2->label);
+	}
+	return limit;
+}
+
+static void delete_function(struct mcc_ir_row *label)
+{
+	while (!mcc_ir_is_function_end(label->next_row)) {
+		struct mcc_ir_row *row = label->next_row;
+		mcc_ir_unlink_row(row);
+		mcc_ir_delete_ir_row(row);
+	}
+	mcc_ir_unlink_row(label);
+	mcc_ir_delete_ir_row(label);
+}
+
+//---------------------------------------------------------------------------------------- Call sites
+
+// Push row of the argument with the given index. Arguments are pushed in reverse order right before the call.
+static struct mcc_ir_row *get_push(struct mcc_ir_row *call, unsigned index)
+{
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < index; i++) {
+		push = push->prev_row;
+	}
+	return push;
+}
+
+static bool has_matching_pushes(struct function_info *function, struct mcc_ir_row *call)
+{
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (!push || push->instr != MCC_IR_INSTR_PUSH)
+			return false;
+		push = push->prev_row;
+	}
+	return true;
+}
+
+// Scalar int and bool parameters that are passed a literal are bound
+static bool is_bound(struct function_info *function, struct mcc_ir_row *call, unsigned index)
+{
+	struct mcc_ir_row *pop = get_param_pop(function, index);
+	struct mcc_ir_arg *arg = get_push(call, index)->arg1;
+	if (pop->type->array_size >= 0)
+		return false;
+	return (pop->type->type == MCC_IR_ROW_INT && arg->type == MCC_IR_TYPE_LIT_INT) ||
+	       (pop->type->type == MCC_IR_ROW_BOOL && arg->type == MCC_IR_TYPE_LIT_BOOL);
+}
+
+static bool binds_literal(struct function_info *function, struct mcc_ir_row *call)
+{
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (is_bound(function, call, i))
+			return true;
+	}
+	return false;
+}
+
+static bool is_same_literal(struct mcc_ir_arg *value, struct mcc_ir_arg *arg)
+{
+	if (value->type != arg->type)
+		return false;
+	return value->type == MCC_IR_TYPE_LIT_INT ? value->lit_int == arg->lit_int : value->lit_bool == arg->lit_bool;
+}
+
+static struct clone *find_clone(struct specialize_data *data, struct function_info *function, struct mcc_ir_row *call)
+{
+	for (struct clone *clone = data->clones; clone; clone = clone->next) {
+		if (clone->function != function)
+			continue;
+		bool matches = true;
+		for (unsigned i = 0; i < function->num_params && matches; i++) {
+			if (is_bound(function, call, i))
+				matches = clone->values[i] && is_same_literal(clone->values[i], get_push(call, i)->arg1);
+			else
+				matches = !clone->values[i];
+		}
+		if (matches)
+			return clone;
+	}
+	return NULL;
+}
+
+static struct clone *new_clone(struct specialize_data *data, struct function_info *function, struct mcc_ir_row *call)
+{
+	struct clone *clone = calloc(1, sizeof(*clone));
+	if (!clone)
+		return NULL;
+	clone->function = function;
+	clone->next = data->clones;
+	data->clones = clone;
+
+	clone->values = calloc(function->num_params + 1, sizeof(*clone->values));
+	if (!clone->values)
+		return NULL;
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (!is_bound(function, call, i))
+			continue;
+		clone->values[i] = mcc_ir_copy_arg(get_push(call, i)->arg1);
+		if (!clone->values[i])
+			return NULL;
+	}
+	return clone;
+}
+
+static void delete_clones(struct clone *clone)
+{
+	while (clone) {
+		struct clone *next = clone->next;
+		for (unsigned i = 0; clone->values && i < clone->function->num_params; i++) {
+			mcc_ir_delete_ir_arg(clone->values[i]);
+		}
+		free(clone->values);
+		free(clone->name);
+		free(clone);
+		clone = next;
+	}
+}
+
+// Call the clone instead and drop the pushes of the bound arguments
+static bool redirect_call(struct mcc_ir_row *call, struct clone *clone)
+{
+	char *name = strdup(clone->name);
+	if (!name)
+		return false;
+	free(call->arg1->func_label);
+	call->arg1->func_label = name;
+
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < clone->function->num_params; i++) {
+		struct mcc_ir_row *previous = push->prev_row;
+		if (clone->values[i]) {
+			mcc_ir_unlink_row(push);
+			mcc_ir_delete_ir_row(push);
+		}
+		push = previous;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Copying
+
+static struct mcc_ir_row *get_new_row(struct copy_data *copy, struct mcc_ir_row *row)
+{
+	for (unsigned i = 0; i < copy->num_rows; i++) {
+		if (copy->old_rows[i] == row)
+			return copy->new_rows[i];
+	}
+	return row;
+}
+
+static unsigned get_new_label(struct copy_data *copy, unsigned label)
+{
+	for (unsigned i = 0; i < copy->num_labels; i++) {
+		if (copy->old_labels[i] == label)
+			return copy->first_label + i;
+	}
+	return label;
+}
+
+// Float and string temporaries end up in the data section, so the copies need names of their own. The suffix of the
+// clone's name is appended.
+static bool rename_temporary(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	char *suffix = strrchr(copy->clone->name, '.');
+	size_t size = strlen(arg->ident) + strlen(suffix) + 1;
+	char *name = malloc(size);
+	if (!name)
+		return false;
+	snprintf(name, size, "%s%s", arg->ident, suffix);
+	free(arg->ident);
+	arg->ident = name;
+	return true;
+}
+
+// Renumber rows, labels and temporaries of a copied argument and put in the literals of bound parameters
+static bool rename_arg(struct copy_data *copy, struct mcc_ir_arg **arg)
+{
+	switch ((*arg)->type) {
+	case MCC_IR_TYPE_IDENTIFIER:
+		if (strncmp((*arg)->ident, "$tmp", 4) == 0)
+			return rename_temporary(copy, *arg);
+		for (unsigned i = 0; i < copy->clone->function->num_params; i++) {
+			if (copy->position >= copy->limits[i] ||
+			    strcmp(get_param_name(copy->clone->function, i), (*arg)->ident) != 0)
+				continue;
+			struct mcc_ir_arg *value = mcc_ir_copy_arg(copy->clone->values[i]);
+			if (!value)
+				return false;
+			mcc_ir_delete_ir_arg(*arg);
+			*arg = value;
+			return true;
+		}
+		return true;
+	case MCC_IR_TYPE_ARR_ELEM:
+		return rename_arg(copy, &(*arg)->index);
+	case MCC_IR_TYPE_ROW:
+		(*arg)->row = get_new_row(copy, (*arg)->row);
+		return true;
+	case MCC_IR_TYPE_LABEL:
+		(*arg)->label = get_new_label(copy, (*arg)->label);
+		return true;
+	default:
+		return true;
+	}
+}
+
+static struct mcc_ir_arg *copy_renamed_arg(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_arg *new_arg = mcc_ir_copy_arg(arg);
+	if (new_arg && !rename_arg(copy, &new_arg)) {
+		mcc_ir_delete_ir_arg(new_arg);
+		return NULL;
+	}
+	return new_arg;
+}
+
+static struct mcc_ir_row *new_row(struct mcc_ir_arg *arg1,
+                                  struct mcc_ir_arg *arg2,
+                                  enum mcc_ir_instruction instr,
+                                  struct mcc_ir_row_type *type,
+                                  bool args_ok)
+{
+	struct mcc_ir_row *row = NULL;
+	if (args_ok && type)
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+	}
+	return row;
+}
+
+// Copy a row behind position. Returns NULL if memory allocation fails.
+static struct mcc_ir_row *copy_row(struct copy_data *copy, struct mcc_ir_row *row, struct mcc_ir_row *position)
+{
+	struct mcc_ir_arg *arg1 = row->arg1 ? copy_renamed_arg(copy, row->arg1) : NULL;
+	struct mcc_ir_arg *arg2 = row->arg2 ? copy_renamed_arg(copy, row->arg2) : NULL;
+	bool args_ok = (!row->arg1 || arg1) && (!row->arg2 || arg2);
+	struct mcc_ir_row *new =
+	    new_row(arg1, arg2, row->instr, mcc_ir_new_row_type(row->type->type, row->type->array_size), args_ok);
+	if (!new)
+		return NULL;
+	mcc_ir_insert_row_after(position, new);
+	copy->old_rows[copy->num_rows] = row;
+	copy->new_rows[copy->num_rows] = new;
+	copy->num_rows++;
+	return new;
+}
+
+// Bound parameters the function assigns become variables that start with the literal
+static struct mcc_ir_row *copy_params(struct copy_data *copy, struct mcc_ir_row *position)
+{
+	struct function_info *function = copy->clone->function;
+	for (unsigned i = 0; i < function->num_params && position; i++) {
+		struct mcc_ir_row *pop = get_param_pop(function, i);
+		if (!copy->clone->values[i]) {
+			position = copy_row(copy, pop, position);
+			position = position ? copy_row(copy, pop->next_row, position) : NULL;
+		}
+	}
+	for (unsigned i = 0; i < function->num_params && position; i++) {
+		if (!copy->clone->values[i] || copy->limits[i] == UINT_MAX)
+			continue;
+		struct mcc_ir_row *param = get_param_pop(function, i)->next_row;
+		struct mcc_ir_arg *variable = mcc_ir_new_arg_identifier(param->arg1->ident);
+		struct mcc_ir_arg *value = mcc_ir_copy_arg(copy->clone->values[i]);
+		struct mcc_ir_row *assign = new_row(variable, value, MCC_IR_INSTR_ASSIGN,
+		                                    mcc_ir_new_row_type(param->type->type, -1), variable && value);
+		if (assign)
+			mcc_ir_insert_row_after(position, assign);
+		position = assign;
+	}
+	return position;
+}
+
+static bool set_up_copy(struct copy_data *copy, struct clone *clone)
+{
+	struct function_info *function = clone->function;
+	unsigned size = count_rows(function->label);
+	copy->clone = clone;
+	copy->limits = calloc(function->num_params + 1, sizeof(*copy->limits));
+	copy->old_rows = malloc(sizeof(*copy->old_rows) * (size + 1));
+	copy->new_rows = malloc(sizeof(*copy->new_rows) * (size + 1));
+	copy->old_labels = malloc(sizeof(*copy->old_labels) * (size + 1));
+	if (!copy->limits || !copy->old_rows || !copy->new_rows || !copy->old_labels)
+		return false;
+
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (clone->values[i])
+			copy->limits[i] = get_param_limit(function, i);
+	}
+	for (struct mcc_ir_row *row = function->label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL)
+			copy->old_labels[copy->num_labels++] = row->arg1->label;
+	}
+	copy->first_label = mcc_ir_get_unused_label(function->label);
+	return true;
+}
+
+static void delete_copy(struct copy_data *copy)
+{
+	free(copy->limits);
+	free(copy->old_rows);
+	free(copy->new_rows);
+	free(copy->old_labels);
+}
+
+// Copy the function behind itself. Returns the label of the copy, NULL if memory allocation fails.
+static struct mcc_ir_row *copy_function(struct clone *clone)
+{
+	struct function_info *function = clone->function;
+	struct mcc_ir_row *last = function->label;
+	while (!mcc_ir_is_function_end(last->next_row)) {
+		last = last->next_row;
+	}
+
+	struct mcc_ir_arg *name = mcc_ir_copy_arg(function->label->arg1);
+	char *clone_name = name ? strdup(clone->name) : NULL;
+	if (clone_name) {
+		free(name->func_label);
+		name->func_label = clone_name;
+	}
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(function->label->type->type, function->label->type->array_size);
+	struct mcc_ir_row *label = new_row(name, NULL, MCC_IR_INSTR_FUNC_LABEL, type, clone_name != NULL);
+	if (!label)
+		return NULL;
+	mcc_ir_insert_row_after(last, label);
+
+	struct copy_data copy = {.num_rows = 0, .num_labels = 0};
+	bool ok = set_up_copy(&copy, clone);
+	struct mcc_ir_row *position = ok ? copy_params(&copy, label) : NULL;
+	for (struct mcc_ir_row *row = get_param_pop(function, function->num_params);
+	     position && !mcc_ir_is_function_end(row); row = row->next_row, copy.position++) {
+		position = copy_row(&copy, row, position);
+	}
+	delete_copy(&copy);
+	if (!position) {
+		delete_function(label);
+		return NULL;
+	}
+	return label;
+}
+
+//---------------------------------------------------------------------------------------- Constant propagation
+
+// Wrap around like 32 bit integer arithmetic
+static long wrap(long value)
+{
+	return (long)(int32_t)(uint32_t)(unsigned long)value;
+}
+
+static bool fold_int(enum mcc_ir_instruction instr, long a, long b, struct mcc_ir_arg *value)
+{
+	value->type = MCC_IR_TYPE_LIT_BOOL;
+	switch (instr) {
+	case MCC_IR_INSTR_PLUS:
+		value->type = MCC_IR_TYPE_LIT_INT;
+		value->lit_int = wrap(a + b);
+		return true;
+	case MCC_IR_INSTR_MINUS:
+		value->type = MCC_IR_TYPE_LIT_INT;
+		value->lit_int = wrap(a - b);
+		return true;
+	case MCC_IR_INSTR_MULTIPLY:
+		value->type = MCC_IR_TYPE_LIT_INT;
+		value->lit_int = wrap(a * b);
+		return true;
+	case MCC_IR_INSTR_DIVIDE:
+		// Division by zero and the overflowing division trap at runtime, which is left to the program
+		if (b == 0 || (a == INT32_MIN && b == -1))
+			return false;
+		value->type = MCC_IR_TYPE_LIT_INT;
+		value->lit_int = a / b;
+		return true;
+	case MCC_IR_INSTR_EQUALS:
+		value->lit_bool = a == b;
+		return true;
+	case MCC_IR_INSTR_NOTEQUALS:
+		value->lit_bool = a != b;
+		return true;
+	case MCC_IR_INSTR_SMALLER:
+		value->lit_bool = a < b;
+		return true;
+	case MCC_IR_INSTR_GREATER:
+		value->lit_bool = a > b;
+		return true;
+	case MCC_IR_INSTR_SMALLEREQ:
+		value->lit_bool = a <= b;
+		return true;
+	case MCC_IR_INSTR_GREATEREQ:
+		value->lit_bool = a >= b;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool fold_bool(enum mcc_ir_instruction instr, bool a, bool b, struct mcc_ir_arg *value)
+{
+	value->type = MCC_IR_TYPE_LIT_BOOL;
+	switch (instr) {
+	case MCC_IR_INSTR_EQUALS:
+		value->lit_bool = a == b;
+		return true;
+	case MCC_IR_INSTR_NOTEQUALS:
+		value->lit_bool = a != b;
+		return true;
+	case MCC_IR_INSTR_AND:
+		value->lit_bool = a && b;
+		return true;
+	case MCC_IR_INSTR_OR:
+		value->lit_bool = a || b;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Compute the value of a row with literal operands. Returns false if the row cannot be folded.
+static bool fold(struct mcc_ir_row *row, struct mcc_ir_arg *value)
+{
+	struct mcc_ir_arg *a = row->arg1;
+	struct mcc_ir_arg *b = row->arg2;
+	if (!a || row->type->lanes != 1)
+		return false;
+	if (row->instr == MCC_IR_INSTR_NOT && a->type == MCC_IR_TYPE_LIT_BOOL) {
+		value->type = MCC_IR_TYPE_LIT_BOOL;
+		value->lit_bool = !a->lit_bool;
+		return true;
+	}
+	if (row->instr == MCC_IR_INSTR_NEGATIV && a->type == MCC_IR_TYPE_LIT_INT) {
+		value->type = MCC_IR_TYPE_LIT_INT;
+		value->lit_int = wrap(-a->lit_int);
+		return true;
+	}
+	if (!b || a->type != b->type)
+		return false;
+	if (a->type == MCC_IR_TYPE_LIT_INT)
+		return fold_int(row->instr, a->lit_int, b->lit_int, value);
+	if (a->type == MCC_IR_TYPE_LIT_BOOL)
+		return fold_bool(row->instr, a->lit_bool, b->lit_bool, value);
+	return false;
+}
+
+static bool is_jump_target(struct mcc_ir_row *function_label, unsigned label)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if ((row->instr == MCC_IR_INSTR_JUMP && row->arg1->label == label) ||
+		    (row->instr == MCC_IR_INSTR_JUMPFALSE && row->arg2->label == label))
+			return true;
+	}
+	return false;
+}
+
+static void remove_row(struct mcc_ir_row *row)
+{
+	mcc_ir_unlink_row(row);
+	mcc_ir_delete_ir_row(row);
+}
+
+// A conditional jump on a literal either always jumps or never
+static void fold_jump(struct mcc_ir_row *row)
+{
+	if (row->arg1->lit_bool) {
+		remove_row(row);
+		return;
+	}
+	mcc_ir_delete_ir_arg(row->arg1);
+	row->instr = MCC_IR_INSTR_JUMP;
+	row->arg1 = row->arg2;
+	row->arg2 = NULL;
+}
+
+static bool uses_row(struct mcc_ir_arg *arg, struct mcc_ir_row *row)
+{
+	if (!arg)
+		return false;
+	if (arg->type == MCC_IR_TYPE_ARR_ELEM)
+		return uses_row(arg->index, row);
+	return arg->type == MCC_IR_TYPE_ROW && arg->row == row;
+}
+
+// State for finding the rows that can be executed
+struct reach_data {
+	unsigned num_rows;
+	struct mcc_ir_row **rows;
+	bool *is_reachable;
+	unsigned *stack;
+	unsigned size;
+};
+
+static void push_label(struct reach_data *reach, unsigned label)
+{
+	for (unsigned i = 0; i < reach->num_rows; i++) {
+		if (reach->rows[i]->instr == MCC_IR_INSTR_LABEL && reach->rows[i]->arg1->label == label) {
+			reach->stack[reach->size++] = i;
+			return;
+		}
+	}
+}
+
+// Every row is marked once and pushes at most one label
+static void mark_reachable(struct reach_data *reach)
+{
+	reach->stack[reach->size++] = 0;
+	while (reach->size > 0) {
+		unsigned i = reach->stack[--reach->size];
+		for (; i < reach->num_rows && !reach->is_reachable[i]; i++) {
+			struct mcc_ir_row *row = reach->rows[i];
+			reach->is_reachable[i] = true;
+			if (row->instr == MCC_IR_INSTR_JUMP) {
+				push_label(reach, row->arg1->label);
+				break;
+			}
+			if (row->instr == MCC_IR_INSTR_RETURN)
+				break;
+			if (row->instr == MCC_IR_INSTR_JUMPFALSE)
+				push_label(reach, row->arg2->label);
+		}
+	}
+}
+
+static bool is_used_by_reachable_row(struct reach_data *reach, struct mcc_ir_row *row)
+{
+	for (unsigned i = 0; i < reach->num_rows; i++) {
+		if (reach->is_reachable[i] && (uses_row(reach->rows[i]->arg1, row) || uses_row(reach->rows[i]->arg2, row)))
+			return true;
+	}
+	return false;
+}
+
+// Remove the rows no path from the start of the function reaches. Returns false if memory allocation fails.
+static bool remove_unreachable_rows(struct mcc_ir_row *label, bool *has_changed)
+{
+	struct reach_data reach = {.num_rows = count_rows(label), .size = 0};
+	reach.rows = malloc(sizeof(*reach.rows) * (reach.num_rows + 1));
+	reach.is_reachable = calloc(reach.num_rows + 1, sizeof(*reach.is_reachable));
+	reach.stack = malloc(sizeof(*reach.stack) * (reach.num_rows + 1));
+	if (!reach.rows || !reach.is_reachable || !reach.stack) {
+		free(reach.rows);
+		free(reach.is_reachable);
+		free(reach.stack);
+		return false;
+	}
+
+	unsigned i = 0;
+	for (struct mcc_ir_row *row = label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		reach.rows[i++] = row;
+	}
+	mark_reachable(&reach);
+	for (i = 0; i < reach.num_rows; i++) {
+		if (reach.is_reachable[i] || is_used_by_reachable_row(&reach, reach.rows[i]))
+			continue;
+		remove_row(reach.rows[i]);
+		*has_changed = true;
+	}
+	free(reach.rows);
+	free(reach.is_reachable);
+	free(reach.stack);
+	return true;
+}
+
+// Fold the rows of a function until nothing changes. Returns false if memory allocation fails.
+static bool propagate_constants(struct mcc_ir_row *label, unsigned *num_folded)
+{
+	bool has_changed = true;
+	while (has_changed) {
+		has_changed = false;
+		struct mcc_ir_row *next = NULL;
+		for (struct mcc_ir_row *row = label->next_row; !mcc_ir_is_function_end(row); row = next) {
+			next = row->next_row;
+			struct mcc_ir_arg value;
+			if (fold(row, &value)) {
+				if (!mcc_ir_replace_row_uses(label, row, &value))
+					return false;
+				remove_row(row);
+				(*num_folded)++;
+			} else if (row->instr == MCC_IR_INSTR_JUMPFALSE && row->arg1->type == MCC_IR_TYPE_LIT_BOOL) {
+				fold_jump(row);
+				(*num_folded)++;
+			} else if (row->instr == MCC_IR_INSTR_LABEL && !is_jump_target(label, row->arg1->label)) {
+				remove_row(row);
+			} else if (row->instr == MCC_IR_INSTR_JUMP && !mcc_ir_is_function_end(next) &&
+			           next->instr == MCC_IR_INSTR_LABEL && next->arg1->label == row->arg1->label) {
+				remove_row(row);
+			} else {
+				continue;
+			}
+			has_changed = true;
+		}
+		if (!remove_unreachable_rows(label, &has_changed))
+			return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Specializing
+
+// Returns false if memory allocation fails. Clones that do not fold anything or do not fit into the budget are
+// dropped, their name stays NULL.
+static bool specialize(struct specialize_data *data, struct clone *clone)
+{
+	struct function_info *function = clone->function;
+	if (function->num_clones >= MCC_SPECIALIZE_MAX_CLONES)
+		return true;
+
+	char *name = function->label->arg1->func_label;
+	size_t size = strlen(name) + 16;
+	clone->name = malloc(size);
+	if (!clone->name)
+		return false;
+	snprintf(clone->name, size, "%s.s%u", name, data->counter++);
+
+	struct mcc_ir_row *label = copy_function(clone);
+	unsigned num_folded = 0;
+	if (!label || !propagate_constants(label, &num_folded)) {
+		if (label)
+			delete_function(label);
+		return false;
+	}
+
+	unsigned num_rows = count_rows(label) + 1;
+	if (num_folded == 0 || data->size + num_rows > MCC_SPECIALIZE_BUDGET) {
+		delete_function(label);
+		free(clone->name);
+		clone->name = NULL;
+		return true;
+	}
+	data->size += num_rows;
+	function->num_clones++;
+	return true;
+}
+
+static bool specialize_call(struct specialize_data *data, struct mcc_ir_row *call)
+{
+	struct function_info *function = find_function(data, call->arg1->func_label);
+	if (!function || strcmp(function->label->arg1->func_label, "main") == 0)
+		return true;
+	if (!has_matching_pushes(function, call) || !binds_literal(function, call))
+		return true;
+
+	struct clone *clone = find_clone(data, function, call);
+	if (!clone) {
+		clone = new_clone(data, function, call);
+		if (!clone || !specialize(data, clone))
+			return false;
+	}
+	return !clone->name || redirect_call(call, clone);
+}
+
+bool mcc_specialize_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	struct specialize_data data = {.clones = NULL, .size = 0, .counter = 0};
+	bool ok = collect_functions(ir, &data);
+
+	// Clones are inserted behind their function, calls in them are specialized as well
+	for (struct mcc_ir_row *row = ir; row && ok; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_CALL)
+			ok = specialize_call(&data, row);
+	}
+	delete_clones(data.clones);
+	free(data.functions);
+	mcc_ir_number_rows(ir);
+	return ok;
+}
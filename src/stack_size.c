@@ -22,6 +22,8 @@ struct mcc_annotated_ir *mcc_new_annotated_ir(struct mcc_ir_row *row, int stack_
 		return NULL;
 	ir->stack_size = stack_size;
 	ir->stack_position = 0;
+	ir->tree = NULL;
+	ir->is_folded = false;
 	ir->row = row;
 	ir->next = NULL;
 	ir->prev = NULL;
@@ -40,7 +42,7 @@ void mcc_delete_annotated_ir(struct mcc_annotated_ir *head)
 // --------------------------------------------------------------------------------------- Forward declarations
 
 static struct mcc_ir_row *first_line_of_function(struct mcc_ir_row *ir);
-static int get_row_size(struct mcc_ir_row *ir);
+static int get_row_size(struct mcc_ir_row *ir, int slot_size);
 
 // --------------------------------------------------------------------------------------- Calc stack size and position
 
@@ -70,7 +72,7 @@ static bool assignment_is_first_occurence(struct mcc_ir_row *first, struct mcc_i
 	return true;
 }
 
-static int get_var_size(struct mcc_ir_row *ir)
+static int get_var_size(struct mcc_ir_row *ir, int slot_size)
 {
 	assert(ir);
 	assert(ir->instr == MCC_IR_INSTR_ASSIGN);
@@ -81,7 +83,7 @@ static int get_var_size(struct mcc_ir_row *ir)
 		return 0;
 	}
 	if (ir->type->type != MCC_IR_ROW_TYPELESS)
-		return DWORD_SIZE;
+		return slot_size;
 	return 0;
 }
 
@@ -97,23 +99,38 @@ static struct mcc_ir_row *first_line_of_function(struct mcc_ir_row *ir)
 	return NULL;
 }
 
-static int get_row_size(struct mcc_ir_row *ir)
+static int get_row_size(struct mcc_ir_row *ir, int slot_size)
 {
 	assert(ir);
 
+	// Vector rows hold one value per lane
 	if (ir->type->type != MCC_IR_ROW_TYPELESS)
-		return DWORD_SIZE;
+		return slot_size * ir->type->lanes;
 	return 0;
 }
 
-static int get_stack_frame_size(struct mcc_ir_row *ir)
+// Bool arrays take a byte per element, or a bit if they are packed. Their size is rounded up to whole slots, which
+// keeps the slots below them aligned and lets packed arrays be accessed a DWORD of 32 elements at a time.
+static int get_array_size(struct mcc_ir_row *ir, const struct mcc_stack_layout *layout)
+{
+	int slot_size = layout->slot_size;
+	if (ir->type->type != MCC_IR_ROW_BOOL)
+		return get_row_size(ir, slot_size) * ir->type->array_size;
+
+	int size = layout->pack_bool_arrays ? (ir->type->array_size + 7) / 8 : ir->type->array_size;
+	return (size + slot_size - 1) / slot_size * slot_size;
+}
+
+static int get_stack_frame_size(struct mcc_ir_row *ir, const struct mcc_stack_layout *layout)
 {
 	assert(ir);
 
+	int slot_size = layout->slot_size;
+
 	switch (ir->instr) {
 	// Assignment of variables to immediate value or temporary:
 	case MCC_IR_INSTR_ASSIGN:
-		return get_var_size(ir);
+		return get_var_size(ir, slot_size);
 
 	// Assignment of temporary: Int or Float
 	case MCC_IR_INSTR_PLUS:
@@ -121,7 +138,9 @@ static int get_stack_frame_size(struct mcc_ir_row *ir)
 	case MCC_IR_INSTR_MINUS:
 	case MCC_IR_INSTR_MULTIPLY:
 	case MCC_IR_INSTR_NEGATIV:
-		return get_row_size(ir);
+	case MCC_IR_INSTR_MIN:
+	case MCC_IR_INSTR_MAX:
+		return get_row_size(ir, slot_size);
 
 	// Assignment of temporary: Bool
 	case MCC_IR_INSTR_AND:
@@ -133,14 +152,14 @@ static int get_stack_frame_size(struct mcc_ir_row *ir)
 	case MCC_IR_INSTR_NOT:
 	case MCC_IR_INSTR_SMALLER:
 	case MCC_IR_INSTR_SMALLEREQ:
-		return DWORD_SIZE;
+		return slot_size;
 
 	case MCC_IR_INSTR_CALL:
-		return get_row_size(ir);
+		return get_row_size(ir, slot_size);
 
 	// Size of entire array
 	case MCC_IR_INSTR_ARRAY:
-		return get_row_size(ir) * ir->type->array_size;
+		return get_array_size(ir, layout);
 
 	// Labels: Size 0
 	case MCC_IR_INSTR_LABEL:
@@ -152,12 +171,13 @@ static int get_stack_frame_size(struct mcc_ir_row *ir)
 	case MCC_IR_INSTR_POP:
 	case MCC_IR_INSTR_RETURN:
 	case MCC_IR_INSTR_PUSH:
+	case MCC_IR_INSTR_COUNT:
 	default:
 		return 0;
 	}
 }
 
-static struct mcc_annotated_ir *add_stack_sizes(struct mcc_ir_row *ir)
+static struct mcc_annotated_ir *add_stack_sizes(struct mcc_ir_row *ir, const struct mcc_stack_layout *layout)
 {
 	assert(ir);
 	assert(ir->instr == MCC_IR_INSTR_FUNC_LABEL);
@@ -168,7 +188,7 @@ static struct mcc_annotated_ir *add_stack_sizes(struct mcc_ir_row *ir)
 	ir = ir->next_row;
 
 	while (ir) {
-		int size = get_stack_frame_size(ir);
+		int size = get_stack_frame_size(ir, layout);
 		new = mcc_new_annotated_ir(ir, size);
 		if (!new) {
 			mcc_delete_annotated_ir(first);
@@ -233,8 +253,12 @@ int mcc_get_array_element_stack_loc(struct mcc_annotated_ir *an_ir, struct mcc_i
 		if (an_ir->row->instr == MCC_IR_INSTR_ARRAY) {
 			if (strcmp(an_ir->row->arg1->ident, array_element->arr_ident) == 0) {
 				int array_pos = an_ir->stack_position;
-				int element_pos =
-				    array_pos + (array_element->index->lit_int) * get_row_size(an_ir->row);
+				// Bool elements take a byte. Packed ones have no position of their own, they are only accessed
+				// through the DWORD holding them (see asm.c).
+				int element_size = an_ir->row->type->type == MCC_IR_ROW_BOOL
+				                       ? 1
+				                       : an_ir->stack_size / an_ir->row->type->array_size;
+				int element_pos = array_pos + (array_element->index->lit_int) * element_size;
 				return element_pos;
 			}
 		}
@@ -302,7 +326,7 @@ static void add_stack_positions(struct mcc_annotated_ir *head)
 		}
 		// Arrays
 		if (head->row->instr == MCC_IR_INSTR_ARRAY) {
-			current_position = current_position - get_row_size(head->row) * head->row->type->array_size;
+			current_position = current_position - head->stack_size;
 			head->stack_position = current_position;
 			head = head->next;
 			continue;
@@ -316,22 +340,376 @@ static void add_stack_positions(struct mcc_annotated_ir *head)
 			continue;
 		}
 
-		// Rest
-		current_position = current_position - head->stack_size;
-		head->stack_position = current_position;
+		// Rest: temporaries get their slots from color_stack_slots
 		head = head->next;
 	}
 }
 
+// --------------------------------------------------------------------------------------- Stack slot coloring
+
+// The value of a row, a temporary, only needs its stack slot from the row computing it to its last use. Temporaries
+// whose live ranges do not overlap share a slot of the same size, below the variables and arrays of the function.
+// Live ranges are intervals of row positions in IR order. A range covers every row from which a read of the value can
+// be reached without passing the row computing it, following fall-throughs and jumps backwards from each read. A value
+// read in a loop but computed in front of it thus lives across the whole loop, also across blocks of the loop that
+// are placed behind it (see block_layout.h).
+// The slots are assigned greedily in the order the ranges start, which needs as many slots of a size as there are
+// overlapping ranges of that size at one point.
+
+struct row_entry {
+	struct mcc_ir_row *row;
+	unsigned position;
+	// Index of the live range of the row, -1 if it is not a temporary
+	int range;
+};
+
+struct live_range {
+	struct mcc_annotated_ir *an_ir;
+	unsigned definition;
+	unsigned start;
+	unsigned end;
+};
+
+struct label_entry {
+	unsigned label;
+	unsigned position;
+};
+
+struct slot {
+	int position;
+	int size;
+	// Position of the last row that uses the slot so far
+	unsigned end;
+};
+
+struct coloring {
+	unsigned num_rows;
+	struct mcc_annotated_ir **rows;
+	// Position at which the operands of each row are read
+	unsigned *reads;
+	// Sorted by row, to find the entry of an operand
+	struct row_entry *entries;
+	unsigned num_ranges;
+	struct live_range *ranges;
+	unsigned num_labels;
+	struct label_entry *labels;
+	// Positions of the jumps to the row at each position are jumps[jumps_start[i]] up to jumps[jumps_start[i + 1]]
+	unsigned *jumps_start;
+	unsigned *jumps;
+	// Rows visited by the walk of the current range are marked with its index + 1
+	unsigned *marks;
+	unsigned *stack;
+	unsigned num_slots;
+	struct slot *slots;
+};
+
+static bool is_temporary(struct mcc_annotated_ir *an_ir)
+{
+	switch (an_ir->row->instr) {
+	case MCC_IR_INSTR_ASSIGN:
+	case MCC_IR_INSTR_ARRAY:
+	case MCC_IR_INSTR_POP:
+	case MCC_IR_INSTR_FUNC_LABEL:
+		return false;
+	default:
+		return an_ir->stack_size > 0;
+	}
+}
+
+// Rows without side effects may be computed inside the expression tree of a later row, and the arguments of pushes are
+// loaded by the call (see asm.c). Their operands are read at the first row after them that is neither.
+static bool defers_reads(struct mcc_ir_row *row)
+{
+	if (row->type && row->type->lanes > 1)
+		return false;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_DIVIDE:
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+	case MCC_IR_INSTR_AND:
+	case MCC_IR_INSTR_OR:
+	case MCC_IR_INSTR_NEGATIV:
+	case MCC_IR_INSTR_NOT:
+	case MCC_IR_INSTR_PUSH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int compare_row_entries(const void *a, const void *b)
+{
+	const struct row_entry *entry_a = a;
+	const struct row_entry *entry_b = b;
+	if (entry_a->row < entry_b->row)
+		return -1;
+	if (entry_a->row > entry_b->row)
+		return 1;
+	return 0;
+}
+
+static int compare_live_ranges(const void *a, const void *b)
+{
+	const struct live_range *range_a = a;
+	const struct live_range *range_b = b;
+	if (range_a->start != range_b->start)
+		return range_a->start < range_b->start ? -1 : 1;
+	if (range_a->definition != range_b->definition)
+		return range_a->definition < range_b->definition ? -1 : 1;
+	return 0;
+}
+
+static void delete_coloring(struct coloring *coloring)
+{
+	free(coloring->rows);
+	free(coloring->reads);
+	free(coloring->entries);
+	free(coloring->ranges);
+	free(coloring->labels);
+	free(coloring->jumps_start);
+	free(coloring->jumps);
+	free(coloring->marks);
+	free(coloring->stack);
+	free(coloring->slots);
+}
+
+static bool new_coloring(struct coloring *coloring, struct mcc_annotated_ir *function_label)
+{
+	unsigned n = 1;
+	for (struct mcc_annotated_ir *an_ir = function_label->next;
+	     an_ir && an_ir->row->instr != MCC_IR_INSTR_FUNC_LABEL; an_ir = an_ir->next)
+		n++;
+
+	*coloring = (struct coloring){.num_rows = n};
+	coloring->rows = malloc(sizeof(*coloring->rows) * n);
+	coloring->reads = malloc(sizeof(*coloring->reads) * n);
+	coloring->entries = malloc(sizeof(*coloring->entries) * n);
+	coloring->ranges = malloc(sizeof(*coloring->ranges) * n);
+	coloring->labels = malloc(sizeof(*coloring->labels) * n);
+	coloring->jumps_start = calloc(n + 1, sizeof(*coloring->jumps_start));
+	coloring->jumps = malloc(sizeof(*coloring->jumps) * n);
+	coloring->marks = calloc(n, sizeof(*coloring->marks));
+	coloring->stack = malloc(sizeof(*coloring->stack) * n);
+	coloring->slots = malloc(sizeof(*coloring->slots) * n);
+	if (!coloring->rows || !coloring->reads || !coloring->entries || !coloring->ranges || !coloring->labels ||
+	    !coloring->jumps_start || !coloring->jumps || !coloring->marks || !coloring->stack || !coloring->slots) {
+		delete_coloring(coloring);
+		return false;
+	}
+
+	struct mcc_annotated_ir *an_ir = function_label;
+	for (unsigned i = 0; i < n; i++, an_ir = an_ir->next) {
+		coloring->rows[i] = an_ir;
+		coloring->entries[i] = (struct row_entry){.row = an_ir->row, .position = i, .range = -1};
+		if (is_temporary(an_ir)) {
+			coloring->entries[i].range = (int)coloring->num_ranges;
+			coloring->ranges[coloring->num_ranges++] =
+			    (struct live_range){.an_ir = an_ir, .definition = i, .start = i, .end = i};
+		}
+	}
+	for (unsigned i = n; i-- > 0;) {
+		bool defers = i + 1 < n && defers_reads(coloring->rows[i]->row);
+		coloring->reads[i] = defers ? coloring->reads[i + 1] : i;
+	}
+	qsort(coloring->entries, n, sizeof(*coloring->entries), compare_row_entries);
+	return true;
+}
+
+static struct live_range *find_live_range(struct coloring *coloring, struct mcc_ir_row *row)
+{
+	struct row_entry key = {.row = row, .position = 0, .range = -1};
+	struct row_entry *entry =
+	    bsearch(&key, coloring->entries, coloring->num_rows, sizeof(*coloring->entries), compare_row_entries);
+	if (!entry || entry->range < 0)
+		return NULL;
+	return &coloring->ranges[entry->range];
+}
+
+static struct mcc_ir_arg *get_jump_target(struct mcc_ir_row *row)
+{
+	return row->instr == MCC_IR_INSTR_JUMP        ? row->arg1
+	       : row->instr == MCC_IR_INSTR_JUMPFALSE ? row->arg2
+	                                              : NULL;
+}
+
+// Returns the number of rows if the label is not in the function
+static unsigned find_label(struct coloring *coloring, unsigned label)
+{
+	for (unsigned l = 0; l < coloring->num_labels; l++) {
+		if (coloring->labels[l].label == label)
+			return coloring->labels[l].position;
+	}
+	return coloring->num_rows;
+}
+
+static void find_jumps(struct coloring *coloring)
+{
+	for (unsigned i = 0; i < coloring->num_rows; i++) {
+		struct mcc_ir_row *row = coloring->rows[i]->row;
+		if (row->instr == MCC_IR_INSTR_LABEL)
+			coloring->labels[coloring->num_labels++] =
+			    (struct label_entry){.label = row->arg1->label, .position = i};
+	}
+
+	// Count the jumps to each position, then fill them in behind the ones of the positions in front
+	unsigned n = coloring->num_rows;
+	for (unsigned i = 0; i < n; i++) {
+		struct mcc_ir_arg *target = get_jump_target(coloring->rows[i]->row);
+		unsigned position = target ? find_label(coloring, target->label) : n;
+		if (position < n)
+			coloring->jumps_start[position + 1]++;
+	}
+	for (unsigned i = 0; i < n; i++)
+		coloring->jumps_start[i + 1] += coloring->jumps_start[i];
+	for (unsigned i = 0; i < n; i++) {
+		struct mcc_ir_arg *target = get_jump_target(coloring->rows[i]->row);
+		unsigned position = target ? find_label(coloring, target->label) : n;
+		if (position < n)
+			coloring->jumps[coloring->jumps_start[position] + coloring->marks[position]++] = i;
+	}
+	memset(coloring->marks, 0, sizeof(*coloring->marks) * n);
+}
+
+static bool falls_through(struct mcc_ir_row *row)
+{
+	return row->instr != MCC_IR_INSTR_JUMP && row->instr != MCC_IR_INSTR_RETURN;
+}
+
+static void visit(struct coloring *coloring, struct live_range *range, unsigned position, unsigned *size)
+{
+	unsigned mark = (unsigned)(range - coloring->ranges) + 1;
+	if (position == range->definition || coloring->marks[position] == mark)
+		return;
+	coloring->marks[position] = mark;
+	coloring->stack[(*size)++] = position;
+	if (position < range->start)
+		range->start = position;
+	if (position > range->end)
+		range->end = position;
+}
+
+// Extends the range of the value of the row arg refers to back along all paths from the row at position that reads
+// it, up to the row computing the value
+static void add_use(struct coloring *coloring, struct mcc_ir_arg *arg, unsigned position)
+{
+	if (!arg || arg->type != MCC_IR_TYPE_ROW)
+		return;
+	struct live_range *range = find_live_range(coloring, arg->row);
+	if (!range)
+		return;
+
+	unsigned read = coloring->reads[position];
+	if (read > range->end)
+		range->end = read;
+
+	unsigned size = 0;
+	visit(coloring, range, position, &size);
+	while (size > 0) {
+		unsigned i = coloring->stack[--size];
+		if (i > 0 && falls_through(coloring->rows[i - 1]->row))
+			visit(coloring, range, i - 1, &size);
+		for (unsigned j = coloring->jumps_start[i]; j < coloring->jumps_start[i + 1]; j++)
+			visit(coloring, range, coloring->jumps[j], &size);
+	}
+}
+
+static void compute_live_ranges(struct coloring *coloring)
+{
+	find_jumps(coloring);
+	for (unsigned i = 0; i < coloring->num_rows; i++) {
+		struct mcc_ir_row *row = coloring->rows[i]->row;
+		struct mcc_ir_arg *args[] = {row->arg1, row->arg2};
+		for (unsigned a = 0; a < 2; a++) {
+			if (args[a] && args[a]->type == MCC_IR_TYPE_ARR_ELEM)
+				add_use(coloring, args[a]->index, i);
+			else
+				add_use(coloring, args[a], i);
+		}
+	}
+	qsort(coloring->ranges, coloring->num_ranges, sizeof(*coloring->ranges), compare_live_ranges);
+}
+
+// Returns the lowest position of the frame
+static int assign_slots(struct coloring *coloring, int position)
+{
+	for (unsigned r = 0; r < coloring->num_ranges; r++) {
+		struct live_range *range = &coloring->ranges[r];
+		struct slot *slot = NULL;
+		// A slot is free once the row its last range ends at has read it
+		for (unsigned s = 0; s < coloring->num_slots && !slot; s++) {
+			if (coloring->slots[s].size == range->an_ir->stack_size && coloring->slots[s].end < range->start)
+				slot = &coloring->slots[s];
+		}
+		if (!slot) {
+			position -= range->an_ir->stack_size;
+			slot = &coloring->slots[coloring->num_slots++];
+			*slot = (struct slot){.position = position, .size = range->an_ir->stack_size, .end = 0};
+		}
+		slot->end = range->end;
+		range->an_ir->stack_position = slot->position;
+	}
+	return position;
+}
+
+static bool color_function(struct mcc_annotated_ir *function_label)
+{
+	struct coloring coloring;
+	if (!new_coloring(&coloring, function_label))
+		return false;
+
+	// Variables and arrays keep the positions from add_stack_positions
+	int position = 0;
+	for (unsigned i = 1; i < coloring.num_rows; i++) {
+		if (!is_temporary(coloring.rows[i]))
+			position -= coloring.rows[i]->stack_size;
+	}
+	compute_live_ranges(&coloring);
+	function_label->stack_size = -assign_slots(&coloring, position);
+	delete_coloring(&coloring);
+	return true;
+}
+
+static bool color_stack_slots(struct mcc_annotated_ir *head)
+{
+	for (; head; head = head->next) {
+		if (head->row->instr == MCC_IR_INSTR_FUNC_LABEL && !color_function(head))
+			return false;
+	}
+	return true;
+}
+
 struct mcc_annotated_ir *mcc_annotate_ir(struct mcc_ir_row *ir)
+{
+	return mcc_annotate_ir_with_slot_size(ir, DWORD_SIZE);
+}
+
+struct mcc_annotated_ir *mcc_annotate_ir_with_slot_size(struct mcc_ir_row *ir, int slot_size)
+{
+	struct mcc_stack_layout layout = {.slot_size = slot_size, .pack_bool_arrays = false};
+	return mcc_annotate_ir_with_layout(ir, &layout);
+}
+
+struct mcc_annotated_ir *mcc_annotate_ir_with_layout(struct mcc_ir_row *ir, const struct mcc_stack_layout *layout)
 {
 	assert(ir);
 	assert(ir->instr == MCC_IR_INSTR_FUNC_LABEL);
+	assert(layout);
 
-	struct mcc_annotated_ir *an_head = add_stack_sizes(ir);
+	struct mcc_annotated_ir *an_head = add_stack_sizes(ir, layout);
 	if (!an_head)
 		return NULL;
 	add_stack_positions(an_head);
+	if (!color_stack_slots(an_head)) {
+		mcc_delete_annotated_ir(an_head);
+		return NULL;
+	}
 	return an_head;
 }
 
@@ -0,0 +1,295 @@
+#include "mcc/tail_call.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct function_data {
+	struct mcc_ir_row *label;
+	unsigned num_params;
+	// First row after the rows that take the parameters, the target of the jumps
+	struct mcc_ir_row *body;
+	bool has_entry_label;
+	// Number of the next temporary
+	unsigned *counter;
+};
+
+//---------------------------------------------------------------------------------------- Functions
+
+static char *get_function_name(struct function_data *function)
+{
+	return function->label->arg1->func_label;
+}
+
+static void init_function_data(struct mcc_ir_row *label, struct function_data *function, unsigned *counter)
+{
+	function->label = label;
+	function->counter = counter;
+	function->num_params = 0;
+	function->has_entry_label = false;
+
+	struct mcc_ir_row *row = label->next_row;
+	while (row && row->instr == MCC_IR_INSTR_POP && row->next_row && row->next_row->instr == MCC_IR_INSTR_ASSIGN) {
+		function->num_params++;
+		row = row->next_row->next_row;
+	}
+	function->body = row;
+}
+
+// POP row of the parameter with the given index, it is followed by the assignment to the parameter
+static struct mcc_ir_row *get_param_pop(struct function_data *function, unsigned index)
+{
+	struct mcc_ir_row *row = function->label->next_row;
+	for (unsigned i = 0; i < index; i++) {
+		row = row->next_row->next_row;
+	}
+	return row;
+}
+
+static char *get_param_name(struct function_data *function, unsigned index)
+{
+	return get_param_pop(function, index)->next_row->arg1->ident;
+}
+
+static bool is_array_param(struct function_data *function, unsigned index)
+{
+	return get_param_pop(function, index)->type->array_size >= 0;
+}
+
+static bool is_param(struct function_data *function, char *ident)
+{
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (strcmp(get_param_name(function, i), ident) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool reads_param(struct function_data *function, struct mcc_ir_arg *arg)
+{
+	switch (arg->type) {
+	case MCC_IR_TYPE_IDENTIFIER:
+		return is_param(function, arg->ident);
+	case MCC_IR_TYPE_ARR_ELEM:
+		return is_param(function, arg->arr_ident) || reads_param(function, arg->index);
+	default:
+		return false;
+	}
+}
+
+//---------------------------------------------------------------------------------------- Tail calls
+
+static struct mcc_ir_row *find_label(struct function_data *function, unsigned label)
+{
+	for (struct mcc_ir_row *row = function->label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label == label)
+			return row;
+	}
+	return NULL;
+}
+
+// The result of the call is returned right away. A void call may also reach the return through labels and jumps.
+static bool is_tail_call(struct function_data *function, struct mcc_ir_row *call)
+{
+	struct mcc_ir_row *row = call->next_row;
+	if (row && row->instr == MCC_IR_INSTR_RETURN && row->arg1 && row->arg1->type == MCC_IR_TYPE_ROW &&
+	    row->arg1->row == call)
+		return true;
+	if (call->type->type != MCC_IR_ROW_TYPELESS)
+		return false;
+
+	// Bound the number of steps, jumps may form a cycle
+	for (unsigned steps = 0; row && steps < 16; steps++) {
+		switch (row->instr) {
+		case MCC_IR_INSTR_LABEL:
+			row = row->next_row;
+			break;
+		case MCC_IR_INSTR_JUMP:
+			row = find_label(function, row->arg1->label);
+			break;
+		case MCC_IR_INSTR_RETURN:
+			return !row->arg1;
+		default:
+			return false;
+		}
+	}
+	return false;
+}
+
+// Arguments are pushed in reverse order right before the call. Array parameters must be passed on unchanged.
+static bool has_matching_pushes(struct function_data *function, struct mcc_ir_row *call)
+{
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < function->num_params; i++) {
+		if (!push || push->instr != MCC_IR_INSTR_PUSH)
+			return false;
+		if (is_array_param(function, i) && (push->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+		                                    strcmp(push->arg1->ident, get_param_name(function, i)) != 0))
+			return false;
+		push = push->prev_row;
+	}
+	return true;
+}
+
+static struct mcc_ir_row *get_push(struct mcc_ir_row *call, unsigned index)
+{
+	struct mcc_ir_row *push = call->prev_row;
+	for (unsigned i = 0; i < index; i++) {
+		push = push->prev_row;
+	}
+	return push;
+}
+
+static bool is_passed_unchanged(struct function_data *function, struct mcc_ir_row *call, unsigned index)
+{
+	struct mcc_ir_arg *arg = get_push(call, index)->arg1;
+	return is_array_param(function, index) ||
+	       (arg->type == MCC_IR_TYPE_IDENTIFIER && strcmp(arg->ident, get_param_name(function, index)) == 0);
+}
+
+static bool insert_entry_label(struct mcc_ir_row *ir, struct function_data *function)
+{
+	if (function->has_entry_label)
+		return true;
+
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(mcc_ir_get_unused_label(ir));
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_row *label = arg && type ? mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_LABEL, type) : NULL;
+	if (!label) {
+		mcc_ir_delete_ir_arg(arg);
+		mcc_ir_delete_ir_row_type(type);
+		return false;
+	}
+	mcc_ir_insert_row_before(function->body, label);
+	function->body = label;
+	function->has_entry_label = true;
+	return true;
+}
+
+static bool
+insert_assignment(struct mcc_ir_row *position, char *ident, struct mcc_ir_arg *value, struct mcc_ir_row *param)
+{
+	struct mcc_ir_arg *variable = mcc_ir_new_arg_identifier(ident);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(param->type->type, -1);
+	struct mcc_ir_row *row =
+	    variable && value && type ? mcc_ir_new_row(variable, value, MCC_IR_INSTR_ASSIGN, type) : NULL;
+	if (!row) {
+		mcc_ir_delete_ir_arg(variable);
+		mcc_ir_delete_ir_arg(value);
+		mcc_ir_delete_ir_row_type(type);
+		return false;
+	}
+	mcc_ir_insert_row_before(position, row);
+	return true;
+}
+
+// Arguments that read parameters are copied to temporaries first, all other values are assigned directly
+static bool assign_arguments(struct function_data *function, struct mcc_ir_row *call, struct mcc_ir_row *position)
+{
+	unsigned num_params = function->num_params;
+	char **temporaries = calloc(num_params + 1, sizeof(*temporaries));
+	if (!temporaries)
+		return false;
+
+	bool ok = true;
+	for (unsigned i = 0; i < num_params && ok; i++) {
+		struct mcc_ir_arg *arg = get_push(call, i)->arg1;
+		if (is_passed_unchanged(function, call, i) || !reads_param(function, arg))
+			continue;
+		char *param = get_param_name(function, i);
+		size_t size = strlen(param) + 16;
+		temporaries[i] = malloc(size);
+		ok = temporaries[i] != NULL;
+		if (ok) {
+			snprintf(temporaries[i], size, "%s.tc%u", param, (*function->counter)++);
+			ok = insert_assignment(position, temporaries[i], mcc_ir_copy_arg(arg),
+			                       get_param_pop(function, i)->next_row);
+		}
+	}
+	for (unsigned i = 0; i < num_params && ok; i++) {
+		if (is_passed_unchanged(function, call, i))
+			continue;
+		struct mcc_ir_arg *value = temporaries[i] ? mcc_ir_new_arg_identifier(temporaries[i])
+		                                          : mcc_ir_copy_arg(get_push(call, i)->arg1);
+		struct mcc_ir_row *param = get_param_pop(function, i)->next_row;
+		ok = insert_assignment(position, get_param_name(function, i), value, param);
+	}
+
+	for (unsigned i = 0; i < num_params; i++) {
+		free(temporaries[i]);
+	}
+	free(temporaries);
+	return ok;
+}
+
+// Replace the call by assignments to the parameters and a jump to the function body. Returns the jump or NULL if
+// memory allocation fails.
+static struct mcc_ir_row *eliminate_call(struct mcc_ir_row *ir, struct function_data *function, struct mcc_ir_row *call)
+{
+	if (!insert_entry_label(ir, function))
+		return NULL;
+
+	struct mcc_ir_row *first_push = function->num_params > 0 ? get_push(call, function->num_params - 1) : call;
+	if (!assign_arguments(function, call, first_push))
+		return NULL;
+
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(function->body->arg1->label);
+	struct mcc_ir_row_type *type = mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1);
+	struct mcc_ir_row *jump = arg && type ? mcc_ir_new_row(arg, NULL, MCC_IR_INSTR_JUMP, type) : NULL;
+	if (!jump) {
+		mcc_ir_delete_ir_arg(arg);
+		mcc_ir_delete_ir_row_type(type);
+		return NULL;
+	}
+	mcc_ir_insert_row_before(first_push, jump);
+
+	// The return of the call's result refers to the call, the rows behind a void call are unreachable now
+	struct mcc_ir_row *next = call->next_row;
+	if (next && next->instr == MCC_IR_INSTR_RETURN && next->arg1 && next->arg1->type == MCC_IR_TYPE_ROW &&
+	    next->arg1->row == call) {
+		mcc_ir_unlink_row(next);
+		mcc_ir_delete_ir_row(next);
+	}
+	for (unsigned i = 0; i < function->num_params; i++) {
+		struct mcc_ir_row *push = call->prev_row;
+		mcc_ir_unlink_row(push);
+		mcc_ir_delete_ir_row(push);
+	}
+	mcc_ir_unlink_row(call);
+	mcc_ir_delete_ir_row(call);
+	return jump;
+}
+
+static bool eliminate_tail_calls(struct mcc_ir_row *ir, struct mcc_ir_row *label, unsigned *counter)
+{
+	struct function_data function;
+	init_function_data(label, &function, counter);
+	if (mcc_ir_is_function_end(function.body))
+		return true;
+
+	struct mcc_ir_row *row = function.body;
+	while (!mcc_ir_is_function_end(row)) {
+		if (row->instr == MCC_IR_INSTR_CALL && strcmp(row->arg1->ident, get_function_name(&function)) == 0 &&
+		    is_tail_call(&function, row) && has_matching_pushes(&function, row)) {
+			row = eliminate_call(ir, &function, row);
+			if (!row)
+				return false;
+		}
+		row = row->next_row;
+	}
+	return true;
+}
+
+bool mcc_tail_call_run(struct mcc_ir_row *ir)
+{
+	assert(ir);
+
+	unsigned counter = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !eliminate_tail_calls(ir, row, &counter))
+			return false;
+	}
+	mcc_ir_number_rows(ir);
+	return true;
+}
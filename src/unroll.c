@@ -0,0 +1,666 @@
+#include "mcc/unroll.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/cfg_analysis.h"
+
+struct loop {
+	struct mcc_ir_row *function_label;
+	// Label row of the header, followed by the test i < n and its jumpfalse
+	struct mcc_ir_row *header;
+	struct mcc_ir_row *test;
+	struct mcc_ir_row *exit_jump;
+	// Last row of the loop, the exit label follows it
+	struct mcc_ir_row *back_jump;
+	char *counter;
+	// The only assignment to the counter in the loop, i = u with u = i + step
+	struct mcc_ir_row *assign;
+	long step;
+	// Rows between the exit jump and the back jump
+	unsigned num_rows;
+};
+
+// State for copying the body of a loop
+struct copy_data {
+	struct loop *loop;
+	unsigned num_rows;
+	struct mcc_ir_row **old_rows;
+	// NULL for rows whose value was computed right away, it is in values then
+	struct mcc_ir_row **new_rows;
+	long *values;
+	unsigned num_labels;
+	unsigned *old_labels;
+	unsigned first_label;
+	// Appended to the names of float and string temporaries
+	char suffix[16];
+	// If the value of the counter is known, its uses are replaced by the literal and the assignment is left out
+	bool is_counter_known;
+	long counter;
+};
+
+struct unroll_data {
+	unsigned factor;
+	// Numbers the copies, for the names of their temporaries
+	unsigned counter;
+	// Header labels of the loops that stay behind their unrolled copy
+	unsigned num_remainders;
+	unsigned *remainders;
+};
+
+static bool fits_int(long long value)
+{
+	return value >= INT_MIN && value <= INT_MAX;
+}
+
+//---------------------------------------------------------------------------------------- Loop shape
+
+static bool is_jump(struct mcc_ir_row *row)
+{
+	return row->instr == MCC_IR_INSTR_JUMP || row->instr == MCC_IR_INSTR_JUMPFALSE;
+}
+
+static unsigned get_jump_target(struct mcc_ir_row *jump)
+{
+	return jump->instr == MCC_IR_INSTR_JUMP ? jump->arg1->label : jump->arg2->label;
+}
+
+static bool is_label_used(struct mcc_ir_row *function_label, unsigned label)
+{
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (is_jump(row) && get_jump_target(row) == label)
+			return true;
+	}
+	return false;
+}
+
+static bool is_label_in_body(struct loop *loop, unsigned label)
+{
+	for (struct mcc_ir_row *row = loop->exit_jump->next_row; row != loop->back_jump; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label == label)
+			return true;
+	}
+	return false;
+}
+
+static unsigned count_assignments(struct loop *loop, char *ident, struct mcc_ir_row **last)
+{
+	unsigned count = 0;
+	for (struct mcc_ir_row *row = loop->header; row != loop->back_jump; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_ASSIGN && mcc_ir_is_identifier(row->arg1, ident)) {
+			*last = row;
+			count++;
+		}
+	}
+	return count;
+}
+
+static bool is_innermost(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *cfg_loop)
+{
+	for (struct mcc_cfg_loop *other = analysis->loops; other; other = other->next) {
+		if (other->parent == cfg_loop)
+			return false;
+	}
+	return true;
+}
+
+// Checks that the rows from the header to the back jump are exactly the rows of the loop in the CFG, and that the body
+// can be copied: its jumps stay inside of it, and it declares no arrays and has no vector rows
+static bool check_body(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *cfg_loop, struct loop *loop)
+{
+	unsigned num_loop_rows = 0;
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		if (!cfg_loop->contains[b])
+			continue;
+		struct mcc_basic_block *block = analysis->blocks[b];
+		for (struct mcc_ir_row *row = block->leader; row != block->last->next_row; row = row->next_row) {
+			num_loop_rows++;
+		}
+	}
+
+	unsigned num_rows = 0;
+	for (struct mcc_ir_row *row = loop->header; row != loop->back_jump->next_row; row = row->next_row) {
+		num_rows++;
+		if (!mcc_cfg_loop_contains_row(analysis, cfg_loop, row) || row->instr == MCC_IR_INSTR_ARRAY ||
+		    (row->type && row->type->lanes > 1))
+			return false;
+		if (row != loop->exit_jump && row != loop->back_jump && is_jump(row) &&
+		    !is_label_in_body(loop, get_jump_target(row)))
+			return false;
+	}
+	// Header, test, exit jump and back jump are no part of the body
+	loop->num_rows = num_rows - 4;
+	return num_rows == num_loop_rows;
+}
+
+static bool check_counter(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *cfg_loop, struct loop *loop)
+{
+	if (count_assignments(loop, loop->counter, &loop->assign) != 1 || loop->assign->arg2->type != MCC_IR_TYPE_ROW)
+		return false;
+	struct mcc_ir_row *increment = loop->assign->arg2->row;
+	if (!mcc_cfg_loop_contains_row(analysis, cfg_loop, increment) || increment->instr != MCC_IR_INSTR_PLUS ||
+	    increment->type->type != MCC_IR_ROW_INT || !mcc_ir_is_identifier(increment->arg1, loop->counter) ||
+	    increment->arg2->type != MCC_IR_TYPE_LIT_INT || increment->arg2->lit_int <= 0)
+		return false;
+	loop->step = increment->arg2->lit_int;
+
+	// Without labels behind it, the assignment is done in every iteration
+	for (struct mcc_ir_row *row = loop->assign; row != loop->back_jump; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL)
+			return false;
+	}
+	return true;
+}
+
+static bool is_invariant_bound(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *cfg_loop, struct loop *loop)
+{
+	struct mcc_ir_arg *bound = loop->test->arg2;
+	struct mcc_ir_row *last = NULL;
+	switch (bound->type) {
+	case MCC_IR_TYPE_LIT_INT:
+		return true;
+	case MCC_IR_TYPE_IDENTIFIER:
+		return strcmp(bound->ident, loop->counter) != 0 && count_assignments(loop, bound->ident, &last) == 0;
+	case MCC_IR_TYPE_ROW:
+		return !mcc_cfg_loop_contains_row(analysis, cfg_loop, bound->row);
+	default:
+		return false;
+	}
+}
+
+// Matches a counted loop (see cfg_analysis.h) whose body assigns the counter once, i = u with u = i + c
+static bool match_loop(struct mcc_cfg_analysis *analysis, struct mcc_cfg_loop *cfg_loop, struct loop *loop)
+{
+	struct mcc_cfg_counted_loop shape;
+	if (!mcc_cfg_match_counted_loop(cfg_loop->header->leader, &shape) || shape.exit_jump != cfg_loop->header->last)
+		return false;
+	loop->header = shape.header;
+	loop->test = shape.test;
+	loop->exit_jump = shape.exit_jump;
+	loop->back_jump = shape.back_jump;
+	loop->counter = shape.counter;
+	return check_body(analysis, cfg_loop, loop) && check_counter(analysis, cfg_loop, loop) &&
+	       is_invariant_bound(analysis, cfg_loop, loop);
+}
+
+// The vector loop ends with the jump back to its header, which is followed by the combination of its reductions
+// without further jumps
+static bool is_vector_remainder(struct loop *loop)
+{
+	struct mcc_ir_row *row = loop->header->prev_row;
+	while (!mcc_ir_is_function_end(row) && row->instr != MCC_IR_INSTR_JUMP) {
+		row = row->prev_row;
+	}
+	if (mcc_ir_is_function_end(row))
+		return false;
+
+	unsigned label = row->arg1->label;
+	bool has_vector_rows = false;
+	for (; !mcc_ir_is_function_end(row); row = row->prev_row) {
+		has_vector_rows = has_vector_rows || (row->type && row->type->lanes > 1);
+		if (row->instr == MCC_IR_INSTR_LABEL && row->arg1->label == label)
+			return has_vector_rows && mcc_ir_is_identifier(row->next_row->arg1, loop->counter);
+	}
+	return false;
+}
+
+static bool is_remainder(struct unroll_data *data, struct loop *loop)
+{
+	for (unsigned i = 0; i < data->num_remainders; i++) {
+		if (data->remainders[i] == loop->header->arg1->label)
+			return true;
+	}
+	return is_vector_remainder(loop);
+}
+
+static bool add_remainder(struct unroll_data *data, struct loop *loop)
+{
+	unsigned *remainders = realloc(data->remainders, sizeof(*remainders) * (data->num_remainders + 1));
+	if (!remainders)
+		return false;
+	remainders[data->num_remainders++] = loop->header->arg1->label;
+	data->remainders = remainders;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Trip count
+
+// Literal value the counter gets in the rows in front of the loop
+static bool find_initial_value(struct loop *loop, long *value)
+{
+	for (struct mcc_ir_row *row = loop->header->prev_row; row; row = row->prev_row) {
+		switch (row->instr) {
+		case MCC_IR_INSTR_LABEL:
+		case MCC_IR_INSTR_FUNC_LABEL:
+		case MCC_IR_INSTR_JUMP:
+		case MCC_IR_INSTR_JUMPFALSE:
+		case MCC_IR_INSTR_RETURN:
+			return false;
+		default:
+			break;
+		}
+		if (row->instr == MCC_IR_INSTR_ASSIGN && mcc_ir_is_identifier(row->arg1, loop->counter)) {
+			if (row->arg2->type != MCC_IR_TYPE_LIT_INT)
+				return false;
+			*value = row->arg2->lit_int;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Number of iterations, if the loop is only entered through the rows in front of it and the initial value of the
+// counter and the bound are literals
+static bool get_trip_count(struct loop *loop, long *initial, long long *trip)
+{
+	struct mcc_ir_arg *bound = loop->test->arg2;
+	if (bound->type != MCC_IR_TYPE_LIT_INT || !find_initial_value(loop, initial))
+		return false;
+	for (struct mcc_ir_row *row = loop->function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row != loop->back_jump && is_jump(row) && get_jump_target(row) == loop->header->arg1->label)
+			return false;
+	}
+
+	long long last = loop->test->instr == MCC_IR_INSTR_SMALLER ? (long long)bound->lit_int - 1 : bound->lit_int;
+	*trip = *initial > last ? 0 : (last - *initial) / loop->step + 1;
+	return fits_int(*initial + *trip * loop->step);
+}
+
+//---------------------------------------------------------------------------------------- Copying
+
+// Inserts a new row in front of position, which takes over type and arguments. args_ok tells whether allocating the
+// arguments succeeded. Returns NULL if memory allocation fails.
+static struct mcc_ir_row *insert_row(struct mcc_ir_row *position,
+                                     enum mcc_ir_instruction instr,
+                                     struct mcc_ir_row_type *type,
+                                     struct mcc_ir_arg *arg1,
+                                     struct mcc_ir_arg *arg2,
+                                     bool args_ok)
+{
+	struct mcc_ir_row *row = NULL;
+	if (args_ok && type)
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+		return NULL;
+	}
+	mcc_ir_insert_row_before(position, row);
+	return row;
+}
+
+// Label or jump
+static struct mcc_ir_row *insert_label_row(struct mcc_ir_row *position, enum mcc_ir_instruction instr, unsigned label)
+{
+	struct mcc_ir_arg *arg = mcc_ir_new_arg_label(label);
+	return insert_row(position, instr, mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1), arg, NULL, arg);
+}
+
+static bool set_up_copy(struct copy_data *copy, struct loop *loop)
+{
+	copy->loop = loop;
+	copy->old_rows = malloc(sizeof(*copy->old_rows) * (loop->num_rows + 1));
+	copy->new_rows = malloc(sizeof(*copy->new_rows) * (loop->num_rows + 1));
+	copy->values = malloc(sizeof(*copy->values) * (loop->num_rows + 1));
+	copy->old_labels = malloc(sizeof(*copy->old_labels) * (loop->num_rows + 1));
+	if (!copy->old_rows || !copy->new_rows || !copy->values || !copy->old_labels)
+		return false;
+
+	copy->num_labels = 0;
+	for (struct mcc_ir_row *row = loop->exit_jump->next_row; row != loop->back_jump; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_LABEL)
+			copy->old_labels[copy->num_labels++] = row->arg1->label;
+	}
+	return true;
+}
+
+static void delete_copy(struct copy_data *copy)
+{
+	free(copy->old_rows);
+	free(copy->new_rows);
+	free(copy->values);
+	free(copy->old_labels);
+}
+
+static unsigned get_new_label(struct copy_data *copy, unsigned label)
+{
+	for (unsigned i = 0; i < copy->num_labels; i++) {
+		if (copy->old_labels[i] == label)
+			return copy->first_label + i;
+	}
+	return label;
+}
+
+// Float and string temporaries end up in the data section, so every copy needs names of its own for those set in the
+// body
+static bool rename_temporary(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_row *last = NULL;
+	if (count_assignments(copy->loop, arg->ident, &last) == 0)
+		return true;
+
+	size_t size = strlen(arg->ident) + strlen(copy->suffix) + 1;
+	char *name = malloc(size);
+	if (!name)
+		return false;
+	snprintf(name, size, "%s%s", arg->ident, copy->suffix);
+	free(arg->ident);
+	arg->ident = name;
+	return true;
+}
+
+static bool replace_by_int(struct mcc_ir_arg **arg, long value)
+{
+	struct mcc_ir_arg *literal = mcc_ir_new_arg_int(value);
+	if (!literal)
+		return false;
+	mcc_ir_delete_ir_arg(*arg);
+	*arg = literal;
+	return true;
+}
+
+// Renumber rows, labels and temporaries of a copied argument and put in the value of the counter if it is known
+static bool rename_arg(struct copy_data *copy, struct mcc_ir_arg **arg)
+{
+	switch ((*arg)->type) {
+	case MCC_IR_TYPE_IDENTIFIER:
+		if (strncmp((*arg)->ident, "$tmp", 4) == 0)
+			return rename_temporary(copy, *arg);
+		if (copy->is_counter_known && strcmp((*arg)->ident, copy->loop->counter) == 0)
+			return replace_by_int(arg, copy->counter);
+		return true;
+	case MCC_IR_TYPE_ARR_ELEM:
+		return rename_arg(copy, &(*arg)->index);
+	case MCC_IR_TYPE_ROW:
+		for (unsigned i = 0; i < copy->num_rows; i++) {
+			if (copy->old_rows[i] != (*arg)->row)
+				continue;
+			if (!copy->new_rows[i])
+				return replace_by_int(arg, copy->values[i]);
+			(*arg)->row = copy->new_rows[i];
+			return true;
+		}
+		return true;
+	case MCC_IR_TYPE_LABEL:
+		(*arg)->label = get_new_label(copy, (*arg)->label);
+		return true;
+	default:
+		return true;
+	}
+}
+
+static struct mcc_ir_arg *copy_renamed_arg(struct copy_data *copy, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_arg *new_arg = mcc_ir_copy_arg(arg);
+	if (new_arg && !rename_arg(copy, &new_arg)) {
+		mcc_ir_delete_ir_arg(new_arg);
+		return NULL;
+	}
+	return new_arg;
+}
+
+// Computes int rows of two literals, unless the result overflows
+static bool compute_row(struct mcc_ir_row *row, struct mcc_ir_arg *arg1, struct mcc_ir_arg *arg2, long *value)
+{
+	if (row->type->type != MCC_IR_ROW_INT || !arg1 || !arg2 || arg1->type != MCC_IR_TYPE_LIT_INT ||
+	    arg2->type != MCC_IR_TYPE_LIT_INT)
+		return false;
+
+	long long result;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+		result = (long long)arg1->lit_int + arg2->lit_int;
+		break;
+	case MCC_IR_INSTR_MINUS:
+		result = (long long)arg1->lit_int - arg2->lit_int;
+		break;
+	case MCC_IR_INSTR_MULTIPLY:
+		result = (long long)arg1->lit_int * arg2->lit_int;
+		break;
+	default:
+		return false;
+	}
+	if (!fits_int(result))
+		return false;
+	*value = (long)result;
+	return true;
+}
+
+// Copy a row in front of position, or only compute its value. Returns false if memory allocation fails.
+static bool copy_row(struct copy_data *copy, struct mcc_ir_row *row, struct mcc_ir_row *position)
+{
+	struct mcc_ir_arg *arg1 = row->arg1 ? copy_renamed_arg(copy, row->arg1) : NULL;
+	struct mcc_ir_arg *arg2 = row->arg2 ? copy_renamed_arg(copy, row->arg2) : NULL;
+	bool args_ok = (!row->arg1 || arg1) && (!row->arg2 || arg2);
+
+	unsigned i = copy->num_rows;
+	copy->old_rows[i] = row;
+	copy->new_rows[i] = NULL;
+	if (args_ok && compute_row(row, arg1, arg2, &copy->values[i])) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		copy->num_rows++;
+		return true;
+	}
+
+	copy->new_rows[i] = insert_row(position, row->instr, mcc_ir_new_row_type(row->type->type, row->type->array_size),
+	                               arg1, arg2, args_ok);
+	if (!copy->new_rows[i])
+		return false;
+	copy->num_rows++;
+	return true;
+}
+
+// Copy the body in front of position, with its labels numbered from first_label on
+static bool copy_body(struct unroll_data *data,
+                      struct copy_data *copy,
+                      struct mcc_ir_row *position,
+                      unsigned first_label)
+{
+	struct loop *loop = copy->loop;
+	copy->num_rows = 0;
+	copy->first_label = first_label;
+	snprintf(copy->suffix, sizeof(copy->suffix), ".u%u", data->counter++);
+
+	for (struct mcc_ir_row *row = loop->exit_jump->next_row; row != loop->back_jump; row = row->next_row) {
+		if (copy->is_counter_known && row == loop->assign) {
+			copy->counter += loop->step;
+			continue;
+		}
+		if (!copy_row(copy, row, position))
+			return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Unrolling
+
+static void delete_rows(struct mcc_ir_row *first, struct mcc_ir_row *last)
+{
+	struct mcc_ir_row *end = last->next_row;
+	while (first != end) {
+		struct mcc_ir_row *next = first->next_row;
+		mcc_ir_unlink_row(first);
+		mcc_ir_delete_ir_row(first);
+		first = next;
+	}
+}
+
+// Replaces the loop by a copy of the body for every iteration, with the counter set to its final value behind them:
+//     b(i0); b(i0 + c); ...; i = i0 + trip * c; E:
+static bool unroll_completely(struct unroll_data *data, struct loop *loop, long initial, long long trip)
+{
+	struct copy_data copy = {.is_counter_known = true, .counter = initial};
+	bool ok = set_up_copy(&copy, loop);
+	unsigned first_label = mcc_ir_get_unused_label(loop->header);
+	for (long long i = 0; i < trip && ok; i++) {
+		ok = copy_body(data, &copy, loop->header, first_label + (unsigned)i * copy.num_labels);
+	}
+	delete_copy(&copy);
+
+	struct mcc_ir_arg *counter = mcc_ir_new_arg_identifier(loop->counter);
+	struct mcc_ir_arg *value = mcc_ir_new_arg_int(copy.counter);
+	if (!ok || !insert_row(loop->header, MCC_IR_INSTR_ASSIGN, mcc_ir_new_row_type(MCC_IR_ROW_INT, -1), counter,
+	                       value, counter && value))
+		return false;
+
+	// Only the exit jump of the loop went to its exit label
+	struct mcc_ir_row *exit_label = loop->back_jump->next_row;
+	delete_rows(loop->header, loop->back_jump);
+	if (!is_label_used(loop->function_label, exit_label->arg1->label))
+		delete_rows(exit_label, exit_label);
+	return true;
+}
+
+// Bound of the test of the unrolled loop, n - distance. Returns NULL if memory allocation fails.
+static struct mcc_ir_arg *get_last_start(struct loop *loop, long distance)
+{
+	struct mcc_ir_arg *bound = loop->test->arg2;
+	if (bound->type == MCC_IR_TYPE_LIT_INT)
+		return mcc_ir_new_arg_int(bound->lit_int - distance);
+
+	struct mcc_ir_arg *arg1 = mcc_ir_copy_arg(bound);
+	struct mcc_ir_arg *arg2 = mcc_ir_new_arg_int(distance);
+	struct mcc_ir_row *row = insert_row(loop->header, MCC_IR_INSTR_MINUS, mcc_ir_new_row_type(MCC_IR_ROW_INT, -1),
+	                                    arg1, arg2, arg1 && arg2);
+	return row ? mcc_ir_new_arg_row(row) : NULL;
+}
+
+// Places the unrolled loop in front of the original loop, which then runs the remaining iterations:
+//     U: t = i < n - (factor - 1) * c; jumpfalse t R; b; b; ...; jump U; R:
+static bool unroll_partially(struct unroll_data *data, struct loop *loop, unsigned factor, long distance)
+{
+	struct mcc_ir_row *position = loop->header;
+	struct mcc_ir_arg *last_start = get_last_start(loop, distance);
+	unsigned unrolled_label = mcc_ir_get_unused_label(position);
+	unsigned exit_label = unrolled_label + 1;
+	if (!last_start || !insert_label_row(position, MCC_IR_INSTR_LABEL, unrolled_label)) {
+		mcc_ir_delete_ir_arg(last_start);
+		return false;
+	}
+
+	struct mcc_ir_arg *counter = mcc_ir_new_arg_identifier(loop->counter);
+	struct mcc_ir_row *test = insert_row(position, loop->test->instr, mcc_ir_new_row_type(MCC_IR_ROW_BOOL, -1), counter,
+	                                     last_start, counter);
+	struct mcc_ir_arg *condition = test ? mcc_ir_new_arg_row(test) : NULL;
+	struct mcc_ir_arg *target = test ? mcc_ir_new_arg_label(exit_label) : NULL;
+	if (!test || !insert_row(position, MCC_IR_INSTR_JUMPFALSE, mcc_ir_new_row_type(MCC_IR_ROW_TYPELESS, -1), condition,
+	                         target, condition && target))
+		return false;
+
+	struct copy_data copy = {.is_counter_known = false};
+	bool ok = set_up_copy(&copy, loop);
+	for (unsigned i = 0; i < factor && ok; i++) {
+		ok = copy_body(data, &copy, position, exit_label + 1 + i * copy.num_labels);
+	}
+	delete_copy(&copy);
+	return ok && insert_label_row(position, MCC_IR_INSTR_JUMP, unrolled_label) &&
+	       insert_label_row(position, MCC_IR_INSTR_LABEL, exit_label) && add_remainder(data, loop);
+}
+
+// Whether the loop ran fewer than factor iterations per entry on average according to the profile. The header runs
+// once more per entry than the back jump.
+static bool runs_few_iterations(struct loop *loop, unsigned factor)
+{
+	long long tests = loop->header->profile_count;
+	long long iterations = loop->back_jump->profile_count;
+	if (iterations < 0 || tests <= iterations)
+		return false;
+	return iterations < (long long)factor * (tests - iterations);
+}
+
+// Returns 1 if the loop was unrolled, 0 if not, and -1 if memory allocation fails
+static int unroll_loop(struct unroll_data *data,
+                       struct mcc_ir_row *function_label,
+                       struct mcc_cfg_analysis *analysis,
+                       struct mcc_cfg_loop *cfg_loop)
+{
+	struct loop loop = {.function_label = function_label};
+	if (!is_innermost(analysis, cfg_loop) || !match_loop(analysis, cfg_loop, &loop) || is_remainder(data, &loop))
+		return 0;
+	// Loops that never ran in the profile are left as they are
+	if (loop.header->profile_count == 0)
+		return 0;
+
+	long initial = 0;
+	long long trip = 0;
+	bool is_counted = get_trip_count(&loop, &initial, &trip);
+	if (is_counted && trip == 0)
+		return 0;
+	if (is_counted && trip * loop.num_rows <= MCC_UNROLL_BUDGET)
+		return unroll_completely(data, &loop, initial, trip) ? 1 : -1;
+
+	unsigned factor = data->factor;
+	if (factor > MCC_UNROLL_BUDGET / loop.num_rows)
+		factor = MCC_UNROLL_BUDGET / loop.num_rows;
+	long long distance = (long long)(factor - 1) * loop.step;
+	struct mcc_ir_arg *bound = loop.test->arg2;
+	if (factor < 2 || (is_counted && trip < factor) || runs_few_iterations(&loop, factor) || !fits_int(distance) ||
+	    (bound->type == MCC_IR_TYPE_LIT_INT && !fits_int(bound->lit_int - distance)))
+		return 0;
+
+	// Jumps from outside the loop to its header have to go to the unrolled loop
+	if (!mcc_cfg_loop_preheader(analysis, cfg_loop))
+		return 0;
+	return unroll_partially(data, &loop, factor, (long)distance) ? 1 : -1;
+}
+
+//---------------------------------------------------------------------------------------- Run
+
+static bool unroll_function(struct unroll_data *data,
+                            struct mcc_pass_manager *manager,
+                            struct mcc_ir_row *function_label)
+{
+	// Every transformation changes the CFG, so analyse again until nothing changes
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		struct mcc_cfg_analysis *analysis = mcc_pass_manager_get_cfg(manager, function_label);
+		if (!analysis)
+			return false;
+		for (struct mcc_cfg_loop *loop = analysis->loops; loop && !changed; loop = loop->next) {
+			int unrolled = unroll_loop(data, function_label, analysis, loop);
+			if (unrolled < 0) {
+				mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+				return false;
+			}
+			changed = unrolled > 0;
+		}
+		if (changed)
+			mcc_pass_manager_invalidate(manager, function_label, MCC_PASS_ANALYSIS_ALL);
+	}
+	return true;
+}
+
+bool mcc_unroll_run_with_manager(struct mcc_pass_manager *manager)
+{
+	assert(manager);
+
+	struct unroll_data data = {
+	    .factor = manager->options.unroll_factor, .counter = 0, .num_remainders = 0, .remainders = NULL};
+	bool ok = true;
+	for (struct mcc_ir_row *row = manager->ir; row && ok; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL)
+			ok = unroll_function(&data, manager, row);
+	}
+	free(data.remainders);
+	mcc_ir_number_rows(manager->ir);
+	return ok;
+}
+
+bool mcc_unroll_run(struct mcc_ir_row *ir, unsigned factor)
+{
+	assert(ir);
+
+	struct mcc_pass_options options = {.unroll_factor = factor};
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, &options);
+	if (!manager)
+		return false;
+	bool success = mcc_unroll_run_with_manager(manager);
+	mcc_pass_manager_delete(manager);
+	return success;
+}
@@ -0,0 +1,795 @@
+#include "mcc/vectorize.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/cfg_analysis.h"
+#include "utils/length_of_int.h"
+
+// Number of 4 byte elements in an SSE2 register
+#define LANES 4
+
+#define REASON_SIZE 160
+
+enum reduction_kind {
+	REDUCTION_SUM,
+	REDUCTION_MIN,
+	REDUCTION_MAX,
+};
+
+// Variable that is combined with a value of every iteration
+struct reduction {
+	enum reduction_kind kind;
+	char *ident;
+	// s + v or s - v for sums, the comparison of the value with the variable for minimum and maximum
+	struct mcc_ir_row *row;
+	struct mcc_ir_arg *value;
+	// Array that holds the partial result of every lane
+	char *accumulator;
+	struct reduction *next;
+};
+
+// What happens to a row of the loop body in the vector loop
+enum row_role {
+	// Computed once for all lanes
+	ROLE_SCALAR,
+	ROLE_VECTOR,
+	// First row of a reduction, replaced by the update of the accumulator
+	ROLE_REDUCTION,
+	// Further rows of a reduction
+	ROLE_SKIP,
+};
+
+struct loop {
+	struct mcc_ir_row *function_label;
+	struct mcc_ir_row *header;
+	// i < n and its jumpfalse
+	struct mcc_ir_row *test;
+	// i + 1, followed by the assignment to i and the jump back to the header
+	struct mcc_ir_row *increment;
+	char *counter;
+	// Rows between the exit test and the increment, what to do with them and their copies in the vector loop
+	unsigned num_rows;
+	struct mcc_ir_row **rows;
+	enum row_role *roles;
+	struct mcc_ir_row **copies;
+	struct reduction *reductions;
+	bool accesses_array;
+	// Why the loop is not vectorized, empty if it is
+	char reason[REASON_SIZE];
+};
+
+struct vectorize_data {
+	FILE *report;
+	// Numbers the accumulator arrays
+	unsigned counter;
+};
+
+static void delete_loop(struct loop *loop)
+{
+	free(loop->rows);
+	free(loop->roles);
+	free(loop->copies);
+	while (loop->reductions) {
+		struct reduction *next = loop->reductions->next;
+		free(loop->reductions->accumulator);
+		free(loop->reductions);
+		loop->reductions = next;
+	}
+}
+
+//---------------------------------------------------------------------------------------- Loop shape
+
+// Matches a counted loop (see cfg_analysis.h) that ends with u = i + 1; i = u; jump L
+static bool match_loop_shape(struct loop *loop)
+{
+	struct mcc_cfg_counted_loop shape;
+	if (!mcc_cfg_match_counted_loop(loop->header, &shape) ||
+	    (shape.test->arg2->type != MCC_IR_TYPE_IDENTIFIER && shape.test->arg2->type != MCC_IR_TYPE_LIT_INT)) {
+		snprintf(loop->reason, REASON_SIZE, "the loop is not a while loop with the exit test i < n or i <= n");
+		return false;
+	}
+	loop->test = shape.test;
+	loop->counter = shape.counter;
+
+	struct mcc_ir_row *assign = shape.back_jump->prev_row;
+	struct mcc_ir_row *increment = assign->prev_row;
+	if (increment == shape.exit_jump || assign->instr != MCC_IR_INSTR_ASSIGN ||
+	    !mcc_ir_is_identifier(assign->arg1, loop->counter) || !mcc_ir_is_row(assign->arg2, increment) ||
+	    increment->instr != MCC_IR_INSTR_PLUS || increment->type->type != MCC_IR_ROW_INT ||
+	    !mcc_ir_is_identifier(increment->arg1, loop->counter) || increment->arg2->type != MCC_IR_TYPE_LIT_INT ||
+	    increment->arg2->lit_int != 1) {
+		snprintf(loop->reason, REASON_SIZE, "the loop does not end with %s = %s + 1", loop->counter,
+		         loop->counter);
+		return false;
+	}
+	loop->increment = increment;
+	return true;
+}
+
+static bool collect_body(struct loop *loop)
+{
+	struct mcc_ir_row *first = loop->test->next_row->next_row;
+	loop->num_rows = 0;
+	for (struct mcc_ir_row *row = first; row != loop->increment; row = row->next_row) {
+		loop->num_rows++;
+	}
+
+	// One more, so nothing is allocated with size 0
+	loop->rows = malloc(sizeof(*loop->rows) * (loop->num_rows + 1));
+	loop->roles = malloc(sizeof(*loop->roles) * (loop->num_rows + 1));
+	loop->copies = malloc(sizeof(*loop->copies) * (loop->num_rows + 1));
+	if (!loop->rows || !loop->roles || !loop->copies)
+		return false;
+
+	unsigned i = 0;
+	for (struct mcc_ir_row *row = first; row != loop->increment; row = row->next_row) {
+		loop->rows[i] = row;
+		loop->roles[i] = ROLE_SCALAR;
+		loop->copies[i] = NULL;
+		i++;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Body analysis
+
+static int find_body_row(struct loop *loop, struct mcc_ir_row *row)
+{
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		if (loop->rows[i] == row)
+			return (int)i;
+	}
+	return -1;
+}
+
+static bool is_assigned_in_body(struct loop *loop, char *ident)
+{
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		struct mcc_ir_row *row = loop->rows[i];
+		if (row->instr == MCC_IR_INSTR_ASSIGN && mcc_ir_is_identifier(row->arg1, ident))
+			return true;
+	}
+	return false;
+}
+
+// Number of times ident is read or assigned in the body, array indices included
+static unsigned count_identifier(struct loop *loop, char *ident)
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		struct mcc_ir_arg *args[] = {loop->rows[i]->arg1, loop->rows[i]->arg2};
+		for (unsigned j = 0; j < 2; j++) {
+			struct mcc_ir_arg *arg = args[j];
+			if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+				arg = arg->index;
+			if (mcc_ir_is_identifier(arg, ident))
+				count++;
+		}
+	}
+	return count;
+}
+
+static unsigned count_row_uses(struct loop *loop, struct mcc_ir_row *used)
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		struct mcc_ir_arg *args[] = {loop->rows[i]->arg1, loop->rows[i]->arg2};
+		for (unsigned j = 0; j < 2; j++) {
+			struct mcc_ir_arg *arg = args[j];
+			if (arg && arg->type == MCC_IR_TYPE_ARR_ELEM)
+				arg = arg->index;
+			if (mcc_ir_is_row(arg, used))
+				count++;
+		}
+	}
+	return count;
+}
+
+// Local arrays are declared by an array row, array parameters by the assignment behind their pop
+static enum mcc_ir_row_types get_element_type(struct loop *loop, char *array)
+{
+	for (struct mcc_ir_row *row = loop->function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_ARRAY && strcmp(row->arg1->ident, array) == 0)
+			return row->type->type;
+		if (row->instr == MCC_IR_INSTR_ASSIGN && row->type->array_size >= 0 && mcc_ir_is_identifier(row->arg1, array))
+			return row->type->type;
+	}
+	return MCC_IR_ROW_TYPELESS;
+}
+
+// Lanes access consecutive elements, so the index has to be the counter itself
+static bool check_access(struct loop *loop, struct mcc_ir_arg *element)
+{
+	if (!mcc_ir_is_identifier(element->index, loop->counter)) {
+		snprintf(loop->reason, REASON_SIZE, "%s is accessed at an index other than %s", element->arr_ident,
+		         loop->counter);
+		return false;
+	}
+	enum mcc_ir_row_types type = get_element_type(loop, element->arr_ident);
+	if (type != MCC_IR_ROW_INT && type != MCC_IR_ROW_FLOAT) {
+		snprintf(loop->reason, REASON_SIZE, "%s is no int or float array", element->arr_ident);
+		return false;
+	}
+	loop->accesses_array = true;
+	return true;
+}
+
+enum operand_kind {
+	OPERAND_SCALAR,
+	OPERAND_VECTOR,
+	OPERAND_INVALID,
+};
+
+static enum operand_kind classify_operand(struct loop *loop, struct mcc_ir_arg *arg)
+{
+	if (!arg)
+		return OPERAND_SCALAR;
+
+	switch (arg->type) {
+	case MCC_IR_TYPE_ARR_ELEM:
+		return check_access(loop, arg) ? OPERAND_VECTOR : OPERAND_INVALID;
+	case MCC_IR_TYPE_IDENTIFIER:
+		if (strcmp(arg->ident, loop->counter) == 0) {
+			snprintf(loop->reason, REASON_SIZE, "the counter %s is used as a value", loop->counter);
+			return OPERAND_INVALID;
+		}
+		// Would carry a value from one iteration to the next
+		if (is_assigned_in_body(loop, arg->ident)) {
+			snprintf(loop->reason, REASON_SIZE, "%s is read and assigned in the loop", arg->ident);
+			return OPERAND_INVALID;
+		}
+		return OPERAND_SCALAR;
+	case MCC_IR_TYPE_ROW: {
+		int index = find_body_row(loop, arg->row);
+		return index >= 0 && loop->roles[index] == ROLE_VECTOR ? OPERAND_VECTOR : OPERAND_SCALAR;
+	}
+	default:
+		return OPERAND_SCALAR;
+	}
+}
+
+static bool args_are_equal(struct mcc_ir_arg *a, struct mcc_ir_arg *b)
+{
+	if (a->type != b->type)
+		return false;
+	switch (a->type) {
+	case MCC_IR_TYPE_ROW:
+		return a->row == b->row;
+	case MCC_IR_TYPE_IDENTIFIER:
+		return strcmp(a->ident, b->ident) == 0;
+	case MCC_IR_TYPE_ARR_ELEM:
+		return strcmp(a->arr_ident, b->arr_ident) == 0 && args_are_equal(a->index, b->index);
+	case MCC_IR_TYPE_LIT_INT:
+		return a->lit_int == b->lit_int;
+	default:
+		return false;
+	}
+}
+
+static bool add_reduction(struct loop *loop,
+                          enum reduction_kind kind,
+                          char *ident,
+                          struct mcc_ir_row *row,
+                          struct mcc_ir_arg *value)
+{
+	struct reduction *reduction = malloc(sizeof(*reduction));
+	if (!reduction)
+		return false;
+	reduction->kind = kind;
+	reduction->ident = ident;
+	reduction->row = row;
+	reduction->value = value;
+	reduction->accumulator = NULL;
+	reduction->next = loop->reductions;
+	loop->reductions = reduction;
+	return true;
+}
+
+// The lanes are combined in a different order than the iterations. For int this gives the same result.
+static bool is_int_reduction(struct loop *loop, struct mcc_ir_row *row, char *ident)
+{
+	if (row->type->type == MCC_IR_ROW_INT)
+		return true;
+	snprintf(loop->reason, REASON_SIZE, "%s is a float reduction, which depends on the order of the iterations",
+	         ident);
+	return false;
+}
+
+// s = s + v or s = s - v, where s is used nowhere else in the loop. Returns the number of matched rows, 0 if they
+// do not match and -1 if memory allocation fails.
+static int match_sum(struct loop *loop, unsigned i)
+{
+	struct mcc_ir_row *row = loop->rows[i];
+	if ((row->instr != MCC_IR_INSTR_PLUS && row->instr != MCC_IR_INSTR_MINUS) || i + 1 >= loop->num_rows)
+		return 0;
+	struct mcc_ir_row *assign = loop->rows[i + 1];
+	if (assign->instr != MCC_IR_INSTR_ASSIGN || assign->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+	    !mcc_ir_is_row(assign->arg2, row))
+		return 0;
+
+	char *ident = assign->arg1->ident;
+	struct mcc_ir_arg *value = NULL;
+	if (mcc_ir_is_identifier(row->arg1, ident))
+		value = row->arg2;
+	else if (row->instr == MCC_IR_INSTR_PLUS && mcc_ir_is_identifier(row->arg2, ident))
+		value = row->arg1;
+	if (!value || strcmp(ident, loop->counter) == 0 || count_identifier(loop, ident) != 2 ||
+	    count_row_uses(loop, row) != 1)
+		return 0;
+
+	if (!is_int_reduction(loop, row, ident) || classify_operand(loop, value) == OPERAND_INVALID)
+		return 0;
+	if (!add_reduction(loop, REDUCTION_SUM, ident, row, value))
+		return -1;
+	loop->roles[i] = ROLE_REDUCTION;
+	loop->roles[i + 1] = ROLE_SKIP;
+	return 2;
+}
+
+// if (v < m) { m = v; } and the variants with > and swapped operands, where m is used nowhere else in the loop
+static int match_min_max(struct loop *loop, unsigned i)
+{
+	struct mcc_ir_row *compare = loop->rows[i];
+	if ((compare->instr != MCC_IR_INSTR_SMALLER && compare->instr != MCC_IR_INSTR_GREATER) ||
+	    i + 3 >= loop->num_rows)
+		return 0;
+	struct mcc_ir_row *jump = loop->rows[i + 1];
+	struct mcc_ir_row *assign = loop->rows[i + 2];
+	struct mcc_ir_row *label = loop->rows[i + 3];
+	if (jump->instr != MCC_IR_INSTR_JUMPFALSE || !mcc_ir_is_row(jump->arg1, compare) ||
+	    assign->instr != MCC_IR_INSTR_ASSIGN || assign->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+	    label->instr != MCC_IR_INSTR_LABEL || label->arg1->label != jump->arg2->label)
+		return 0;
+
+	char *ident = assign->arg1->ident;
+	struct mcc_ir_arg *value = assign->arg2;
+	bool is_smaller = compare->instr == MCC_IR_INSTR_SMALLER;
+	enum reduction_kind kind;
+	if (mcc_ir_is_identifier(compare->arg2, ident) && args_are_equal(compare->arg1, value))
+		kind = is_smaller ? REDUCTION_MIN : REDUCTION_MAX;
+	else if (mcc_ir_is_identifier(compare->arg1, ident) && args_are_equal(compare->arg2, value))
+		kind = is_smaller ? REDUCTION_MAX : REDUCTION_MIN;
+	else
+		return 0;
+	if (strcmp(ident, loop->counter) == 0 || count_identifier(loop, ident) != 2 ||
+	    count_row_uses(loop, compare) != 1)
+		return 0;
+
+	if (!is_int_reduction(loop, assign, ident) || classify_operand(loop, value) == OPERAND_INVALID)
+		return 0;
+	if (!add_reduction(loop, kind, ident, compare, value))
+		return -1;
+	loop->roles[i] = ROLE_REDUCTION;
+	for (unsigned j = i + 1; j <= i + 3; j++) {
+		loop->roles[j] = ROLE_SKIP;
+	}
+	return 4;
+}
+
+static bool check_value_row(struct loop *loop, unsigned i)
+{
+	struct mcc_ir_row *row = loop->rows[i];
+	enum operand_kind kind1 = classify_operand(loop, row->arg1);
+	enum operand_kind kind2 = classify_operand(loop, row->arg2);
+	if (kind1 == OPERAND_INVALID || kind2 == OPERAND_INVALID)
+		return false;
+	if (kind1 == OPERAND_SCALAR && kind2 == OPERAND_SCALAR)
+		return true;
+
+	bool is_float = row->type->type == MCC_IR_ROW_FLOAT;
+	switch (row->instr) {
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+		break;
+	case MCC_IR_INSTR_MULTIPLY:
+		if (!is_float) {
+			snprintf(loop->reason, REASON_SIZE, "SSE2 has no packed multiplication of 32 bit ints");
+			return false;
+		}
+		break;
+	case MCC_IR_INSTR_DIVIDE:
+		if (!is_float) {
+			snprintf(loop->reason, REASON_SIZE, "SSE2 has no packed int division");
+			return false;
+		}
+		break;
+	default:
+		snprintf(loop->reason, REASON_SIZE, "array elements are compared, negated or used as bools");
+		return false;
+	}
+	loop->roles[i] = ROLE_VECTOR;
+	return true;
+}
+
+static bool check_row(struct loop *loop, unsigned i)
+{
+	struct mcc_ir_row *row = loop->rows[i];
+	switch (row->instr) {
+	case MCC_IR_INSTR_ASSIGN:
+		if (row->arg1->type == MCC_IR_TYPE_ARR_ELEM) {
+			if (!check_access(loop, row->arg1) || classify_operand(loop, row->arg2) == OPERAND_INVALID)
+				return false;
+			loop->roles[i] = ROLE_VECTOR;
+			return true;
+		}
+		if (strcmp(row->arg1->ident, loop->counter) == 0) {
+			snprintf(loop->reason, REASON_SIZE, "the counter %s is assigned in the body", loop->counter);
+		} else {
+			snprintf(loop->reason, REASON_SIZE, "%s is assigned, but is no sum, minimum or maximum",
+			         row->arg1->ident);
+		}
+		return false;
+	case MCC_IR_INSTR_PLUS:
+	case MCC_IR_INSTR_MINUS:
+	case MCC_IR_INSTR_MULTIPLY:
+	case MCC_IR_INSTR_DIVIDE:
+	case MCC_IR_INSTR_EQUALS:
+	case MCC_IR_INSTR_NOTEQUALS:
+	case MCC_IR_INSTR_SMALLER:
+	case MCC_IR_INSTR_GREATER:
+	case MCC_IR_INSTR_SMALLEREQ:
+	case MCC_IR_INSTR_GREATEREQ:
+	case MCC_IR_INSTR_AND:
+	case MCC_IR_INSTR_OR:
+	case MCC_IR_INSTR_NEGATIV:
+	case MCC_IR_INSTR_NOT:
+		return check_value_row(loop, i);
+	case MCC_IR_INSTR_LABEL:
+	case MCC_IR_INSTR_JUMP:
+	case MCC_IR_INSTR_JUMPFALSE:
+		snprintf(loop->reason, REASON_SIZE, "the body branches, other than for a minimum or maximum");
+		return false;
+	case MCC_IR_INSTR_PUSH:
+	case MCC_IR_INSTR_CALL:
+		snprintf(loop->reason, REASON_SIZE, "the body calls a function");
+		return false;
+	case MCC_IR_INSTR_RETURN:
+		snprintf(loop->reason, REASON_SIZE, "the body returns");
+		return false;
+	case MCC_IR_INSTR_ARRAY:
+		snprintf(loop->reason, REASON_SIZE, "the body declares an array");
+		return false;
+	default:
+		snprintf(loop->reason, REASON_SIZE, "the body contains an unsupported instruction");
+		return false;
+	}
+}
+
+// Returns false if memory allocation fails. If the loop cannot be vectorized, reason is set.
+static bool analyse_body(struct loop *loop)
+{
+	struct mcc_ir_arg *bound = loop->test->arg2;
+	if (bound->type == MCC_IR_TYPE_IDENTIFIER &&
+	    (strcmp(bound->ident, loop->counter) == 0 || is_assigned_in_body(loop, bound->ident))) {
+		snprintf(loop->reason, REASON_SIZE, "the bound %s changes in the loop", bound->ident);
+		return true;
+	}
+
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		int matched = match_sum(loop, i);
+		if (matched == 0 && !loop->reason[0])
+			matched = match_min_max(loop, i);
+		if (matched < 0)
+			return false;
+		if (loop->reason[0])
+			return true;
+		if (matched > 0) {
+			i += matched - 1;
+			continue;
+		}
+		if (!check_row(loop, i))
+			return true;
+	}
+
+	if (!loop->accesses_array)
+		snprintf(loop->reason, REASON_SIZE, "the body accesses no array");
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Vector loop
+
+static struct mcc_ir_row_type *new_type(enum mcc_ir_row_types type, unsigned lanes)
+{
+	struct mcc_ir_row_type *row_type = mcc_ir_new_row_type(type, -1);
+	if (row_type)
+		row_type->lanes = lanes;
+	return row_type;
+}
+
+// Inserts a new row in front of position and takes over type and arguments. arg2 may be NULL only for rows with one
+// argument. Returns NULL if memory allocation fails.
+static struct mcc_ir_row *insert_row(struct mcc_ir_row *position,
+                                     enum mcc_ir_instruction instr,
+                                     struct mcc_ir_row_type *type,
+                                     unsigned num_args,
+                                     struct mcc_ir_arg *arg1,
+                                     struct mcc_ir_arg *arg2)
+{
+	struct mcc_ir_row *row = NULL;
+	if (type && arg1 && (num_args < 2 || arg2))
+		row = mcc_ir_new_row(arg1, arg2, instr, type);
+	if (!row) {
+		mcc_ir_delete_ir_arg(arg1);
+		mcc_ir_delete_ir_arg(arg2);
+		mcc_ir_delete_ir_row_type(type);
+		return NULL;
+	}
+	mcc_ir_insert_row_before(position, row);
+	return row;
+}
+
+static struct mcc_ir_arg *new_element(char *array, long index)
+{
+	struct mcc_ir_arg *index_arg = mcc_ir_new_arg_int(index);
+	if (!index_arg)
+		return NULL;
+	struct mcc_ir_arg *element = mcc_ir_new_arg_array_element(array, index_arg);
+	if (!element)
+		mcc_ir_delete_ir_arg(index_arg);
+	return element;
+}
+
+static struct mcc_ir_arg *new_row_arg(struct mcc_ir_row *row)
+{
+	return row ? mcc_ir_new_arg_row(row) : NULL;
+}
+
+// Operands computed in the body refer to their copies in the vector loop
+static struct mcc_ir_arg *copy_operand(struct loop *loop, struct mcc_ir_arg *arg)
+{
+	struct mcc_ir_arg *copy = mcc_ir_copy_arg(arg);
+	if (copy && copy->type == MCC_IR_TYPE_ROW) {
+		int index = find_body_row(loop, copy->row);
+		if (index >= 0)
+			copy->row = loop->copies[index];
+	}
+	return copy;
+}
+
+static char *new_accumulator_name(struct vectorize_data *data)
+{
+	unsigned size = 4 + length_of_int(data->counter) + 1;
+	char *name = malloc(size);
+	if (name)
+		snprintf(name, size, "$vec%u", data->counter++);
+	return name;
+}
+
+// Declares an accumulator array per reduction and starts every lane with 0 for sums or the current value
+static bool insert_accumulators(struct loop *loop, struct vectorize_data *data)
+{
+	struct mcc_ir_row *position = loop->header;
+	for (struct reduction *reduction = loop->reductions; reduction; reduction = reduction->next) {
+		reduction->accumulator = new_accumulator_name(data);
+		if (!reduction->accumulator)
+			return false;
+		if (!insert_row(position, MCC_IR_INSTR_ARRAY, mcc_ir_new_row_type(MCC_IR_ROW_INT, LANES), 2,
+		                mcc_ir_new_arg_identifier(reduction->accumulator), mcc_ir_new_arg_int(LANES)))
+			return false;
+		struct mcc_ir_arg *start = reduction->kind == REDUCTION_SUM ? mcc_ir_new_arg_int(0)
+		                                                            : mcc_ir_new_arg_identifier(reduction->ident);
+		if (!insert_row(position, MCC_IR_INSTR_ASSIGN, new_type(MCC_IR_ROW_INT, LANES), 2,
+		                new_element(reduction->accumulator, 0), start))
+			return false;
+	}
+	return true;
+}
+
+static struct reduction *find_reduction(struct loop *loop, struct mcc_ir_row *row)
+{
+	struct reduction *reduction = loop->reductions;
+	while (reduction && reduction->row != row) {
+		reduction = reduction->next;
+	}
+	return reduction;
+}
+
+// accumulator = accumulator + v, or the lanes of the minimum or maximum of both
+static bool insert_accumulation(struct loop *loop, struct reduction *reduction)
+{
+	struct mcc_ir_row *position = loop->header;
+	struct mcc_ir_row *row;
+	if (reduction->kind == REDUCTION_SUM) {
+		row = insert_row(position, reduction->row->instr, new_type(MCC_IR_ROW_INT, LANES), 2,
+		                 new_element(reduction->accumulator, 0), copy_operand(loop, reduction->value));
+	} else {
+		enum mcc_ir_instruction instr = reduction->kind == REDUCTION_MIN ? MCC_IR_INSTR_MIN : MCC_IR_INSTR_MAX;
+		row = insert_row(position, instr, new_type(MCC_IR_ROW_INT, LANES), 2,
+		                 copy_operand(loop, reduction->value), new_element(reduction->accumulator, 0));
+	}
+	return row && insert_row(position, MCC_IR_INSTR_ASSIGN, new_type(MCC_IR_ROW_INT, LANES), 2,
+	                         new_element(reduction->accumulator, 0), new_row_arg(row));
+}
+
+static bool insert_body_copy(struct loop *loop)
+{
+	for (unsigned i = 0; i < loop->num_rows; i++) {
+		struct mcc_ir_row *row = loop->rows[i];
+		switch (loop->roles[i]) {
+		case ROLE_SKIP:
+			continue;
+		case ROLE_REDUCTION:
+			if (!insert_accumulation(loop, find_reduction(loop, row)))
+				return false;
+			continue;
+		case ROLE_SCALAR:
+		case ROLE_VECTOR:
+			break;
+		}
+
+		struct mcc_ir_row_type *type = mcc_ir_new_row_type(row->type->type, row->type->array_size);
+		if (type && loop->roles[i] == ROLE_VECTOR)
+			type->lanes = LANES;
+		struct mcc_ir_arg *arg2 = row->arg2 ? copy_operand(loop, row->arg2) : NULL;
+		loop->copies[i] =
+		    insert_row(loop->header, row->instr, type, row->arg2 ? 2 : 1, copy_operand(loop, row->arg1), arg2);
+		if (!loop->copies[i])
+			return false;
+	}
+	return true;
+}
+
+// Adds up the lanes of a sum, or merges the lanes of a minimum or maximum the same way as the original loop
+static bool insert_combination(struct loop *loop, struct reduction *reduction)
+{
+	struct mcc_ir_row *position = loop->header;
+	char *accumulator = reduction->accumulator;
+	if (reduction->kind == REDUCTION_SUM) {
+		struct mcc_ir_arg *sum = new_element(accumulator, 0);
+		for (unsigned lane = 1; lane < LANES; lane++) {
+			struct mcc_ir_row *row = insert_row(position, MCC_IR_INSTR_PLUS, new_type(MCC_IR_ROW_INT, 1), 2, sum,
+			                                    new_element(accumulator, lane));
+			sum = new_row_arg(row);
+		}
+		struct mcc_ir_row *row = insert_row(position, MCC_IR_INSTR_PLUS, new_type(MCC_IR_ROW_INT, 1), 2,
+		                                    mcc_ir_new_arg_identifier(reduction->ident), sum);
+		return row && insert_row(position, MCC_IR_INSTR_ASSIGN, new_type(MCC_IR_ROW_INT, 1), 2,
+		                         mcc_ir_new_arg_identifier(reduction->ident), new_row_arg(row));
+	}
+
+	enum mcc_ir_instruction instr = reduction->kind == REDUCTION_MIN ? MCC_IR_INSTR_SMALLER : MCC_IR_INSTR_GREATER;
+	for (unsigned lane = 0; lane < LANES; lane++) {
+		unsigned label = mcc_ir_get_unused_label(position);
+		struct mcc_ir_row *compare = insert_row(position, instr, new_type(MCC_IR_ROW_BOOL, 1), 2,
+		                                        new_element(accumulator, lane),
+		                                        mcc_ir_new_arg_identifier(reduction->ident));
+		if (!compare ||
+		    !insert_row(position, MCC_IR_INSTR_JUMPFALSE, new_type(MCC_IR_ROW_TYPELESS, 1), 2,
+		                new_row_arg(compare), mcc_ir_new_arg_label(label)) ||
+		    !insert_row(position, MCC_IR_INSTR_ASSIGN, new_type(MCC_IR_ROW_INT, 1), 2,
+		                mcc_ir_new_arg_identifier(reduction->ident), new_element(accumulator, lane)) ||
+		    !insert_row(position, MCC_IR_INSTR_LABEL, new_type(MCC_IR_ROW_TYPELESS, 1), 1,
+		                mcc_ir_new_arg_label(label), NULL))
+			return false;
+	}
+	return true;
+}
+
+// Places the vector loop in front of the original loop, which then runs the remaining iterations:
+//     V: t = i < n - 3; jumpfalse t X; <body for 4 lanes>; u = i + 4; i = u; jump V; X: <combine reductions>
+static bool insert_vector_loop(struct loop *loop, struct vectorize_data *data)
+{
+	struct mcc_ir_row *position = loop->header;
+	if (!insert_accumulators(loop, data))
+		return false;
+
+	// i + 3 < n is computed as i < n - 3, so the subtraction can be done once
+	struct mcc_ir_arg *bound = loop->test->arg2;
+	struct mcc_ir_arg *last_start;
+	if (bound->type == MCC_IR_TYPE_LIT_INT) {
+		last_start = mcc_ir_new_arg_int(bound->lit_int - (LANES - 1));
+	} else {
+		last_start = new_row_arg(insert_row(position, MCC_IR_INSTR_MINUS, new_type(MCC_IR_ROW_INT, 1), 2,
+		                                    mcc_ir_copy_arg(bound), mcc_ir_new_arg_int(LANES - 1)));
+	}
+
+	unsigned vector_label = mcc_ir_get_unused_label(position);
+	if (!insert_row(position, MCC_IR_INSTR_LABEL, new_type(MCC_IR_ROW_TYPELESS, 1), 1,
+	                mcc_ir_new_arg_label(vector_label), NULL)) {
+		mcc_ir_delete_ir_arg(last_start);
+		return false;
+	}
+	unsigned exit_label = mcc_ir_get_unused_label(position);
+	struct mcc_ir_row *test = insert_row(position, loop->test->instr, new_type(MCC_IR_ROW_BOOL, 1), 2,
+	                                     mcc_ir_new_arg_identifier(loop->counter), last_start);
+	if (!test ||
+	    !insert_row(position, MCC_IR_INSTR_JUMPFALSE, new_type(MCC_IR_ROW_TYPELESS, 1), 2, new_row_arg(test),
+	                mcc_ir_new_arg_label(exit_label)) ||
+	    !insert_body_copy(loop))
+		return false;
+
+	struct mcc_ir_row *increment = insert_row(position, MCC_IR_INSTR_PLUS, new_type(MCC_IR_ROW_INT, 1), 2,
+	                                          mcc_ir_new_arg_identifier(loop->counter), mcc_ir_new_arg_int(LANES));
+	if (!increment ||
+	    !insert_row(position, MCC_IR_INSTR_ASSIGN, new_type(MCC_IR_ROW_INT, 1), 2,
+	                mcc_ir_new_arg_identifier(loop->counter), new_row_arg(increment)) ||
+	    !insert_row(position, MCC_IR_INSTR_JUMP, new_type(MCC_IR_ROW_TYPELESS, 1), 1,
+	                mcc_ir_new_arg_label(vector_label), NULL) ||
+	    !insert_row(position, MCC_IR_INSTR_LABEL, new_type(MCC_IR_ROW_TYPELESS, 1), 1,
+	                mcc_ir_new_arg_label(exit_label), NULL))
+		return false;
+
+	for (struct reduction *reduction = loop->reductions; reduction; reduction = reduction->next) {
+		if (!insert_combination(loop, reduction))
+			return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------- Report
+
+static const char *reduction_kind_to_string(enum reduction_kind kind)
+{
+	switch (kind) {
+	case REDUCTION_SUM:
+		return "sum";
+	case REDUCTION_MIN:
+		return "minimum";
+	case REDUCTION_MAX:
+		return "maximum";
+	}
+	return "";
+}
+
+static void report_loop(struct loop *loop, struct vectorize_data *data)
+{
+	if (!data->report)
+		return;
+
+	fprintf(data->report, "%s: loop L%u: ", loop->function_label->arg1->func_label, loop->header->arg1->label);
+	if (loop->reason[0]) {
+		fprintf(data->report, "not vectorized: %s\n", loop->reason);
+		return;
+	}
+	fprintf(data->report, "vectorized with %d lanes", LANES);
+	for (struct reduction *reduction = loop->reductions; reduction; reduction = reduction->next) {
+		fprintf(data->report, ", %s of %s", reduction_kind_to_string(reduction->kind), reduction->ident);
+	}
+	fprintf(data->report, "\n");
+}
+
+//---------------------------------------------------------------------------------------- Functions: Vectorization
+
+static bool vectorize_loop(struct mcc_ir_row *function_label, struct mcc_ir_row *header, struct vectorize_data *data)
+{
+	struct loop loop = {.function_label = function_label, .header = header};
+	loop.reason[0] = '\0';
+
+	bool ok = true;
+	if (match_loop_shape(&loop)) {
+		ok = collect_body(&loop) && analyse_body(&loop);
+		if (ok && !loop.reason[0])
+			ok = insert_vector_loop(&loop, data);
+	}
+	if (ok)
+		report_loop(&loop, data);
+	delete_loop(&loop);
+	return ok;
+}
+
+static bool vectorize_function(struct mcc_ir_row *function_label, struct vectorize_data *data)
+{
+	// The vector loop is inserted in front of the header, so it is not visited again
+	for (struct mcc_ir_row *row = function_label->next_row; !mcc_ir_is_function_end(row); row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_LABEL)
+			continue;
+		if (mcc_cfg_find_back_jump(row) && !vectorize_loop(function_label, row, data))
+			return false;
+	}
+	return true;
+}
+
+bool mcc_vectorize_run(struct mcc_ir_row *ir, FILE *report)
+{
+	assert(ir);
+
+	struct vectorize_data data = {.report = report, .counter = 0};
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr == MCC_IR_INSTR_FUNC_LABEL && !vectorize_function(row, &data))
+			return false;
+	}
+	mcc_ir_number_rows(ir);
+	return true;
+}
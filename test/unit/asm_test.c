@@ -1,12 +1,16 @@
 #include <CuTest.h>
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "mcc/asm.h"
+#include "mcc/asm_print.h"
 #include "mcc/ast.h"
 #include "mcc/ir.h"
+#include "mcc/peephole.h"
+#include "mcc/profile.h"
 #include "mcc/semantic_checks.h"
 #include "mcc/stack_size.h"
 #include "mcc/symbol_table.h"
@@ -83,7 +87,8 @@ void stack_frame_size_int(CuTest *tc)
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_LITERAL, code->text_section->function->head->next->next->first->type);
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, code->text_section->function->head->next->next->second->type);
 	CuAssertIntEquals(tc, MCC_ASM_ESP, code->text_section->function->head->next->next->second->reg);
-	CuAssertIntEquals(tc, 20, code->text_section->function->head->next->next->first->literal);
+	// a and b, and one slot shared by the temporaries of the loop, which do not overlap
+	CuAssertIntEquals(tc, 12, code->text_section->function->head->next->next->first->literal);
 
 	mcc_ir_delete_ir(ir);
 	mcc_semantic_check_delete_single_check(checks);
@@ -129,6 +134,7 @@ void addition_lit(CuTest *tc)
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
 	CuAssertIntEquals(tc, MCC_ASM_EAX, line->second->reg);
 
+	// The sum is stored into a directly, which is in the first slot below the temporary
 	line = line->next;
 
 	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
@@ -147,15 +153,6 @@ void addition_lit(CuTest *tc)
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
 	CuAssertIntEquals(tc, MCC_ASM_EAX, line->second->reg);
 
-	line = line->next;
-
-	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
-	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->first->type);
-	CuAssertIntEquals(tc, MCC_ASM_EAX, line->first->reg);
-	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
-	CuAssertIntEquals(tc, MCC_ASM_EBP, line->second->reg);
-	CuAssertIntEquals(tc, -8, line->second->offset);
-
 	mcc_ir_delete_ir(ir);
 	mcc_semantic_check_delete_single_check(checks);
 	mcc_ast_delete(parser_result.program);
@@ -166,7 +163,7 @@ void addition_lit(CuTest *tc)
 void div_int(CuTest *tc)
 {
 	// Define test input and create IR
-	const char input[] = "int main(){ int a; a = 17; a = a / 3; return a;}";
+	const char input[] = "int main(){ int a; int b; a = 17; b = 3; a = a / b; return a;}";
 	struct mcc_parser_result parser_result;
 	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
 	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
@@ -178,7 +175,7 @@ void div_int(CuTest *tc)
 
 	struct mcc_asm *code = mcc_asm_generate(ir);
 	CuAssertPtrNotNull(tc, code);
-	struct mcc_asm_line *line = code->text_section->function->head->next->next->next->next;
+	struct mcc_asm_line *line = code->text_section->function->head->next->next->next->next->next;
 
 	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->first->type);
@@ -190,18 +187,17 @@ void div_int(CuTest *tc)
 	line = line->next;
 
 	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
-	CuAssertIntEquals(tc, MCC_ASM_OPERAND_LITERAL, line->first->type);
-	CuAssertIntEquals(tc, 3, line->first->literal);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->first->type);
+	CuAssertIntEquals(tc, MCC_ASM_EBP, line->first->reg);
+	CuAssertIntEquals(tc, -8, line->first->offset);
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
 	CuAssertIntEquals(tc, MCC_ASM_EBX, line->second->reg);
 
 	line = line->next;
 
-	CuAssertIntEquals(tc, MCC_ASM_XORL, line->opcode);
-	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->first->type);
-	CuAssertIntEquals(tc, MCC_ASM_EDX, line->first->reg);
-	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
-	CuAssertIntEquals(tc, MCC_ASM_EDX, line->second->reg);
+	// The dividend is sign extended into edx
+	CuAssertIntEquals(tc, MCC_ASM_CLTD, line->opcode);
+	CuAssertPtrEquals(tc, NULL, line->first);
 
 	line = line->next;
 
@@ -217,7 +213,7 @@ void div_int(CuTest *tc)
 	CuAssertIntEquals(tc, MCC_ASM_EAX, line->first->reg);
 	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
 	CuAssertIntEquals(tc, MCC_ASM_EBP, line->second->reg);
-	CuAssertIntEquals(tc, -8, line->second->offset);
+	CuAssertIntEquals(tc, -12, line->second->offset);
 
 	mcc_ir_delete_ir(ir);
 	mcc_semantic_check_delete_single_check(checks);
@@ -369,6 +365,748 @@ void strings2(CuTest *tc)
 	mcc_symbol_table_delete_table(table);
 	mcc_asm_delete_asm(code);
 }
+void increment_in_place(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ int a; a = 1; a = a + 2; return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	struct mcc_asm_line *line = code->text_section->function->head->next->next->next->next;
+
+	// a = a + 2 changes the stack slot of a directly
+	CuAssertIntEquals(tc, MCC_ASM_ADDL, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_LITERAL, line->first->type);
+	CuAssertIntEquals(tc, 2, line->first->literal);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->second->type);
+	CuAssertIntEquals(tc, MCC_ASM_EBP, line->second->reg);
+	CuAssertIntEquals(tc, -4, line->second->offset);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void constant_operands(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ int a; a = read_int(); a = a * 8; a = a * 9; a = a * 10; a = a / 7; return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	// a * 8 is a shift, a * 9 a leal, a * 10 a leal and a shift, a / 7 a multiplication with the magic number into edx
+	int shll = 0;
+	int leal = 0;
+	int imull = 0;
+	for (struct mcc_asm_line *line = code->text_section->function->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_IDIVL);
+		if (line->opcode == MCC_ASM_SHLL)
+			shll++;
+		if (line->opcode == MCC_ASM_LEAL)
+			leal++;
+		if (line->opcode == MCC_ASM_IMULL)
+			imull++;
+	}
+	CuAssertIntEquals(tc, 2, shll);
+	CuAssertIntEquals(tc, 2, leal);
+	CuAssertIntEquals(tc, 1, imull);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void constant_multiplications(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] =
+	    "int main(){ int a; a = read_int(); a = a * 6; a = a * 7; a = a * 17; a = a * -4; return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	// a * 6 is a leal and a shift, a * 7 and a * 17 a shift and a subl or addl, a * -4 a shift and a negl
+	int shll = 0;
+	int leal = 0;
+	int addl = 0;
+	int subl = 0;
+	int negl = 0;
+	for (struct mcc_asm_line *line = code->text_section->function->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_IMULL);
+		if (line->opcode == MCC_ASM_SHLL)
+			shll++;
+		if (line->opcode == MCC_ASM_LEAL)
+			leal++;
+		// Not counting the adjustments of esp by literals
+		bool is_register_step = line->first && line->first->type == MCC_ASM_OPERAND_REGISTER;
+		if (line->opcode == MCC_ASM_ADDL && is_register_step)
+			addl++;
+		if (line->opcode == MCC_ASM_SUBL && is_register_step)
+			subl++;
+		if (line->opcode == MCC_ASM_NEGL)
+			negl++;
+	}
+	CuAssertIntEquals(tc, 4, shll);
+	CuAssertIntEquals(tc, 1, leal);
+	CuAssertIntEquals(tc, 1, addl);
+	CuAssertIntEquals(tc, 1, subl);
+	CuAssertIntEquals(tc, 1, negl);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void expression_trees(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ int a; int b; a = read_int(); b = read_int(); int x; x = a * 4 + b; return x;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	struct mcc_asm_line *line = code->text_section->function->head;
+	while (line && line->opcode != MCC_ASM_LEAL)
+		line = line->next;
+	CuAssertPtrNotNull(tc, line);
+
+	// The product is folded into the addition, which is stored into x directly
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_COMPUTED_OFFSET, line->first->type);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->first->offset_base);
+	CuAssertIntEquals(tc, MCC_ASM_EDX, line->first->offset_factor);
+	CuAssertIntEquals(tc, 4, line->first->offset_size);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->second->reg);
+
+	line = line->next;
+
+	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->first->reg);
+	CuAssertIntEquals(tc, MCC_ASM_EBP, line->second->reg);
+
+	line = line->next;
+
+	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_REGISTER, line->first->type);
+	CuAssertIntEquals(tc, MCC_ASM_EBP, line->first->reg);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->second->reg);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void tail_jump(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int g(int x){ return x + 1;} int f(int y){ return g(y * 2);} int main(){ return f(1);}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	struct mcc_asm_function *function = code->text_section->function->next;
+	CuAssertStrEquals(tc, "f", function->label);
+	struct mcc_asm_line *line = function->head;
+	while (line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_CALLL);
+		line = line->next;
+	}
+
+	// f gives up its frame and jumps to g, which returns to the caller of f
+	CuAssertIntEquals(tc, MCC_ASM_JMP, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_FUNCTION, line->first->type);
+	CuAssertStrEquals(tc, "g", line->first->func_name);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void compare_and_branch(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ int i; float f; i = 0; f = 0.0; while (i < 10) { i = i + 1; } "
+	                     "while (f >= 1.5) { f = f - 1.0; } return i;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	// The loop conditions jump on the flags of the comparison, no bool is set
+	int jge = 0;
+	int jb = 0;
+	for (struct mcc_asm_line *line = code->text_section->function->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_SETL && line->opcode != MCC_ASM_SETAE);
+		if (line->opcode == MCC_ASM_JGE)
+			jge++;
+		if (line->opcode == MCC_ASM_JB)
+			jb++;
+	}
+	CuAssertIntEquals(tc, 1, jge);
+	CuAssertIntEquals(tc, 1, jb);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void conditional_moves(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ int a; int b; int m; a = read_int(); b = read_int(); "
+	                     "if (a < b) m = a; else m = b; if (m > 3) m = m * 2; return m;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	// Both if statements are computed without jumps. The first selects one of two values, the second keeps the old
+	// value of m if the condition stored in ebx is false.
+	int cmovl = 0;
+	int cmove = 0;
+	for (struct mcc_asm_line *line = code->text_section->function->head; line; line = line->next) {
+		CuAssertTrue(tc, !mcc_asm_opcode_has_label(line->opcode) || line->opcode == MCC_ASM_LABEL);
+		if (line->opcode == MCC_ASM_CMOVL)
+			cmovl++;
+		if (line->opcode == MCC_ASM_CMOVE)
+			cmove++;
+	}
+	CuAssertIntEquals(tc, 1, cmovl);
+	CuAssertIntEquals(tc, 1, cmove);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void register_arguments(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int f(int a, int b, int c, int d){ print_int(d); return a + b + c; } "
+	                     "int main(){ return f(1, 2, 3, 4); }";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+
+	// f stores a, b and c from eax, edx and ecx. The builtin print_int is still called with cdecl.
+	struct mcc_asm_function *f = code->text_section->function;
+	CuAssertStrEquals(tc, "f", f->label);
+	enum mcc_asm_register registers[] = {MCC_ASM_EAX, MCC_ASM_EDX, MCC_ASM_ECX};
+	struct mcc_asm_line *line = f->head->next->next->next;
+	for (unsigned i = 0; i < 3; i++) {
+		line = line->next;
+		CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
+		CuAssertIntEquals(tc, registers[i], line->first->reg);
+		CuAssertIntEquals(tc, 0, line->first->offset);
+	}
+	int pushes = 0;
+	for (; line; line = line->next) {
+		pushes += line->opcode == MCC_ASM_PUSHL;
+	}
+	CuAssertIntEquals(tc, 1, pushes);
+
+	// main pushes only d
+	pushes = 0;
+	for (line = f->next->head->next; line; line = line->next) {
+		pushes += line->opcode == MCC_ASM_PUSHL;
+	}
+	CuAssertIntEquals(tc, 1, pushes);
+
+	// Only main, which keeps cdecl, is exported
+	CuAssertTrue(tc, !f->is_global);
+	CuAssertTrue(tc, f->next->is_global);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void sse2_floats(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int main(){ float a; float b; a = 1.5; b = a + a; if (b > a) return 1; return 0;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm_options options = {.sse2 = true};
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &options);
+	CuAssertPtrNotNull(tc, code);
+
+	// No float is loaded onto the x87 stack
+	int addss = 0;
+	int ucomiss = 0;
+	for (struct mcc_asm_line *line = code->text_section->function->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_FLDS && line->opcode != MCC_ASM_FSTPS);
+		if (line->opcode == MCC_ASM_ADDSS)
+			addss++;
+		if (line->opcode == MCC_ASM_UCOMISS)
+			ucomiss++;
+	}
+	CuAssertIntEquals(tc, 1, addss);
+	CuAssertIntEquals(tc, 1, ucomiss);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void x86_64_system_v_call(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int f(int a, float b){ print(\"x\"); return a; } int main(){ return f(1, 2.5); }";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm_options options = {.sse2 = false, .target = MCC_ASM_TARGET_X86_64};
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &options);
+	CuAssertPtrNotNull(tc, code);
+
+	// f stores its parameters from rdi and xmm0 and loads the string relative to rip
+	struct mcc_asm_function *f = code->text_section->function;
+	CuAssertStrEquals(tc, "f", f->label);
+	int params = 0;
+	int rip_relative = 0;
+	for (struct mcc_asm_line *line = f->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_PUSHL && line->opcode != MCC_ASM_CALLL);
+		if (line->opcode == MCC_ASM_MOVQ && line->first->type == MCC_ASM_OPERAND_REGISTER &&
+		    line->first->reg == MCC_ASM_RDI)
+			params++;
+		if (line->opcode == MCC_ASM_MOVSS && line->first->type == MCC_ASM_OPERAND_REGISTER &&
+		    line->first->reg == MCC_ASM_XMM0)
+			params++;
+		if (line->opcode == MCC_ASM_LEAQ && line->first->type == MCC_ASM_OPERAND_DATA)
+			rip_relative += line->first->rip_relative;
+	}
+	CuAssertIntEquals(tc, 2, params);
+	CuAssertIntEquals(tc, 1, rip_relative);
+
+	// main passes the arguments in rdi and xmm0 instead of pushing them
+	int args = 0;
+	for (struct mcc_asm_line *line = f->next->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_PUSHL && line->opcode != MCC_ASM_FLDS);
+		if (line->opcode == MCC_ASM_MOVQ && line->first->type == MCC_ASM_OPERAND_LITERAL &&
+		    line->second->reg == MCC_ASM_RDI)
+			args++;
+		if (line->opcode == MCC_ASM_MOVSS && line->first->type == MCC_ASM_OPERAND_REGISTER &&
+		    line->first->reg == MCC_ASM_RBP && line->second->reg == MCC_ASM_XMM0)
+			args++;
+	}
+	CuAssertIntEquals(tc, 2, args);
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+// Function with a single line, further lines are appended to data->current
+static bool is_ebp_operand(struct mcc_asm_operand *operand)
+{
+	return operand && ((operand->type == MCC_ASM_OPERAND_REGISTER && operand->reg == MCC_ASM_EBP) ||
+	                   (operand->type == MCC_ASM_OPERAND_COMPUTED_OFFSET && operand->offset_base == MCC_ASM_EBP));
+}
+
+void omit_frame_pointer(CuTest *tc)
+{
+	// Define test input and create IR
+	const char input[] = "int square(int x){ return x * x; } int main(){ return square(3); }";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm_options options = {.sse2 = false, .target = MCC_ASM_TARGET_X86, .omit_frame_pointer = true};
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &options);
+	CuAssertPtrNotNull(tc, code);
+
+	// square calls no function: its frame is reserved and addressed from esp, ebx is not saved
+	struct mcc_asm_function *square = code->text_section->function;
+	CuAssertStrEquals(tc, "square", square->label);
+	CuAssertIntEquals(tc, MCC_ASM_SUBL, square->head->opcode);
+	for (struct mcc_asm_line *line = square->head; line; line = line->next) {
+		CuAssertTrue(tc, line->opcode != MCC_ASM_PUSHL && line->opcode != MCC_ASM_POPL);
+		CuAssertTrue(tc, line->opcode != MCC_ASM_LEAVE);
+		CuAssertTrue(tc, !is_ebp_operand(line->first) && !is_ebp_operand(line->second));
+	}
+
+	// main calls square and keeps its frame pointer
+	CuAssertIntEquals(tc, MCC_ASM_PUSHL, square->next->head->opcode);
+	CuAssertTrue(tc, is_ebp_operand(square->next->head->first));
+
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void align_loop_headers(CuTest *tc)
+{
+	const char input[] = "int main(){int i; i = 0; while (i < 10) {i = i + 1;} return i;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm *code = mcc_asm_generate(ir);
+	CuAssertPtrNotNull(tc, code);
+	FILE *out = tmpfile();
+	CuAssertPtrNotNull(tc, out);
+	mcc_asm_print_func(out, code->text_section->function);
+
+	// The function and L0, which the jump at the end of the loop goes back to, are aligned. The exit label L1 is not.
+	char line[64];
+	char previous[64] = {0};
+	unsigned num_aligned_labels = 0;
+	rewind(out);
+	while (fgets(line, sizeof(line), out)) {
+		if (strcmp(line, "main:\n") == 0)
+			CuAssertStrEquals(tc, "        .p2align 4\n", previous);
+		if (strcmp(previous, "        .p2align 4,,10\n") == 0) {
+			CuAssertStrEquals(tc, "    L0:\n", line);
+			num_aligned_labels++;
+		}
+		strcpy(previous, line);
+	}
+	CuAssertIntEquals(tc, 1, num_aligned_labels);
+
+	fclose(out);
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void profile_counters(CuTest *tc)
+{
+	const char input[] = "int main(){int i; i = 0; while (i < 10) {i = i + 1;} return i;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+	struct mcc_profile *profile = mcc_profile_instrument(ir);
+	CuAssertPtrNotNull(tc, profile);
+
+	struct mcc_asm_options options = {.target = MCC_ASM_TARGET_X86,
+	                                  .num_profile_counters = mcc_profile_num_counters(profile),
+	                                  .profile_header = mcc_profile_header(profile, "test.profile")};
+	CuAssertPtrNotNull(tc, options.profile_header);
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &options);
+	CuAssertPtrNotNull(tc, code);
+	FILE *out = tmpfile();
+	CuAssertPtrNotNull(tc, out);
+	mcc_asm_print_asm(out, code);
+
+	// The counter of the loop header L0 is the second one. Its upper half takes the carry of the lower one.
+	char line[128];
+	bool has_add = false, has_carry = false, has_counters = false;
+	rewind(out);
+	while (fgets(line, sizeof(line), out)) {
+		has_add |= strstr(line, "addl") && strstr(line, "$1, " MCC_PROFILE_COUNTERS_SYMBOL "+8\n");
+		has_carry |= strstr(line, "adcl") && strstr(line, "$0, " MCC_PROFILE_COUNTERS_SYMBOL "+12\n");
+		has_counters |= strstr(line, ".zero") && strstr(line, "32\n");
+	}
+	CuAssertTrue(tc, has_add);
+	CuAssertTrue(tc, has_carry);
+	CuAssertTrue(tc, has_counters);
+
+	fclose(out);
+	free(options.profile_header);
+	mcc_profile_delete(profile);
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+// Elements of the local array s are read with movzbl, written with movb and addressed with scale 1. Packed, the
+// element is the bit the index selects in the DWORD at the index shifted right by 5.
+static void check_bool_array(CuTest *tc, bool pack_bool_arrays)
+{
+	const char input[] = "int main(){bool[10] s; int i; i = 3; s[i] = true; if (!s[i]) {return 1;} return 0;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_asm_options options = {.target = MCC_ASM_TARGET_X86, .pack_bool_arrays = pack_bool_arrays};
+	struct mcc_asm *code = mcc_asm_generate_with_options(ir, &options);
+	CuAssertPtrNotNull(tc, code);
+	FILE *out = tmpfile();
+	CuAssertPtrNotNull(tc, out);
+	mcc_asm_print_asm(out, code);
+
+	char line[128];
+	bool has_load = false, has_store = false;
+	rewind(out);
+	while (fgets(line, sizeof(line), out)) {
+		if (pack_bool_arrays) {
+			has_load |= strstr(line, "btl") && strstr(line, "%ebx, %eax");
+			has_store |= strstr(line, "btsl") && strstr(line, "%ebx, %edx");
+		} else {
+			has_load |= strstr(line, "movzbl") && strstr(line, ",%ebx,1), %eax");
+			has_store |= strstr(line, "movb") && strstr(line, "$1, ") && strstr(line, ",%ebx,1)");
+		}
+	}
+	CuAssertTrue(tc, has_load);
+	CuAssertTrue(tc, has_store);
+
+	fclose(out);
+	mcc_ir_delete_ir(ir);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_asm_delete_asm(code);
+}
+
+void bool_array_bytes(CuTest *tc)
+{
+	check_bool_array(tc, false);
+}
+
+void bool_array_bits(CuTest *tc)
+{
+	check_bool_array(tc, true);
+}
+
+static struct mcc_asm_function *new_peephole_function(CuTest *tc, struct mcc_asm_data *data)
+{
+	data->has_failed = false;
+	struct mcc_asm_function *function = mcc_asm_new_function("f", NULL, NULL, data);
+	struct mcc_asm_line *head = malloc(sizeof(*head));
+	CuAssertPtrNotNull(tc, function);
+	CuAssertPtrNotNull(tc, head);
+	head->opcode = MCC_ASM_PUSHL;
+	head->first = mcc_asm_new_register_operand(MCC_ASM_EBP, 0, data);
+	head->second = NULL;
+	head->next = NULL;
+	function->head = head;
+	data->current = head;
+	return function;
+}
+
+static void apply_peephole_rule(CuTest *tc, struct mcc_asm_function *function, const char *name)
+{
+	const struct mcc_peephole_rule *rule = mcc_peephole_find_rule(name);
+	CuAssertPtrNotNull(tc, rule);
+	CuAssertTrue(tc, mcc_peephole_optimise_function(function, rule, 1));
+}
+
+static struct mcc_asm_operand *stack_slot(int offset, struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(MCC_ASM_EBP, offset, data);
+}
+
+static struct mcc_asm_operand *eax_operand(struct mcc_asm_data *data)
+{
+	return mcc_asm_new_register_operand(MCC_ASM_EAX, 0, data);
+}
+
+void peephole_store_load(CuTest *tc)
+{
+	struct mcc_asm_data data;
+	struct mcc_asm_function *function = new_peephole_function(tc, &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax_operand(&data), stack_slot(-8, &data), &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, stack_slot(-8, &data), eax_operand(&data), &data);
+
+	apply_peephole_rule(tc, function, "store_load");
+
+	// eax still holds the stored value, so the load is removed
+	struct mcc_asm_line *line = function->head->next;
+	CuAssertIntEquals(tc, MCC_ASM_MOVL, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->first->reg);
+	CuAssertIntEquals(tc, -8, line->second->offset);
+	CuAssertPtrEquals(tc, NULL, line->next);
+
+	mcc_asm_delete_function(function);
+}
+
+void peephole_no_match(CuTest *tc)
+{
+	struct mcc_asm_data data;
+	struct mcc_asm_function *function = new_peephole_function(tc, &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax_operand(&data), stack_slot(-8, &data), &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, stack_slot(-12, &data), eax_operand(&data), &data);
+
+	apply_peephole_rule(tc, function, "store_load");
+
+	// Both uses of a variable must match the same operand
+	struct mcc_asm_line *line = function->head->next;
+	CuAssertIntEquals(tc, -8, line->second->offset);
+	CuAssertPtrNotNull(tc, line->next);
+	CuAssertIntEquals(tc, -12, line->next->first->offset);
+
+	mcc_asm_delete_function(function);
+}
+
+void peephole_jump_to_next_label(CuTest *tc)
+{
+	struct mcc_asm_data data;
+	struct mcc_asm_function *function = new_peephole_function(tc, &data);
+	mcc_asm_new_line(MCC_ASM_CMPL, eax_operand(&data), eax_operand(&data), &data);
+	mcc_asm_new_label(MCC_ASM_JE, 3, &data);
+	mcc_asm_new_label(MCC_ASM_LABEL, 3, &data);
+
+	apply_peephole_rule(tc, function, "jump_to_next_label");
+
+	struct mcc_asm_line *line = function->head->next;
+	CuAssertIntEquals(tc, MCC_ASM_LABEL, line->opcode);
+	CuAssertIntEquals(tc, 3, line->label);
+	CuAssertPtrEquals(tc, NULL, line->next);
+
+	mcc_asm_delete_function(function);
+}
+
+void peephole_add_zero(CuTest *tc)
+{
+	struct mcc_asm_data data;
+	struct mcc_asm_function *function = new_peephole_function(tc, &data);
+	mcc_asm_new_line(MCC_ASM_ADDL, mcc_asm_new_literal_operand(0, &data),
+	                 mcc_asm_new_register_operand(MCC_ASM_ESP, 0, &data), &data);
+
+	apply_peephole_rule(tc, function, "add_zero");
+
+	CuAssertPtrEquals(tc, NULL, function->head->next);
+
+	mcc_asm_delete_function(function);
+}
+
+void peephole_stored_bool_jump(CuTest *tc)
+{
+	struct mcc_asm_data data;
+	struct mcc_asm_function *function = new_peephole_function(tc, &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, eax_operand(&data), stack_slot(-12, &data), &data);
+	mcc_asm_new_line(MCC_ASM_MOVL, mcc_asm_new_literal_operand(1, &data), eax_operand(&data), &data);
+	mcc_asm_new_line(MCC_ASM_CMPL, stack_slot(-12, &data), eax_operand(&data), &data);
+	mcc_asm_new_label(MCC_ASM_JNE, 1, &data);
+
+	apply_peephole_rule(tc, function, "stored_bool_jump");
+
+	// The bool is compared in eax instead of being loaded again
+	struct mcc_asm_line *line = function->head->next->next;
+	CuAssertIntEquals(tc, MCC_ASM_CMPL, line->opcode);
+	CuAssertIntEquals(tc, MCC_ASM_OPERAND_LITERAL, line->first->type);
+	CuAssertIntEquals(tc, 1, line->first->literal);
+	CuAssertIntEquals(tc, MCC_ASM_EAX, line->second->reg);
+	CuAssertIntEquals(tc, MCC_ASM_JNE, line->next->opcode);
+	CuAssertIntEquals(tc, 1, line->next->label);
+	CuAssertPtrEquals(tc, NULL, line->next->next);
+
+	mcc_asm_delete_function(function);
+}
+
 // clang-format off
 
 #define TESTS \
@@ -377,7 +1115,27 @@ void strings2(CuTest *tc)
 	TEST(addition_lit) \
 	TEST(div_int) \
 	TEST(strings) \
-	TEST(strings2)
+	TEST(strings2) \
+	TEST(increment_in_place) \
+	TEST(constant_operands) \
+	TEST(constant_multiplications) \
+	TEST(expression_trees) \
+	TEST(tail_jump) \
+	TEST(compare_and_branch) \
+	TEST(conditional_moves) \
+	TEST(register_arguments) \
+	TEST(sse2_floats) \
+	TEST(x86_64_system_v_call) \
+	TEST(omit_frame_pointer) \
+	TEST(align_loop_headers) \
+	TEST(profile_counters) \
+	TEST(bool_array_bytes) \
+	TEST(bool_array_bits) \
+	TEST(peephole_store_load) \
+	TEST(peephole_no_match) \
+	TEST(peephole_jump_to_next_label) \
+	TEST(peephole_add_zero) \
+	TEST(peephole_stored_bool_jump)
 
 // clang-format on
 
@@ -709,6 +709,80 @@ void type_array_test(CuTest *tc)
 	mcc_symbol_table_delete_table(table);
 }
 
+void short_circuit_condition(CuTest *tc)
+{
+	const char input[] = "int main(){int a; int b; a = 1; b = 2; if (a < 1 && b > 1) a = 3; return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	struct mcc_ir_row *ir_head = ir;
+	while (ir->instr != MCC_IR_INSTR_SMALLER)
+		ir = ir->next_row;
+
+	// Jumpfalse L0, before b > 1 is evaluated
+	struct mcc_ir_row *tmp = ir;
+	ir = ir->next_row;
+	CuAssertIntEquals(tc, ir->instr, MCC_IR_INSTR_JUMPFALSE);
+	CuAssertPtrEquals(tc, ir->arg1->row, tmp);
+	CuAssertIntEquals(tc, ir->arg2->label, 0);
+
+	// Jumpfalse L0
+	tmp = ir->next_row;
+	CuAssertIntEquals(tc, tmp->instr, MCC_IR_INSTR_GREATER);
+	ir = tmp->next_row;
+	CuAssertIntEquals(tc, ir->instr, MCC_IR_INSTR_JUMPFALSE);
+	CuAssertPtrEquals(tc, ir->arg1->row, tmp);
+	CuAssertIntEquals(tc, ir->arg2->label, 0);
+
+	// On true: a = 3
+	ir = ir->next_row;
+	CuAssertIntEquals(tc, ir->instr, MCC_IR_INSTR_ASSIGN);
+
+	// L0
+	ir = ir->next_row;
+	CuAssertIntEquals(tc, ir->instr, MCC_IR_INSTR_LABEL);
+	CuAssertIntEquals(tc, ir->arg1->label, 0);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir_head);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+}
+
+void short_circuit_value(CuTest *tc)
+{
+	const char input[] = "int main(){int a; bool c; a = 1; c = a < 1 || a > 1; return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	struct mcc_ir_row *ir_head = ir;
+	while (ir->instr != MCC_IR_INSTR_ASSIGN || ir->arg2->type != MCC_IR_TYPE_LIT_BOOL)
+		ir = ir->next_row;
+
+	// The result is false unless a < 1 or a > 1 holds
+	CuAssertIntEquals(tc, ir->type->type, MCC_IR_ROW_BOOL);
+	CuAssertIntEquals(tc, ir->arg2->lit_bool, false);
+	char *result = ir->arg1->ident;
+
+	for (ir = ir->next_row; ir->instr != MCC_IR_INSTR_ASSIGN || strcmp(ir->arg1->ident, "c") != 0;
+	     ir = ir->next_row) {
+		CuAssertTrue(tc, ir->instr != MCC_IR_INSTR_OR);
+	}
+	CuAssertIntEquals(tc, ir->arg2->type, MCC_IR_TYPE_IDENTIFIER);
+	CuAssertStrEquals(tc, ir->arg2->ident, result);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir_head);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+}
+
 // clang-format off
 
 #define TESTS \
@@ -724,7 +798,9 @@ void type_array_test(CuTest *tc)
 	TEST(func_call)\
 	TEST(variable_shadowing) \
 	TEST(type_test) \
-	TEST(type_array_test)
+	TEST(type_array_test) \
+	TEST(short_circuit_condition) \
+	TEST(short_circuit_value)
 
 // clang-format on
 
@@ -0,0 +1,1047 @@
+#include <CuTest.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcc/ast.h"
+#include "mcc/block_layout.h"
+#include "mcc/call_graph.h"
+#include "mcc/cfg_analysis.h"
+#include "mcc/copy_propagation.h"
+#include "mcc/induction.h"
+#include "mcc/inline.h"
+#include "mcc/ir.h"
+#include "mcc/licm.h"
+#include "mcc/liveness.h"
+#include "mcc/loop_rotation.h"
+#include "mcc/pass_manager.h"
+#include "mcc/profile.h"
+#include "mcc/semantic_checks.h"
+#include "mcc/specialize.h"
+#include "mcc/symbol_table.h"
+#include "mcc/tail_call.h"
+#include "mcc/unroll.h"
+#include "mcc/vectorize.h"
+
+static struct mcc_symbol_table *check_program(CuTest *tc, const char *input, struct mcc_parser_result *parser_result)
+{
+	*parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result->status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create(parser_result->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all(parser_result->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	mcc_semantic_check_delete_single_check(checks);
+	return table;
+}
+
+static struct mcc_ir_row *generate_ir(CuTest *tc, const char *input, struct mcc_parser_result *parser_result)
+{
+	struct mcc_symbol_table *table = check_program(tc, input, parser_result);
+
+	struct mcc_ir_row *ir = mcc_ir_generate(parser_result->program);
+	CuAssertPtrNotNull(tc, ir);
+	mcc_symbol_table_delete_table(table);
+	return ir;
+}
+
+static struct mcc_ir_row *find_row(struct mcc_ir_row *ir, enum mcc_ir_instruction instr)
+{
+	while (ir && ir->instr != instr)
+		ir = ir->next_row;
+	return ir;
+}
+
+static bool comes_before(struct mcc_ir_row *first, struct mcc_ir_row *second)
+{
+	for (struct mcc_ir_row *row = first; row; row = row->next_row) {
+		if (row == second)
+			return true;
+	}
+	return false;
+}
+
+void licm_invariant(CuTest *tc)
+{
+	const char input[] = "int main(){int a; int i; a = 3; i = 0; while (i < 10) { i = i + a * 2; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	struct mcc_ir_row *multiply = find_row(ir, MCC_IR_INSTR_MULTIPLY);
+	struct mcc_ir_row *plus = find_row(ir, MCC_IR_INSTR_PLUS);
+	CuAssertPtrNotNull(tc, multiply);
+	CuAssertPtrNotNull(tc, plus);
+
+	CuAssertTrue(tc, mcc_licm_run(ir));
+
+	// a * 2 moves in front of the loop header, i + ... stays in the loop
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	CuAssertPtrNotNull(tc, header);
+	CuAssertTrue(tc, comes_before(multiply, header));
+	CuAssertTrue(tc, comes_before(header, plus));
+	CuAssertPtrEquals(tc, multiply, plus->arg2->row);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void licm_variant(CuTest *tc)
+{
+	const char input[] =
+	    "int main(){int a; int i; a = 3; i = 0; while (i < 10) { a = a + 1; i = i + a * 2; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_licm_run(ir));
+
+	// a is assigned in the loop, so nothing moves
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_ir_row *multiply = find_row(ir, MCC_IR_INSTR_MULTIPLY);
+	CuAssertPtrNotNull(tc, header);
+	CuAssertPtrNotNull(tc, multiply);
+	CuAssertTrue(tc, comes_before(header, multiply));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void licm_division(CuTest *tc)
+{
+	const char input[] = "int main(){int a; int i; a = 3; i = 0; while (i < 10) { i = i + 10 / a; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_licm_run(ir));
+
+	// The divisor may be zero, so the division must not be executed unless the loop is entered
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_ir_row *divide = find_row(ir, MCC_IR_INSTR_DIVIDE);
+	CuAssertTrue(tc, comes_before(header, divide));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+static struct mcc_ir_row *find_assignment(struct mcc_ir_row *ir, const char *ident)
+{
+	while (ir && (ir->instr != MCC_IR_INSTR_ASSIGN || ir->arg1->type != MCC_IR_TYPE_IDENTIFIER ||
+	              strcmp(ir->arg1->ident, ident) != 0))
+		ir = ir->next_row;
+	return ir;
+}
+
+void induction_multiply(CuTest *tc)
+{
+	const char input[] = "int main(){int[40] a; int i; int n; i = 0; n = read_int(); while (i < n) { a[i * 4] = i; "
+	                     "i = i + 1; } return a[4];}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_induction_run(ir));
+
+	// i * 4 is computed once in front of the loop and then increased by 4
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_ir_row *multiply = find_row(ir, MCC_IR_INSTR_MULTIPLY);
+	CuAssertPtrNotNull(tc, header);
+	CuAssertPtrNotNull(tc, multiply);
+	CuAssertTrue(tc, comes_before(multiply, header));
+	CuAssertPtrEquals(tc, NULL, find_row(header, MCC_IR_INSTR_MULTIPLY));
+
+	struct mcc_ir_row *update = find_assignment(header, "i.iv0");
+	CuAssertPtrNotNull(tc, update);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ROW, update->arg2->type);
+	CuAssertIntEquals(tc, MCC_IR_INSTR_PLUS, update->arg2->row->instr);
+	CuAssertIntEquals(tc, 4, (int)update->arg2->row->arg2->lit_int);
+
+	// The array index uses the new variable
+	struct mcc_ir_row *store = header;
+	while (store->instr != MCC_IR_INSTR_ASSIGN || store->arg1->type != MCC_IR_TYPE_ARR_ELEM)
+		store = store->next_row;
+	CuAssertIntEquals(tc, MCC_IR_TYPE_IDENTIFIER, store->arg1->index->type);
+	CuAssertStrEquals(tc, update->arg1->ident, store->arg1->index->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void induction_exit_test(CuTest *tc)
+{
+	const char input[] =
+	    "int main(){int[40] a; int i; i = 0; while (i < 10) { a[i * 4] = 1; i = i + 1; } return a[4];}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_induction_run(ir));
+
+	// i is only needed for the exit test, which is rewritten to i * 4 < 40
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_ir_row *compare = find_row(header, MCC_IR_INSTR_SMALLER);
+	CuAssertPtrNotNull(tc, compare);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_IDENTIFIER, compare->arg1->type);
+	CuAssertStrEquals(tc, "i.iv0", compare->arg1->ident);
+	CuAssertIntEquals(tc, 40, (int)compare->arg2->lit_int);
+	CuAssertPtrEquals(tc, NULL, find_assignment(header, "i"));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void induction_used_after_loop(CuTest *tc)
+{
+	const char input[] =
+	    "int main(){int[40] a; int i; i = 0; while (i < 10) { a[i * 4] = 1; i = i + 1; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_induction_run(ir));
+
+	// i is returned, so the exit test stays
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_ir_row *compare = find_row(header, MCC_IR_INSTR_SMALLER);
+	CuAssertStrEquals(tc, "i", compare->arg1->ident);
+	CuAssertPtrNotNull(tc, find_assignment(header, "i"));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+static struct mcc_ir_row *find_function(struct mcc_ir_row *ir, const char *name)
+{
+	while (ir && (ir->instr != MCC_IR_INSTR_FUNC_LABEL || strcmp(ir->arg1->func_label, name) != 0))
+		ir = ir->next_row;
+	return ir;
+}
+
+void inline_small_function(CuTest *tc)
+{
+	const char input[] = "int add(int a, int b){return a + b;} int main(){int x; x = add(1, 2); return x;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_inline_run(ir, MCC_INLINE_DEFAULT_LIMIT));
+
+	// The call is replaced by the renamed parameters and an assignment to the result variable
+	struct mcc_ir_row *main_label = find_function(ir, "main");
+	CuAssertPtrNotNull(tc, main_label);
+	CuAssertPtrEquals(tc, NULL, find_row(main_label, MCC_IR_INSTR_CALL));
+	CuAssertPtrEquals(tc, NULL, find_row(main_label, MCC_IR_INSTR_PUSH));
+	CuAssertPtrNotNull(tc, find_assignment(main_label, "a.i0"));
+	CuAssertPtrNotNull(tc, find_assignment(main_label, "b.i0"));
+	CuAssertPtrNotNull(tc, find_assignment(main_label, "add.r0"));
+
+	struct mcc_ir_row *assign = find_assignment(main_label, "x");
+	CuAssertIntEquals(tc, MCC_IR_TYPE_IDENTIFIER, assign->arg2->type);
+	CuAssertStrEquals(tc, "add.r0", assign->arg2->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void inline_recursive_function(CuTest *tc)
+{
+	const char input[] =
+	    "int fact(int n){if (n <= 1) return 1; return n * fact(n - 1);} int main(){return fact(5);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_inline_run(ir, MCC_INLINE_DEFAULT_LIMIT));
+
+	// Recursive functions are never inlined
+	struct mcc_ir_row *main_label = find_function(ir, "main");
+	struct mcc_ir_row *call = find_row(main_label, MCC_IR_INSTR_CALL);
+	CuAssertPtrNotNull(tc, call);
+	CuAssertStrEquals(tc, "fact", call->arg1->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void inline_disabled(CuTest *tc)
+{
+	const char input[] = "int one(){return 1;} int main(){return one();}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_inline_run(ir, 0));
+
+	// A limit of 0 keeps all calls
+	CuAssertPtrNotNull(tc, find_row(find_function(ir, "main"), MCC_IR_INSTR_CALL));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+static unsigned count_rows(struct mcc_ir_row *function_label, enum mcc_ir_instruction instr)
+{
+	unsigned count = 0;
+	for (struct mcc_ir_row *row = function_label->next_row; row && row->instr != MCC_IR_INSTR_FUNC_LABEL;
+	     row = row->next_row) {
+		if (row->instr == instr)
+			count++;
+	}
+	return count;
+}
+
+void tail_call_loop(CuTest *tc)
+{
+	const char input[] = "int sum(int n, int acc){if (n == 0) return acc; return sum(n - 1, acc + n);} "
+	                     "int main(){return sum(10, 0);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_tail_call_run(ir));
+
+	// The recursive call becomes assignments to the parameters and a jump to the start of the body
+	struct mcc_ir_row *sum = find_function(ir, "sum");
+	CuAssertIntEquals(tc, 0, count_rows(sum, MCC_IR_INSTR_CALL));
+	CuAssertIntEquals(tc, 0, count_rows(sum, MCC_IR_INSTR_PUSH));
+
+	struct mcc_ir_row *entry = sum->next_row->next_row->next_row->next_row->next_row;
+	CuAssertIntEquals(tc, MCC_IR_INSTR_LABEL, entry->instr);
+	struct mcc_ir_row *jump = find_row(entry, MCC_IR_INSTR_JUMP);
+	CuAssertPtrNotNull(tc, jump);
+	CuAssertIntEquals(tc, (int)entry->arg1->label, (int)jump->arg1->label);
+	CuAssertPtrNotNull(tc, find_assignment(entry, "n"));
+	CuAssertPtrNotNull(tc, find_assignment(entry, "acc"));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void tail_call_swapped_params(CuTest *tc)
+{
+	const char input[] =
+	    "int f(int a, int b){if (a <= 0) return b; return f(b - 1, a);} int main(){return f(3, 4);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_tail_call_run(ir));
+
+	// b is passed as a, so it is saved before a is overwritten
+	struct mcc_ir_row *f = find_function(ir, "f");
+	struct mcc_ir_row *saved = find_assignment(f, "b.tc0");
+	struct mcc_ir_row *a = find_assignment(f->next_row->next_row->next_row, "a");
+	CuAssertPtrNotNull(tc, saved);
+	CuAssertPtrNotNull(tc, a);
+	CuAssertTrue(tc, comes_before(saved, a));
+	struct mcc_ir_row *b = find_assignment(a, "b");
+	CuAssertIntEquals(tc, MCC_IR_TYPE_IDENTIFIER, b->arg2->type);
+	CuAssertStrEquals(tc, "b.tc0", b->arg2->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void tail_call_not_in_tail_position(CuTest *tc)
+{
+	const char input[] =
+	    "int fact(int n){if (n <= 1) return 1; return n * fact(n - 1);} int main(){return fact(5);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_tail_call_run(ir));
+
+	// The result is multiplied after the call returns
+	CuAssertIntEquals(tc, 1, count_rows(find_function(ir, "fact"), MCC_IR_INSTR_CALL));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void specialize_literal_flag(CuTest *tc)
+{
+	const char input[] = "int f(int x, bool twice){if (twice) return x * 2; return x + 1;} "
+	                     "int main(){int a; a = read_int(); return f(a, true) + f(a + 1, true) + f(a, false);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_specialize_run(ir));
+
+	// Both calls with true share a clone, the branch on the flag is gone from the clones
+	struct mcc_ir_row *twice = find_function(ir, "f.s0");
+	struct mcc_ir_row *once = find_function(ir, "f.s1");
+	CuAssertPtrNotNull(tc, twice);
+	CuAssertPtrNotNull(tc, once);
+	CuAssertIntEquals(tc, 0, count_rows(twice, MCC_IR_INSTR_JUMPFALSE));
+	CuAssertIntEquals(tc, 1, count_rows(twice, MCC_IR_INSTR_MULTIPLY));
+	CuAssertIntEquals(tc, 0, count_rows(once, MCC_IR_INSTR_MULTIPLY));
+	CuAssertIntEquals(tc, 1, count_rows(find_function(ir, "f"), MCC_IR_INSTR_JUMPFALSE));
+
+	// The flag is not pushed anymore
+	struct mcc_ir_row *main_label = find_function(ir, "main");
+	CuAssertIntEquals(tc, 3, count_rows(main_label, MCC_IR_INSTR_PUSH));
+	struct mcc_ir_row *call = find_row(find_row(main_label, MCC_IR_INSTR_CALL)->next_row, MCC_IR_INSTR_CALL);
+	CuAssertStrEquals(tc, "f.s0", call->arg1->func_label);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void specialize_nothing_to_fold(CuTest *tc)
+{
+	const char input[] = "int f(int x, int y){int i; i = 0; while (i < y) {x = x + i; i = i + 1;} return x;} "
+	                     "int main(){return f(1, 2);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_specialize_run(ir));
+
+	// x is assigned in the loop and y is only compared to a variable, the clone would fold nothing
+	CuAssertPtrEquals(tc, NULL, find_function(ir, "f.s0"));
+	CuAssertStrEquals(tc, "f", find_row(ir, MCC_IR_INSTR_CALL)->arg1->func_label);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void copy_propagation_inlined_call(CuTest *tc)
+{
+	const char input[] = "int sq(int x){return x * x;} "
+	                     "int main(){int a; int b; float f; a = read_int(); b = sq(a + 1); f = 2.5 * 1.5; "
+	                     "print_float(f); return b;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	CuAssertTrue(tc, mcc_inline_run(ir, 30));
+	CuAssertTrue(tc, mcc_copy_propagation_run(ir));
+
+	// The parameter of sq keeps its assignment. Only the float literals are left assigned in main.
+	struct mcc_ir_row *function = find_function(ir, "main");
+	CuAssertPtrNotNull(tc, find_assignment(ir, "x"));
+	CuAssertIntEquals(tc, 2, count_rows(function, MCC_IR_INSTR_ASSIGN));
+	struct mcc_ir_row *multiply = find_row(find_row(function, MCC_IR_INSTR_PLUS), MCC_IR_INSTR_MULTIPLY);
+	CuAssertPtrNotNull(tc, multiply);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ROW, multiply->arg1->type);
+	CuAssertPtrEquals(tc, find_row(function, MCC_IR_INSTR_PLUS), multiply->arg1->row);
+	struct mcc_ir_row *ret = find_row(function, MCC_IR_INSTR_RETURN);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ROW, ret->arg1->type);
+	CuAssertPtrEquals(tc, multiply, ret->arg1->row);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void copy_propagation_not_dominated(CuTest *tc)
+{
+	const char input[] = "int main(){int i; int n; int m; i = 0; n = 0; m = read_int(); "
+	                     "while (i < m) {n = i * 2; i = i + 1;} return n;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	CuAssertTrue(tc, mcc_copy_propagation_run(ir));
+
+	// m is read in the loop behind its only assignment, n also behind the loop it is assigned in
+	CuAssertPtrEquals(tc, NULL, find_assignment(ir, "m"));
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ROW, find_row(ir, MCC_IR_INSTR_SMALLER)->arg2->type);
+	struct mcc_ir_row *first = find_assignment(ir, "n");
+	CuAssertPtrNotNull(tc, first);
+	CuAssertPtrNotNull(tc, find_assignment(first->next_row, "n"));
+	struct mcc_ir_row *ret = find_row(ir, MCC_IR_INSTR_RETURN);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_IDENTIFIER, ret->arg1->type);
+	CuAssertStrEquals(tc, "n", ret->arg1->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void copy_propagation_temporaries(CuTest *tc)
+{
+	const char input[] = "int main(){int[4] a; float x; a[0] = 1; a[1] = 2; a[a[0]] = 3; a[a[1]] = 4; "
+	                     "x = read_float(); print_float(x * 2.0); print_float(x + 2.0); return a[1];}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	CuAssertTrue(tc, mcc_copy_propagation_run(ir));
+
+	// Both indices are held in the same temporary, both float operations read the first literal
+	struct mcc_ir_row *first = find_row(ir, MCC_IR_INSTR_ASSIGN);
+	while (first && first->arg2->type != MCC_IR_TYPE_ARR_ELEM)
+		first = find_row(first->next_row, MCC_IR_INSTR_ASSIGN);
+	CuAssertPtrNotNull(tc, first);
+	struct mcc_ir_row *second = find_assignment(first->next_row, first->arg1->ident);
+	CuAssertPtrNotNull(tc, second);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ARR_ELEM, second->arg2->type);
+
+	struct mcc_ir_row *multiply = find_row(ir, MCC_IR_INSTR_MULTIPLY);
+	struct mcc_ir_row *plus = find_row(ir, MCC_IR_INSTR_PLUS);
+	CuAssertStrEquals(tc, multiply->arg2->ident, plus->arg2->ident);
+	CuAssertPtrEquals(tc, NULL, find_assignment(find_assignment(ir, multiply->arg2->ident)->next_row,
+	                                            multiply->arg2->ident));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void rotate_while_loop(CuTest *tc)
+{
+	const char input[] = "int main(){int i; i = 0; while (i < 10) { i = i + 1; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_loop_rotation_run(ir));
+
+	// The guard tests the condition in front of the header, the latch tests the inverted condition
+	struct mcc_ir_row *guard = find_row(ir, MCC_IR_INSTR_JUMPFALSE);
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	CuAssertPtrNotNull(tc, guard);
+	CuAssertPtrNotNull(tc, header);
+	CuAssertTrue(tc, comes_before(guard, header));
+	CuAssertIntEquals(tc, MCC_IR_INSTR_SMALLER, guard->arg1->row->instr);
+
+	struct mcc_ir_row *latch = find_row(header, MCC_IR_INSTR_JUMPFALSE);
+	CuAssertPtrNotNull(tc, latch);
+	CuAssertIntEquals(tc, (int)header->arg1->label, (int)latch->arg2->label);
+	CuAssertIntEquals(tc, MCC_IR_INSTR_GREATEREQ, latch->arg1->row->instr);
+	CuAssertTrue(tc, comes_before(find_row(header, MCC_IR_INSTR_PLUS), latch));
+	CuAssertIntEquals(tc, 0, count_rows(ir, MCC_IR_INSTR_JUMP));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void rotate_or_condition(CuTest *tc)
+{
+	const char input[] = "int main(){int i; i = 0; while (i < 10 || i == 20) { i = i + 1; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	unsigned jumps = count_rows(ir, MCC_IR_INSTR_JUMP);
+	CuAssertTrue(tc, mcc_loop_rotation_run(ir));
+
+	// The condition has control flow of its own, so the loop keeps its jump back to the header
+	CuAssertIntEquals(tc, jumps, count_rows(ir, MCC_IR_INSTR_JUMP));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+static unsigned count_vector_rows(struct mcc_ir_row *ir)
+{
+	unsigned count = 0;
+	for (; ir; ir = ir->next_row) {
+		if (ir->type && ir->type->lanes > 1)
+			count++;
+	}
+	return count;
+}
+
+void vectorize_sum(CuTest *tc)
+{
+	const char input[] = "int sum(int[8] a, int n){int s; int i; s = 0; i = 0; while (i < n) {s = s + a[i]; i = i + 1;} "
+	                     "return s;} int main(){int[8] a; return sum(a, 8);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	FILE *report = tmpfile();
+	CuAssertPtrNotNull(tc, report);
+
+	CuAssertTrue(tc, mcc_vectorize_run(ir, report));
+
+	// The vector loop adds four elements at once into the accumulator, the scalar loop stays behind it
+	CuAssertTrue(tc, count_vector_rows(ir) > 0);
+	CuAssertIntEquals(tc, 2, count_rows(find_function(ir, "sum"), MCC_IR_INSTR_JUMPFALSE));
+
+	char line[128] = {0};
+	rewind(report);
+	CuAssertPtrNotNull(tc, fgets(line, sizeof(line), report));
+	CuAssertStrEquals(tc, "sum: loop L0: vectorized with 4 lanes, sum of s\n", line);
+
+	// Cleanup
+	fclose(report);
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void vectorize_int_multiplication(CuTest *tc)
+{
+	const char input[] = "int main(){int[8] a; int i; i = 0; while (i < 8) {a[i] = a[i] * 3; i = i + 1;} return a[1];}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	FILE *report = tmpfile();
+	CuAssertPtrNotNull(tc, report);
+
+	CuAssertTrue(tc, mcc_vectorize_run(ir, report));
+
+	// SSE2 has no packed 32 bit multiplication
+	CuAssertIntEquals(tc, 0, count_vector_rows(ir));
+
+	char line[128] = {0};
+	rewind(report);
+	CuAssertPtrNotNull(tc, fgets(line, sizeof(line), report));
+	CuAssertTrue(tc, strstr(line, "not vectorized") != NULL);
+
+	// Cleanup
+	fclose(report);
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void unroll_completely(CuTest *tc)
+{
+	const char input[] = "int main(){int[4] a; int i; i = 0; while (i < 4) {a[i] = i * 2; i = i + 1;} return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_unroll_run(ir, MCC_UNROLL_DEFAULT_FACTOR));
+
+	// The loop is gone, every copy stores a literal at a literal index
+	CuAssertIntEquals(tc, 0, count_rows(ir, MCC_IR_INSTR_JUMPFALSE));
+	CuAssertIntEquals(tc, 0, count_rows(ir, MCC_IR_INSTR_MULTIPLY));
+	unsigned stores = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row) {
+		if (row->instr != MCC_IR_INSTR_ASSIGN || row->arg1->type != MCC_IR_TYPE_ARR_ELEM)
+			continue;
+		CuAssertIntEquals(tc, MCC_IR_TYPE_LIT_INT, row->arg1->index->type);
+		CuAssertIntEquals(tc, MCC_IR_TYPE_LIT_INT, row->arg2->type);
+		CuAssertIntEquals(tc, (int)stores * 2, (int)row->arg2->lit_int);
+		stores++;
+	}
+	CuAssertIntEquals(tc, 4, stores);
+
+	// i still has its value after the loop
+	struct mcc_ir_row *last = find_assignment(find_assignment(ir, "i")->next_row, "i");
+	CuAssertPtrNotNull(tc, last);
+	CuAssertIntEquals(tc, 4, (int)last->arg2->lit_int);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void unroll_by_factor(CuTest *tc)
+{
+	const char input[] = "int main(){int[8] a; int i; int n; i = 0; n = read_int(); while (i < n) {a[i] = i; "
+	                     "i = i + 1;} return a[0];}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_unroll_run(ir, 4));
+
+	// The unrolled loop runs while 4 iterations are left, the original loop runs the rest
+	CuAssertIntEquals(tc, 2, count_rows(ir, MCC_IR_INSTR_JUMPFALSE));
+	CuAssertIntEquals(tc, 5, count_rows(ir, MCC_IR_INSTR_PLUS));
+	struct mcc_ir_row *test = find_row(ir, MCC_IR_INSTR_SMALLER);
+	CuAssertIntEquals(tc, MCC_IR_TYPE_ROW, test->arg2->type);
+	CuAssertIntEquals(tc, MCC_IR_INSTR_MINUS, test->arg2->row->instr);
+	CuAssertIntEquals(tc, 3, (int)test->arg2->row->arg2->lit_int);
+	CuAssertStrEquals(tc, "n", find_row(test->next_row, MCC_IR_INSTR_SMALLER)->arg2->ident);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void unroll_budget(CuTest *tc)
+{
+	const char input[] = "int main(){int s; int i; s = 0; i = 0; while (i < 1000) {s = s + i; i = i + 1;} return s;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	unsigned rows = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row)
+		rows++;
+	CuAssertTrue(tc, mcc_unroll_run(ir, 64));
+
+	// Too many iterations to unroll completely, and the factor is lowered until the copies fit into the budget. The
+	// unrolled loop adds its test, jumps and labels.
+	CuAssertIntEquals(tc, 2, count_rows(ir, MCC_IR_INSTR_JUMPFALSE));
+	unsigned unrolled_rows = 0;
+	for (struct mcc_ir_row *row = ir; row; row = row->next_row)
+		unrolled_rows++;
+	CuAssertTrue(tc, unrolled_rows - rows <= MCC_UNROLL_BUDGET + 5);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void counted_loop_shape(CuTest *tc)
+{
+	const char input[] = "int main(){int i; int n; i = 0; n = read_int(); while (i < n) {i = i + 2;} "
+	                     "while (n > 0) {n = n - 1;} return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	// The first loop counts i up to n
+	struct mcc_ir_row *header = find_row(ir, MCC_IR_INSTR_LABEL);
+	struct mcc_cfg_counted_loop loop;
+	CuAssertTrue(tc, mcc_cfg_match_counted_loop(header, &loop));
+	CuAssertPtrEquals(tc, header, loop.header);
+	CuAssertStrEquals(tc, "i", loop.counter);
+	CuAssertIntEquals(tc, MCC_IR_INSTR_SMALLER, loop.test->instr);
+	CuAssertPtrEquals(tc, mcc_cfg_find_back_jump(header), loop.back_jump);
+
+	// The exit label of the first loop is no header, and the second loop tests n > 0
+	struct mcc_ir_row *exit_label = loop.back_jump->next_row;
+	CuAssertPtrEquals(tc, NULL, mcc_cfg_find_back_jump(exit_label));
+	CuAssertTrue(tc, !mcc_cfg_match_counted_loop(exit_label, &loop));
+	CuAssertTrue(tc, !mcc_cfg_match_counted_loop(exit_label->next_row, &loop));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void layout_loop_exit(CuTest *tc)
+{
+	const char input[] = "bool is_square(int n){int i; i = 0; while (i * i <= n) {if (i * i == n) {return true;} "
+	                     "i = i + 1;} return false;} int main(){if (is_square(9)) {return 1;} return 0;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	struct mcc_ir_row *function = find_function(ir, "is_square");
+	struct mcc_ir_row *early_return = find_row(function, MCC_IR_INSTR_RETURN);
+	struct mcc_ir_row *back_jump = find_row(function, MCC_IR_INSTR_JUMP);
+
+	CuAssertTrue(tc, mcc_block_layout_run(ir));
+
+	// The return in the loop is unlikely, so the loop continues by falling through and the return moves behind it
+	CuAssertTrue(tc, comes_before(back_jump, early_return));
+	CuAssertPtrNotNull(tc, find_row(function, MCC_IR_INSTR_NOTEQUALS));
+	CuAssertIntEquals(tc, 1, count_rows(function, MCC_IR_INSTR_JUMP));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void layout_balanced_branches(CuTest *tc)
+{
+	const char input[] = "int main(){int a; a = read_int(); if (a < 3) {a = 1;} else {a = 2;} return a;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	struct mcc_ir_row *rows[32];
+	unsigned num_rows = 0;
+	for (struct mcc_ir_row *row = ir; row && num_rows < 32; row = row->next_row)
+		rows[num_rows++] = row;
+
+	CuAssertTrue(tc, mcc_block_layout_run(ir));
+
+	// Without a likely branch the generated order is kept
+	struct mcc_ir_row *row = ir;
+	for (unsigned i = 0; i < num_rows; i++, row = row->next_row)
+		CuAssertPtrEquals(tc, rows[i], row);
+	CuAssertPtrEquals(tc, NULL, row);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void profile_instrument(CuTest *tc)
+{
+	const char input[] = "int f(int a){if (a < 3) {return 1;} return 2;} int main(){return f(read_int());}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	struct mcc_ir_row *function = find_function(ir, "f");
+
+	struct mcc_profile *profile = mcc_profile_instrument(ir);
+	CuAssertPtrNotNull(tc, profile);
+	CuAssertIntEquals(tc, 2, profile->num_functions);
+	CuAssertStrEquals(tc, "f", profile->functions[0].name);
+	CuAssertIntEquals(tc, 3, profile->functions[0].num_blocks);
+	CuAssertIntEquals(tc, 4, mcc_profile_num_counters(profile));
+
+	// Every block counts, the first one behind the parameter
+	CuAssertIntEquals(tc, 3, count_rows(function, MCC_IR_INSTR_COUNT));
+	struct mcc_ir_row *count = find_row(function, MCC_IR_INSTR_COUNT);
+	CuAssertTrue(tc, comes_before(find_row(function, MCC_IR_INSTR_ASSIGN), count));
+	CuAssertIntEquals(tc, 0, count->arg1->lit_int);
+	CuAssertIntEquals(tc, 3, find_row(find_function(ir, "main"), MCC_IR_INSTR_COUNT)->arg1->lit_int);
+
+	char *header = mcc_profile_header(profile, "test.profile");
+	CuAssertPtrNotNull(tc, header);
+	CuAssertTrue(tc, strncmp(header, "test.profile\nf ", 15) == 0);
+	free(header);
+
+	// Another function in front does not change the checksum
+	struct mcc_parser_result other_result;
+	struct mcc_ir_row *other_ir = generate_ir(tc,
+	                                          "int g(int b){while (b > 0) {b = b - 1;} return b;} "
+	                                          "int f(int a){if (a < 3) {return 1;} return 2;} "
+	                                          "int main(){return f(g(read_int()));}",
+	                                          &other_result);
+	struct mcc_profile *other = mcc_profile_instrument(other_ir);
+	CuAssertPtrNotNull(tc, other);
+	CuAssertStrEquals(tc, "f", other->functions[1].name);
+	CuAssertTrue(tc, other->functions[1].checksum == profile->functions[0].checksum);
+	CuAssertTrue(tc, other->functions[2].checksum != profile->functions[1].checksum);
+
+	// Cleanup
+	mcc_profile_delete(profile);
+	mcc_profile_delete(other);
+	mcc_ir_delete_ir(ir);
+	mcc_ir_delete_ir(other_ir);
+	mcc_ast_delete(parser_result.program);
+	mcc_ast_delete(other_result.program);
+}
+
+void profile_layout(CuTest *tc)
+{
+	const char input[] = "int main(){int a; a = read_int(); if (a < 3) {a = 1;} else {a = 2;} return a;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+	struct mcc_basic_block *cfg = mcc_cfg_generate_function(ir);
+	CuAssertPtrNotNull(tc, cfg);
+	unsigned long checksum = mcc_profile_checksum(cfg);
+	mcc_cfg_delete_cfg(cfg);
+
+	FILE *file = tmpfile();
+	CuAssertPtrNotNull(tc, file);
+	fprintf(file, "mcc-profile 1\nfunction main %lx 4\n10\n1\n9\n10\nfunction gone 0 1\n5\n", checksum);
+	rewind(file);
+	struct mcc_profile *profile = mcc_profile_read(file);
+	fclose(file);
+	CuAssertPtrNotNull(tc, profile);
+	CuAssertIntEquals(tc, 2, profile->num_functions);
+	CuAssertTrue(tc, mcc_profile_annotate(ir, profile));
+	mcc_profile_delete(profile);
+
+	struct mcc_ir_row *then_branch = find_assignment(ir, "a");
+	then_branch = find_assignment(then_branch->next_row, "a");
+	struct mcc_ir_row *else_branch = find_assignment(then_branch->next_row, "a");
+	CuAssertTrue(tc, ir->profile_count == 10);
+	CuAssertTrue(tc, then_branch->profile_count == 1);
+	CuAssertTrue(tc, else_branch->profile_count == 9);
+
+	// The else branch ran more often, so it is placed behind the test
+	CuAssertTrue(tc, mcc_block_layout_run(ir));
+	CuAssertTrue(tc, comes_before(else_branch, then_branch));
+	CuAssertPtrNotNull(tc, find_row(ir, MCC_IR_INSTR_GREATEREQ));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void liveness_loop(CuTest *tc)
+{
+	const char input[] = "int main(){int a; int i; a = 3; i = 0; while (i < 10) { i = i + a; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	struct mcc_cfg_analysis *analysis = mcc_cfg_analyse_function(ir);
+	CuAssertPtrNotNull(tc, analysis);
+	CuAssertPtrNotNull(tc, analysis->loops);
+	struct mcc_liveness *liveness = mcc_liveness_analyse(analysis);
+	CuAssertPtrNotNull(tc, liveness);
+
+	// Both are assigned before the loop and read in it
+	int a = mcc_liveness_find_identifier(liveness, "a");
+	int i = mcc_liveness_find_identifier(liveness, "i");
+	CuAssertTrue(tc, a >= 0);
+	CuAssertTrue(tc, i >= 0);
+	CuAssertIntEquals(tc, -1, mcc_liveness_find_identifier(liveness, "b"));
+	struct mcc_basic_block *entry = analysis->blocks[0];
+	struct mcc_basic_block *header = analysis->loops->header;
+	CuAssertTrue(tc, !mcc_liveness_is_live_in(liveness, entry, a));
+	CuAssertTrue(tc, !mcc_liveness_is_live_in(liveness, entry, i));
+	CuAssertTrue(tc, mcc_liveness_is_live_out(liveness, entry, a));
+	CuAssertTrue(tc, mcc_liveness_is_live_in(liveness, header, a));
+	CuAssertTrue(tc, mcc_liveness_is_live_in(liveness, header, i));
+
+	// The sum is only read by the assignment right after it
+	int plus = mcc_liveness_find_row(liveness, find_row(ir, MCC_IR_INSTR_PLUS));
+	CuAssertTrue(tc, plus >= 0);
+	for (unsigned b = 0; b < analysis->num_blocks; b++) {
+		CuAssertTrue(tc, !mcc_liveness_is_live_in(liveness, analysis->blocks[b], plus));
+		CuAssertTrue(tc, !mcc_liveness_is_live_out(liveness, analysis->blocks[b], plus));
+	}
+
+	// Cleanup
+	mcc_liveness_delete(liveness);
+	mcc_cfg_delete_analysis(analysis);
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void pass_manager_cached_analyses(CuTest *tc)
+{
+	const char input[] = "int main(){int i; i = 0; while (i < 10) { i = i + 1; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	CuAssertPtrNotNull(tc, manager);
+
+	// Liveness reuses the cached CFG
+	struct mcc_cfg_analysis *cfg = mcc_pass_manager_get_cfg(manager, ir);
+	CuAssertPtrNotNull(tc, cfg);
+	CuAssertPtrEquals(tc, cfg, mcc_pass_manager_get_cfg(manager, ir));
+	struct mcc_liveness *liveness = mcc_pass_manager_get_liveness(manager, ir);
+	CuAssertPtrNotNull(tc, liveness);
+	CuAssertPtrEquals(tc, cfg, liveness->analysis);
+	CuAssertIntEquals(tc, 2, manager->num_computed);
+
+	// Dropping liveness keeps the CFG, dropping the CFG drops both
+	mcc_pass_manager_invalidate(manager, ir, MCC_PASS_ANALYSIS_LIVENESS);
+	CuAssertPtrEquals(tc, cfg, mcc_pass_manager_get_cfg(manager, ir));
+	CuAssertPtrNotNull(tc, mcc_pass_manager_get_liveness(manager, ir));
+	CuAssertIntEquals(tc, 3, manager->num_computed);
+	mcc_pass_manager_invalidate(manager, NULL, MCC_PASS_ANALYSIS_CFG);
+	CuAssertPtrNotNull(tc, mcc_pass_manager_get_liveness(manager, ir));
+	CuAssertIntEquals(tc, 5, manager->num_computed);
+
+	// Cleanup
+	mcc_pass_manager_delete(manager);
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+void pass_manager_pipeline(CuTest *tc)
+{
+	const char input[] = "int main(){int a; int i; a = 3; i = 0; while (i < 10) { i = i + a * 2; } return i;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_ir_row *ir = generate_ir(tc, input, &parser_result);
+
+	CuAssertTrue(tc, mcc_pass_is_valid_list("licm,induction,licm"));
+	CuAssertTrue(tc, !mcc_pass_is_valid_list("licm,"));
+	CuAssertTrue(tc, !mcc_pass_is_valid_list("lic"));
+	CuAssertPtrEquals(tc, NULL, (void *)mcc_pass_find("bogus"));
+
+	struct mcc_pass_manager *manager = mcc_pass_manager_new(ir, NULL);
+	CuAssertPtrNotNull(tc, manager);
+	unsigned num_level_passes = 0;
+	for (unsigned i = 0; i < mcc_num_passes; i++)
+		num_level_passes += mcc_passes[i].level <= 1;
+	CuAssertTrue(tc, mcc_pass_manager_add_level(manager, 0));
+	CuAssertIntEquals(tc, 0, manager->num_passes);
+	CuAssertTrue(tc, mcc_pass_manager_add_list(manager, "licm,induction"));
+	CuAssertTrue(tc, mcc_pass_manager_add_level(manager, 1));
+	CuAssertIntEquals(tc, 2 + num_level_passes, manager->num_passes);
+	CuAssertPtrEquals(tc, (void *)mcc_pass_find("licm"), (void *)manager->passes[0]);
+	CuAssertPtrEquals(tc, (void *)mcc_pass_find("inline"), (void *)manager->passes[2]);
+
+	struct mcc_ir_row *multiply = find_row(ir, MCC_IR_INSTR_MULTIPLY);
+	CuAssertTrue(tc, mcc_pass_manager_run(manager));
+	CuAssertTrue(tc, comes_before(multiply, find_row(ir, MCC_IR_INSTR_LABEL)));
+
+	// Induction gets the analysis licm left unchanged from the cache
+	CuAssertPtrEquals(tc, (void *)manager->passes[1], (void *)manager->timings[1].pass);
+	CuAssertIntEquals(tc, 0, manager->timings[1].analyses);
+
+	// Cleanup
+	mcc_pass_manager_delete(manager);
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+}
+
+static struct mcc_call_graph_function *find_node(struct mcc_call_graph *graph, const char *name)
+{
+	for (unsigned i = 0; i < graph->num_functions; i++) {
+		if (strcmp(graph->functions[i].definition->identifier->identifier_name, name) == 0)
+			return &graph->functions[i];
+	}
+	return NULL;
+}
+
+void call_graph_reachable(CuTest *tc)
+{
+	const char input[] = "int even(int n){if (n == 0) return 1; return odd(n - 1);}"
+	                     "int odd(int n){if (n == 0) return 0; return even(n - 1);}"
+	                     "int unused(int n){return even(n) + even(n + 1);}"
+	                     "int main(){print_int(even(4)); return 0;}";
+	struct mcc_parser_result parser_result;
+	struct mcc_symbol_table *table = check_program(tc, input, &parser_result);
+
+	struct mcc_call_graph *graph = mcc_call_graph_build(parser_result.program);
+	CuAssertPtrNotNull(tc, graph);
+	CuAssertTrue(tc, find_node(graph, "even")->is_reachable);
+	CuAssertTrue(tc, find_node(graph, "odd")->is_reachable);
+	CuAssertTrue(tc, find_node(graph, "print_int")->is_reachable);
+	CuAssertTrue(tc, !find_node(graph, "unused")->is_reachable);
+	CuAssertTrue(tc, !find_node(graph, "read_int")->is_reachable);
+	// Both calls of even are one edge
+	CuAssertIntEquals(tc, 1, find_node(graph, "unused")->num_callees);
+
+	// Cleanup
+	mcc_call_graph_delete(graph);
+	mcc_symbol_table_delete_table(table);
+	mcc_ast_delete(parser_result.program);
+}
+
+void call_graph_remove_unreachable(CuTest *tc)
+{
+	const char input[] = "int unused(){return 1;}"
+	                     "int used(int n){return n * 2;}"
+	                     "int also_unused(){return used(1);}"
+	                     "int main(){return used(3);}";
+	struct mcc_parser_result parser_result;
+	struct mcc_symbol_table *table = check_program(tc, input, &parser_result);
+
+	// The first node of the program stays, it holds the first reachable function now
+	struct mcc_ast_program *program = parser_result.program;
+	CuAssertTrue(tc, mcc_call_graph_remove_unreachable(program));
+	CuAssertPtrEquals(tc, program, parser_result.program);
+	CuAssertStrEquals(tc, "used", program->function->identifier->identifier_name);
+
+	struct mcc_ir_row *ir = mcc_ir_generate(parser_result.program);
+	CuAssertPtrNotNull(tc, ir);
+	CuAssertPtrNotNull(tc, find_function(ir, "used"));
+	CuAssertPtrNotNull(tc, find_function(ir, "main"));
+	CuAssertPtrEquals(tc, NULL, find_function(ir, "unused"));
+	CuAssertPtrEquals(tc, NULL, find_function(ir, "also_unused"));
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_symbol_table_delete_table(table);
+	mcc_ast_delete(parser_result.program);
+}
+
+// clang-format off
+
+#define TESTS \
+	TEST(licm_invariant) \
+	TEST(licm_variant) \
+	TEST(licm_division) \
+	TEST(induction_multiply) \
+	TEST(induction_exit_test) \
+	TEST(induction_used_after_loop) \
+	TEST(inline_small_function) \
+	TEST(inline_recursive_function) \
+	TEST(inline_disabled) \
+	TEST(tail_call_loop) \
+	TEST(tail_call_swapped_params) \
+	TEST(tail_call_not_in_tail_position) \
+	TEST(specialize_literal_flag) \
+	TEST(specialize_nothing_to_fold) \
+	TEST(copy_propagation_inlined_call) \
+	TEST(copy_propagation_not_dominated) \
+	TEST(copy_propagation_temporaries) \
+	TEST(rotate_while_loop) \
+	TEST(rotate_or_condition) \
+	TEST(vectorize_sum) \
+	TEST(vectorize_int_multiplication) \
+	TEST(unroll_completely) \
+	TEST(unroll_by_factor) \
+	TEST(unroll_budget) \
+	TEST(counted_loop_shape) \
+	TEST(layout_loop_exit) \
+	TEST(layout_balanced_branches) \
+	TEST(profile_instrument) \
+	TEST(profile_layout) \
+	TEST(liveness_loop) \
+	TEST(pass_manager_cached_analyses) \
+	TEST(pass_manager_pipeline) \
+	TEST(call_graph_reachable) \
+	TEST(call_graph_remove_unreachable)
+
+// clang-format on
+
+#include "main_stub.inc"
+#undef TESTS
@@ -7,6 +7,7 @@
 #include "mcc/asm.h"
 #include "mcc/ast.h"
 #include "mcc/ir.h"
+#include "mcc/licm.h"
 #include "mcc/semantic_checks.h"
 #include "mcc/stack_size.h"
 #include "mcc/symbol_table.h"
@@ -91,10 +92,12 @@ void test_int_temporaries(CuTest *tc)
 
 	// an_ir
 	CuAssertPtrNotNull(tc, an_ir);
+	// The variable comes first. The product is read by the sum, which may compute it in place when it is assigned,
+	// so the temporaries overlap.
 	CuAssertIntEquals(tc, 3 * DWORD_SIZE, an_ir->stack_size);
-	CuAssertIntEquals(tc, -1 * DWORD_SIZE, an_ir->next->stack_position);
-	CuAssertIntEquals(tc, -2 * DWORD_SIZE, an_ir->next->next->stack_position);
-	CuAssertIntEquals(tc, -3 * DWORD_SIZE, an_ir->next->next->next->stack_position);
+	CuAssertIntEquals(tc, -2 * DWORD_SIZE, an_ir->next->stack_position);
+	CuAssertIntEquals(tc, -3 * DWORD_SIZE, an_ir->next->next->stack_position);
+	CuAssertIntEquals(tc, -1 * DWORD_SIZE, an_ir->next->next->next->stack_position);
 
 	// Cleanup
 	mcc_ir_delete_ir(ir);
@@ -141,6 +144,47 @@ void test_int_array(CuTest *tc)
 	mcc_delete_annotated_ir(first);
 }
 
+void test_bool_array(CuTest *tc)
+{
+	// Define test input and create IR -> the elements take a byte, or a bit if packed, rounded up to whole slots
+	const char input[] = "int main(){bool [42]a; a[0] = true; a[41] = true; return 0;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_annotated_ir *an_ir = mcc_annotate_ir(ir);
+	CuAssertPtrNotNull(tc, an_ir);
+	// Function and array
+	CuAssertIntEquals(tc, 11 * DWORD_SIZE, an_ir->stack_size);
+	CuAssertIntEquals(tc, -11 * DWORD_SIZE, an_ir->next->stack_position);
+	// a[41]
+	CuAssertIntEquals(tc, -11 * DWORD_SIZE + 41, an_ir->next->next->next->stack_position);
+	mcc_delete_annotated_ir(an_ir);
+
+	struct mcc_stack_layout layout = {.slot_size = DWORD_SIZE, .pack_bool_arrays = true};
+	an_ir = mcc_annotate_ir_with_layout(ir, &layout);
+	CuAssertPtrNotNull(tc, an_ir);
+	CuAssertIntEquals(tc, 2 * DWORD_SIZE, an_ir->stack_size);
+	mcc_delete_annotated_ir(an_ir);
+
+	layout = (struct mcc_stack_layout){.slot_size = QWORD_SIZE, .pack_bool_arrays = false};
+	an_ir = mcc_annotate_ir_with_layout(ir, &layout);
+	CuAssertPtrNotNull(tc, an_ir);
+	CuAssertIntEquals(tc, 6 * QWORD_SIZE, an_ir->stack_size);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_delete_annotated_ir(an_ir);
+}
+
 void test_int_multiple_references(CuTest *tc)
 {
 	// Define test input and create IR -> produces 2 temporaries
@@ -297,6 +341,90 @@ void test_string_array(CuTest *tc)
 	mcc_delete_annotated_ir(first);
 }
 
+void test_shared_temporaries(CuTest *tc)
+{
+	// Define test input and create IR -> produces 4 temporaries, 2 per statement
+	const char input[] = "int main(){int a; a = 1 + (2*2); a = a + (3*3); return a;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+
+	struct mcc_annotated_ir *an_ir = mcc_annotate_ir(ir);
+	struct mcc_annotated_ir *first = an_ir;
+
+	// The temporaries of the second statement reuse the slots of the first one
+	CuAssertPtrNotNull(tc, an_ir);
+	CuAssertIntEquals(tc, 3 * DWORD_SIZE, an_ir->stack_size);
+	an_ir = an_ir->next;
+	CuAssertIntEquals(tc, -2 * DWORD_SIZE, an_ir->stack_position);
+	an_ir = an_ir->next;
+	CuAssertIntEquals(tc, -3 * DWORD_SIZE, an_ir->stack_position);
+	an_ir = an_ir->next;
+	CuAssertIntEquals(tc, -1 * DWORD_SIZE, an_ir->stack_position);
+	an_ir = an_ir->next;
+	CuAssertIntEquals(tc, -2 * DWORD_SIZE, an_ir->stack_position);
+	an_ir = an_ir->next;
+	CuAssertIntEquals(tc, -3 * DWORD_SIZE, an_ir->stack_position);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_delete_annotated_ir(first);
+}
+
+void test_temporary_used_in_loop(CuTest *tc)
+{
+	// Define test input and create IR -> a * 2 is moved in front of the loop and read in every iteration
+	const char input[] =
+	    "int main(){int a; int i; a = 3; i = 0; while (i < 10) { i = i + a * 2; i = i + 1; } return i;}";
+	struct mcc_parser_result parser_result;
+	parser_result = mcc_parse_string(input, MCC_PARSER_ENTRY_POINT_PROGRAM, "test");
+	CuAssertIntEquals(tc, parser_result.status, MCC_PARSER_STATUS_OK);
+	struct mcc_symbol_table *table = mcc_symbol_table_create((&parser_result)->program);
+	struct mcc_semantic_check *checks = mcc_semantic_check_run_all((&parser_result)->program, table);
+	CuAssertIntEquals(tc, checks->status, MCC_SEMANTIC_CHECK_OK);
+	struct mcc_ir_row *ir = mcc_ir_generate((&parser_result)->program);
+	CuAssertPtrNotNull(tc, ir);
+	CuAssertTrue(tc, mcc_licm_run(ir));
+
+	struct mcc_annotated_ir *an_ir = mcc_annotate_ir(ir);
+	struct mcc_annotated_ir *first = an_ir;
+	CuAssertPtrNotNull(tc, an_ir);
+
+	struct mcc_annotated_ir *product = an_ir;
+	while (product && product->row->instr != MCC_IR_INSTR_MULTIPLY)
+		product = product->next;
+	CuAssertPtrNotNull(tc, product);
+
+	// The product keeps its slot through the whole loop, the condition and the two sums in the loop share another one
+	unsigned num_in_loop = 0;
+	int shared_position = 0;
+	for (an_ir = product->next; an_ir; an_ir = an_ir->next) {
+		if (an_ir->row->instr == MCC_IR_INSTR_ASSIGN || an_ir->stack_size == 0)
+			continue;
+		CuAssertTrue(tc, an_ir->stack_position != product->stack_position);
+		if (num_in_loop++ == 0)
+			shared_position = an_ir->stack_position;
+		CuAssertIntEquals(tc, shared_position, an_ir->stack_position);
+	}
+	CuAssertIntEquals(tc, 3, num_in_loop);
+	CuAssertIntEquals(tc, 4 * DWORD_SIZE, first->stack_size);
+
+	// Cleanup
+	mcc_ir_delete_ir(ir);
+	mcc_ast_delete(parser_result.program);
+	mcc_symbol_table_delete_table(table);
+	mcc_semantic_check_delete_single_check(checks);
+	mcc_delete_annotated_ir(first);
+}
+
 // clang-format off
 
 #define TESTS \
@@ -305,9 +433,12 @@ void test_string_array(CuTest *tc)
 	TEST(test_ints) \
 	TEST(test_int_temporaries) \
 	TEST(test_int_array) \
+	TEST(test_bool_array) \
 	TEST(test_int_multiple_references) \
 	TEST(test_strings) \
-	TEST(test_string_array)
+	TEST(test_string_array) \
+	TEST(test_shared_temporaries) \
+	TEST(test_temporary_used_in_loop)
 
 // clang-format on
 